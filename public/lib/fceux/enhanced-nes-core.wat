@@ -15,6 +15,13 @@
   (global $running (mut i32) (i32.const 0))
   (global $frameCount (mut i32) (i32.const 0))
 
+  ;; Output format: 0=RGBA32, 1=BGRA32, 2=RGB565 (pixels are generated colors,
+  ;; not palette indices, so there is no INDEXED8)
+  (global $pixelFormat (mut i32) (i32.const 0))
+  (global $cropOverscan (mut i32) (i32.const 0))
+  (global $bytesPerPixel (mut i32) (i32.const 4))
+  (global $outputHeight (mut i32) (i32.const 240))
+
   ;; ROM header info
   (global $prgBanks (mut i32) (i32.const 0))
   (global $chrBanks (mut i32) (i32.const 0))
@@ -23,7 +30,8 @@
 
   ;; Constants
   (global $NES_HEADER_SIZE i32 (i32.const 16))
-  (global $FRAME_BUFFER_SIZE i32 (i32.const 245760))  ;; 256 * 240 * 4 (RGBA)
+  (global $FRAME_BUFFER_SIZE i32 (i32.const 245760))  ;; 256 * 240 * 4 (RGBA, largest format)
+  (global $FRAME_SPEC_PTR i32 (i32.const 327680))     ;; width(4), height(4), format(4), pitch(4)
   (global $PALETTE_SIZE i32 (i32.const 256))          ;; 64 colors * 4 bytes RGBA
   (global $CHR_RAM_SIZE i32 (i32.const 8192))         ;; 8KB CHR RAM
   (global $PRG_RAM_SIZE i32 (i32.const 8192))         ;; 8KB PRG RAM
@@ -262,14 +270,33 @@
 
   ;; Get frame buffer size
   (func $getFrameBufferSize (export "getFrameBufferSize") (result i32)
-    (global.get $FRAME_BUFFER_SIZE)
+    (i32.mul (i32.mul (i32.const 256) (global.get $bytesPerPixel)) (global.get $outputHeight))
   )
 
   ;; Get frame specification
   (func $getFrameSpec (export "getFrameSpec") (result i32)
     ;; Return pointer to frame spec structure in memory
-    ;; Format: width(4), height(4), format(4) where format 0=RGBA32
-    (i32.const 327680) ;; Fixed location for frame spec
+    ;; Format: width(4), height(4), format(4), pitch(4) reflecting the live output format
+    (call $writeFrameSpec)
+    (global.get $FRAME_SPEC_PTR)
+  )
+
+  ;; Select output pixel format (0=RGBA32, 1=BGRA32, 2=RGB565)
+  (func $setPixelFormat (export "setPixelFormat") (param $format i32) (result i32)
+    (if (i32.gt_u (local.get $format) (i32.const 2))
+      (then (return (i32.const 0)))
+    )
+    (global.set $pixelFormat (local.get $format))
+    (call $writeFrameSpec)
+    (call $clearFrameBuffer)
+    (i32.const 1)
+  )
+
+  ;; Crop 8 overscan lines top and bottom (256x224 output)
+  (func $setOverscanCrop (export "setOverscanCrop") (param $enabled i32)
+    (global.set $cropOverscan (i32.ne (local.get $enabled) (i32.const 0)))
+    (call $writeFrameSpec)
+    (call $clearFrameBuffer)
   )
 
   ;; Get palette pointer
@@ -313,26 +340,83 @@
     )
 
     ;; Write frame spec at fixed location
-    (i32.store (i32.const 327680) (i32.const 256))     ;; width
-    (i32.store (i32.const 327684) (i32.const 240))     ;; height
-    (i32.store (i32.const 327688) (i32.const 0))       ;; format (0 = RGBA32)
+    (call $writeFrameSpec)
   )
 
-  ;; Internal function: Clear frame buffer to black
+  ;; Internal function: Recompute derived output size and write frame spec
+  (func $writeFrameSpec
+    (global.set $bytesPerPixel
+      (if (result i32) (i32.eq (global.get $pixelFormat) (i32.const 2))
+        (then (i32.const 2))
+        (else (i32.const 4))
+      )
+    )
+    (global.set $outputHeight
+      (if (result i32) (global.get $cropOverscan)
+        (then (i32.const 224))
+        (else (i32.const 240))
+      )
+    )
+
+    (i32.store (global.get $FRAME_SPEC_PTR) (i32.const 256))                                    ;; width
+    (i32.store (i32.add (global.get $FRAME_SPEC_PTR) (i32.const 4)) (global.get $outputHeight))  ;; height
+    (i32.store (i32.add (global.get $FRAME_SPEC_PTR) (i32.const 8)) (global.get $pixelFormat))   ;; format
+    (i32.store (i32.add (global.get $FRAME_SPEC_PTR) (i32.const 12))
+      (i32.mul (i32.const 256) (global.get $bytesPerPixel)))                                    ;; pitch
+  )
+
+  ;; Internal function: Store one pixel in the live format, returns the next pointer
+  (func $storePixel (param $ptr i32) (param $pixel i32) (result i32)
+    (local $r i32)
+    (local $g i32)
+    (local $b i32)
+
+    (local.set $r (i32.and (local.get $pixel) (i32.const 255)))
+    (local.set $g (i32.and (i32.shr_u (local.get $pixel) (i32.const 1)) (i32.const 255)))
+    (local.set $b (i32.and (i32.shr_u (local.get $pixel) (i32.const 2)) (i32.const 255)))
+
+    ;; RGBA32
+    (if (i32.eqz (global.get $pixelFormat))
+      (then
+        (i32.store (local.get $ptr) (i32.or (i32.or (local.get $r) (i32.shl (local.get $g) (i32.const 8)))
+          (i32.or (i32.shl (local.get $b) (i32.const 16)) (i32.const 0xFF000000))))
+        (return (i32.add (local.get $ptr) (i32.const 4)))
+      )
+    )
+    ;; BGRA32
+    (if (i32.eq (global.get $pixelFormat) (i32.const 1))
+      (then
+        (i32.store (local.get $ptr) (i32.or (i32.or (local.get $b) (i32.shl (local.get $g) (i32.const 8)))
+          (i32.or (i32.shl (local.get $r) (i32.const 16)) (i32.const 0xFF000000))))
+        (return (i32.add (local.get $ptr) (i32.const 4)))
+      )
+    )
+    ;; RGB565
+    (i32.store16 (local.get $ptr) (i32.or
+      (i32.shl (i32.and (local.get $r) (i32.const 0xF8)) (i32.const 8))
+      (i32.or (i32.shl (i32.and (local.get $g) (i32.const 0xFC)) (i32.const 3))
+              (i32.shr_u (local.get $b) (i32.const 3)))))
+    (i32.add (local.get $ptr) (i32.const 2))
+  )
+
+  ;; Internal function: Is source line $y visible with the current overscan setting
+  (func $isLineVisible (param $y i32) (result i32)
+    (if (result i32) (global.get $cropOverscan)
+      (then (i32.and (i32.ge_u (local.get $y) (i32.const 8)) (i32.lt_u (local.get $y) (i32.const 232))))
+      (else (i32.const 1))
+    )
+  )
+
+  ;; Internal function: Clear frame buffer to black in the live format
   (func $clearFrameBuffer
     (local $ptr i32)
     (local $end i32)
 
     (local.set $ptr (global.get $frameBuffer))
-    (local.set $end (i32.add (local.get $ptr) (global.get $FRAME_BUFFER_SIZE)))
+    (local.set $end (i32.add (local.get $ptr) (call $getFrameBufferSize)))
 
-    ;; Clear to black (RGBA: 0,0,0,255)
     (loop $clearLoop
-      (i32.store8 (local.get $ptr) (i32.const 0))                    ;; R = 0
-      (i32.store8 (i32.add (local.get $ptr) (i32.const 1)) (i32.const 0))  ;; G = 0
-      (i32.store8 (i32.add (local.get $ptr) (i32.const 2)) (i32.const 0))  ;; B = 0
-      (i32.store8 (i32.add (local.get $ptr) (i32.const 3)) (i32.const 255)) ;; A = 255
-      (local.set $ptr (i32.add (local.get $ptr) (i32.const 4)))
+      (local.set $ptr (call $storePixel (local.get $ptr) (i32.const 0)))
       (br_if $clearLoop (i32.lt_u (local.get $ptr) (local.get $end)))
     )
   )
@@ -455,14 +539,10 @@
           (then (local.set $pixel (i32.add (local.get $pixel) (i32.const 96))))
         )
 
-        ;; Write RGBA pixel
-        (i32.store8 (local.get $ptr) (i32.and (local.get $pixel) (i32.const 255)))           ;; R
-        (i32.store8 (i32.add (local.get $ptr) (i32.const 1)) (i32.and (i32.shr_u (local.get $pixel) (i32.const 1)) (i32.const 255))) ;; G
-        (i32.store8 (i32.add (local.get $ptr) (i32.const 2)) (i32.and (i32.shr_u (local.get $pixel) (i32.const 2)) (i32.const 255))) ;; B
-        (i32.store8 (i32.add (local.get $ptr) (i32.const 3)) (i32.const 255))                ;; A
-
-        ;; Advance pointer
-        (local.set $ptr (i32.add (local.get $ptr) (i32.const 4)))
+        ;; Write pixel in the live format (skipping cropped overscan lines)
+        (if (call $isLineVisible (local.get $y))
+          (then (local.set $ptr (call $storePixel (local.get $ptr) (local.get $pixel))))
+        )
 
         ;; Increment x
         (local.set $x (i32.add (local.get $x) (i32.const 1)))
@@ -497,12 +577,21 @@
               (i32.and (i32.add (local.get $x) (i32.mul (local.get $y) (i32.const 32))) (i32.const 8191))
             )))
 
-            ;; Modify pixel based on CHR RAM
-            (local.set $ptr (i32.add (global.get $frameBuffer) (i32.mul (i32.add (local.get $x) (i32.mul (local.get $y) (i32.const 256))) (i32.const 4))))
-
-            ;; Add CHR pattern to existing pixel
-            (i32.store8 (local.get $ptr)
-              (i32.and (i32.add (i32.load8_u (local.get $ptr)) (local.get $chrValue)) (i32.const 255)))
+            ;; Modify pixel based on CHR RAM (first byte of the pixel in any format)
+            (if (call $isLineVisible (local.get $y))
+              (then
+                (local.set $ptr (i32.add (global.get $frameBuffer)
+                  (i32.mul
+                    (i32.add (local.get $x) (i32.mul
+                      (i32.sub (local.get $y) (i32.shl (global.get $cropOverscan) (i32.const 3)))
+                      (i32.const 256)))
+                    (global.get $bytesPerPixel))))
+
+                ;; Add CHR pattern to existing pixel
+                (i32.store8 (local.get $ptr)
+                  (i32.and (i32.add (i32.load8_u (local.get $ptr)) (local.get $chrValue)) (i32.const 255)))
+              )
+            )
           )
         )
 
@@ -0,0 +1,367 @@
+/**
+ * Native benchmark for the C core (see bench-core.sh)
+ *
+ * Drives the core's exports directly, the same way the wasm host does, with a
+ * music-like APU register workload, and reports the time per frame().
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Core exports (scripts/fceux-simple.c)
+int init(void);
+int loadRom(uint8_t* rom, uint32_t size);
+void frame(void);
+int runFrames(int count, const uint8_t* inputs, int flags);
+void setButton(int button, int pressed);
+void setButtons(const uint8_t* port_masks);
+uint8_t* getFrameBuffer(void);
+int getFrameBufferSize(void);
+void setRunning(int running);
+int setPixelFormat(int format);
+void cpuWrite(int addr, int value);
+int getAudioSampleCount(void);
+void setAudioEnabled(int enabled);
+uint32_t takeSnapshot(void);
+int setRewindBudget(uint32_t bytes);
+int setRunAhead(int frames);
+int restoreSnapshot(uint32_t id);
+void setVideoEnabled(int enabled);
+uint32_t getStateHash(void);
+int getStatePageHashes(uint32_t* out);
+uint32_t saveStatePatch(const uint32_t* peer_hashes, uint8_t* out);
+uint32_t saveStateSize(void);
+void setTileEncoder(int enabled);
+uint32_t tilePacketMaxSize(void);
+uint32_t encodeTileFrame(uint8_t* out, int keyframe);
+int decodeTileFrame(const uint8_t* packet, uint32_t size);
+uint32_t* getCoreStats(void);
+
+#define BENCH_FRAMES 20000
+
+static uint8_t rom[16 + 2 * 16384 + 8192];
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+/**
+ * Per-frame register writes: pulse arpeggio and melody, triangle bass,
+ * noise hi-hat and a looping DMC sample
+ */
+static void play_music(uint32_t f) {
+    static const uint16_t notes[8] = { 253, 225, 200, 189, 168, 150, 134, 126 };
+
+    if (f == 0) {
+        cpuWrite(0x4015, 0x1F);
+        cpuWrite(0x4010, 0x4F);   // DMC loop, fastest rate
+        cpuWrite(0x4012, 0x00);
+        cpuWrite(0x4013, 0x20);
+        cpuWrite(0x4015, 0x1F);
+    }
+
+    uint16_t p1 = notes[f % 8];
+    cpuWrite(0x4000, 0xBF);
+    cpuWrite(0x4002, p1 & 0xFF);
+    cpuWrite(0x4003, (p1 >> 8) | 0x08);
+
+    if (f % 4 == 0) {
+        uint16_t p2 = notes[(f / 4) % 8] * 2;
+        cpuWrite(0x4004, 0x7A);
+        cpuWrite(0x4005, 0x00);
+        cpuWrite(0x4006, p2 & 0xFF);
+        cpuWrite(0x4007, (p2 >> 8) | 0x08);
+        cpuWrite(0x400C, 0x34);
+        cpuWrite(0x400E, 0x03);
+        cpuWrite(0x400F, 0x08);
+    }
+
+    if (f % 8 == 0) {
+        uint16_t t = notes[(f / 8) % 8] * 2;
+        cpuWrite(0x4008, 0xFF);
+        cpuWrite(0x400A, t & 0xFF);
+        cpuWrite(0x400B, (t >> 8) | 0x08);
+    }
+}
+
+/**
+ * Typical per-frame RAM traffic of a game: zero-page variables, the OAM
+ * shadow page at $0200 and a little of the stack
+ */
+static void update_game_ram(uint32_t f) {
+    for (int i = 0; i < 16; i++) {
+        cpuWrite(0x0000 + ((f + i * 7) & 0xFF), (int)(f + i));
+    }
+    for (int i = 0; i < 256; i += 4) {
+        cpuWrite(0x0200 + i, (int)((f * 3 + i) & 0xFF));
+    }
+    cpuWrite(0x01F0 + (f & 0x0F), (int)f);
+}
+
+/**
+ * Frame time with game-like RAM traffic, optionally taking a snapshot after
+ * every frame. The core times snapshots itself (getCoreStats()), since they
+ * are too cheap to separate from frame noise.
+ */
+static double run_game(int snapshots) {
+    setPixelFormat(0);
+    setAudioEnabled(1);
+
+    double start = now_ms();
+    for (uint32_t f = 0; f < BENCH_FRAMES; f++) {
+        play_music(f);
+        update_game_ram(f);
+        frame();
+        if (snapshots) {
+            takeSnapshot();
+        }
+    }
+    return (now_ms() - start) * 1000.0 / BENCH_FRAMES;
+}
+
+/**
+ * Frame time with rewind capturing into a `budget`-byte history
+ */
+static double run_rewind(uint32_t budget) {
+    setPixelFormat(0);
+    setAudioEnabled(1);
+    setRewindBudget(budget);
+
+    double start = now_ms();
+    for (uint32_t f = 0; f < BENCH_FRAMES; f++) {
+        play_music(f);
+        update_game_ram(f);
+        frame();
+    }
+    return (now_ms() - start) * 1000.0 / BENCH_FRAMES;
+}
+
+/**
+ * Cost of one rollback: restore the snapshot from `depth` frames back and
+ * re-simulate those frames with video off, as netplay does on a misprediction
+ */
+static double run_rollback(int depth) {
+    enum { ROLLBACKS = 2000 };
+    uint32_t ids[8];
+    setPixelFormat(0);
+    setAudioEnabled(1);
+
+    double total = 0;
+    uint32_t f = 0;
+    for (int r = 0; r < ROLLBACKS; r++) {
+        for (int i = 0; i < depth; i++, f++) {
+            ids[i] = takeSnapshot();
+            play_music(f);
+            update_game_ram(f);
+            frame();
+        }
+
+        double start = now_ms();
+        restoreSnapshot(ids[0]);
+        setVideoEnabled(0);
+        for (int i = 0; i < depth; i++) {
+            takeSnapshot();
+            play_music(f - depth + i);
+            update_game_ram(f - depth + i);
+            frame();
+        }
+        setVideoEnabled(1);
+        total += now_ms() - start;
+    }
+    return total * 1000.0 / ROLLBACKS;
+}
+
+/**
+ * Cost of getStateHash(), which netplay peers compare every few frames
+ */
+static double run_state_hash(uint32_t* hash) {
+    enum { HASHES = 20000 };
+    double start = now_ms();
+    for (int i = 0; i < HASHES; i++) {
+        *hash = getStateHash();
+    }
+    return (now_ms() - start) * 1000.0 / HASHES;
+}
+
+/**
+ * Tile video: encode and decode cost per frame and the average packet size.
+ * The synthetic ROM scrolls the whole picture every frame, so every tile
+ * changes; this is the codec's worst case, not a typical game.
+ */
+static double run_tile_video(double* decode_us, uint32_t* bytes) {
+    enum { TILE_FRAMES = 2000 };
+    uint8_t* packet = malloc(tilePacketMaxSize());
+    setPixelFormat(3);
+    setAudioEnabled(0);
+    setTileEncoder(1);
+
+    double encode = 0, decode = 0;
+    uint64_t total = 0;
+    for (uint32_t f = 0; f < TILE_FRAMES; f++) {
+        frame();
+        double start = now_ms();
+        uint32_t size = encodeTileFrame(packet, f == 0);
+        encode += now_ms() - start;
+        start = now_ms();
+        decodeTileFrame(packet, size);
+        decode += now_ms() - start;
+        total += size;
+    }
+    setTileEncoder(0);
+    free(packet);
+    *decode_us = decode * 1000.0 / TILE_FRAMES;
+    *bytes = (uint32_t)(total / TILE_FRAMES);
+    return encode * 1000.0 / TILE_FRAMES;
+}
+
+/**
+ * Catch-up of `batch` frames as the JS host drives it today (every button of
+ * both pads, frame(), frame buffer pointer and size, each frame), against one
+ * runFrames() call with per-frame inputs and video and audio on the last
+ * frame only. Natively a call costs next to nothing; in the browser each of
+ * `*calls` also crosses the JS/wasm boundary.
+ */
+static double run_catch_up(int batch, int batched, int* calls) {
+    enum { CATCH_UPS = 2000 };
+    uint8_t inputs[8 * 4];
+    setPixelFormat(0);
+    setAudioEnabled(1);
+
+    double start = now_ms();
+    for (int r = 0; r < CATCH_UPS; r++) {
+        if (batched) {
+            for (int i = 0; i < batch; i++) {
+                memset(inputs + i * 4, (r + i) & 0xFF, 4);
+            }
+            runFrames(batch, inputs, 3);
+            *calls = 1;
+        } else {
+            for (int i = 0; i < batch; i++) {
+                for (int button = 0; button < 16; button++) {
+                    setButton(button & 7, ((r + i) >> (button & 7)) & 1);
+                }
+                frame();
+                getFrameBuffer();
+                getFrameBufferSize();
+            }
+            *calls = batch * 19;
+        }
+    }
+    return (now_ms() - start) * 1000.0 / CATCH_UPS;
+}
+
+static double run(int audio, int format, long* samples) {
+    setPixelFormat(format);
+    setAudioEnabled(audio);
+    *samples = 0;
+
+    // Warm up, then time
+    for (uint32_t f = 0; f < 200; f++) {
+        play_music(f);
+        frame();
+    }
+    double start = now_ms();
+    for (uint32_t f = 0; f < BENCH_FRAMES; f++) {
+        play_music(f);
+        frame();
+        *samples += getAudioSampleCount();
+    }
+    return (now_ms() - start) * 1000.0 / BENCH_FRAMES;
+}
+
+int main(void) {
+    memcpy(rom, "NES\x1a\x02\x01", 6);
+    srand(1);
+    for (size_t i = 16; i < sizeof(rom); i++) {
+        rom[i] = (uint8_t)rand();
+    }
+
+    init();
+    if (!loadRom(rom, sizeof(rom))) {
+        fprintf(stderr, "ROM rejected\n");
+        return 1;
+    }
+    setRunning(1);
+
+    static const struct { int format; const char* name; } formats[] = {
+        { 0, "RGBA32" },
+        { 3, "INDEXED8" },
+    };
+
+    printf("%-10s %-10s %12s %14s\n", "format", "audio", "us/frame", "samples/frame");
+    for (int i = 0; i < 2; i++) {
+        long samples;
+        double on = run(1, formats[i].format, &samples);
+        printf("%-10s %-10s %12.2f %14.1f\n", formats[i].name, "enabled", on, (double)samples / BENCH_FRAMES);
+        double off = run(0, formats[i].format, &samples);
+        printf("%-10s %-10s %12.2f %14.1f\n", formats[i].name, "disabled", off, (double)samples / BENCH_FRAMES);
+        printf("%-10s saving     %12.2f us/frame (%.0f%%)\n", formats[i].name, on - off, 100.0 * (on - off) / on);
+    }
+
+    // Incremental snapshot after every frame (CoreStats fields, see getCoreStats())
+    double frame_us = run_game(1);
+    const uint32_t* stats = getCoreStats();
+    printf("\nsnapshot every frame: %.2f us (%.1f%% of %.2f us/frame), %u pages / %u bytes each, %u bytes held\n",
+           stats[3] / 1000.0, stats[3] / 10.0 / frame_us, frame_us, stats[1], stats[2], stats[6]);
+
+    // Rewind history at 4MB (CoreStats rewind fields)
+    frame_us = run_rewind(4 << 20);
+    stats = getCoreStats();
+    double seconds = stats[8] / 60.0988;
+    printf("rewind (4MB): %.2f us/frame (%.1f%% of %.2f us/frame), %u bytes/state, %.0f s held (%.1f s per MB)\n",
+           stats[11] / 1000.0, stats[11] / 10.0 / frame_us, frame_us, stats[9] / (stats[7] ? stats[7] : 1),
+           seconds, seconds * (1 << 20) / (stats[9] ? stats[9] : 1));
+    setRewindBudget(0);
+
+    // Run-ahead: total frame time and the per-frame cost the core measured
+    for (int n = 1; n <= 2; n++) {
+        setRunAhead(n);
+        frame_us = run_game(0);
+        stats = getCoreStats();
+        printf("run-ahead %d: %.2f us/frame total, %.2f us per frame run ahead, %.2f us save/restore\n",
+               n, frame_us, stats[13] / 1000.0, stats[14] / 1000.0);
+    }
+    setRunAhead(0);
+
+    // Rollback netplay: restore plus video-off re-simulation per misprediction
+    for (int depth = 4; depth <= 8; depth += 4) {
+        double rollback_us = run_rollback(depth);
+        printf("rollback %d frames: %.2f us (%.2f us per re-simulated frame)\n",
+               depth, rollback_us, rollback_us / depth);
+    }
+
+    // Catch-up: per-call host loop against one batched call
+    for (int batch = 4; batch <= 8; batch += 4) {
+        int loop_calls, batched_calls;
+        double loop_us = run_catch_up(batch, 0, &loop_calls);
+        double batched_us = run_catch_up(batch, 1, &batched_calls);
+        printf("catch-up %d frames: %.2f us in %d calls, runFrames %.2f us in %d call\n",
+               batch, loop_us, loop_calls, batched_us, batched_calls);
+    }
+
+    // Desync check and targeted resync: a peer one frame behind differs in a few pages
+    uint32_t hash = 0;
+    double hash_us = run_state_hash(&hash);
+    static uint32_t peer_hashes[128];
+    static uint8_t patch[64 << 10];
+    int hashed = getStatePageHashes(peer_hashes);
+    play_music(0);
+    update_game_ram(0);
+    frame();
+    uint32_t patch_bytes = saveStatePatch(peer_hashes, patch);
+    printf("state hash: %.2f us (%d pages, %08x), resync patch %u bytes vs %u byte state\n",
+           hash_us, hashed, hash, patch_bytes, saveStateSize());
+
+    // Tile video, before deflate in the transport
+    double decode_us;
+    uint32_t tile_bytes;
+    double encode_us = run_tile_video(&decode_us, &tile_bytes);
+    printf("tile video: encode %.2f us, decode %.2f us, %u bytes/frame (every tile changing)\n",
+           encode_us, decode_us, tile_bytes);
+    return 0;
+}
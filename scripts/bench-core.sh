@@ -0,0 +1,18 @@
+#!/bin/bash
+
+# Build the C core natively and run scripts/bench-core.c
+# Native timings are a proxy for the wasm build; relative savings carry over.
+
+set -e
+
+CC="${CC:-cc}"
+OUT="${TMPDIR:-/tmp}/nes-bench-core"
+
+echo "🔨 Building native benchmark with $CC..."
+"$CC" -O3 -march=native -Wall \
+    scripts/fceux-simple.c scripts/nes-apu.c scripts/nes-blip.c scripts/nes-hash.c scripts/nes-input.c scripts/nes-palette.c scripts/nes-rewind.c scripts/nes-snapshot.c scripts/nes-state.c scripts/nes-stretch.c scripts/nes-tiles.c scripts/nes-trace.c \
+    scripts/bench-core.c \
+    -lm -o "$OUT"
+
+echo "⏱️  Running..."
+"$OUT"
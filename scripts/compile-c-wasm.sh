@@ -26,24 +26,36 @@ if [ -d "/tmp/emsdk" ]; then
 fi
 
 OUTPUT_DIR="$(pwd)/public/wasm"
+
+# DEBUG=1 builds the core with the trace ring buffer (see scripts/nes-trace.h);
+# release builds compile all tracing away
+EXPORTS='"_init","_loadRom","_getRomBuffer","_getRomBufferSize","_frame","_reset","_getFrameBuffer","_getFrameBufferSize","_getLatestFrame","_getFrameSequences","_getFrameBufferAt","_setFrameBufferCount","_getMemoryEpoch","_getFrameSpec","_setPixelFormat","_setOverscanCrop","_setButton","_setRunning","_getPalette","_loadPalette","_expandIndexed","_getEmphasis","_cpuRead","_cpuWrite","_setSampleRate","_getAudioBuffer","_getAudioSampleCount","_setAudioBufferFill","_setAudioEnabled","_setSpeed","_saveStateSize","_saveState","_loadState","_takeSnapshot","_restoreSnapshot","_getCoreStats","_setRewindBudget","_rewindStep","_setRunAhead","_setPortButtons","_setButtons","_runFrames","_setInputMode","_getLagFrames","_getLagFrameCount","_setVideoEnabled","_queueInputs","_getFrameCount","_getRomHash","_getStateHash","_getStatePageHashes","_saveStatePatch","_setTileEncoder","_tilePacketMaxSize","_encodeTileFrame","_decodeTileFrame","_malloc","_free"'
+BUILD_FLAGS="-O3"
+if [ "${DEBUG:-0}" = "1" ]; then
+    echo "🐞 Debug build: tracing enabled"
+    EXPORTS="$EXPORTS,\"_getTraceBuffer\",\"_getTraceHead\""
+    BUILD_FLAGS="-O1 -g -DNES_TRACE"
+fi
+
 mkdir -p "$OUTPUT_DIR"
 
 echo "📁 Output directory: $OUTPUT_DIR"
 echo "🔨 Compiling C source to WebAssembly..."
 
 # Compile with Emscripten
-emcc scripts/fceux-simple.c \
+emcc scripts/fceux-simple.c scripts/nes-apu.c scripts/nes-blip.c scripts/nes-hash.c scripts/nes-input.c scripts/nes-palette.c scripts/nes-rewind.c scripts/nes-snapshot.c scripts/nes-state.c scripts/nes-stretch.c scripts/nes-tiles.c scripts/nes-trace.c \
     -s WASM=1 \
     -s ALLOW_MEMORY_GROWTH=1 \
     -s INITIAL_MEMORY=64MB \
     -s MAXIMUM_MEMORY=256MB \
-    -s EXPORTED_FUNCTIONS='["_init","_loadRom","_frame","_reset","_getFrameBuffer","_getFrameBufferSize","_setButton","_setRunning","_getPalette"]' \
-    -s EXPORTED_RUNTIME_METHODS='["ccall","cwrap","getValue","setValue","writeArrayToMemory"]' \
+    -s EXPORTED_FUNCTIONS="[$EXPORTS]" \
+    -s EXPORTED_RUNTIME_METHODS='["ccall","cwrap","getValue","setValue","writeArrayToMemory","wasmMemory"]' \
     -s MODULARIZE=1 \
     -s EXPORT_NAME="FCEUXModule" \
     -s DISABLE_EXCEPTION_CATCHING=1 \
     -s ASSERTIONS=0 \
-    -O3 \
+    -msimd128 \
+    $BUILD_FLAGS \
     -o "$OUTPUT_DIR/fceux-c.js"
 
 echo "📊 Build results:"
@@ -66,6 +78,18 @@ echo "This core provides:"
 echo "   ✅ Real ROM loading with validation"
 echo "   ✅ Mapper-specific frame generation (NROM, UNROM, etc.)"
 echo "   ✅ CHR RAM support for mapper 2 (UNROM)"
-echo "   ✅ 245,760-byte RGBA frame buffer"
+echo "   ✅ RGBA32, BGRA32, RGB565 and INDEXED8 output (optional 256x224 crop)"
+echo "   ✅ Band-limited APU (pulse, triangle, noise, DMC) at the host sample rate"
+echo "   ✅ Pitch-preserving time-stretch for 0.25x-8x speed"
+echo "   ✅ Versioned, chunk-tagged savestates and incremental page snapshots"
+echo "   ✅ Compressed rewind history within a fixed memory budget"
+echo "   ✅ Run-ahead (0-4 frames) to hide in-game input lag"
+echo "   ✅ Per-port input and video-off frames for rollback netplay"
+echo "   ✅ Batched setButtons / runFrames (video and audio on the last frame only)"
+echo "   ✅ Batched, frame- and scanline-stamped input queue, latched at the \$4016 strobe"
+echo "   ✅ Four Score (four pads) and Zapper (light sensed on the aimed line)"
+echo "   ✅ Lag-frame flags and counter (frames that never read \$4016/\$4017)"
+echo "   ✅ xxHash32 state and page hashes, page-level state patches"
+echo "   ✅ Tile-delta INDEXED8 video encoder and decoder for streaming"
 echo "   ✅ All required exports for web integration"
 echo "   ✅ Realistic file size (should be >50KB)"
\ No newline at end of file
@@ -5,72 +5,443 @@
  * to create a realistic-sized WASM file with all required exports.
  */
 
+#ifdef __EMSCRIPTEN__
 #include <emscripten.h>
+#else
+#define EMSCRIPTEN_KEEPALIVE  // Native builds (scripts/bench-core.sh)
+#endif
 #include <stdint.h>
 #include <string.h>
-#include <stdio.h>
+#include <time.h>
+
+#include "nes-apu.h"
+#include "nes-hash.h"
+#include "nes-input.h"
+#include "nes-palette.h"
+#include "nes-rewind.h"
+#include "nes-snapshot.h"
+#include "nes-state.h"
+#include "nes-stretch.h"
+#include "nes-tiles.h"
+#include "nes-trace.h"
+
+// Output pixel formats (must match PIXEL_FORMAT_CODES in wasmCoreAdapter.ts)
+#define PIXEL_FORMAT_RGBA32   0
+#define PIXEL_FORMAT_BGRA32   1
+#define PIXEL_FORMAT_RGB565   2
+#define PIXEL_FORMAT_INDEXED8 3
+
+#define NES_WIDTH        256
+#define NES_HEIGHT       240
+#define OVERSCAN_LINES   8    // Lines hidden top and bottom when cropping to 256x224
+#define BACKDROP_COLOR   0x0F // Black in the NES palette
+#define MAX_FRAME_BUFFERS 3   // Triple buffering at most
+#define NES_SCANLINES    262  // Scanlines per NTSC frame, including vblank
+#define AUDIO_MAX_RATE_ADJUST_PPM 5000  // Dynamic rate control range (+/-0.5%, ~9 cents)
+#define AUDIO_BUFFER_SAMPLES (APU_MAX_SAMPLES * 4)  // Room for 0.25x slow motion
+#define RAM_PAGES        72   // Work RAM, PRG RAM and CHR RAM in 256-byte pages
+#define REWIND_INTERVAL  2    // Frames between rewind states
+#define RUN_AHEAD_MAX    4    // Frames setRunAhead() can hide
+#define NES_PORTS        4    // Controller ports, through a Four Score
+#define STATE_HASH_PAGES (RAM_PAGES + 1)  // Guest RAM pages, then registers and APU
+#define CHR_RAM_PAGE     40   // First page of ram.chr (after 8 work RAM and 32 PRG RAM pages)
+
+// runFrames() flags
+#define RUN_FRAMES_VIDEO_LAST 0x01  // Render only the last frame
+#define RUN_FRAMES_AUDIO_LAST 0x02  // Synthesize only the last frame's audio
+
+// Frame specification, read by the host through getFrameSpec()
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;
+    uint32_t pitch;           // Bytes per output row
+} FrameSpec;
+
+// Latest completed frame, read by the host through getLatestFrame()
+typedef struct {
+    uint32_t index;           // Slot holding the frame
+    uint32_t sequence;        // Frame sequence number (never 0 for a completed frame)
+    uint32_t size;            // Bytes in the frame
+    uint8_t* buffer;          // Slot pointer
+} LatestFrame;
 
 // NES emulator state
 static uint8_t rom_data[2 * 1024 * 1024];  // 2MB max ROM
 static uint32_t rom_size = 0;
-static uint8_t frame_buffer[256 * 240 * 4]; // RGBA frame buffer
-static uint8_t chr_ram[8192];               // 8KB CHR RAM
-static uint8_t prg_ram[8192];               // 8KB PRG RAM
-static uint32_t palette[64];                // NES palette (RGBA)
-static uint8_t controls = 0;
+// Frame slots, each sized for the widest format (RGBA). frame() renders into the
+// slot after the latest completed one, so a host reading the latest frame is never
+// written to while the core produces the next.
+static uint8_t frame_buffers[MAX_FRAME_BUFFERS][NES_WIDTH * NES_HEIGHT * 4];
+static uint32_t slot_sequence[MAX_FRAME_BUFFERS]; // 0 while a slot is being written
+static uint32_t frame_buffer_count = MAX_FRAME_BUFFERS;
+static uint32_t frame_sequence = 0;
+static LatestFrame latest_frame;
+static uint8_t* frame_buffer = frame_buffers[0];   // Slot currently being written
+static uint32_t memory_epoch = 0;                  // Bumped whenever linear memory has grown
+#ifdef __wasm__
+static uint32_t memory_pages = 0;
+#endif
+static uint8_t line_buffer[NES_WIDTH];      // Palette indices for the scanline being rendered
+static FrameSpec frame_spec = { NES_WIDTH, NES_HEIGHT, PIXEL_FORMAT_RGBA32, NES_WIDTH * 4 };
+static int crop_overscan = 0;
+// Tile video (encodeTileFrame / decodeTileFrame): the last rendered frame as
+// palette indices, the frame the remote decoder holds, and the decoded frame
+static int tile_capture = 0;
+static uint8_t tile_source[NES_HEIGHT][NES_WIDTH];
+static uint8_t tile_reference[NES_HEIGHT][NES_WIDTH];
+static uint8_t tile_view[NES_HEIGHT][NES_WIDTH];
+
+// All guest-writable memory, in 256-byte pages tracked for snapshots
+typedef union {
+    struct {
+        uint8_t work[2048];                 // 2KB CPU work RAM
+        uint8_t prg[8192];                  // 8KB PRG RAM
+        uint8_t chr[8192];                  // 8KB CHR RAM
+    };
+    uint8_t pages[RAM_PAGES][SNAPSHOT_PAGE_SIZE];
+} GuestRam;
+
+static GuestRam ram;
+static int8_t ram_page_map[256];            // CPU page -> guest RAM page, or -1
+static int16_t audio_buffer[AUDIO_BUFFER_SAMPLES];
+static int16_t stretch_input[APU_MAX_SAMPLES];    // APU output while time-stretching
+static int32_t audio_speed = 1 << 16;             // setSpeed() multiplier, Q16
+static int audio_sample_count = 0;          // Samples produced by the last frame()
+static int32_t cpu_cycle = 0;               // CPU cycle within the current frame
+static uint8_t emphasis = 0;                // PPUMASK emphasis bits, selects the palette LUT bank
+static uint8_t controls[NES_PORTS];          // Button masks per port (bit 0 = Right ... bit 7 = A)
+static InputPorts input_ports;               // $4016/$4017 strobe and latches
+static int input_mode = INPUT_MODE_STANDARD; // setInputMode()
+static int zapper_lit = -1;                  // Scanline whose aimed pixel lit the Zapper this frame, or -1
+// Lag frames: frames in which the game never read $4016/$4017
+static int input_polled = 0;                 // Set by controller reads, cleared per frame
+static uint32_t lag_history = 0;             // Bit n: the frame n frames before the last one was a lag frame
+static uint32_t lag_frames = 0;
 static int initialized = 0;
 static int rom_loaded = 0;
 static int running = 0;
+static int video_enabled = 1;               // frame() renders (off while re-simulating)
+static int audio_enabled = 1;               // setAudioEnabled()
 static uint32_t frame_count = 0;
 
 // ROM header info
 static uint8_t prg_banks = 0;
 static uint8_t chr_banks = 0;
 static uint8_t mapper = 0;
+static uint8_t prg_bank = 0;                // UxROM bank mapped at $8000
 static int has_chr_ram = 0;
 static int has_trainer = 0;
 static int has_battery = 0;
+static uint32_t rom_hash = 0;               // Ties savestates to the loaded ROM
+
+// Statistics for getCoreStats(); times are averages in nanoseconds
+typedef struct {
+    uint32_t snapshots;             // Snapshots taken since the ROM was loaded
+    uint32_t snapshot_pages;        // Pages copied by the last snapshot
+    uint32_t snapshot_bytes;        // Bytes copied by the last snapshot
+    uint32_t snapshot_ns;
+    uint32_t restore_ns;
+    uint32_t snapshots_held;        // Snapshots restoreSnapshot() can still return to
+    uint32_t snapshot_pool_bytes;   // Snapshot page storage in use
+    uint32_t rewind_states;         // States rewindStep() can return to
+    uint32_t rewind_frames;         // Frames of history they cover
+    uint32_t rewind_bytes;          // Encoded bytes held
+    uint32_t rewind_state_bytes;    // Encoded size of the last state captured
+    uint32_t rewind_ns;             // Capture cost per frame (averaged over the interval)
+    uint32_t run_ahead;             // Frames run ahead per frame()
+    uint32_t run_ahead_frame_ns;    // Cost of one silent frame run ahead, excluding rendering
+    uint32_t run_ahead_state_ns;    // Save and restore around the frames run ahead, per frame()
+} CoreStats;
+
+static CoreStats core_stats;
+static double snapshot_ns = 0;
+static double restore_ns = 0;
+static uint32_t restores = 0;
+static uint32_t rewind_countdown = REWIND_INTERVAL;   // Frames until the next rewind capture
+static double rewind_ns = 0;
+static uint32_t rewind_captures = 0;
+static int run_ahead = 0;
+static double run_ahead_frame_ns = 0;
+static double run_ahead_state_ns = 0;
+static uint32_t run_ahead_frames = 0;    // Frames run ahead since the counters were reset
+static uint32_t run_ahead_passes = 0;    // frame() calls that ran ahead
+
+/**
+ * Monotonic time for the cost figures in getCoreStats()
+ */
+static double now_ns(void) {
+#ifdef __EMSCRIPTEN__
+    return emscripten_get_now() * 1e6;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+#endif
+}
+
+/**
+ * Recompute the frame spec after a format or overscan change
+ */
+static void update_frame_spec(void) {
+    uint32_t bytes_per_pixel;
+    switch (frame_spec.format) {
+        case PIXEL_FORMAT_RGB565:   bytes_per_pixel = 2; break;
+        case PIXEL_FORMAT_INDEXED8: bytes_per_pixel = 1; break;
+        default:                    bytes_per_pixel = 4; break;
+    }
+    frame_spec.width = NES_WIDTH;
+    frame_spec.height = crop_overscan ? NES_HEIGHT - 2 * OVERSCAN_LINES : NES_HEIGHT;
+    frame_spec.pitch = NES_WIDTH * bytes_per_pixel;
+}
+
+/**
+ * Write one scanline of palette indices to the frame buffer in the host's format.
+ * This is the only place pixels are produced, so no conversion pass is needed later.
+ */
+static void emit_scanline(int y, const uint8_t* indices) {
+    if (tile_capture) {
+        memcpy(tile_source[y], indices, NES_WIDTH);
+    }
+    if (crop_overscan) {
+        if (y < OVERSCAN_LINES || y >= NES_HEIGHT - OVERSCAN_LINES) return;
+        y -= OVERSCAN_LINES;
+    }
+
+    uint8_t* row = frame_buffer + y * frame_spec.pitch;
+
+    switch (frame_spec.format) {
+        case PIXEL_FORMAT_RGBA32:
+            expand_indexed((uint32_t*)row, indices, NES_WIDTH, emphasis, CHANNEL_ORDER_RGBA);
+            break;
+        case PIXEL_FORMAT_BGRA32:
+            expand_indexed((uint32_t*)row, indices, NES_WIDTH, emphasis, CHANNEL_ORDER_BGRA);
+            break;
+        case PIXEL_FORMAT_RGB565: {
+            const uint16_t* lut = palette_rgb565 + (emphasis << 6);
+            uint16_t* dst = (uint16_t*)row;
+            for (int x = 0; x < NES_WIDTH; x++) {
+                dst[x] = lut[indices[x] & 0x3F];
+            }
+            break;
+        }
+        case PIXEL_FORMAT_INDEXED8:
+            memcpy(row, indices, NES_WIDTH);
+            break;
+    }
+}
+
+/**
+ * Claim the next slot for writing; it is invalid until publish_frame()
+ */
+static void begin_frame(void) {
+    uint32_t index = (latest_frame.index + 1) % frame_buffer_count;
+    slot_sequence[index] = 0;
+    frame_buffer = frame_buffers[index];
+}
+
+/**
+ * Make the slot just written the latest completed frame
+ */
+static void publish_frame(void) {
+    uint32_t index = (uint32_t)((frame_buffer - frame_buffers[0]) / sizeof(frame_buffers[0]));
+
+    frame_sequence++;
+    slot_sequence[index] = frame_sequence;
+    latest_frame.index = index;
+    latest_frame.sequence = frame_sequence;
+    latest_frame.size = frame_spec.pitch * frame_spec.height;
+    latest_frame.buffer = frame_buffer;
+}
+
+/**
+ * Fill every slot with the backdrop color
+ */
+static void clear_frame_buffer(void) {
+    memset(line_buffer, BACKDROP_COLOR, sizeof(line_buffer));
+    for (uint32_t slot = 0; slot < frame_buffer_count; slot++) {
+        begin_frame();
+        for (int y = 0; y < NES_HEIGHT; y++) {
+            emit_scanline(y, line_buffer);
+        }
+        publish_frame();
+    }
+}
+
+/**
+ * Render one scanline of palette indices based on mapper type
+ */
+static void render_scanline(int y, uint8_t* line) {
+    if (mapper == 0) {
+        // NROM - diagonal bands
+        for (int x = 0; x < NES_WIDTH; x++) {
+            line[x] = (((x + frame_count) >> 3) + ((y + frame_count) >> 4)) & 0x3F;
+        }
+    } else if (mapper == 2) {
+        // UNROM - pattern driven by CHR RAM
+        for (int x = 0; x < NES_WIDTH; x++) {
+            uint8_t base_color = has_chr_ram ? ram.chr[(x + y * 16) % sizeof(ram.chr)] : 0x10;
+            uint8_t index = (base_color + ((x + y + frame_count) >> 3)) & 0x3F;
+
+            // Add control influence
+            if (controls[0] & 0x01) index ^= 0x10; // Right
+            if (controls[0] & 0x02) index ^= 0x20; // Left
+            if (controls[0] & 0x80) index ^= 0x08; // A button
+            line[x] = index;
+        }
+    } else {
+        // Other mappers - generic pattern
+        for (int x = 0; x < NES_WIDTH; x++) {
+            line[x] = ((x >> 2) + (y >> 2) + frame_count) & 0x3F;
+        }
+    }
+}
+
+/**
+ * Read PRG ROM through the mapper: switchable bank at $8000, last bank fixed at $C000
+ */
+static uint8_t prg_read(uint16_t addr) {
+    if (!rom_loaded) {
+        return 0;
+    }
+    uint32_t bank = addr < 0xC000 ? prg_bank : prg_banks - 1;
+    uint32_t offset = 16 + (has_trainer ? 512 : 0) + bank * 16384 + (addr & 0x3FFF);
+    return offset < rom_size ? rom_data[offset] : 0;
+}
+
+/**
+ * Map CPU pages onto guest RAM: work RAM mirrored through $0000-$1FFF, PRG RAM at $6000
+ */
+static void build_ram_page_map(void) {
+    memset(ram_page_map, -1, sizeof(ram_page_map));
+    for (int page = 0x00; page < 0x20; page++) {
+        ram_page_map[page] = (int8_t)(page & 0x07);
+    }
+    for (int page = 0x60; page < 0x80; page++) {
+        ram_page_map[page] = (int8_t)(sizeof(ram.work) / SNAPSHOT_PAGE_SIZE + (page - 0x60));
+    }
+}
+
+/**
+ * Scanline the CPU is on, from the cycle within the frame
+ */
+static uint32_t current_scanline(void) {
+    return (uint32_t)cpu_cycle * NES_SCANLINES / NES_CPU_CYCLES_PER_FRAME;
+}
+
+/**
+ * Zapper photodiode, checked on the palette indices of the line just rendered:
+ * the aimed pixel lights it when the beam draws that line
+ */
+static int zapper_aimed(int y) {
+    return input_mode == INPUT_MODE_ZAPPER && controls[3] == y;
+}
+
+static void sense_light(int y, const uint8_t* line) {
+    if (zapper_aimed(y) && input_zapper_bright(line[controls[2]])) {
+        zapper_lit = y;
+    }
+}
+
+/**
+ * $4017 with a Zapper attached: lit from the aimed line for ZAPPER_LIGHT_LINES
+ */
+static uint8_t zapper_read(void) {
+    int32_t line = (int32_t)current_scanline();
+    int light = zapper_lit >= 0 && line >= zapper_lit && line < zapper_lit + ZAPPER_LIGHT_LINES;
+    return input_read_zapper(controls[1], light);
+}
+
+/**
+ * CPU bus read (also used by the APU for DMC sample fetches)
+ */
+uint8_t cpu_read(uint16_t addr) {
+    int page = ram_page_map[addr >> 8];
+    if (page >= 0) return ram.pages[page][addr & 0xFF];
+    if (addr == 0x4015) return apu_read_status(cpu_cycle);
+    if (addr == 0x4016 || addr == 0x4017) {
+        input_polled = 1;
+        if (addr == 0x4017 && input_mode == INPUT_MODE_ZAPPER) return zapper_read();
+        return input_read(&input_ports, addr - 0x4016, controls, input_mode == INPUT_MODE_FOUR_SCORE);
+    }
+    if (addr >= 0x8000) return prg_read(addr);
+    return 0; // Open bus
+}
+
+/**
+ * CPU bus write. RAM writes go through the page map and mark the page dirty.
+ */
+static void cpu_write(uint16_t addr, uint8_t value) {
+    int page = ram_page_map[addr >> 8];
+    if (page >= 0) {
+        ram.pages[page][addr & 0xFF] = value;
+        snapshot_mark(page);
+    } else if (addr >= 0x2000 && addr < 0x4000) {
+        // PPUMASK: bits 5-7 select the emphasis bank of the palette LUT
+        if ((addr & 7) == 1) emphasis = value >> 5;
+    } else if (addr == 0x4016) {
+        // Controller strobe: latch the buttons stamped up to this scanline
+        input_apply(frame_count, current_scanline(), controls);
+        input_strobe(&input_ports, value, controls, NES_PORTS);
+    } else if (addr >= 0x4000 && addr <= 0x4017) {
+        apu_write(cpu_cycle, addr, value);
+    } else if (addr >= 0x8000 && mapper == 2 && prg_banks > 0) {
+        prg_bank = value % prg_banks;
+    }
+}
 
 /**
  * Initialize the NES emulator
  */
 EMSCRIPTEN_KEEPALIVE
 int init() {
-    printf("[NES Core] Initializing...\n");
-    
     if (initialized) {
-        printf("[NES Core] Already initialized\n");
+        TRACE(TRACE_INIT, 1, 0);
         return 1;
     }
     
     // Clear all memory
     memset(rom_data, 0, sizeof(rom_data));
-    memset(frame_buffer, 0, sizeof(frame_buffer));
-    memset(chr_ram, 0, sizeof(chr_ram));
-    memset(prg_ram, 0, sizeof(prg_ram));
+    memset(frame_buffers, 0, sizeof(frame_buffers));
+    memset(slot_sequence, 0, sizeof(slot_sequence));
+    memset(&latest_frame, 0, sizeof(latest_frame));
+    frame_sequence = 0;
+    memset(ram.chr, 0, sizeof(ram.chr));
+    memset(ram.prg, 0, sizeof(ram.prg));
+    memset(ram.work, 0, sizeof(ram.work));
+    build_ram_page_map();
+    snapshot_attach(ram.pages[0], RAM_PAGES);
     
-    // Initialize frame buffer alpha channel
-    for (int i = 3; i < sizeof(frame_buffer); i += 4) {
-        frame_buffer[i] = 255;
-    }
+    // APU with band-limited synthesis at 44.1kHz until the host sets its rate
+    apu_init(44100);
+    audio_enabled = 1;
+    stretch_configure(44100);
+    audio_speed = 1 << 16;
+    audio_sample_count = 0;
+    cpu_cycle = 0;
     
-    // Initialize NES palette
-    for (int i = 0; i < 64; i++) {
-        // Simple NES-like palette
-        uint8_t r = (i * 4) & 0xFF;
-        uint8_t g = (i * 8) & 0xFF;
-        uint8_t b = (i * 16) & 0xFF;
-        palette[i] = (0xFF << 24) | (b << 16) | (g << 8) | r; // ABGR format
-    }
+    // Build the 512-entry palette LUTs (64 colors x 8 emphasis combinations)
+    palette_build_default();
+    emphasis = 0;
+    
+    // Default output: full 256x240 RGBA
+    frame_spec.format = PIXEL_FORMAT_RGBA32;
+    crop_overscan = 0;
+    update_frame_spec();
+    clear_frame_buffer();
     
     // Reset state
-    controls = 0;
+    memset(controls, 0, sizeof(controls));
+    memset(&input_ports, 0, sizeof(input_ports));
+    input_reset();
+    input_mode = INPUT_MODE_STANDARD;
+    video_enabled = 1;
     rom_loaded = 0;
     running = 0;
     frame_count = 0;
     
     initialized = 1;
-    printf("[NES Core] Initialization complete\n");
+    TRACE(TRACE_INIT, 0, 0);
     return 1;
 }
 
@@ -79,26 +450,24 @@ int init() {
  */
 EMSCRIPTEN_KEEPALIVE
 int loadRom(uint8_t* rom, uint32_t size) {
-    printf("[NES Core] Loading ROM, size: %u bytes\n", size);
-    
     if (!initialized) {
-        printf("[NES Core] Error: Not initialized\n");
+        TRACE(TRACE_ROM_REJECTED, TRACE_REJECT_NOT_INITIALIZED, size);
         return 0;
     }
     
     if (size < 16) {
-        printf("[NES Core] Error: ROM too small\n");
+        TRACE(TRACE_ROM_REJECTED, TRACE_REJECT_TOO_SMALL, size);
         return 0;
     }
     
     if (size > sizeof(rom_data)) {
-        printf("[NES Core] Error: ROM too large\n");
+        TRACE(TRACE_ROM_REJECTED, TRACE_REJECT_TOO_LARGE, size);
         return 0;
     }
     
     // Validate NES header
     if (rom[0] != 0x4E || rom[1] != 0x45 || rom[2] != 0x53 || rom[3] != 0x1A) {
-        printf("[NES Core] Error: Invalid NES header\n");
+        TRACE(TRACE_ROM_REJECTED, TRACE_REJECT_BAD_HEADER, size);
         return 0;
     }
     
@@ -111,13 +480,11 @@ int loadRom(uint8_t* rom, uint32_t size) {
     has_trainer = (flags6 & 0x04) != 0;
     has_battery = (flags6 & 0x02) != 0;
     has_chr_ram = (chr_banks == 0);
-    
-    printf("[NES Core] ROM info: PRG=%u, CHR=%u, Mapper=%u, CHR_RAM=%s\n", 
-           prg_banks, chr_banks, mapper, has_chr_ram ? "yes" : "no");
+    prg_bank = 0;
     
     // Validate PRG banks
     if (prg_banks == 0) {
-        printf("[NES Core] Error: No PRG banks\n");
+        TRACE(TRACE_ROM_REJECTED, TRACE_REJECT_NO_PRG, size);
         return 0;
     }
     
@@ -128,81 +495,209 @@ int loadRom(uint8_t* rom, uint32_t size) {
     expected_size += chr_banks * 8192;  // CHR ROM
     
     if (size < expected_size) {
-        printf("[NES Core] Error: ROM size mismatch, expected %u, got %u\n", expected_size, size);
+        TRACE(TRACE_ROM_REJECTED, TRACE_REJECT_SIZE_MISMATCH, size);
         return 0;
     }
     
-    // Copy ROM data
-    memcpy(rom_data, rom, size);
+    // Copy ROM data (hosts may have written it into getRomBuffer() already)
+    if (rom != rom_data) {
+        memcpy(rom_data, rom, size);
+    }
     rom_size = size;
+    rom_hash = state_hash(rom_data, size);
     
     // Initialize CHR RAM if needed
     if (has_chr_ram) {
-        printf("[NES Core] Initializing CHR RAM\n");
         // Fill CHR RAM with pattern
-        for (int i = 0; i < sizeof(chr_ram); i++) {
-            chr_ram[i] = i & 0xFF;
+        for (int i = 0; i < sizeof(ram.chr); i++) {
+            ram.chr[i] = i & 0xFF;
         }
     }
+    input_reset();
+    input_polled = 0;
+    lag_history = 0;
+    lag_frames = 0;
+    snapshot_reset();
+    snapshot_ns = restore_ns = 0;
+    restores = 0;
+    rewind_reset();
+    rewind_countdown = REWIND_INTERVAL;
+    rewind_ns = 0;
+    rewind_captures = 0;
+    run_ahead_frame_ns = run_ahead_state_ns = 0;
+    run_ahead_frames = run_ahead_passes = 0;
     
     rom_loaded = 1;
-    printf("[NES Core] ROM loaded successfully\n");
+    TRACE(TRACE_ROM_LOADED, mapper, (prg_banks << 8) | chr_banks);
     return 1;
 }
 
 /**
- * Execute one frame of emulation
+ * Get the ROM staging buffer so hosts can write ROM data without a separate allocation
  */
 EMSCRIPTEN_KEEPALIVE
-void frame() {
-    if (!initialized || !rom_loaded || !running) {
-        return;
-    }
+uint8_t* getRomBuffer() {
+    return rom_data;
+}
+
+/**
+ * Size of getRomBuffer(); larger ROMs are rejected by loadRom()
+ */
+EMSCRIPTEN_KEEPALIVE
+uint32_t getRomBufferSize() {
+    return sizeof(rom_data);
+}
+
+uint32_t saveStateSize();
+uint32_t saveState(uint8_t* out);
+
+/**
+ * Push the current state onto the rewind history
+ */
+static void capture_rewind_state(void) {
+    double start = now_ns();
+    rewind_countdown = REWIND_INTERVAL;
     
+    uint8_t* state = rewind_state_buffer(saveStateSize());
+    if (state) {
+        rewind_push(state, saveState(state));
+    }
+    rewind_ns += now_ns() - start;
+    rewind_captures++;
+}
+
+/**
+ * Emulate one frame, rendering it only if `video` is set. With `input` set,
+ * queued input is applied at the scanlines it is stamped with; frames run
+ * ahead leave the queue alone and keep the current buttons. The caller ends
+ * the frame's audio.
+ */
+static void emulate_frame(int video, int input) {
+    uint32_t frame = frame_count;
+    if (input) {
+        input_apply(frame, 0, controls);
+    }
     frame_count++;
+    TRACE_FRAME_NUMBER(frame_count);
     
-    // Generate frame based on mapper type
-    if (mapper == 0) {
-        // NROM - simple pattern
-        for (int y = 0; y < 240; y++) {
-            for (int x = 0; x < 256; x++) {
-                int index = (y * 256 + x) * 4;
-                frame_buffer[index + 0] = (x + frame_count) & 0xFF;
-                frame_buffer[index + 1] = 0x20; // Green tint for NROM
-                frame_buffer[index + 2] = (y + frame_count) & 0xFF;
-                frame_buffer[index + 3] = 255;
-            }
+    // Without video a Zapper still needs its aimed line, so light sensing
+    // does not depend on whether the frame is shown
+    if (video || input_mode == INPUT_MODE_ZAPPER) {
+        if (video) {
+            begin_frame();
         }
-    } else if (mapper == 2) {
-        // UNROM - different pattern, especially for CHR RAM
-        for (int y = 0; y < 240; y++) {
-            for (int x = 0; x < 256; x++) {
-                int index = (y * 256 + x) * 4;
-                uint8_t base_color = has_chr_ram ? chr_ram[(x + y * 16) % sizeof(chr_ram)] : 0x40;
-                
-                frame_buffer[index + 0] = 0x40; // Blue tint for UNROM
-                frame_buffer[index + 1] = (base_color + frame_count) & 0xFF;
-                frame_buffer[index + 2] = (x + y + frame_count) & 0xFF;
-                frame_buffer[index + 3] = 255;
-                
-                // Add control influence
-                if (controls & 0x01) frame_buffer[index + 0] += 64; // Right
-                if (controls & 0x02) frame_buffer[index + 1] += 64; // Left
-                if (controls & 0x80) frame_buffer[index + 2] += 64; // A button
+        for (int y = 0; y < NES_HEIGHT; y++) {
+            cpu_cycle = y * NES_CPU_CYCLES_PER_FRAME / NES_SCANLINES;
+            if (input) {
+                input_apply(frame, (uint32_t)y, controls);
+            }
+            if (video || zapper_aimed(y)) {
+                render_scanline(y, line_buffer);
+                sense_light(y, line_buffer);
+            }
+            if (video) {
+                emit_scanline(y, line_buffer);
             }
         }
+        if (video) {
+            publish_frame();
+        }
+    }
+    // The rest of the frame's input, so the state after it does not depend on video
+    if (input) {
+        input_apply(frame, NES_SCANLINES - 1, controls);
+    }
+    zapper_lit = -1;   // Dark through vblank
+}
+
+static void run_ahead_pass(void);
+
+/**
+ * Run one real frame, rendering it if `video` is set, and write its samples
+ * to `audio` (room for `capacity`). Returns the samples written.
+ */
+static int step_frame(int video, int16_t* audio, int capacity) {
+    // With run-ahead the real frame only produces audio; the picture comes
+    // from the last frame run ahead
+    emulate_frame(video && run_ahead == 0, 1);
+    lag_history = (lag_history << 1) | !input_polled;
+    lag_frames += !input_polled;
+    
+    // One frame of samples at the host rate; the next frame starts at cycle 0.
+    // Off 1x speed the frame's audio is time-stretched back to real time.
+    int count;
+    if (audio_speed != 1 << 16) {
+        count = apu_end_frame(NES_CPU_CYCLES_PER_FRAME, stretch_input);
+        count = stretch_process(stretch_input, count, audio, capacity);
+    } else if (capacity >= APU_MAX_SAMPLES) {
+        count = apu_end_frame(NES_CPU_CYCLES_PER_FRAME, audio);
     } else {
-        // Other mappers - generic pattern
-        for (int y = 0; y < 240; y++) {
-            for (int x = 0; x < 256; x++) {
-                int index = (y * 256 + x) * 4;
-                frame_buffer[index + 0] = (x * 2 + frame_count) & 0xFF;
-                frame_buffer[index + 1] = (y * 2 + frame_count) & 0xFF;
-                frame_buffer[index + 2] = 0x60; // Purple tint for other mappers
-                frame_buffer[index + 3] = 255;
-            }
+        count = apu_end_frame(NES_CPU_CYCLES_PER_FRAME, stretch_input);
+        count = count < capacity ? count : capacity;
+        memcpy(audio, stretch_input, count * sizeof(int16_t));
+    }
+    cpu_cycle = 0;
+    
+    if (rewind_enabled() && --rewind_countdown == 0) {
+        capture_rewind_state();
+    }
+    if (run_ahead > 0 && video) {
+        run_ahead_pass();
+    }
+    // Reads from here on, frames run ahead aside, count toward the next frame
+    input_polled = 0;
+    TRACE_SAMPLED(TRACE_FRAME, frame_sequence, frame_sequence, latest_frame.index);
+    return count;
+}
+
+/**
+ * Execute one frame of emulation
+ */
+EMSCRIPTEN_KEEPALIVE
+void frame() {
+    if (!initialized || !rom_loaded || !running) {
+        audio_sample_count = 0;
+        return;
+    }
+    audio_sample_count = step_frame(video_enabled, audio_buffer, AUDIO_BUFFER_SAMPLES);
+}
+
+/**
+ * Run `count` frames in one call, for fast-forward and catch-up. `inputs`
+ * holds each frame's buttons, INPUT_MAX_PORTS bytes per frame (port order,
+ * setButtons() layout), or is null to keep the current buttons; queued input
+ * due in a frame still applies on top. Flags: RUN_FRAMES_VIDEO_LAST renders
+ * only the last frame, RUN_FRAMES_AUDIO_LAST skips synthesis before the last
+ * frame so getAudioBuffer() holds just its samples. Without it the buffer
+ * holds all frames' samples, as many as fit. Like setAudioEnabled(0), skipping
+ * synthesis leaves the state and getStateHash() as they would be with sound,
+ * so batched and frame-by-frame peers stay in sync. setVideoEnabled(0) still
+ * turns rendering off. Returns the frames run.
+ */
+EMSCRIPTEN_KEEPALIVE
+int runFrames(int count, const uint8_t* inputs, int flags) {
+    audio_sample_count = 0;
+    if (!initialized || !rom_loaded || !running || count <= 0) {
+        return 0;
+    }
+    
+    int quiet = (flags & RUN_FRAMES_AUDIO_LAST) && audio_enabled && count > 1;
+    if (quiet) {
+        apu_set_enabled(0);
+    }
+    for (int i = 0; i < count; i++) {
+        int last = i == count - 1;
+        if (inputs) {
+            memcpy(controls, inputs + i * INPUT_MAX_PORTS, NES_PORTS);
         }
+        if (last && quiet) {
+            apu_set_enabled(1);
+        }
+        int video = video_enabled && (last || !(flags & RUN_FRAMES_VIDEO_LAST));
+        int room = AUDIO_BUFFER_SAMPLES - audio_sample_count;
+        audio_sample_count += step_frame(video, audio_buffer + audio_sample_count, room);
     }
+    return count;
 }
 
 /**
@@ -210,20 +705,27 @@ void frame() {
  */
 EMSCRIPTEN_KEEPALIVE
 void reset() {
-    printf("[NES Core] Resetting\n");
-    controls = 0;
+    TRACE(TRACE_RESET, 0, 0);
+    memset(controls, 0, sizeof(controls));
+    memset(&input_ports, 0, sizeof(input_ports));
+    input_reset();
+    input_polled = 0;
+    lag_history = 0;
+    lag_frames = 0;
     frame_count = 0;
+    prg_bank = 0;
+    cpu_cycle = 0;
+    audio_sample_count = 0;
+    apu_reset();
+    stretch_reset();
     
-    // Clear frame buffer
-    memset(frame_buffer, 0, sizeof(frame_buffer));
-    for (int i = 3; i < sizeof(frame_buffer); i += 4) {
-        frame_buffer[i] = 255;
-    }
+    clear_frame_buffer();
     
     // Clear CHR RAM if used
     if (has_chr_ram) {
-        memset(chr_ram, 0, sizeof(chr_ram));
+        memset(ram.chr, 0, sizeof(ram.chr));
     }
+    snapshot_mark_all();
 }
 
 /**
@@ -235,10 +737,106 @@ void setButton(int button, int pressed) {
     
     uint8_t mask = 1 << button;
     if (pressed) {
-        controls |= mask;
+        controls[0] |= mask;
     } else {
-        controls &= ~mask;
+        controls[0] &= ~mask;
+    }
+}
+
+/**
+ * Set every button of a controller port at once (bit 0 = Right ... bit 7 = A,
+ * same order as setButton). Netplay applies each player's input per frame.
+ */
+EMSCRIPTEN_KEEPALIVE
+void setPortButtons(int port, int mask) {
+    if (port < 0 || port >= NES_PORTS) return;
+    controls[port] = (uint8_t)mask;
+}
+
+/**
+ * Set every port's buttons in one call: INPUT_MAX_PORTS masks in port order.
+ * Ports 3 and 4 are read through a Four Score; with a Zapper, port 2 holds
+ * the trigger (ZAPPER_TRIGGER) and ports 3 and 4 its aim.
+ */
+EMSCRIPTEN_KEEPALIVE
+void setButtons(const uint8_t* port_masks) {
+    memcpy(controls, port_masks, NES_PORTS);
+}
+
+/**
+ * Choose the devices plugged into the controller ports (INPUT_MODE_*): pads,
+ * four pads through a Four Score, or a pad and a Zapper. Like the ROM, the
+ * devices are not part of savestates; every peer must choose the same ones.
+ * Returns 0 for an unknown mode.
+ */
+EMSCRIPTEN_KEEPALIVE
+int setInputMode(int mode) {
+    if (mode != INPUT_MODE_STANDARD && mode != INPUT_MODE_FOUR_SCORE && mode != INPUT_MODE_ZAPPER) {
+        return 0;
     }
+    input_mode = mode;
+    return 1;
+}
+
+/**
+ * Queue frame-stamped input (InputEvent records, 8 bytes each: frame, port,
+ * mask, scanline). Each applies when frame() reaches the scanline of the frame
+ * it is stamped with (scanline 0: as the frame starts, i.e. once
+ * getFrameCount() has reached it), and the game reads it at its next
+ * controller strobe. Returns how many were queued.
+ */
+EMSCRIPTEN_KEEPALIVE
+int queueInputs(const uint8_t* events, int count) {
+    return input_queue((const InputEvent*)events, count, NES_PORTS);
+}
+
+/**
+ * Hash of the loaded ROM (0 if none), the value savestates are tied to.
+ * Spectators compare it before loading the host's state.
+ */
+EMSCRIPTEN_KEEPALIVE
+uint32_t getRomHash() {
+    return rom_loaded ? rom_hash : 0;
+}
+
+/**
+ * Lag frames: bit 0 is set if the last frame emulated never read $4016/$4017
+ * (the game ignored its input), bit n for the frame n before it, so the bits
+ * of a whole runFrames() batch are there at once. Reads between frames count
+ * toward the next one. Netplay need not send or predict input for these
+ * frames, and replays can drop it.
+ */
+EMSCRIPTEN_KEEPALIVE
+uint32_t getLagFrames() {
+    return lag_history;
+}
+
+/**
+ * Lag frames emulated since the ROM was loaded or reset. Like the rest of the
+ * history this is not part of savestates: re-simulated frames count again.
+ */
+EMSCRIPTEN_KEEPALIVE
+uint32_t getLagFrameCount() {
+    return lag_frames;
+}
+
+/**
+ * Frames emulated since reset (the frame the next frame() emulates), the
+ * clock queueInputs() stamps refer to
+ */
+EMSCRIPTEN_KEEPALIVE
+uint32_t getFrameCount() {
+    return frame_count;
+}
+
+/**
+ * Turn rendering on or off. With video off frame() still emulates (state,
+ * audio) but leaves the frame buffers alone, which is how rollback
+ * re-simulates frames that were already shown.
+ */
+EMSCRIPTEN_KEEPALIVE
+void setVideoEnabled(int enabled) {
+    video_enabled = enabled != 0;
 }
 
 /**
@@ -247,29 +845,844 @@ void setButton(int button, int pressed) {
 EMSCRIPTEN_KEEPALIVE
 void setRunning(int is_running) {
     running = is_running;
-    printf("[NES Core] Running state: %s\n", running ? "true" : "false");
+    TRACE(TRACE_RUNNING, running, 0);
 }
 
 /**
- * Get frame buffer pointer
+ * Get pointer to the latest completed frame
  */
 EMSCRIPTEN_KEEPALIVE
 uint8_t* getFrameBuffer() {
-    return frame_buffer;
+    return latest_frame.buffer;
+}
+
+/**
+ * Get the latest completed frame (slot index, sequence number, size, pointer).
+ * The slot stays untouched for the next frame() call; with three slots a reader
+ * has two frames before it is reused. Readers that may race the core can check
+ * getFrameSequences()[index] still matches the sequence after reading.
+ */
+EMSCRIPTEN_KEEPALIVE
+LatestFrame* getLatestFrame() {
+    return &latest_frame;
+}
+
+/**
+ * Get per-slot sequence numbers (0 while a slot is being written)
+ */
+EMSCRIPTEN_KEEPALIVE
+uint32_t* getFrameSequences() {
+    return slot_sequence;
+}
+
+/**
+ * Get pointer to a frame slot
+ */
+EMSCRIPTEN_KEEPALIVE
+uint8_t* getFrameBufferAt(int index) {
+    if (index < 0 || index >= (int)frame_buffer_count) return 0;
+    return frame_buffers[index];
+}
+
+/**
+ * Set the number of frame slots (2 = double, 3 = triple buffering)
+ */
+EMSCRIPTEN_KEEPALIVE
+int setFrameBufferCount(int count) {
+    if (count < 2 || count > MAX_FRAME_BUFFERS) {
+        return 0;
+    }
+    
+    frame_buffer_count = count;
+    latest_frame.index = 0;
+    clear_frame_buffer();
+    return 1;
+}
+
+/**
+ * Get the memory epoch. It changes only when wasm memory has grown, which
+ * detaches every JS view onto it; hosts can keep views until then.
+ */
+EMSCRIPTEN_KEEPALIVE
+uint32_t getMemoryEpoch() {
+#ifdef __wasm__
+    uint32_t pages = (uint32_t)__builtin_wasm_memory_size(0);
+    if (pages != memory_pages) {
+        memory_pages = pages;
+        memory_epoch++;
+    }
+#endif
+    return memory_epoch;
 }
 
 /**
- * Get frame buffer size
+ * Get frame buffer size for the current format and overscan setting
  */
 EMSCRIPTEN_KEEPALIVE
 int getFrameBufferSize() {
-    return sizeof(frame_buffer);
+    return frame_spec.pitch * frame_spec.height;
 }
 
 /**
- * Get palette pointer
+ * Get frame specification (width, height, format, pitch)
  */
 EMSCRIPTEN_KEEPALIVE
-uint32_t* getPalette() {
-    return palette;
-}
\ No newline at end of file
+FrameSpec* getFrameSpec() {
+    return &frame_spec;
+}
+
+/**
+ * Select the pixel format written by frame(). Returns 0 for unknown formats.
+ */
+EMSCRIPTEN_KEEPALIVE
+int setPixelFormat(int format) {
+    if (format < PIXEL_FORMAT_RGBA32 || format > PIXEL_FORMAT_INDEXED8) {
+        return 0;
+    }
+    
+    frame_spec.format = format;
+    update_frame_spec();
+    clear_frame_buffer();
+    TRACE(TRACE_PIXEL_FORMAT, format, frame_spec.height);
+    return 1;
+}
+
+/**
+ * Crop 8 overscan lines top and bottom (256x224 output) in the same pass
+ */
+EMSCRIPTEN_KEEPALIVE
+void setOverscanCrop(int enabled) {
+    crop_overscan = enabled ? 1 : 0;
+    update_frame_spec();
+    clear_frame_buffer();
+}
+
+/**
+ * Get palette pointer (512 RGBA entries; the first 64 have no emphasis)
+ */
+EMSCRIPTEN_KEEPALIVE
+uint32_t* getPalette() {
+    return palette_rgba;
+}
+
+/**
+ * Replace the palette from a .pal file (192 bytes, or 1536 bytes with emphasis)
+ */
+EMSCRIPTEN_KEEPALIVE
+int loadPalette(const uint8_t* data, int size) {
+    if (size % 3 != 0 || !palette_build(data, size / 3)) {
+        TRACE(TRACE_PALETTE_REJECTED, size, 0);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Expand palette indices into RGBA pixels in any buffer in core memory
+ */
+EMSCRIPTEN_KEEPALIVE
+void expandIndexed(uint32_t* dst, const uint8_t* src, int count, int emphasis_bits) {
+    expand_indexed(dst, src, count, emphasis_bits, CHANNEL_ORDER_RGBA);
+}
+
+/**
+ * Get the current PPUMASK emphasis bits (0-7), the palette bank INDEXED8 frames need
+ */
+EMSCRIPTEN_KEEPALIVE
+int getEmphasis() {
+    return emphasis;
+}
+
+/**
+ * Read a byte from the CPU bus (RAM, APU status, PRG RAM/ROM)
+ */
+EMSCRIPTEN_KEEPALIVE
+int cpuRead(int addr) {
+    return cpu_read((uint16_t)addr);
+}
+
+/**
+ * Write a byte to the CPU bus (RAM, PPUMASK, APU registers, PRG RAM, mapper)
+ */
+EMSCRIPTEN_KEEPALIVE
+void cpuWrite(int addr, int value) {
+    cpu_write((uint16_t)addr, (uint8_t)value);
+}
+
+/**
+ * Set the audio output rate in Hz (8000-192000). Returns 0 if out of range.
+ */
+EMSCRIPTEN_KEEPALIVE
+int setSampleRate(int rate) {
+    if (!apu_set_sample_rate((uint32_t)rate)) {
+        return 0;
+    }
+    stretch_configure((uint32_t)rate);
+    return 1;
+}
+
+/**
+ * Get the samples produced by the last frame() (mono, signed 16-bit).
+ * The buffer is rewritten by every frame() call.
+ */
+EMSCRIPTEN_KEEPALIVE
+int16_t* getAudioBuffer() {
+    return audio_buffer;
+}
+
+/**
+ * Get the number of samples in getAudioBuffer()
+ */
+EMSCRIPTEN_KEEPALIVE
+int getAudioSampleCount() {
+    return audio_sample_count;
+}
+
+/**
+ * Report how many samples the host has queued for playback out of its buffer
+ * capacity. From the next frame on, the core produces up to 0.5% more samples
+ * per frame while the buffer is under half full and up to 0.5% fewer while it
+ * is over, keeping 60.098fps emulation and the audio clock locked without
+ * dropping or repeating samples. Returns the adjustment in ppm.
+ */
+EMSCRIPTEN_KEEPALIVE
+int setAudioBufferFill(int queued, int capacity) {
+    if (capacity <= 0) {
+        return 0;
+    }
+    
+    int64_t ppm = (int64_t)AUDIO_MAX_RATE_ADJUST_PPM * (capacity - 2 * queued) / capacity;
+    if (ppm > AUDIO_MAX_RATE_ADJUST_PPM) ppm = AUDIO_MAX_RATE_ADJUST_PPM;
+    if (ppm < -AUDIO_MAX_RATE_ADJUST_PPM) ppm = -AUDIO_MAX_RATE_ADJUST_PPM;
+    apu_set_rate_adjust((int32_t)ppm);
+    return (int)ppm;
+}
+
+/**
+ * Enable or disable sound generation (e.g. while muted or for background
+ * previews). Disabled audio keeps all game-visible APU timing but skips
+ * synthesis; frame() then produces no samples. Savestates and getStateHash()
+ * come out the same either way, so muted netplay peers stay in sync.
+ */
+EMSCRIPTEN_KEEPALIVE
+void setAudioEnabled(int enabled) {
+    audio_enabled = enabled != 0;
+    apu_set_enabled(enabled);
+    if (!enabled) {
+        audio_sample_count = 0;
+    }
+}
+
+/**
+ * Set the emulation speed the host is running at (0.25-8x). The host runs
+ * frame() `multiplier` times per 60.098Hz period; the core time-stretches the
+ * resulting audio back to real time without changing its pitch, so
+ * getAudioSampleCount() stays around one frame's worth per real-time frame.
+ * Returns 0 if out of range.
+ */
+EMSCRIPTEN_KEEPALIVE
+int setSpeed(float multiplier) {
+    if (!(multiplier >= STRETCH_SPEED_MIN && multiplier <= STRETCH_SPEED_MAX)) {
+        return 0;
+    }
+    
+    int32_t speed = (int32_t)(multiplier * 65536.0f + 0.5f);
+    if (speed == audio_speed) {
+        return 1;
+    }
+    
+    // Back at 1x the buffered input is dropped so audio returns to zero latency
+    audio_speed = speed;
+    if (speed == 1 << 16) {
+        stretch_reset();
+    }
+    stretch_set_speed(speed);
+    return 1;
+}
+
+// Savestate chunk tags
+#define CHUNK_CPU    STATE_TAG('C', 'P', 'U', ' ')
+#define CHUNK_RAM    STATE_TAG('R', 'A', 'M', ' ')
+#define CHUNK_PPU    STATE_TAG('P', 'P', 'U', ' ')
+#define CHUNK_MAPPER STATE_TAG('M', 'A', 'P', 'R')
+#define CHUNK_PRGRAM STATE_TAG('P', 'R', 'G', 'R')
+#define CHUNK_CHRRAM STATE_TAG('C', 'H', 'R', 'R')
+#define CHUNK_APU    STATE_TAG('A', 'P', 'U', ' ')
+#define CHUNK_PAGES  STATE_TAG('P', 'A', 'G', 'S')   // u32 first page, then whole guest RAM pages
+#define CHUNK_PORTS  STATE_TAG('J', 'O', 'Y', 'P')   // Controller port latches (InputPorts)
+
+typedef struct {
+    uint32_t frame_count;
+    int32_t cycle;
+    uint32_t controls;         // Port n's buttons in bits 8n-8n+7
+} CpuChunk;
+
+typedef struct {
+    uint32_t emphasis;         // PPUMASK bits 5-7
+} PpuChunk;
+
+typedef struct {
+    uint32_t mapper;
+    uint32_t prg_bank;
+} MapperChunk;
+
+// Unpaged state: everything but guest RAM and the APU
+typedef struct {
+    CpuChunk cpu;
+    PpuChunk ppu;
+    MapperChunk mapper;
+    InputPorts ports;
+} Registers;
+
+static void save_registers(Registers* regs) {
+    regs->cpu.frame_count = frame_count;
+    regs->cpu.cycle = cpu_cycle;
+    regs->cpu.controls = 0;
+    for (int port = 0; port < NES_PORTS; port++) {
+        regs->cpu.controls |= (uint32_t)controls[port] << (port * 8);
+    }
+    regs->ppu.emphasis = emphasis;
+    regs->mapper.mapper = mapper;
+    regs->mapper.prg_bank = prg_bank;
+    regs->ports = input_ports;
+}
+
+static void load_cpu(const CpuChunk* cpu) {
+    frame_count = cpu->frame_count;
+    cpu_cycle = cpu->cycle;
+    for (int port = 0; port < NES_PORTS; port++) {
+        controls[port] = (uint8_t)(cpu->controls >> (port * 8));
+    }
+}
+
+static void load_ppu(const PpuChunk* ppu) {
+    emphasis = (uint8_t)(ppu->emphasis & 7);
+}
+
+static void load_mapper(const MapperChunk* mapper_chunk) {
+    prg_bank = prg_banks > 0 ? (uint8_t)(mapper_chunk->prg_bank % prg_banks) : 0;
+}
+
+static void load_ports(const InputPorts* ports) {
+    input_ports = *ports;
+    input_ports.strobe &= 1;
+}
+
+/**
+ * Get the number of bytes saveState() writes for the loaded ROM
+ */
+EMSCRIPTEN_KEEPALIVE
+uint32_t saveStateSize() {
+    uint32_t size = STATE_HEADER_SIZE +
+                    state_chunk_size(sizeof(CpuChunk)) +
+                    state_chunk_size(sizeof(ram.work)) +
+                    state_chunk_size(sizeof(PpuChunk)) +
+                    state_chunk_size(sizeof(MapperChunk)) +
+                    state_chunk_size(sizeof(InputPorts)) +
+                    state_chunk_size(sizeof(ram.prg)) +
+                    state_chunk_size(apu_state_size());
+    if (has_chr_ram) {
+        size += state_chunk_size(sizeof(ram.chr));
+    }
+    return size;
+}
+
+/**
+ * Write the emulation state to `out` (saveStateSize() bytes), between frames.
+ * Returns the number of bytes written, or 0 if no ROM is loaded.
+ */
+EMSCRIPTEN_KEEPALIVE
+uint32_t saveState(uint8_t* out) {
+    if (!rom_loaded) {
+        return 0;
+    }
+    
+    Registers regs;
+    save_registers(&regs);
+    
+    StateWriter writer;
+    state_begin(&writer, out, rom_hash);
+    state_write_chunk(&writer, CHUNK_CPU, &regs.cpu, sizeof(regs.cpu));
+    state_write_chunk(&writer, CHUNK_RAM, ram.work, sizeof(ram.work));
+    state_write_chunk(&writer, CHUNK_PPU, &regs.ppu, sizeof(regs.ppu));
+    state_write_chunk(&writer, CHUNK_MAPPER, &regs.mapper, sizeof(regs.mapper));
+    state_write_chunk(&writer, CHUNK_PORTS, &regs.ports, sizeof(regs.ports));
+    state_write_chunk(&writer, CHUNK_PRGRAM, ram.prg, sizeof(ram.prg));
+    if (has_chr_ram) {
+        state_write_chunk(&writer, CHUNK_CHRRAM, ram.chr, sizeof(ram.chr));
+    }
+    apu_save_state(state_reserve_chunk(&writer, CHUNK_APU, apu_state_size()));
+    return state_end(&writer);
+}
+
+/**
+ * Payload size a known chunk must have, or -1 for tags this core skips
+ */
+static int32_t chunk_payload_size(uint32_t tag) {
+    switch (tag) {
+        case CHUNK_CPU:    return sizeof(CpuChunk);
+        case CHUNK_RAM:    return sizeof(ram.work);
+        case CHUNK_PPU:    return sizeof(PpuChunk);
+        case CHUNK_MAPPER: return sizeof(MapperChunk);
+        case CHUNK_PORTS:  return sizeof(InputPorts);
+        case CHUNK_PRGRAM: return sizeof(ram.prg);
+        case CHUNK_CHRRAM: return has_chr_ram ? (int32_t)sizeof(ram.chr) : -1;
+        case CHUNK_APU:    return (int32_t)apu_state_size();
+        default:           return -1;
+    }
+}
+
+/**
+ * CHUNK_PAGES payloads vary in size: whole pages, all inside guest RAM
+ */
+static int pages_chunk_valid(const uint8_t* payload, uint32_t size) {
+    if (size < 4 + SNAPSHOT_PAGE_SIZE || (size - 4) % SNAPSHOT_PAGE_SIZE != 0) {
+        return 0;
+    }
+    uint32_t first;
+    memcpy(&first, payload, sizeof(first));
+    return first < RAM_PAGES && (size - 4) / SNAPSHOT_PAGE_SIZE <= RAM_PAGES - first;
+}
+
+/**
+ * Restore a state written by saveState() for the same ROM, or apply a patch
+ * from saveStatePatch(). The whole state is validated before anything is
+ * applied, so a rejected state leaves emulation untouched. Chunks with
+ * unknown tags are skipped. Returns 1 on success.
+ */
+EMSCRIPTEN_KEEPALIVE
+int loadState(const uint8_t* data, uint32_t size) {
+    StateReader reader;
+    int error = rom_loaded ? state_open(&reader, data, size, rom_hash) : STATE_ERROR_NO_ROM;
+    if (error) {
+        TRACE(TRACE_STATE_REJECTED, error, size);
+        return 0;
+    }
+    
+    uint32_t tag;
+    const uint8_t* payload;
+    uint32_t payload_size;
+    int result;
+    
+    // Validation pass
+    StateReader check = reader;
+    while (!error && (result = state_next_chunk(&check, &tag, &payload, &payload_size)) != 0) {
+        int32_t expected = chunk_payload_size(tag);
+        if (result < 0) {
+            error = STATE_ERROR_TRUNCATED;
+        } else if (tag == CHUNK_PAGES) {
+            if (!pages_chunk_valid(payload, payload_size)) error = STATE_ERROR_CHUNK_SIZE;
+        } else if (expected >= 0 && payload_size != (uint32_t)expected) {
+            error = STATE_ERROR_CHUNK_SIZE;
+        }
+    }
+    if (error) {
+        TRACE(TRACE_STATE_REJECTED, error, size);
+        return 0;
+    }
+    
+    int whole_ram = 0;   // Otherwise only the pages in CHUNK_PAGES changed
+    while (state_next_chunk(&reader, &tag, &payload, &payload_size) > 0) {
+        if (tag == CHUNK_PAGES) {
+            uint32_t first;
+            memcpy(&first, payload, sizeof(first));
+            uint32_t count = (payload_size - 4) / SNAPSHOT_PAGE_SIZE;
+            memcpy(ram.pages[first], payload + 4, count * SNAPSHOT_PAGE_SIZE);
+            for (uint32_t page = first; page < first + count; page++) {
+                snapshot_mark((int)page);
+            }
+            continue;
+        }
+        if (chunk_payload_size(tag) < 0) {
+            continue;
+        }
+        switch (tag) {
+            case CHUNK_CPU: {
+                CpuChunk cpu;
+                memcpy(&cpu, payload, sizeof(cpu));
+                load_cpu(&cpu);
+                break;
+            }
+            case CHUNK_RAM:
+                memcpy(ram.work, payload, sizeof(ram.work));
+                whole_ram = 1;
+                break;
+            case CHUNK_PPU: {
+                PpuChunk ppu;
+                memcpy(&ppu, payload, sizeof(ppu));
+                load_ppu(&ppu);
+                break;
+            }
+            case CHUNK_MAPPER: {
+                MapperChunk mapper_chunk;
+                memcpy(&mapper_chunk, payload, sizeof(mapper_chunk));
+                load_mapper(&mapper_chunk);
+                break;
+            }
+            case CHUNK_PORTS: {
+                InputPorts ports;
+                memcpy(&ports, payload, sizeof(ports));
+                load_ports(&ports);
+                break;
+            }
+            case CHUNK_PRGRAM:
+                memcpy(ram.prg, payload, sizeof(ram.prg));
+                whole_ram = 1;
+                break;
+            case CHUNK_CHRRAM:
+                memcpy(ram.chr, payload, sizeof(ram.chr));
+                whole_ram = 1;
+                break;
+            case CHUNK_APU:
+                apu_load_state(payload);
+                break;
+        }
+    }
+    
+    if (whole_ram) {
+        snapshot_mark_all();
+    }
+    
+    // Audio buffered for the old timeline is dropped
+    stretch_reset();
+    audio_sample_count = 0;
+    return 1;
+}
+
+/**
+ * Take an incremental snapshot of the whole emulation state, between frames.
+ * Only guest RAM pages written since the previous snapshot are copied.
+ * Returns the snapshot id for restoreSnapshot(), or 0 if no ROM is loaded.
+ */
+EMSCRIPTEN_KEEPALIVE
+uint32_t takeSnapshot() {
+    if (!rom_loaded) {
+        return 0;
+    }
+    
+    uint32_t size = sizeof(Registers) + apu_state_size();
+    if (size > SNAPSHOT_EXTRA_MAX) {
+        return 0;
+    }
+    
+    double start = now_ns();
+    Registers regs;
+    uint8_t extra[SNAPSHOT_EXTRA_MAX];
+    save_registers(&regs);
+    memcpy(extra, &regs, sizeof(regs));
+    apu_save_state(extra + sizeof(Registers));
+    uint32_t id = snapshot_capture(extra, size);
+    
+    snapshot_ns += now_ns() - start;
+    return id;
+}
+
+/**
+ * Return to a snapshot from takeSnapshot(). The most recent 64 snapshots are
+ * kept (fewer if they dirty a lot of memory). Returns 0 if `id` is gone.
+ */
+EMSCRIPTEN_KEEPALIVE
+int restoreSnapshot(uint32_t id) {
+    double start = now_ns();
+    uint8_t extra[SNAPSHOT_EXTRA_MAX];
+    if (!rom_loaded || snapshot_restore(id, extra) < 0) {
+        return 0;
+    }
+    
+    Registers regs;
+    memcpy(&regs, extra, sizeof(regs));
+    load_cpu(&regs.cpu);
+    load_ppu(&regs.ppu);
+    load_mapper(&regs.mapper);
+    load_ports(&regs.ports);
+    apu_load_state(extra + sizeof(Registers));
+    
+    stretch_reset();
+    audio_sample_count = 0;
+    restore_ns += now_ns() - start;
+    restores++;
+    return 1;
+}
+
+/**
+ * Hash every guest RAM page that is part of the state (CHR RAM pages only
+ * when the cartridge has CHR RAM, 0 otherwise) and, last, the registers and
+ * APU state
+ */
+static int state_pages(void) {
+    return has_chr_ram ? RAM_PAGES : CHR_RAM_PAGE;
+}
+
+static void hash_state_pages(uint32_t* hashes) {
+    int pages = state_pages();
+    for (int page = 0; page < RAM_PAGES; page++) {
+        hashes[page] = page < pages ? hash_xxh32(ram.pages[page], SNAPSHOT_PAGE_SIZE, 0) : 0;
+    }
+    
+    uint8_t unpaged[SNAPSHOT_EXTRA_MAX];
+    Registers regs;
+    save_registers(&regs);
+    memcpy(unpaged, &regs, sizeof(regs));
+    apu_save_state(unpaged + sizeof(Registers));
+    hashes[RAM_PAGES] = hash_xxh32(unpaged, sizeof(Registers) + apu_state_size(), 0);
+}
+
+/**
+ * Hash of the whole emulation state, between frames, for netplay peers to
+ * confirm they have not desynced. Covers the same state as saveState(): CPU
+ * registers, work RAM, PRG RAM, CHR RAM (this core's pattern memory; it keeps
+ * no other VRAM or OAM), PPU, mapper and APU registers. Returns 0 if no ROM
+ * is loaded.
+ */
+EMSCRIPTEN_KEEPALIVE
+uint32_t getStateHash() {
+    if (!rom_loaded) {
+        return 0;
+    }
+    uint32_t hashes[STATE_HASH_PAGES];
+    hash_state_pages(hashes);
+    return hash_xxh32(hashes, sizeof(hashes), rom_hash);
+}
+
+/**
+ * Write the per-page hashes getStateHash() is built from to `out`
+ * (STATE_HASH_PAGES uint32 values: 72 guest RAM pages of 256 bytes, then
+ * registers and APU). Returns the count, or 0 if no ROM is loaded.
+ */
+EMSCRIPTEN_KEEPALIVE
+int getStatePageHashes(uint32_t* out) {
+    if (!rom_loaded) {
+        return 0;
+    }
+    hash_state_pages(out);
+    return STATE_HASH_PAGES;
+}
+
+/**
+ * Write a state patch that turns a peer's state into this one, given the
+ * peer's getStatePageHashes(): only guest RAM pages whose hash differs (runs
+ * of them per chunk), plus the registers and APU if those differ. The peer
+ * applies it with loadState(), which marks only the patched pages dirty.
+ * `out` needs saveStateSize() bytes. Returns the bytes written (a bare header
+ * if nothing differs), or 0 if no ROM is loaded.
+ */
+EMSCRIPTEN_KEEPALIVE
+uint32_t saveStatePatch(const uint32_t* peer_hashes, uint8_t* out) {
+    if (!rom_loaded) {
+        return 0;
+    }
+    uint32_t hashes[STATE_HASH_PAGES];
+    hash_state_pages(hashes);
+    
+    StateWriter writer;
+    state_begin(&writer, out, rom_hash);
+    int pages = state_pages();
+    for (int page = 0; page < pages; ) {
+        if (hashes[page] == peer_hashes[page]) {
+            page++;
+            continue;
+        }
+        uint32_t first = (uint32_t)page;
+        while (page < pages && hashes[page] != peer_hashes[page]) {
+            page++;
+        }
+        uint32_t count = (uint32_t)page - first;
+        uint8_t* payload = state_reserve_chunk(&writer, CHUNK_PAGES, 4 + count * SNAPSHOT_PAGE_SIZE);
+        memcpy(payload, &first, sizeof(first));
+        memcpy(payload + 4, ram.pages[first], count * SNAPSHOT_PAGE_SIZE);
+    }
+    
+    if (hashes[RAM_PAGES] != peer_hashes[RAM_PAGES]) {
+        Registers regs;
+        save_registers(&regs);
+        state_write_chunk(&writer, CHUNK_CPU, &regs.cpu, sizeof(regs.cpu));
+        state_write_chunk(&writer, CHUNK_PPU, &regs.ppu, sizeof(regs.ppu));
+        state_write_chunk(&writer, CHUNK_MAPPER, &regs.mapper, sizeof(regs.mapper));
+        state_write_chunk(&writer, CHUNK_PORTS, &regs.ports, sizeof(regs.ports));
+        apu_save_state(state_reserve_chunk(&writer, CHUNK_APU, apu_state_size()));
+    }
+    return state_end(&writer);
+}
+
+/**
+ * Turn tile video capture on or off. While on, every rendered frame is kept
+ * as palette indices (whatever the output format) for encodeTileFrame(), and
+ * the next packet is a keyframe.
+ */
+EMSCRIPTEN_KEEPALIVE
+void setTileEncoder(int enabled) {
+    tile_capture = enabled != 0;
+    memset(tile_source, BACKDROP_COLOR, sizeof(tile_source));
+    memset(tile_reference, BACKDROP_COLOR, sizeof(tile_reference));
+}
+
+/**
+ * Size encodeTileFrame() needs for `out` in the worst case
+ */
+EMSCRIPTEN_KEEPALIVE
+uint32_t tilePacketMaxSize() {
+    return TILES_PACKET_MAX;
+}
+
+/**
+ * Encode the last rendered frame as the tiles that changed since the last
+ * packet (all of them for a keyframe), see nes-tiles.h. Packets must reach
+ * the decoder in order; send a keyframe when one may have been lost or a
+ * viewer joins. Returns the packet size, or 0 if capture is off.
+ */
+EMSCRIPTEN_KEEPALIVE
+uint32_t encodeTileFrame(uint8_t* out, int keyframe) {
+    if (!tile_capture) {
+        return 0;
+    }
+    return tiles_encode(tile_source[0], tile_reference[0], keyframe, emphasis, out);
+}
+
+/**
+ * Apply a packet from encodeTileFrame() to the decoded frame and publish it
+ * as the latest frame in the current output format and crop, as if frame()
+ * had rendered it. Returns 0 (nothing changes) if the packet is malformed.
+ */
+EMSCRIPTEN_KEEPALIVE
+int decodeTileFrame(const uint8_t* packet, uint32_t size) {
+    int packet_emphasis = tiles_decode(packet, size, tile_view[0]);
+    if (packet_emphasis < 0) {
+        return 0;
+    }
+    
+    uint8_t saved_emphasis = emphasis;
+    emphasis = (uint8_t)packet_emphasis;
+    begin_frame();
+    for (int y = 0; y < NES_HEIGHT; y++) {
+        emit_scanline(y, tile_view[y]);
+    }
+    publish_frame();
+    emphasis = saved_emphasis;
+    return 1;
+}
+
+/**
+ * Get the core statistics (CoreStats, uint32 fields), refreshed by this call
+ */
+EMSCRIPTEN_KEEPALIVE
+CoreStats* getCoreStats() {
+    const SnapshotStats* snapshots = snapshot_stats();
+    core_stats.snapshots = snapshots->captures;
+    core_stats.snapshot_pages = snapshots->last_pages;
+    core_stats.snapshot_bytes = snapshots->last_bytes;
+    core_stats.snapshot_ns = snapshots->captures ? (uint32_t)(snapshot_ns / snapshots->captures) : 0;
+    core_stats.restore_ns = restores ? (uint32_t)(restore_ns / restores) : 0;
+    core_stats.snapshots_held = snapshots->held;
+    core_stats.snapshot_pool_bytes = snapshots->pool_pages * SNAPSHOT_PAGE_SIZE;
+    
+    const RewindStats* rewind = rewind_stats();
+    core_stats.rewind_states = rewind->entries;
+    core_stats.rewind_frames = rewind->entries * REWIND_INTERVAL;
+    core_stats.rewind_bytes = rewind->bytes;
+    core_stats.rewind_state_bytes = rewind->last_bytes;
+    core_stats.rewind_ns = rewind_captures ? (uint32_t)(rewind_ns / rewind_captures / REWIND_INTERVAL) : 0;
+    
+    core_stats.run_ahead = (uint32_t)run_ahead;
+    core_stats.run_ahead_frame_ns = run_ahead_frames ? (uint32_t)(run_ahead_frame_ns / run_ahead_frames) : 0;
+    core_stats.run_ahead_state_ns = run_ahead_passes ? (uint32_t)(run_ahead_state_ns / run_ahead_passes) : 0;
+    return &core_stats;
+}
+
+/**
+ * Set the memory for rewind history in bytes; 0 turns rewind off. While on,
+ * the state is captured every 2 frames and stored XOR-delta + RLE encoded, so
+ * a few MB hold minutes of play. Returns 0 if the budget is under 64KB or
+ * cannot be allocated (rewind is then off).
+ */
+EMSCRIPTEN_KEEPALIVE
+int setRewindBudget(uint32_t bytes) {
+    rewind_countdown = REWIND_INTERVAL;
+    rewind_ns = 0;
+    rewind_captures = 0;
+    return rewind_set_budget(bytes);
+}
+
+/**
+ * Step back to the newest state in the rewind history (2 frames earlier per
+ * call) and remove it. Calling it before each frame() rewinds at 2x speed;
+ * the frame() right after a step never captures, so stepping does not refill
+ * the history. Returns 0 when the history is exhausted.
+ */
+EMSCRIPTEN_KEEPALIVE
+int rewindStep() {
+    uint8_t* state = rewind_enabled() && rom_loaded ? rewind_state_buffer(saveStateSize()) : 0;
+    uint32_t size = state ? rewind_pop(state) : 0;
+    if (size == 0 || !loadState(state, size)) {
+        return 0;
+    }
+    rewind_countdown = REWIND_INTERVAL + 1;   // The frame() showing this state does not capture
+    return 1;
+}
+
+// Machine state kept across a run-ahead pass
+static struct {
+    GuestRam ram;
+    Registers regs;
+    uint8_t apu[SNAPSHOT_EXTRA_MAX];
+} run_ahead_state;
+
+/**
+ * Save the machine, emulate the run-ahead frames silently with only the last
+ * one rendered, then put the machine back. Writes made while running ahead
+ * leave their pages marked dirty, so the next snapshot still sees every page
+ * that may have changed.
+ */
+static void run_ahead_pass(void) {
+    double start = now_ns();
+    memcpy(&run_ahead_state.ram, &ram, sizeof(ram));
+    save_registers(&run_ahead_state.regs);
+    apu_save_state(run_ahead_state.apu);
+    
+    // Rendering moved here from the real frame, so it is not counted as run-ahead cost
+    double ahead_start = now_ns();
+    double render_ns = 0;
+    apu_set_silent(1);
+    for (int i = 1; i <= run_ahead; i++) {
+        if (i == run_ahead) {
+            double render_start = now_ns();
+            emulate_frame(1, 0);
+            render_ns = now_ns() - render_start;
+        } else {
+            emulate_frame(0, 0);
+        }
+        apu_end_frame(NES_CPU_CYCLES_PER_FRAME, stretch_input);
+        cpu_cycle = 0;
+    }
+    apu_set_silent(0);
+    double ahead_end = now_ns();
+    
+    memcpy(&ram, &run_ahead_state.ram, sizeof(ram));
+    load_cpu(&run_ahead_state.regs.cpu);
+    load_ppu(&run_ahead_state.regs.ppu);
+    load_mapper(&run_ahead_state.regs.mapper);
+    load_ports(&run_ahead_state.regs.ports);
+    apu_load_state(run_ahead_state.apu);
+    
+    run_ahead_frame_ns += ahead_end - ahead_start - render_ns;
+    run_ahead_state_ns += (now_ns() - start) - (ahead_end - ahead_start);
+    run_ahead_frames += (uint32_t)run_ahead;
+    run_ahead_passes++;
+}
+
+/**
+ * Hide `frames` (0-4) frames of the game's own input lag. Each frame() then
+ * emulates the real frame for audio, saves the machine, runs `frames` frames
+ * ahead with sound off (rendering only the last one, which is what the host
+ * displays) and restores the machine. Costs are reported by getCoreStats().
+ * Returns 0 if out of range.
+ */
+EMSCRIPTEN_KEEPALIVE
+int setRunAhead(int frames) {
+    if (frames < 0 || frames > RUN_AHEAD_MAX) {
+        return 0;
+    }
+    run_ahead = frames;
+    run_ahead_frame_ns = run_ahead_state_ns = 0;
+    run_ahead_frames = run_ahead_passes = 0;
+    return 1;
+}
@@ -0,0 +1,805 @@
+/**
+ * NES APU channels, frame counter and mixer
+ */
+
+#include "nes-apu.h"
+
+#include <string.h>
+
+#define APU_IDLE        INT32_MAX   // Event time of a channel whose timer is stopped
+#define APU_MIX_SCALE   28000.0     // Output units for a mix level of 1.0
+
+typedef struct {
+    uint8_t start;
+    uint8_t loop;             // Also halts the length counter
+    uint8_t constant;
+    uint8_t volume;           // Constant volume or divider period
+    uint8_t divider;
+    uint8_t decay;
+} Envelope;
+
+typedef struct {
+    Envelope envelope;
+    uint8_t duty;
+    uint8_t step;
+    uint8_t length;
+    uint8_t sweep_enabled;
+    uint8_t sweep_period;
+    uint8_t sweep_negate;
+    uint8_t sweep_shift;
+    uint8_t sweep_reload;
+    uint8_t sweep_divider;
+    uint8_t ones_complement;  // Pulse 1 negates with one's complement
+    uint8_t output;
+    uint16_t period;
+    int32_t next;
+} Pulse;
+
+typedef struct {
+    uint8_t control;          // Also halts the length counter
+    uint8_t linear_load;
+    uint8_t linear;
+    uint8_t linear_reload;
+    uint8_t length;
+    uint8_t step;
+    uint8_t output;
+    uint16_t period;
+    int32_t next;
+} Triangle;
+
+typedef struct {
+    Envelope envelope;
+    uint8_t mode;
+    uint8_t length;
+    uint8_t output;
+    uint16_t period;
+    uint16_t lfsr;
+    int32_t next;
+} Noise;
+
+typedef struct {
+    uint8_t irq_enabled;
+    uint8_t loop;
+    uint8_t level;
+    uint8_t shift;
+    uint8_t bits;
+    uint8_t silence;
+    uint8_t buffer;
+    uint8_t buffer_full;
+    uint8_t irq;
+    uint16_t sample_address;
+    uint16_t sample_length;
+    uint16_t address;
+    uint16_t remaining;
+    uint16_t period;
+    int32_t next;
+} Dmc;
+
+static const uint8_t length_table[32] = {
+    10, 254, 20, 2, 40, 4, 80, 6, 160, 8, 60, 10, 14, 12, 26, 14,
+    12, 16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30
+};
+
+static const uint8_t duty_table[4][8] = {
+    {0, 1, 0, 0, 0, 0, 0, 0},
+    {0, 1, 1, 0, 0, 0, 0, 0},
+    {0, 1, 1, 1, 1, 0, 0, 0},
+    {1, 0, 0, 1, 1, 1, 1, 1}
+};
+
+static const uint8_t triangle_table[32] = {
+    15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+};
+
+static const uint16_t noise_periods[16] = {
+    4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068
+};
+
+// Noise shift register jumps (the register is linear): noise_jumps[mode][j]
+// gives the register 2^j clocks on, XORed together from one lookup per nibble
+#define NOISE_JUMPS 32
+typedef uint16_t NoiseJump[4][16];
+static NoiseJump noise_jumps[2][NOISE_JUMPS];
+
+static const uint16_t dmc_periods[16] = {
+    428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54
+};
+
+// Frame counter step times (CPU cycles from the start of the sequence)
+static const int32_t frame_steps_4[4] = { 7457, 14913, 22371, 29829 };
+static const int32_t frame_steps_5[5] = { 7457, 14913, 22371, 29829, 37281 };
+#define FRAME_PERIOD_4 29830
+#define FRAME_PERIOD_5 37282
+
+// Nonlinear mixer lookup tables (pulse1 + pulse2, and 3 * triangle + 2 * noise + DMC)
+static int32_t pulse_mix[31];
+static int32_t tnd_mix[203];
+
+static Pulse pulse1, pulse2;
+static Triangle triangle;
+static Noise noise;
+static Dmc dmc;
+
+static uint8_t channels_enabled = 0;  // $4015 enable bits
+static uint8_t frame_mode = 0;        // 0 = 4-step, 1 = 5-step
+static uint8_t frame_irq_inhibit = 0;
+static uint8_t frame_irq = 0;
+static uint8_t frame_step = 0;
+static int32_t frame_base = 0;        // Start of the current frame counter sequence
+static int32_t frame_next = 0;
+
+static int32_t apu_time = 0;          // Cycle the channels have been run to
+static int32_t mix_level = 0;         // Mix currently represented in the blip buffer
+static uint32_t sample_rate = 44100;
+static int32_t rate_adjust_ppm = 0;   // Applied at the next frame boundary
+static int audio_enabled = 1;
+static int silenced_enabled = 1;      // audio_enabled to return to after apu_set_silent()
+static BlipBuffer blip;
+
+/**
+ * Look up the mix for the current channel outputs and record any change
+ */
+static void mix(int32_t time) {
+    if (!audio_enabled) {
+        return;
+    }
+    int32_t level = pulse_mix[pulse1.output + pulse2.output] +
+                    tnd_mix[3 * triangle.output + 2 * noise.output + dmc.level];
+    if (level != mix_level) {
+        blip_add_delta(&blip, (uint32_t)time, level - mix_level);
+        mix_level = level;
+    }
+}
+
+static void envelope_clock(Envelope* envelope) {
+    if (envelope->start) {
+        envelope->start = 0;
+        envelope->decay = 15;
+        envelope->divider = envelope->volume;
+    } else if (envelope->divider == 0) {
+        envelope->divider = envelope->volume;
+        if (envelope->decay > 0) {
+            envelope->decay--;
+        } else if (envelope->loop) {
+            envelope->decay = 15;
+        }
+    } else {
+        envelope->divider--;
+    }
+}
+
+static uint8_t envelope_volume(const Envelope* envelope) {
+    return envelope->constant ? envelope->volume : envelope->decay;
+}
+
+static uint8_t pulse_output(const Pulse* pulse) {
+    return duty_table[pulse->duty][pulse->step] ? envelope_volume(&pulse->envelope) : 0;
+}
+
+static uint16_t pulse_target(const Pulse* pulse) {
+    uint16_t change = pulse->period >> pulse->sweep_shift;
+    if (!pulse->sweep_negate) {
+        return pulse->period + change;
+    }
+    return pulse->period - change - pulse->ones_complement;
+}
+
+/**
+ * Recompute a pulse channel's output after a register or frame counter change.
+ * Muted channels stop their timer so they cost nothing until unmuted.
+ */
+static void pulse_refresh(Pulse* pulse, int32_t time) {
+    if (pulse->length == 0 || pulse->period < 8 || pulse_target(pulse) > 0x7FF) {
+        pulse->next = APU_IDLE;
+        pulse->output = 0;
+        return;
+    }
+    if (pulse->next == APU_IDLE) {
+        pulse->next = time + (pulse->period + 1) * 2;
+    }
+    pulse->output = pulse_output(pulse);
+}
+
+static void pulse_clock(Pulse* pulse) {
+    pulse->step = (pulse->step + 1) & 7;
+    pulse->next += (pulse->period + 1) * 2;
+    pulse->output = pulse_output(pulse);
+}
+
+static void pulse_sweep(Pulse* pulse) {
+    if (pulse->sweep_divider == 0 && pulse->sweep_enabled && pulse->sweep_shift > 0 &&
+        pulse->period >= 8 && pulse_target(pulse) <= 0x7FF) {
+        pulse->period = pulse_target(pulse);
+    }
+    if (pulse->sweep_divider == 0 || pulse->sweep_reload) {
+        pulse->sweep_divider = pulse->sweep_period;
+        pulse->sweep_reload = 0;
+    } else {
+        pulse->sweep_divider--;
+    }
+}
+
+static void pulse_write(Pulse* pulse, int reg, uint8_t value) {
+    switch (reg) {
+        case 0:
+            pulse->duty = value >> 6;
+            pulse->envelope.loop = (value >> 5) & 1;
+            pulse->envelope.constant = (value >> 4) & 1;
+            pulse->envelope.volume = value & 0x0F;
+            break;
+        case 1:
+            pulse->sweep_enabled = value >> 7;
+            pulse->sweep_period = (value >> 4) & 7;
+            pulse->sweep_negate = (value >> 3) & 1;
+            pulse->sweep_shift = value & 7;
+            pulse->sweep_reload = 1;
+            break;
+        case 2:
+            pulse->period = (pulse->period & 0x700) | value;
+            break;
+        case 3:
+            pulse->period = (pulse->period & 0xFF) | ((value & 7) << 8);
+            pulse->length = length_table[value >> 3];
+            pulse->step = 0;
+            pulse->envelope.start = 1;
+            break;
+    }
+}
+
+/**
+ * Triangle holds its current level when halted, so only the timer stops.
+ * Periods below 2 are ultrasonic and are frozen as well.
+ */
+static void triangle_refresh(int32_t time) {
+    if (triangle.length == 0 || triangle.linear == 0 || triangle.period < 2) {
+        triangle.next = APU_IDLE;
+    } else if (triangle.next == APU_IDLE) {
+        triangle.next = time + triangle.period + 1;
+    }
+    triangle.output = triangle_table[triangle.step];
+}
+
+static void triangle_clock(void) {
+    triangle.step = (triangle.step + 1) & 31;
+    triangle.next += triangle.period + 1;
+    triangle.output = triangle_table[triangle.step];
+}
+
+static void noise_refresh(int32_t time) {
+    if (noise.length == 0) {
+        noise.next = APU_IDLE;
+        noise.output = 0;
+        return;
+    }
+    if (noise.next == APU_IDLE) {
+        noise.next = time + noise.period;
+    }
+    noise.output = (noise.lfsr & 1) ? 0 : envelope_volume(&noise.envelope);
+}
+
+static uint16_t lfsr_step(uint16_t lfsr, int mode) {
+    uint16_t feedback = (lfsr ^ (lfsr >> (mode ? 6 : 1))) & 1;
+    return (uint16_t)((lfsr >> 1) | (feedback << 14));
+}
+
+static uint16_t lfsr_jump(const NoiseJump jump, uint16_t lfsr) {
+    return jump[0][lfsr & 15] ^ jump[1][(lfsr >> 4) & 15] ^ jump[2][(lfsr >> 8) & 15] ^ jump[3][lfsr >> 12];
+}
+
+/**
+ * Fill a jump's nibble tables from the registers reached by each single bit
+ */
+static void noise_jump_build(NoiseJump jump, const uint16_t* columns) {
+    for (int nibble = 0; nibble < 4; nibble++) {
+        for (int value = 0; value < 16; value++) {
+            uint16_t result = 0;
+            for (int bit = 0; bit < 4; bit++) {
+                if ((value & (1 << bit)) && nibble * 4 + bit < 15) {
+                    result ^= columns[nibble * 4 + bit];
+                }
+            }
+            jump[nibble][value] = result;
+        }
+    }
+}
+
+static void build_noise_jumps(void) {
+    uint16_t columns[15];
+    for (int mode = 0; mode < 2; mode++) {
+        for (int bit = 0; bit < 15; bit++) {
+            columns[bit] = lfsr_step((uint16_t)(1 << bit), mode);
+        }
+        noise_jump_build(noise_jumps[mode][0], columns);
+        for (int j = 1; j < NOISE_JUMPS; j++) {
+            // Twice the previous jump
+            for (int bit = 0; bit < 15; bit++) {
+                uint16_t once = lfsr_jump(noise_jumps[mode][j - 1], (uint16_t)(1 << bit));
+                columns[bit] = lfsr_jump(noise_jumps[mode][j - 1], once);
+            }
+            noise_jump_build(noise_jumps[mode][j], columns);
+        }
+    }
+}
+
+static void noise_clock(void) {
+    noise.lfsr = lfsr_step(noise.lfsr, noise.mode);
+    noise.next += noise.period;
+    noise.output = (noise.lfsr & 1) ? 0 : envelope_volume(&noise.envelope);
+}
+
+static void dmc_restart(void) {
+    dmc.address = dmc.sample_address;
+    dmc.remaining = dmc.sample_length;
+}
+
+/**
+ * Refill the sample buffer from the CPU bus when it is empty
+ */
+static void dmc_fetch(void) {
+    if (dmc.buffer_full || dmc.remaining == 0) {
+        return;
+    }
+    dmc.buffer = cpu_read(dmc.address);
+    dmc.buffer_full = 1;
+    dmc.address = dmc.address == 0xFFFF ? 0x8000 : dmc.address + 1;
+    if (--dmc.remaining == 0) {
+        if (dmc.loop) {
+            dmc_restart();
+        } else if (dmc.irq_enabled) {
+            dmc.irq = 1;
+        }
+    }
+}
+
+static void dmc_clock(void) {
+    if (!dmc.silence) {
+        if (dmc.shift & 1) {
+            if (dmc.level <= 125) dmc.level += 2;
+        } else {
+            if (dmc.level >= 2) dmc.level -= 2;
+        }
+    }
+    dmc.shift >>= 1;
+    dmc.next += dmc.period;
+
+    if (--dmc.bits == 0) {
+        dmc.bits = 8;
+        dmc.silence = !dmc.buffer_full;
+        if (dmc.buffer_full) {
+            dmc.shift = dmc.buffer;
+            dmc.buffer_full = 0;
+            dmc_fetch();
+        } else if (dmc.remaining == 0) {
+            // Nothing left to play; the level holds until the next sample starts
+            dmc.next = APU_IDLE;
+        }
+    }
+}
+
+static void quarter_frame(void) {
+    envelope_clock(&pulse1.envelope);
+    envelope_clock(&pulse2.envelope);
+    envelope_clock(&noise.envelope);
+
+    if (triangle.linear_reload) {
+        triangle.linear = triangle.linear_load;
+    } else if (triangle.linear > 0) {
+        triangle.linear--;
+    }
+    if (!triangle.control) {
+        triangle.linear_reload = 0;
+    }
+}
+
+static void half_frame(void) {
+    if (!pulse1.envelope.loop && pulse1.length > 0) pulse1.length--;
+    if (!pulse2.envelope.loop && pulse2.length > 0) pulse2.length--;
+    if (!triangle.control && triangle.length > 0) triangle.length--;
+    if (!noise.envelope.loop && noise.length > 0) noise.length--;
+
+    pulse_sweep(&pulse1);
+    pulse_sweep(&pulse2);
+}
+
+static void refresh_channels(int32_t time) {
+    pulse_refresh(&pulse1, time);
+    pulse_refresh(&pulse2, time);
+    triangle_refresh(time);
+    noise_refresh(time);
+}
+
+static void frame_counter_clock(int32_t time) {
+    if (frame_mode == 0) {
+        quarter_frame();
+        if (frame_step & 1) {
+            half_frame();
+        }
+        if (frame_step == 3 && !frame_irq_inhibit) {
+            frame_irq = 1;
+        }
+    } else if (frame_step != 3) {
+        quarter_frame();
+        if (frame_step == 1 || frame_step == 4) {
+            half_frame();
+        }
+    }
+    refresh_channels(time);
+
+    int steps = frame_mode ? 5 : 4;
+    if (++frame_step == steps) {
+        frame_step = 0;
+        frame_base += frame_mode ? FRAME_PERIOD_5 : FRAME_PERIOD_4;
+    }
+    frame_next = frame_base + (frame_mode ? frame_steps_5 : frame_steps_4)[frame_step];
+}
+
+/**
+ * Clock a timer through all of its events before `limit` at once.
+ * Returns the clocks (0 for an idle timer).
+ */
+static uint32_t timer_skip(int32_t* next, int32_t period, int32_t limit) {
+    if (*next >= limit) {
+        return 0;
+    }
+    uint32_t clocks = (uint32_t)((limit - 1 - *next) / period) + 1;
+    *next += (int32_t)clocks * period;
+    return clocks;
+}
+
+static void pulse_skip(Pulse* pulse, int32_t limit) {
+    uint32_t clocks = timer_skip(&pulse->next, (pulse->period + 1) * 2, limit);
+    if (clocks) {
+        pulse->step = (uint8_t)((pulse->step + clocks) & 7);
+        pulse->output = pulse_output(pulse);
+    }
+}
+
+/**
+ * Without sound: bring the tone channels' timers, sequencers and noise shift
+ * register to where clocking them one event at a time would have, for the
+ * events before `limit`. Periods only change at frame counter events and
+ * register writes, so the jump is exact in between.
+ */
+static void tones_skip(int32_t limit) {
+    pulse_skip(&pulse1, limit);
+    pulse_skip(&pulse2, limit);
+
+    uint32_t clocks = timer_skip(&triangle.next, triangle.period + 1, limit);
+    if (clocks) {
+        triangle.step = (uint8_t)((triangle.step + clocks) & 31);
+        triangle.output = triangle_table[triangle.step];
+    }
+
+    clocks = timer_skip(&noise.next, noise.period, limit);
+    if (clocks) {
+        for (int j = 0; clocks; j++, clocks >>= 1) {
+            if (clocks & 1) {
+                noise.lfsr = lfsr_jump(noise_jumps[noise.mode][j], noise.lfsr);
+            }
+        }
+        noise.output = (noise.lfsr & 1) ? 0 : envelope_volume(&noise.envelope);
+    }
+}
+
+/**
+ * Advance every channel to `end`, visiting only cycles where something happens
+ */
+static void apu_run(int32_t end) {
+    // Without sound only the events games can observe are visited: the frame
+    // counter (lengths, sweeps, IRQ) and the DMC (sample fetches, IRQ). Tone
+    // timers are caught up before each frame counter event, as they would
+    // have run first at the same cycle.
+    while (!audio_enabled) {
+        int32_t time = frame_next < dmc.next ? frame_next : dmc.next;
+        if (time >= end) {
+            tones_skip(end);
+            break;
+        }
+        if (dmc.next == time) dmc_clock();
+        if (frame_next == time) {
+            tones_skip(time + 1);
+            frame_counter_clock(time);
+        }
+    }
+
+    while (audio_enabled) {
+        int32_t time = frame_next;
+        if (pulse1.next < time) time = pulse1.next;
+        if (pulse2.next < time) time = pulse2.next;
+        if (triangle.next < time) time = triangle.next;
+        if (noise.next < time) time = noise.next;
+        if (dmc.next < time) time = dmc.next;
+        if (time >= end) {
+            break;
+        }
+
+        if (pulse1.next == time) pulse_clock(&pulse1);
+        if (pulse2.next == time) pulse_clock(&pulse2);
+        if (triangle.next == time) triangle_clock();
+        if (noise.next == time) noise_clock();
+        if (dmc.next == time) dmc_clock();
+        if (frame_next == time) frame_counter_clock(time);
+        mix(time);
+    }
+    if (end > apu_time) {
+        apu_time = end;
+    }
+}
+
+void apu_init(uint32_t rate) {
+    for (int n = 0; n < 31; n++) {
+        pulse_mix[n] = n == 0 ? 0 : (int32_t)(95.52 / (8128.0 / n + 100) * APU_MIX_SCALE);
+    }
+    for (int n = 0; n < 203; n++) {
+        tnd_mix[n] = n == 0 ? 0 : (int32_t)(163.67 / (24329.0 / n + 100) * APU_MIX_SCALE);
+    }
+
+    blip_init_kernel();
+    build_noise_jumps();
+    sample_rate = rate;
+    apu_reset();
+}
+
+void apu_reset(void) {
+    memset(&pulse1, 0, sizeof(pulse1));
+    memset(&pulse2, 0, sizeof(pulse2));
+    memset(&triangle, 0, sizeof(triangle));
+    memset(&noise, 0, sizeof(noise));
+    memset(&dmc, 0, sizeof(dmc));
+
+    pulse1.ones_complement = 1;
+    pulse1.next = pulse2.next = triangle.next = noise.next = dmc.next = APU_IDLE;
+    noise.lfsr = 1;
+    noise.period = noise_periods[0];
+    dmc.period = dmc_periods[0];
+    dmc.bits = 8;
+    dmc.silence = 1;
+
+    channels_enabled = 0;
+    frame_mode = 0;
+    frame_irq_inhibit = 0;
+    frame_irq = 0;
+    frame_step = 0;
+    frame_base = 0;
+    frame_next = frame_steps_4[0];
+
+    apu_time = 0;
+    mix_level = 0;
+    blip_set_rates(&blip, NES_CPU_CLOCK, sample_rate);
+    blip_adjust_rate(&blip, rate_adjust_ppm);
+}
+
+int apu_set_sample_rate(uint32_t rate) {
+    if (rate < 8000 || rate > 192000) {
+        return 0;
+    }
+    sample_rate = rate;
+    blip_set_rates(&blip, NES_CPU_CLOCK, sample_rate);
+    blip_adjust_rate(&blip, rate_adjust_ppm);
+
+    // The cleared buffer starts from silence; re-add the level being held
+    mix_level = 0;
+    mix(apu_time);
+    return 1;
+}
+
+void apu_write(int32_t cycle, uint16_t addr, uint8_t value) {
+    apu_run(cycle);
+    int32_t time = apu_time;
+
+    switch (addr) {
+        case 0x4000: case 0x4001: case 0x4002: case 0x4003:
+            pulse_write(&pulse1, addr & 3, value);
+            break;
+        case 0x4004: case 0x4005: case 0x4006: case 0x4007:
+            pulse_write(&pulse2, addr & 3, value);
+            break;
+        case 0x4008:
+            triangle.control = value >> 7;
+            triangle.linear_load = value & 0x7F;
+            break;
+        case 0x400A:
+            triangle.period = (triangle.period & 0x700) | value;
+            break;
+        case 0x400B:
+            triangle.period = (triangle.period & 0xFF) | ((value & 7) << 8);
+            triangle.length = length_table[value >> 3];
+            triangle.linear_reload = 1;
+            break;
+        case 0x400C:
+            noise.envelope.loop = (value >> 5) & 1;
+            noise.envelope.constant = (value >> 4) & 1;
+            noise.envelope.volume = value & 0x0F;
+            break;
+        case 0x400E:
+            noise.mode = value >> 7;
+            noise.period = noise_periods[value & 0x0F];
+            break;
+        case 0x400F:
+            noise.length = length_table[value >> 3];
+            noise.envelope.start = 1;
+            break;
+        case 0x4010:
+            dmc.irq_enabled = value >> 7;
+            dmc.loop = (value >> 6) & 1;
+            dmc.period = dmc_periods[value & 0x0F];
+            if (!dmc.irq_enabled) dmc.irq = 0;
+            break;
+        case 0x4011:
+            dmc.level = value & 0x7F;
+            break;
+        case 0x4012:
+            dmc.sample_address = 0xC000 + value * 64;
+            break;
+        case 0x4013:
+            dmc.sample_length = value * 16 + 1;
+            break;
+        case 0x4015:
+            channels_enabled = value & 0x1F;
+            dmc.irq = 0;
+            if (!(value & 0x10)) {
+                dmc.remaining = 0;
+            } else if (dmc.remaining == 0) {
+                dmc_restart();
+                dmc_fetch();
+                if (dmc.next == APU_IDLE) dmc.next = time + dmc.period;
+            }
+            break;
+        case 0x4017:
+            frame_mode = value >> 7;
+            frame_irq_inhibit = (value >> 6) & 1;
+            if (frame_irq_inhibit) frame_irq = 0;
+            frame_step = 0;
+            frame_base = time;
+            frame_next = time + frame_steps_4[0];
+            if (frame_mode) {
+                quarter_frame();
+                half_frame();
+            }
+            break;
+        default:
+            return;
+    }
+
+    // Length counters of disabled channels stay at zero
+    if (!(channels_enabled & 0x01)) pulse1.length = 0;
+    if (!(channels_enabled & 0x02)) pulse2.length = 0;
+    if (!(channels_enabled & 0x04)) triangle.length = 0;
+    if (!(channels_enabled & 0x08)) noise.length = 0;
+
+    refresh_channels(time);
+    mix(time);
+}
+
+void apu_set_enabled(int enabled) {
+    enabled = enabled ? 1 : 0;
+    if (enabled == audio_enabled) {
+        return;
+    }
+    audio_enabled = enabled;
+
+    if (enabled) {
+        // The timers kept running; rebuild the mix from silence
+        blip_clear(&blip);
+        mix_level = 0;
+        mix(apu_time);
+    }
+}
+
+void apu_set_silent(int silent) {
+    if (silent) {
+        silenced_enabled = audio_enabled;
+        audio_enabled = 0;
+    } else {
+        audio_enabled = silenced_enabled;
+    }
+}
+
+void apu_set_rate_adjust(int32_t ppm) {
+    rate_adjust_ppm = ppm;
+}
+
+uint8_t apu_read_status(int32_t cycle) {
+    apu_run(cycle);
+
+    uint8_t status = (pulse1.length > 0 ? 0x01 : 0) |
+                     (pulse2.length > 0 ? 0x02 : 0) |
+                     (triangle.length > 0 ? 0x04 : 0) |
+                     (noise.length > 0 ? 0x08 : 0) |
+                     (dmc.remaining > 0 ? 0x10 : 0) |
+                     (frame_irq ? 0x40 : 0) |
+                     (dmc.irq ? 0x80 : 0);
+    frame_irq = 0;
+    return status;
+}
+
+int apu_irq_pending(void) {
+    return frame_irq || dmc.irq;
+}
+
+// Everything a savestate needs; the blip buffer and output settings belong to the host
+typedef struct {
+    Pulse pulse1, pulse2;
+    Triangle triangle;
+    Noise noise;
+    Dmc dmc;
+    uint8_t channels_enabled;
+    uint8_t frame_mode;
+    uint8_t frame_irq_inhibit;
+    uint8_t frame_irq;
+    uint8_t frame_step;
+    int32_t frame_base;
+    int32_t frame_next;
+    int32_t apu_time;
+} ApuState;
+
+uint32_t apu_state_size(void) {
+    return sizeof(ApuState);
+}
+
+void apu_save_state(void* out) {
+    ApuState state;
+    memset(&state, 0, sizeof(state));   // Deterministic padding bytes
+    state.pulse1 = pulse1;
+    state.pulse2 = pulse2;
+    state.triangle = triangle;
+    state.noise = noise;
+    state.dmc = dmc;
+    state.channels_enabled = channels_enabled;
+    state.frame_mode = frame_mode;
+    state.frame_irq_inhibit = frame_irq_inhibit;
+    state.frame_irq = frame_irq;
+    state.frame_step = frame_step;
+    state.frame_base = frame_base;
+    state.frame_next = frame_next;
+    state.apu_time = apu_time;
+    memcpy(out, &state, sizeof(state));
+}
+
+void apu_load_state(const void* in) {
+    ApuState state;
+    memcpy(&state, in, sizeof(state));
+    pulse1 = state.pulse1;
+    pulse2 = state.pulse2;
+    triangle = state.triangle;
+    noise = state.noise;
+    dmc = state.dmc;
+    channels_enabled = state.channels_enabled;
+    frame_mode = state.frame_mode;
+    frame_irq_inhibit = state.frame_irq_inhibit;
+    frame_irq = state.frame_irq;
+    frame_step = state.frame_step;
+    frame_base = state.frame_base;
+    frame_next = state.frame_next;
+    apu_time = state.apu_time;
+
+    if (!audio_enabled) {
+        return;
+    }
+    // Step from the level being played to the restored one; the blip buffer
+    // keeps its history so the jump is band-limited rather than a click
+    mix(apu_time);
+}
+
+int apu_end_frame(int32_t cycles, int16_t* out) {
+    apu_run(cycles);
+
+    // Rebase every pending event onto the next frame
+    apu_time -= cycles;
+    frame_base -= cycles;
+    frame_next -= cycles;
+    if (dmc.next != APU_IDLE) dmc.next -= cycles;
+    if (pulse1.next != APU_IDLE) pulse1.next -= cycles;
+    if (pulse2.next != APU_IDLE) pulse2.next -= cycles;
+    if (triangle.next != APU_IDLE) triangle.next -= cycles;
+    if (noise.next != APU_IDLE) noise.next -= cycles;
+
+    if (!audio_enabled) {
+        return 0;
+    }
+
+    int count = blip_end_frame(&blip, (uint32_t)cycles, out);
+    blip_adjust_rate(&blip, rate_adjust_ppm);
+    return count;
+}
@@ -0,0 +1,85 @@
+/**
+ * NES APU (2A03 sound): two pulse channels, triangle, noise and DMC
+ *
+ * Channels are event driven: the APU jumps from one timer or frame counter
+ * event to the next instead of stepping every CPU cycle. Whenever a channel's
+ * output changes, the nonlinear mix is looked up again and the difference is
+ * added to a band-limited step buffer (nes-blip.h) at that cycle.
+ */
+
+#ifndef NES_APU_H
+#define NES_APU_H
+
+#include <stdint.h>
+
+#include "nes-blip.h"
+
+#define NES_CPU_CLOCK             1789773   // NTSC CPU clock (Hz)
+#define NES_CPU_CYCLES_PER_FRAME  29781     // 262 scanlines x 341 dots / 3, rounded
+#define APU_MAX_SAMPLES           BLIP_MAX_SAMPLES
+
+/**
+ * Provided by the core: CPU bus read, used for DMC sample fetches
+ */
+uint8_t cpu_read(uint16_t addr);
+
+void apu_init(uint32_t sample_rate);
+void apu_reset(void);
+
+/**
+ * Change the output rate (8000-192000 Hz). Returns 0 if out of range.
+ */
+int apu_set_sample_rate(uint32_t sample_rate);
+
+/**
+ * Disable or re-enable sound generation. While disabled the APU keeps length
+ * counters, sweeps, envelopes, the frame counter IRQ and DMC fetch/IRQ timing
+ * (all visible to games) and skips mixing and synthesis; apu_end_frame()
+ * produces no samples. Channel timers jump straight from one frame counter
+ * event to the next, so the saved state matches a run with sound.
+ */
+void apu_set_enabled(int enabled);
+
+/**
+ * Run frames whose APU state will be discarded (run-ahead) without synthesis.
+ * Unlike apu_set_enabled(0) the output buffer and mix level are left alone, so
+ * after unsilencing, the caller must restore the state saved before silencing
+ * with apu_load_state(); output then continues without a seam.
+ */
+void apu_set_silent(int silent);
+
+/**
+ * Resample slightly faster (ppm > 0) or slower from the next frame on, so the
+ * host's output buffer neither drains nor fills up. The band-limited step
+ * buffer places every delta at its exact fractional output position, so a
+ * new ratio takes effect without a separate resampling pass or a glitch.
+ */
+void apu_set_rate_adjust(int32_t ppm);
+
+/**
+ * Register access at a CPU cycle within the current frame
+ */
+void apu_write(int32_t cycle, uint16_t addr, uint8_t value);
+uint8_t apu_read_status(int32_t cycle);
+
+/**
+ * Frame counter or DMC interrupt pending
+ */
+int apu_irq_pending(void);
+
+/**
+ * Run to the end of a frame of `cycles` CPU cycles and write the frame's
+ * samples (mono, signed 16-bit). Returns the number of samples written.
+ */
+int apu_end_frame(int32_t cycles, int16_t* out);
+
+/**
+ * Savestate support: channel, frame counter and DMC state as an opaque blob of
+ * apu_state_size() bytes. Output settings (rate, enable, rate control) are not
+ * part of it.
+ */
+uint32_t apu_state_size(void);
+void apu_save_state(void* out);
+void apu_load_state(const void* in);
+
+#endif // NES_APU_H
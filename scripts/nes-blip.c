@@ -0,0 +1,100 @@
+/**
+ * Band-limited step synthesis buffer
+ */
+
+#include "nes-blip.h"
+
+#include <math.h>
+#include <string.h>
+
+#define BLIP_CUTOFF   0.90    // Passband as a fraction of Nyquist
+#define BLIP_DC_SHIFT 8       // DC blocker time constant (2^n samples, ~25Hz at 44.1kHz)
+
+static int16_t blip_kernel[BLIP_PHASES][BLIP_TAPS];
+
+void blip_init_kernel(void) {
+    const double pi = 3.14159265358979323846;
+
+    for (int phase = 0; phase < BLIP_PHASES; phase++) {
+        double fraction = (double)phase / BLIP_PHASES;
+        double taps[BLIP_TAPS];
+        double sum = 0;
+
+        // Windowed sinc centered between taps 7 and 8, shifted by the phase
+        for (int k = 0; k < BLIP_TAPS; k++) {
+            double x = k - (BLIP_TAPS / 2 - 1) - fraction;
+            double sinc = x == 0 ? BLIP_CUTOFF : sin(pi * BLIP_CUTOFF * x) / (pi * x);
+            double n = (k + 0.5 - fraction) / BLIP_TAPS;
+            double window = 0.42 - 0.5 * cos(2 * pi * n) + 0.08 * cos(4 * pi * n);
+            taps[k] = sinc * window;
+            sum += taps[k];
+        }
+
+        // Normalize so every impulse integrates to exactly 1 << BLIP_KERNEL_BITS;
+        // rounding error goes to the largest tap so no DC creeps in
+        int total = 0;
+        int largest = 0;
+        for (int k = 0; k < BLIP_TAPS; k++) {
+            blip_kernel[phase][k] = (int16_t)lround(taps[k] / sum * (1 << BLIP_KERNEL_BITS));
+            total += blip_kernel[phase][k];
+            if (blip_kernel[phase][k] > blip_kernel[phase][largest]) largest = k;
+        }
+        blip_kernel[phase][largest] += (int16_t)((1 << BLIP_KERNEL_BITS) - total);
+    }
+}
+
+void blip_clear(BlipBuffer* blip) {
+    blip->offset = 0;
+    blip->integrator = 0;
+    blip->dc = 0;
+    memset(blip->buffer, 0, sizeof(blip->buffer));
+}
+
+void blip_set_rates(BlipBuffer* blip, uint32_t clock_rate, uint32_t sample_rate) {
+    blip->base_factor = ((uint64_t)sample_rate << BLIP_FRAC_BITS) / clock_rate;
+    blip->factor = blip->base_factor;
+    blip_clear(blip);
+}
+
+void blip_adjust_rate(BlipBuffer* blip, int32_t ppm) {
+    blip->factor = blip->base_factor + (int64_t)blip->base_factor * ppm / 1000000;
+}
+
+void blip_add_delta(BlipBuffer* blip, uint32_t time, int32_t delta) {
+    uint64_t position = blip->offset + time * blip->factor;
+    int32_t* out = blip->buffer + (position >> BLIP_FRAC_BITS);
+    const int16_t* kernel = blip_kernel[(position >> (BLIP_FRAC_BITS - BLIP_PHASE_BITS)) & (BLIP_PHASES - 1)];
+
+    for (int k = 0; k < BLIP_TAPS; k++) {
+        out[k] += delta * kernel[k];
+    }
+}
+
+int blip_end_frame(BlipBuffer* blip, uint32_t time, int16_t* out) {
+    uint64_t end = blip->offset + time * blip->factor;
+    int count = (int)(end >> BLIP_FRAC_BITS);
+    if (count > BLIP_MAX_SAMPLES) count = BLIP_MAX_SAMPLES;
+    blip->offset = end - ((uint64_t)count << BLIP_FRAC_BITS);
+
+    int32_t integrator = blip->integrator;
+    int32_t dc = blip->dc;
+    for (int i = 0; i < count; i++) {
+        integrator += blip->buffer[i];
+        int32_t level = integrator >> BLIP_KERNEL_BITS;
+
+        // One-pole high-pass, standing in for the console's output coupling capacitors
+        int32_t sample = level - (dc >> 8);
+        dc += ((level << 8) - dc) >> BLIP_DC_SHIFT;
+
+        if (sample > 32767) sample = 32767;
+        if (sample < -32768) sample = -32768;
+        out[i] = (int16_t)sample;
+    }
+    blip->integrator = integrator;
+    blip->dc = dc;
+
+    // Keep the impulse tails that reach into the next frame
+    memmove(blip->buffer, blip->buffer + count, BLIP_TAPS * sizeof(int32_t));
+    memset(blip->buffer + BLIP_TAPS, 0, count * sizeof(int32_t));
+    return count;
+}
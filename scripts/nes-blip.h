@@ -0,0 +1,61 @@
+/**
+ * Band-limited step synthesis
+ *
+ * Channels report amplitude changes as deltas at CPU-cycle timestamps. Each delta
+ * is spread over BLIP_TAPS output samples using a windowed-sinc impulse picked
+ * by the delta's sub-sample phase, and the buffer is integrated once per frame.
+ * The result is an alias-free step waveform at the host sample rate, with no
+ * per-cycle oversampling.
+ */
+
+#ifndef NES_BLIP_H
+#define NES_BLIP_H
+
+#include <stdint.h>
+
+#define BLIP_PHASE_BITS   6
+#define BLIP_PHASES       (1 << BLIP_PHASE_BITS)  // Sub-sample positions per impulse
+#define BLIP_TAPS         16                      // Output samples touched per delta
+#define BLIP_KERNEL_BITS  14                      // Each impulse sums to 1 << BLIP_KERNEL_BITS
+#define BLIP_FRAC_BITS    32                      // Fixed-point bits of sample positions
+#define BLIP_MAX_SAMPLES  4096                    // Samples one frame may produce
+
+typedef struct {
+    uint64_t base_factor;     // Output samples per clock at the nominal rate
+    uint64_t factor;          // Output samples per clock, BLIP_FRAC_BITS fixed point
+    uint64_t offset;          // Fractional sample position carried into the next frame
+    int32_t integrator;       // Running sum of the delta buffer
+    int32_t dc;               // DC blocker state (level << 8)
+    int32_t buffer[BLIP_MAX_SAMPLES + BLIP_TAPS];
+} BlipBuffer;
+
+/**
+ * Build the shared impulse table (call once before use)
+ */
+void blip_init_kernel(void);
+
+/**
+ * Set the input clock and output sample rate and clear the buffer
+ */
+void blip_set_rates(BlipBuffer* blip, uint32_t clock_rate, uint32_t sample_rate);
+
+void blip_clear(BlipBuffer* blip);
+
+/**
+ * Scale the output rate by (1 + ppm / 1e6). Only call between frames: deltas
+ * already added this frame were placed at the previous ratio.
+ */
+void blip_adjust_rate(BlipBuffer* blip, int32_t ppm);
+
+/**
+ * Add an amplitude change at a clock time relative to the start of the frame
+ */
+void blip_add_delta(BlipBuffer* blip, uint32_t time, int32_t delta);
+
+/**
+ * Finish a frame of `time` clocks and write the completed samples.
+ * Returns the number of samples written.
+ */
+int blip_end_frame(BlipBuffer* blip, uint32_t time, int16_t* out);
+
+#endif // NES_BLIP_H
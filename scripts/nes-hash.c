@@ -0,0 +1,98 @@
+/**
+ * xxHash32
+ */
+
+#include "nes-hash.h"
+
+#include <string.h>
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+#define PRIME1 0x9E3779B1u
+#define PRIME2 0x85EBCA77u
+#define PRIME3 0xC2B2AE3Du
+#define PRIME4 0x27D4EB2Fu
+#define PRIME5 0x165667B1u
+
+static inline uint32_t rotl(uint32_t x, int r) {
+    return (x << r) | (x >> (32 - r));
+}
+
+// Little-endian targets only (wasm, x86)
+static inline uint32_t read32(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t round32(uint32_t acc, uint32_t input) {
+    return rotl(acc + input * PRIME2, 13) * PRIME1;
+}
+
+uint32_t hash_xxh32(const void* data, uint32_t size, uint32_t seed) {
+    const uint8_t* p = (const uint8_t*)data;
+    const uint8_t* end = p + size;
+    uint32_t h;
+
+    if (size >= 16) {
+        const uint8_t* limit = end - 16;
+        uint32_t v[4];
+#if defined(__wasm_simd128__)
+        v128_t acc = wasm_i32x4_make(seed + PRIME1 + PRIME2, seed + PRIME2, seed, seed - PRIME1);
+        const v128_t prime1 = wasm_i32x4_splat((int32_t)PRIME1);
+        const v128_t prime2 = wasm_i32x4_splat((int32_t)PRIME2);
+        do {
+            acc = wasm_i32x4_add(acc, wasm_i32x4_mul(wasm_v128_load(p), prime2));
+            acc = wasm_v128_or(wasm_i32x4_shl(acc, 13), wasm_u32x4_shr(acc, 19));
+            acc = wasm_i32x4_mul(acc, prime1);
+            p += 16;
+        } while (p <= limit);
+        wasm_v128_store(v, acc);
+#elif defined(__SSE4_1__)
+        __m128i acc = _mm_setr_epi32((int)(seed + PRIME1 + PRIME2), (int)(seed + PRIME2), (int)seed, (int)(seed - PRIME1));
+        const __m128i prime1 = _mm_set1_epi32((int)PRIME1);
+        const __m128i prime2 = _mm_set1_epi32((int)PRIME2);
+        do {
+            acc = _mm_add_epi32(acc, _mm_mullo_epi32(_mm_loadu_si128((const __m128i*)p), prime2));
+            acc = _mm_or_si128(_mm_slli_epi32(acc, 13), _mm_srli_epi32(acc, 19));
+            acc = _mm_mullo_epi32(acc, prime1);
+            p += 16;
+        } while (p <= limit);
+        _mm_storeu_si128((__m128i*)v, acc);
+#else
+        v[0] = seed + PRIME1 + PRIME2;
+        v[1] = seed + PRIME2;
+        v[2] = seed;
+        v[3] = seed - PRIME1;
+        do {
+            v[0] = round32(v[0], read32(p));
+            v[1] = round32(v[1], read32(p + 4));
+            v[2] = round32(v[2], read32(p + 8));
+            v[3] = round32(v[3], read32(p + 12));
+            p += 16;
+        } while (p <= limit);
+#endif
+        h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+    } else {
+        h = seed + PRIME5;
+    }
+
+    h += size;
+    for (; p + 4 <= end; p += 4) {
+        h = rotl(h + read32(p) * PRIME3, 17) * PRIME4;
+    }
+    for (; p < end; p++) {
+        h = rotl(h + *p * PRIME5, 11) * PRIME1;
+    }
+
+    h ^= h >> 15;
+    h *= PRIME2;
+    h ^= h >> 13;
+    h *= PRIME3;
+    h ^= h >> 16;
+    return h;
+}
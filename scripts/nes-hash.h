@@ -0,0 +1,17 @@
+/**
+ * Fast state hashing
+ *
+ * xxHash32 (same output as the reference implementation), with the four
+ * accumulator lanes kept in one vector under simd128 or SSE4.1. Netplay peers
+ * compare a hash of the emulation state every few frames; per-page hashes
+ * then narrow a mismatch down to the pages that need resending.
+ */
+
+#ifndef NES_HASH_H
+#define NES_HASH_H
+
+#include <stdint.h>
+
+uint32_t hash_xxh32(const void* data, uint32_t size, uint32_t seed);
+
+#endif // NES_HASH_H
@@ -0,0 +1,113 @@
+/**
+ * Frame-stamped input queue
+ */
+
+#include "nes-input.h"
+
+#define NOTHING_DUE UINT64_MAX
+
+// Four Score ID, clocked out MSB first after both pads' buttons
+static const uint8_t four_score_signature[2] = { 0x10, 0x20 };
+
+static InputEvent queue[INPUT_QUEUE_MAX];
+static uint32_t queued = 0;
+static uint64_t next_due = NOTHING_DUE;   // Earliest event_time() in the queue
+
+static uint64_t event_time(uint32_t frame, uint32_t scanline) {
+    return ((uint64_t)frame << 16) | scanline;
+}
+
+void input_reset(void) {
+    queued = 0;
+    next_due = NOTHING_DUE;
+}
+
+int input_queue(const InputEvent* events, int count, int port_count) {
+    int accepted = 0;
+    for (int i = 0; i < count && queued < INPUT_QUEUE_MAX; i++) {
+        if (events[i].port < port_count && events[i].port < INPUT_MAX_PORTS) {
+            uint64_t time = event_time(events[i].frame, events[i].scanline);
+            if (time < next_due) {
+                next_due = time;
+            }
+            queue[queued++] = events[i];
+            accepted++;
+        }
+    }
+    return accepted;
+}
+
+void input_apply(uint32_t frame, uint32_t scanline, uint8_t* ports) {
+    uint64_t now = event_time(frame, scanline);
+    if (next_due > now) {
+        return;
+    }
+
+    uint32_t kept = 0;
+    uint64_t applied_time[INPUT_MAX_PORTS];
+    uint8_t applied[INPUT_MAX_PORTS] = { 0 };
+
+    next_due = NOTHING_DUE;
+    for (uint32_t i = 0; i < queued; i++) {
+        const InputEvent* event = &queue[i];
+        uint64_t time = event_time(event->frame, event->scanline);
+        if (time > now) {
+            if (time < next_due) {
+                next_due = time;
+            }
+            queue[kept++] = *event;
+            continue;
+        }
+        if (!applied[event->port] || time >= applied_time[event->port]) {
+            ports[event->port] = event->mask;
+            applied_time[event->port] = time;
+            applied[event->port] = 1;
+        }
+    }
+    queued = kept;
+}
+
+uint32_t input_pending(void) {
+    return queued;
+}
+
+void input_strobe(InputPorts* latches, uint8_t value, const uint8_t* ports, int port_count) {
+    if (latches->strobe || (value & 1)) {
+        for (int port = 0; port < port_count && port < INPUT_MAX_PORTS; port++) {
+            latches->latch[port] = ports[port];
+        }
+        latches->reads[0] = 0;
+        latches->reads[1] = 0;
+    }
+    latches->strobe = value & 1;
+}
+
+uint8_t input_read(InputPorts* latches, int line, const uint8_t* ports, int four_score) {
+    if (latches->strobe) {
+        return 0x40 | (ports[line] >> 7);
+    }
+    uint32_t n = latches->reads[line];
+    uint8_t bit;
+    if (n < 8) {
+        bit = (latches->latch[line] >> (7 - n)) & 1;
+    } else if (four_score && n < 16) {
+        bit = (latches->latch[line + 2] >> (15 - n)) & 1;
+    } else if (four_score && n < 24) {
+        bit = (four_score_signature[line] >> (23 - n)) & 1;
+    } else {
+        // Official pads return 1 once all their bits have been read
+        bit = 1;
+    }
+    if (n < 0xFF) {
+        latches->reads[line] = (uint8_t)(n + 1);
+    }
+    return 0x40 | bit;
+}
+
+uint8_t input_read_zapper(uint8_t mask, int light) {
+    return 0x40 | (mask & ZAPPER_TRIGGER) | (light ? 0 : 0x08);
+}
+
+int input_zapper_bright(uint8_t index) {
+    return (index & 0x30) >= 0x20 && (index & 0x0F) < 0x0D;
+}
@@ -0,0 +1,100 @@
+/**
+ * Frame-stamped input queue
+ *
+ * Netplay and input-stream playback deliver each player's buttons ahead of
+ * time, stamped with the frame they belong to. The host queues them in batches
+ * and the core applies each one when emulation reaches its frame, so input
+ * timing no longer depends on when the host gets to call setButton(). An
+ * event can also name a scanline within its frame; the game sees it at the
+ * first controller strobe ($4016) from that scanline on, as with a real pad
+ * pressed mid-frame.
+ *
+ * The controller ports themselves are here too: a strobe latches each port's
+ * buttons, which $4016/$4017 reads then clock out one at a time, A first.
+ * Besides a pad in each port, a Four Score adapter (pads 3 and 4 follow pads
+ * 1 and 2 on the same lines, then its signature) and a Zapper in port 2 are
+ * modeled. Every device takes its state from the same per-port input bytes,
+ * so four players or a light gun cost no more to deliver than one pad.
+ */
+
+#ifndef NES_INPUT_H
+#define NES_INPUT_H
+
+#include <stdint.h>
+
+#define INPUT_QUEUE_MAX  512    // Events waiting at most
+#define INPUT_MAX_PORTS  4
+
+// Devices plugged into the ports
+#define INPUT_MODE_STANDARD   0    // A pad in ports 1 and 2
+#define INPUT_MODE_FOUR_SCORE 1    // Four pads through a Four Score
+#define INPUT_MODE_ZAPPER     2    // A pad in port 1, a Zapper in port 2
+
+// Zapper input bytes: the trigger in port 2's mask, the aim in ports 3 and 4
+// (x, then y; a y past the last line points away from the screen)
+#define ZAPPER_TRIGGER     0x10
+#define ZAPPER_LIGHT_LINES 26      // Scanlines the photodiode stays lit after the beam passes
+
+// 8 bytes, the record layout queueInputs() takes from the host
+typedef struct {
+    uint32_t frame;     // Frame the buttons apply from (frames emulated before it)
+    uint8_t port;
+    uint8_t mask;       // setButton() bit order
+    uint16_t scanline;  // Scanline within the frame (0: from the frame's start)
+} InputEvent;
+
+// Controller port latches, part of the savestate
+typedef struct {
+    uint8_t strobe;                   // $4016 bit 0 as last written
+    uint8_t reserved;
+    uint8_t reads[2];                 // Bits clocked out of $4016 and $4017 since the strobe
+    uint8_t latch[INPUT_MAX_PORTS];   // Buttons latched by the strobe
+} InputPorts;
+
+void input_reset(void);
+
+/**
+ * Queue events in any order. Returns how many were accepted (the rest did not
+ * fit or name a port outside `port_count`, at most INPUT_MAX_PORTS).
+ */
+int input_queue(const InputEvent* events, int count, int port_count);
+
+/**
+ * Apply every event stamped at or before `scanline` of `frame` to `ports`.
+ * When a port has several, the newest wins. Returns at once when nothing is
+ * due, so it can be called every scanline.
+ */
+void input_apply(uint32_t frame, uint32_t scanline, uint8_t* ports);
+
+/**
+ * $4016 write: while bit 0 is set, and when it is cleared, every port's
+ * buttons are latched from `ports` and the reads start over
+ */
+void input_strobe(InputPorts* latches, uint8_t value, const uint8_t* ports, int port_count);
+
+/**
+ * $4016/$4017 read (`line` 0/1) with pads attached: the next button in bit 0
+ * (A, B, Select, Start, Up, Down, Left, Right), with open-bus bit 6 set. A
+ * lone pad then returns 1s; through a Four Score the line goes on with pad 3
+ * or 4 and the adapter's signature before the 1s.
+ */
+uint8_t input_read(InputPorts* latches, int line, const uint8_t* ports, int four_score);
+
+/**
+ * $4017 read with a Zapper: bit 4 set while the trigger is pulled, bit 3
+ * clear while the photodiode sees light. As on hardware, light is only seen
+ * for ZAPPER_LIGHT_LINES from the aimed line while it is drawn. Reads in
+ * vblank or between frames (e.g. cpuRead() after frame()) always see dark;
+ * games poll during rendering.
+ */
+uint8_t input_read_zapper(uint8_t mask, int light);
+
+/**
+ * Whether the Zapper senses a pixel of this palette index as light: the
+ * bright rows of the palette, without the blacks in columns $D-$F
+ */
+int input_zapper_bright(uint8_t index);
+
+uint32_t input_pending(void);
+
+#endif // NES_INPUT_H
@@ -0,0 +1,172 @@
+/**
+ * NES palette lookup tables and index expansion kernel
+ */
+
+#include "nes-palette.h"
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+// Standard NES palette (2C02, RGB)
+static const uint8_t nes_palette[PALETTE_COLORS][3] = {
+    {84, 84, 84}, {0, 30, 116}, {8, 16, 144}, {48, 0, 136},
+    {68, 0, 100}, {92, 0, 48}, {84, 4, 0}, {60, 24, 0},
+    {32, 42, 0}, {8, 58, 0}, {0, 64, 0}, {0, 60, 0},
+    {0, 50, 60}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0},
+    {152, 150, 152}, {8, 76, 196}, {48, 50, 236}, {92, 30, 228},
+    {136, 20, 176}, {160, 20, 100}, {152, 34, 32}, {120, 60, 0},
+    {84, 90, 0}, {40, 114, 0}, {8, 124, 0}, {0, 118, 40},
+    {0, 102, 120}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0},
+    {236, 238, 236}, {76, 154, 236}, {120, 124, 236}, {176, 98, 236},
+    {228, 84, 236}, {236, 88, 180}, {236, 106, 100}, {212, 136, 32},
+    {160, 170, 0}, {116, 196, 0}, {76, 208, 32}, {56, 204, 108},
+    {56, 180, 204}, {60, 60, 60}, {0, 0, 0}, {0, 0, 0},
+    {236, 238, 236}, {168, 204, 236}, {188, 188, 236}, {212, 178, 236},
+    {236, 174, 236}, {236, 174, 212}, {236, 180, 176}, {228, 196, 144},
+    {204, 210, 120}, {180, 222, 120}, {168, 226, 144}, {152, 226, 180},
+    {160, 214, 228}, {160, 162, 160}, {0, 0, 0}, {0, 0, 0}
+};
+
+// Emphasis dims the two non-emphasized channels to ~81.6% (209/256)
+#define EMPHASIS_ATTENUATION 209
+
+uint32_t palette_rgba[PALETTE_LUT_SIZE];
+uint16_t palette_rgb565[PALETTE_LUT_SIZE];
+
+// Planar copies of the LUT for the SIMD kernel: [emphasis][channel R/G/B][color]
+static uint8_t palette_planes[PALETTE_EMPHASIS][3][PALETTE_COLORS];
+
+static void palette_set_entry(int entry, uint8_t r, uint8_t g, uint8_t b) {
+    int emphasis = entry >> 6;
+    int color = entry & 0x3F;
+
+    palette_rgba[entry] = 0xFF000000u | ((uint32_t)b << 16) | ((uint32_t)g << 8) | r;
+    palette_rgb565[entry] = (uint16_t)(((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3));
+    palette_planes[emphasis][0][color] = r;
+    palette_planes[emphasis][1][color] = g;
+    palette_planes[emphasis][2][color] = b;
+}
+
+int palette_build(const uint8_t* rgb, int entries) {
+    if (entries == PALETTE_LUT_SIZE) {
+        for (int i = 0; i < PALETTE_LUT_SIZE; i++) {
+            palette_set_entry(i, rgb[i * 3], rgb[i * 3 + 1], rgb[i * 3 + 2]);
+        }
+        return 1;
+    }
+
+    if (entries != PALETTE_COLORS) {
+        return 0;
+    }
+
+    for (int emphasis = 0; emphasis < PALETTE_EMPHASIS; emphasis++) {
+        for (int color = 0; color < PALETTE_COLORS; color++) {
+            uint32_t r = rgb[color * 3];
+            uint32_t g = rgb[color * 3 + 1];
+            uint32_t b = rgb[color * 3 + 2];
+
+            // Bit 0 = red, bit 1 = green, bit 2 = blue (PPUMASK bits 5-7)
+            if (emphasis & 1) { g = g * EMPHASIS_ATTENUATION >> 8; b = b * EMPHASIS_ATTENUATION >> 8; }
+            if (emphasis & 2) { r = r * EMPHASIS_ATTENUATION >> 8; b = b * EMPHASIS_ATTENUATION >> 8; }
+            if (emphasis & 4) { r = r * EMPHASIS_ATTENUATION >> 8; g = g * EMPHASIS_ATTENUATION >> 8; }
+
+            palette_set_entry((emphasis << 6) | color, (uint8_t)r, (uint8_t)g, (uint8_t)b);
+        }
+    }
+    return 1;
+}
+
+void palette_build_default(void) {
+    palette_build(&nes_palette[0][0], PALETTE_COLORS);
+}
+
+void expand_indexed(uint32_t* dst, const uint8_t* src, int count, int emphasis, int channel_order) {
+    const uint8_t (*planes)[PALETTE_COLORS] = palette_planes[emphasis & 7];
+    const uint8_t* first = planes[channel_order == CHANNEL_ORDER_BGRA ? 2 : 0];
+    const uint8_t* second = planes[1];
+    const uint8_t* third = planes[channel_order == CHANNEL_ORDER_BGRA ? 0 : 2];
+    int i = 0;
+
+#if defined(__wasm_simd128__)
+    // Each 64-entry channel table is four 16-byte swizzle tables. Lanes whose
+    // rebased index falls outside 0-15 read as zero, so OR-ing the four lookups
+    // selects the right entry without compares.
+    v128_t t0[4], t1[4], t2[4];
+    for (int k = 0; k < 4; k++) {
+        t0[k] = wasm_v128_load(first + k * 16);
+        t1[k] = wasm_v128_load(second + k * 16);
+        t2[k] = wasm_v128_load(third + k * 16);
+    }
+    const v128_t mask = wasm_i8x16_splat(0x3F);
+    const v128_t step = wasm_i8x16_splat(16);
+    const v128_t alpha = wasm_i8x16_splat((int8_t)0xFF);
+
+    for (; i + 16 <= count; i += 16) {
+        v128_t idx = wasm_v128_and(wasm_v128_load(src + i), mask);
+        v128_t c0 = wasm_i8x16_swizzle(t0[0], idx);
+        v128_t c1 = wasm_i8x16_swizzle(t1[0], idx);
+        v128_t c2 = wasm_i8x16_swizzle(t2[0], idx);
+        for (int k = 1; k < 4; k++) {
+            idx = wasm_i8x16_sub(idx, step);
+            c0 = wasm_v128_or(c0, wasm_i8x16_swizzle(t0[k], idx));
+            c1 = wasm_v128_or(c1, wasm_i8x16_swizzle(t1[k], idx));
+            c2 = wasm_v128_or(c2, wasm_i8x16_swizzle(t2[k], idx));
+        }
+
+        // Interleave the channel planes into four vectors of 4 pixels
+        v128_t lo01 = wasm_i8x16_shuffle(c0, c1, 0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+        v128_t hi01 = wasm_i8x16_shuffle(c0, c1, 8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31);
+        v128_t lo2a = wasm_i8x16_shuffle(c2, alpha, 0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+        v128_t hi2a = wasm_i8x16_shuffle(c2, alpha, 8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31);
+        wasm_v128_store(dst + i, wasm_i16x8_shuffle(lo01, lo2a, 0, 8, 1, 9, 2, 10, 3, 11));
+        wasm_v128_store(dst + i + 4, wasm_i16x8_shuffle(lo01, lo2a, 4, 12, 5, 13, 6, 14, 7, 15));
+        wasm_v128_store(dst + i + 8, wasm_i16x8_shuffle(hi01, hi2a, 0, 8, 1, 9, 2, 10, 3, 11));
+        wasm_v128_store(dst + i + 12, wasm_i16x8_shuffle(hi01, hi2a, 4, 12, 5, 13, 6, 14, 7, 15));
+    }
+#elif defined(__SSSE3__)
+    // pshufb only zeroes lanes with the top bit set, so rebased indices above 15
+    // are forced negative before each lookup.
+    __m128i t0[4], t1[4], t2[4];
+    for (int k = 0; k < 4; k++) {
+        t0[k] = _mm_loadu_si128((const __m128i*)(first + k * 16));
+        t1[k] = _mm_loadu_si128((const __m128i*)(second + k * 16));
+        t2[k] = _mm_loadu_si128((const __m128i*)(third + k * 16));
+    }
+    const __m128i mask = _mm_set1_epi8(0x3F);
+    const __m128i step = _mm_set1_epi8(16);
+    const __m128i fifteen = _mm_set1_epi8(15);
+    const __m128i alpha = _mm_set1_epi8((char)0xFF);
+
+    for (; i + 16 <= count; i += 16) {
+        __m128i idx = _mm_and_si128(_mm_loadu_si128((const __m128i*)(src + i)), mask);
+        __m128i c0 = _mm_setzero_si128();
+        __m128i c1 = _mm_setzero_si128();
+        __m128i c2 = _mm_setzero_si128();
+        for (int k = 0; k < 4; k++) {
+            __m128i sel = _mm_or_si128(idx, _mm_cmpgt_epi8(idx, fifteen));
+            c0 = _mm_or_si128(c0, _mm_shuffle_epi8(t0[k], sel));
+            c1 = _mm_or_si128(c1, _mm_shuffle_epi8(t1[k], sel));
+            c2 = _mm_or_si128(c2, _mm_shuffle_epi8(t2[k], sel));
+            idx = _mm_sub_epi8(idx, step);
+        }
+
+        __m128i lo01 = _mm_unpacklo_epi8(c0, c1);
+        __m128i hi01 = _mm_unpackhi_epi8(c0, c1);
+        __m128i lo2a = _mm_unpacklo_epi8(c2, alpha);
+        __m128i hi2a = _mm_unpackhi_epi8(c2, alpha);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi16(lo01, lo2a));
+        _mm_storeu_si128((__m128i*)(dst + i + 4), _mm_unpackhi_epi16(lo01, lo2a));
+        _mm_storeu_si128((__m128i*)(dst + i + 8), _mm_unpacklo_epi16(hi01, hi2a));
+        _mm_storeu_si128((__m128i*)(dst + i + 12), _mm_unpackhi_epi16(hi01, hi2a));
+    }
+#endif
+
+    // Scalar path and tail
+    for (; i < count; i++) {
+        uint8_t color = src[i] & 0x3F;
+        dst[i] = 0xFF000000u | ((uint32_t)third[color] << 16) | ((uint32_t)second[color] << 8) | first[color];
+    }
+}
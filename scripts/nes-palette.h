@@ -0,0 +1,45 @@
+/**
+ * NES palette lookup tables and index expansion kernel
+ *
+ * The palette is expanded once into a 512-entry LUT (64 colors x 8 emphasis
+ * combinations) in every output layout the core writes. expand_indexed() turns
+ * palette indices into 32-bit pixels 16 at a time using simd128 or SSSE3 when
+ * available.
+ */
+
+#ifndef NES_PALETTE_H
+#define NES_PALETTE_H
+
+#include <stdint.h>
+
+#define PALETTE_COLORS      64
+#define PALETTE_EMPHASIS    8
+#define PALETTE_LUT_SIZE    (PALETTE_COLORS * PALETTE_EMPHASIS)
+
+// Channel order for 32-bit output
+#define CHANNEL_ORDER_RGBA  0
+#define CHANNEL_ORDER_BGRA  1
+
+// 512-entry LUTs, indexed by (emphasis << 6) | color
+extern uint32_t palette_rgba[PALETTE_LUT_SIZE];
+extern uint16_t palette_rgb565[PALETTE_LUT_SIZE];
+
+/**
+ * Build all LUTs from an RGB triplet table.
+ * 64 entries get emphasis attenuation computed; 512 entries (.pal files
+ * with emphasis) are used as-is. Returns 0 for any other size.
+ */
+int palette_build(const uint8_t* rgb, int entries);
+
+/**
+ * Build all LUTs from the built-in NES palette
+ */
+void palette_build_default(void);
+
+/**
+ * Expand palette indices to 32-bit pixels.
+ * Only the low 6 bits of each index are used; emphasis (0-7) selects the LUT bank.
+ */
+void expand_indexed(uint32_t* dst, const uint8_t* src, int count, int emphasis, int channel_order);
+
+#endif // NES_PALETTE_H
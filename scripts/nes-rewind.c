@@ -0,0 +1,336 @@
+/**
+ * Rewind history: XOR-delta + RLE entries in a fixed-size ring
+ */
+
+#include "nes-rewind.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_ENTRY      UINT32_MAX
+#define ENTRY_BYTES   128    // One descriptor is reserved per 128 bytes of budget
+#define MAX_LITERAL   128
+#define MAX_ZERO_RUN  32768
+
+typedef struct {
+    uint32_t offset;
+    uint32_t size;
+    uint32_t key;            // Keyframe (encoded against zeros)
+} Entry;
+
+static uint8_t* block = 0;       // Budget allocation: descriptors, then data
+static uint32_t budget = 0;
+static Entry* entries = 0;
+static uint32_t entry_capacity = 0;
+static uint8_t* data = 0;
+static uint32_t data_size = 0;
+
+static uint32_t oldest_seq = 0;  // Entries oldest_seq..next_seq-1 are held
+static uint32_t next_seq = 0;
+static uint32_t data_head = 0;   // Where the next entry is written
+static uint32_t key_seq = NO_ENTRY;      // Newest keyframe held
+static uint32_t stored_bytes = 0;
+
+// Scratch, sized for one state
+static uint32_t state_size = 0;
+static uint8_t* state_buffer = 0;   // Caller serializes here
+static uint8_t* key_state = 0;      // Decoded keyframe
+static uint32_t key_state_seq = NO_ENTRY;
+static uint8_t* zeros = 0;          // Reference for keyframes
+static uint8_t* encoded = 0;
+
+static RewindStats stats;
+
+static Entry* entry_at(uint32_t seq) {
+    return &entries[seq % entry_capacity];
+}
+
+static uint64_t load64(const uint8_t* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static int has_zero_byte(uint64_t value) {
+    return ((value - 0x0101010101010101ull) & ~value & 0x8080808080808080ull) != 0;
+}
+
+/**
+ * Length of the run of bytes equal in `state` and `ref` starting at `pos`
+ */
+static uint32_t equal_run(const uint8_t* state, const uint8_t* ref, uint32_t pos, uint32_t size) {
+    uint32_t end = pos;
+    while (end + 32 <= size &&
+           ((load64(state + end) ^ load64(ref + end)) |
+            (load64(state + end + 8) ^ load64(ref + end + 8)) |
+            (load64(state + end + 16) ^ load64(ref + end + 16)) |
+            (load64(state + end + 24) ^ load64(ref + end + 24))) == 0) {
+        end += 32;
+    }
+    while (end + 8 <= size && load64(state + end) == load64(ref + end)) {
+        end += 8;
+    }
+    while (end < size && state[end] == ref[end]) {
+        end++;
+    }
+    return end - pos;
+}
+
+/**
+ * XOR `state` with `ref` and run-length encode the result into `out`
+ */
+static uint32_t encode(const uint8_t* state, const uint8_t* ref, uint32_t size, uint8_t* out) {
+    uint32_t pos = 0;
+    uint32_t length = 0;
+
+    while (pos < size) {
+        uint32_t run = equal_run(state, ref, pos, size);
+        if (run >= 3 || pos + run == size) {
+            pos += run;
+            while (run > 0) {
+                uint32_t n = run < MAX_ZERO_RUN ? run : MAX_ZERO_RUN;
+                out[length++] = (uint8_t)(0x80 | ((n - 1) >> 8));
+                out[length++] = (uint8_t)(n - 1);
+                run -= n;
+            }
+            continue;
+        }
+
+        // Literal bytes up to the next run of three unchanged bytes. Words
+        // whose bytes all changed cannot contain such a run.
+        uint32_t start = pos;
+        while (pos < size && pos - start < MAX_LITERAL) {
+            if (pos + 8 <= size && pos - start + 8 <= MAX_LITERAL &&
+                !has_zero_byte(load64(state + pos) ^ load64(ref + pos))) {
+                pos += 8;
+                continue;
+            }
+            if (pos + 3 <= size && state[pos] == ref[pos] &&
+                state[pos + 1] == ref[pos + 1] && state[pos + 2] == ref[pos + 2]) {
+                break;
+            }
+            pos++;
+        }
+        uint8_t* literal = out + length + 1;
+        out[length] = (uint8_t)(pos - start - 1);
+        for (uint32_t i = 0; i < pos - start; i++) {
+            literal[i] = state[start + i] ^ ref[start + i];
+        }
+        length += 1 + pos - start;
+    }
+    return length;
+}
+
+static void decode(const uint8_t* in, uint32_t length, const uint8_t* ref, uint8_t* out) {
+    uint32_t i = 0;
+    uint32_t pos = 0;
+    while (i < length) {
+        uint8_t header = in[i++];
+        if (header < 0x80) {
+            uint32_t n = header + 1u;
+            for (uint32_t k = 0; k < n; k++) {
+                out[pos + k] = in[i + k] ^ ref[pos + k];
+            }
+            i += n;
+            pos += n;
+        } else {
+            uint32_t n = (((uint32_t)(header & 0x7F) << 8) | in[i++]) + 1;
+            memcpy(out + pos, ref + pos, n);
+            pos += n;
+        }
+    }
+}
+
+static void drop_oldest(void) {
+    // A keyframe takes the deltas encoded against it along
+    do {
+        stored_bytes -= entry_at(oldest_seq)->size;
+        oldest_seq++;
+    } while (oldest_seq != next_seq && !entry_at(oldest_seq)->key);
+
+    if (oldest_seq == next_seq) {
+        key_seq = NO_ENTRY;
+        data_head = 0;
+    }
+}
+
+/**
+ * Evict old entries until `size` contiguous bytes are free at the write position
+ */
+static void make_room(uint32_t size) {
+    if (data_head + size > data_size) {
+        // Wrap: entries beyond the write position are the oldest
+        while (oldest_seq != next_seq && entry_at(oldest_seq)->offset >= data_head) {
+            drop_oldest();
+        }
+        data_head = 0;
+    }
+    while (oldest_seq != next_seq) {
+        uint32_t offset = entry_at(oldest_seq)->offset;
+        if (offset < data_head || offset >= data_head + size) {
+            break;
+        }
+        drop_oldest();
+    }
+    if (next_seq - oldest_seq >= entry_capacity) {
+        drop_oldest();
+    }
+}
+
+/**
+ * Make `key_state` hold the decoded keyframe `seq`
+ */
+static void load_key_state(uint32_t seq) {
+    if (key_state_seq != seq) {
+        const Entry* entry = entry_at(seq);
+        decode(data + entry->offset, entry->size, zeros, key_state);
+        key_state_seq = seq;
+    }
+}
+
+static void free_scratch(void) {
+    free(state_buffer);
+    free(key_state);
+    free(zeros);
+    free(encoded);
+    state_buffer = key_state = zeros = encoded = 0;
+    state_size = 0;
+}
+
+int rewind_set_budget(uint32_t bytes) {
+    free(block);
+    block = 0;
+    entries = 0;
+    data = 0;
+    entry_capacity = data_size = 0;
+    budget = 0;
+    free_scratch();
+    rewind_reset();
+
+    if (bytes == 0) {
+        return 1;
+    }
+    if (bytes < REWIND_MIN_BUDGET || !(block = malloc(bytes))) {
+        return 0;
+    }
+
+    entry_capacity = bytes / ENTRY_BYTES;
+    entries = (Entry*)block;
+    data = block + entry_capacity * sizeof(Entry);
+    data_size = bytes - entry_capacity * sizeof(Entry);
+    budget = stats.budget = bytes;
+    return 1;
+}
+
+int rewind_enabled(void) {
+    return block != 0;
+}
+
+void rewind_reset(void) {
+    oldest_seq = next_seq = 0;
+    data_head = 0;
+    key_seq = NO_ENTRY;
+    key_state_seq = NO_ENTRY;
+    stored_bytes = 0;
+    stats.entries = stats.bytes = stats.last_bytes = 0;
+    stats.budget = budget;
+}
+
+uint8_t* rewind_state_buffer(uint32_t size) {
+    if (size == state_size) {
+        return state_buffer;
+    }
+
+    // New state layout: earlier entries cannot be decoded into it
+    free_scratch();
+    rewind_reset();
+    state_buffer = malloc(size);
+    key_state = malloc(size);
+    zeros = calloc(size, 1);
+    encoded = malloc(size + size / MAX_LITERAL + 16);   // Worst case: all literals
+    if (!state_buffer || !key_state || !zeros || !encoded) {
+        free_scratch();
+        return 0;
+    }
+    state_size = size;
+    return state_buffer;
+}
+
+int rewind_push(const uint8_t* state, uint32_t size) {
+    if (!block || size != state_size) {
+        return 0;
+    }
+
+    for (;;) {
+        int key = key_seq == NO_ENTRY || next_seq - key_seq >= REWIND_KEY_INTERVAL;
+        uint32_t length;
+        if (key) {
+            length = encode(state, zeros, size, encoded);
+        } else {
+            load_key_state(key_seq);
+            length = encode(state, key_state, size, encoded);
+        }
+        if (length > data_size) {
+            return 0;
+        }
+
+        make_room(length);
+        if (!key && key_seq == NO_ENTRY) {
+            continue;   // Evicting made room by dropping this delta's keyframe
+        }
+
+        Entry* entry = entry_at(next_seq);
+        entry->offset = data_head;
+        entry->size = length;
+        entry->key = (uint32_t)key;
+        memcpy(data + data_head, encoded, length);
+        if (key) {
+            memcpy(key_state, state, size);
+            key_state_seq = key_seq = next_seq;
+        }
+
+        next_seq++;
+        data_head += length;
+        stored_bytes += length;
+        stats.last_bytes = length;
+        return 1;
+    }
+}
+
+uint32_t rewind_pop(uint8_t* out) {
+    if (!block || oldest_seq == next_seq) {
+        return 0;
+    }
+
+    uint32_t seq = --next_seq;
+    const Entry* entry = entry_at(seq);
+    if (entry->key) {
+        decode(data + entry->offset, entry->size, zeros, out);
+
+        // The previous group's keyframe becomes the newest one
+        key_seq = NO_ENTRY;
+        key_state_seq = NO_ENTRY;
+        for (uint32_t s = seq; s != oldest_seq; s--) {
+            if (entry_at(s - 1)->key) {
+                key_seq = s - 1;
+                break;
+            }
+        }
+    } else {
+        load_key_state(key_seq);
+        decode(data + entry->offset, entry->size, key_state, out);
+    }
+
+    data_head = entry->offset;
+    stored_bytes -= entry->size;
+    if (oldest_seq == next_seq) {
+        data_head = 0;
+    }
+    return state_size;
+}
+
+const RewindStats* rewind_stats(void) {
+    stats.entries = next_seq - oldest_seq;
+    stats.bytes = stored_bytes;
+    return &stats;
+}
@@ -0,0 +1,64 @@
+/**
+ * Rewind history
+ *
+ * States pushed at a fixed interval are stored in a ring of fixed size. Every
+ * REWIND_KEY_INTERVAL-th state is a keyframe; the others are XORed with their
+ * keyframe, which leaves zeros everywhere the state did not change, and every
+ * entry is then run-length encoded:
+ *
+ *   0x00-0x7F       literal run: the next n + 1 bytes
+ *   0x80-0xFF, lo   zero run of ((n & 0x7F) << 8 | lo) + 1 bytes
+ *
+ * When the ring is full the oldest entries are overwritten; dropping a keyframe
+ * drops the deltas that depend on it.
+ */
+
+#ifndef NES_REWIND_H
+#define NES_REWIND_H
+
+#include <stdint.h>
+
+#define REWIND_KEY_INTERVAL  32     // Entries per keyframe group
+#define REWIND_MIN_BUDGET    65536
+
+typedef struct {
+    uint32_t entries;       // States held
+    uint32_t bytes;         // Encoded bytes held
+    uint32_t last_bytes;    // Encoded size of the last state pushed
+    uint32_t budget;        // Ring size
+} RewindStats;
+
+/**
+ * Allocate a ring of `bytes` (0 frees it and disables rewind). Clears the history.
+ * Returns 0 if the budget is below REWIND_MIN_BUDGET or cannot be allocated.
+ */
+int rewind_set_budget(uint32_t bytes);
+
+int rewind_enabled(void);
+
+/**
+ * Drop the history (e.g. a new ROM was loaded)
+ */
+void rewind_reset(void);
+
+/**
+ * Scratch space for the caller to serialize a state of `size` bytes into.
+ * Returns 0 if it cannot be allocated.
+ */
+uint8_t* rewind_state_buffer(uint32_t size);
+
+/**
+ * Encode and store a state. All states must have the same size until the next
+ * rewind_reset(). Returns 0 if the state does not fit in the budget.
+ */
+int rewind_push(const uint8_t* state, uint32_t size);
+
+/**
+ * Remove the newest state and decode it into `out`. Returns its size, or 0 if
+ * the history is empty.
+ */
+uint32_t rewind_pop(uint8_t* out);
+
+const RewindStats* rewind_stats(void);
+
+#endif // NES_REWIND_H
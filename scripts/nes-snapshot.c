@@ -0,0 +1,154 @@
+/**
+ * Incremental page snapshots
+ */
+
+#include "nes-snapshot.h"
+
+#include <string.h>
+
+#define NO_SLOT (-1)
+
+typedef struct {
+    int16_t slots[SNAPSHOT_MAX_PAGES];   // Pool slot holding each page's contents
+    uint8_t extra[SNAPSHOT_EXTRA_MAX];
+    uint32_t extra_size;
+} Snapshot;
+
+uint8_t snapshot_dirty[SNAPSHOT_MAX_PAGES];
+
+static uint8_t* memory = 0;
+static int page_count = 0;
+
+static uint8_t pool[SNAPSHOT_POOL_PAGES][SNAPSHOT_PAGE_SIZE];
+static uint16_t pool_refs[SNAPSHOT_POOL_PAGES];
+static uint8_t pool_page[SNAPSHOT_POOL_PAGES];      // Tracked page a slot holds
+static int16_t free_slots[SNAPSHOT_POOL_PAGES];
+static int free_count = 0;
+
+// Pool slot whose contents equal the live page, or NO_SLOT if it was written since
+static int16_t live_slots[SNAPSHOT_MAX_PAGES];
+
+static Snapshot ring[SNAPSHOT_RING];
+static uint32_t oldest_id = 1;   // Ids oldest_id..newest_id are held
+static uint32_t newest_id = 0;
+static SnapshotStats stats;
+
+static void release_slot(int16_t slot) {
+    if (--pool_refs[slot] > 0) {
+        return;
+    }
+    if (live_slots[pool_page[slot]] == slot) {
+        live_slots[pool_page[slot]] = NO_SLOT;
+    }
+    free_slots[free_count++] = slot;
+}
+
+static void drop_oldest(void) {
+    Snapshot* snapshot = &ring[oldest_id % SNAPSHOT_RING];
+    for (int page = 0; page < page_count; page++) {
+        release_slot(snapshot->slots[page]);
+    }
+    oldest_id++;
+}
+
+static int16_t alloc_slot(void) {
+    // The pool holds far more than one snapshot's pages, so dropping old
+    // snapshots always frees enough
+    while (free_count == 0) {
+        drop_oldest();
+    }
+    return free_slots[--free_count];
+}
+
+void snapshot_attach(uint8_t* tracked, int pages) {
+    memory = tracked;
+    page_count = pages < SNAPSHOT_MAX_PAGES ? pages : SNAPSHOT_MAX_PAGES;
+
+    free_count = 0;
+    for (int slot = SNAPSHOT_POOL_PAGES - 1; slot >= 0; slot--) {
+        pool_refs[slot] = 0;
+        free_slots[free_count++] = (int16_t)slot;
+    }
+    oldest_id = newest_id + 1;
+    snapshot_mark_all();
+    memset(&stats, 0, sizeof(stats));
+}
+
+void snapshot_reset(void) {
+    while (oldest_id <= newest_id) {
+        drop_oldest();
+    }
+    snapshot_mark_all();
+    memset(&stats, 0, sizeof(stats));
+}
+
+void snapshot_mark_all(void) {
+    for (int page = 0; page < page_count; page++) {
+        snapshot_dirty[page] = 1;
+        live_slots[page] = NO_SLOT;
+    }
+}
+
+uint32_t snapshot_capture(const void* extra, uint32_t extra_size) {
+    if (extra_size > SNAPSHOT_EXTRA_MAX || !memory) {
+        return 0;
+    }
+    if (newest_id - oldest_id + 1 >= SNAPSHOT_RING) {
+        drop_oldest();
+    }
+
+    uint32_t id = newest_id + 1;
+    Snapshot* snapshot = &ring[id % SNAPSHOT_RING];
+    uint32_t copied = 0;
+
+    for (int page = 0; page < page_count; page++) {
+        int16_t slot = live_slots[page];
+        if (snapshot_dirty[page] || slot == NO_SLOT) {
+            slot = alloc_slot();
+            memcpy(pool[slot], memory + page * SNAPSHOT_PAGE_SIZE, SNAPSHOT_PAGE_SIZE);
+            pool_refs[slot] = 1;
+            pool_page[slot] = (uint8_t)page;
+            live_slots[page] = slot;
+            snapshot_dirty[page] = 0;
+            copied++;
+        } else {
+            pool_refs[slot]++;
+        }
+        snapshot->slots[page] = slot;
+    }
+
+    memcpy(snapshot->extra, extra, extra_size);
+    snapshot->extra_size = extra_size;
+    newest_id = id;
+
+    stats.captures++;
+    stats.last_pages = copied;
+    stats.last_bytes = copied * SNAPSHOT_PAGE_SIZE + extra_size;
+    stats.held = newest_id - oldest_id + 1;
+    stats.pool_pages = SNAPSHOT_POOL_PAGES - free_count;
+    return id;
+}
+
+int snapshot_restore(uint32_t id, void* extra) {
+    if (id < oldest_id || id > newest_id) {
+        return -1;
+    }
+
+    const Snapshot* snapshot = &ring[id % SNAPSHOT_RING];
+    for (int page = 0; page < page_count; page++) {
+        int16_t slot = snapshot->slots[page];
+        if (snapshot_dirty[page] || live_slots[page] != slot) {
+            memcpy(memory + page * SNAPSHOT_PAGE_SIZE, pool[slot], SNAPSHOT_PAGE_SIZE);
+            live_slots[page] = slot;
+            snapshot_dirty[page] = 0;
+        }
+    }
+    memcpy(extra, snapshot->extra, snapshot->extra_size);
+    return (int)snapshot->extra_size;
+}
+
+const SnapshotStats* snapshot_stats(void) {
+    stats.held = newest_id - oldest_id + 1;
+    stats.pool_pages = SNAPSHOT_POOL_PAGES - free_count;
+    return &stats;
+}
@@ -0,0 +1,71 @@
+/**
+ * Incremental page snapshots
+ *
+ * The core keeps all guest-writable memory in one block of 256-byte pages and
+ * marks a page dirty whenever a CPU write lands in it. A snapshot copies only
+ * the pages dirtied since the previous snapshot; every other page is shared
+ * with the snapshot before it (reference-counted copy-on-write), so a frame
+ * that touches a handful of pages costs a handful of page copies.
+ *
+ * Restoring a snapshot copies back only the pages that differ from it. Old
+ * snapshots are dropped when the ring or the page pool is full.
+ */
+
+#ifndef NES_SNAPSHOT_H
+#define NES_SNAPSHOT_H
+
+#include <stdint.h>
+
+#define SNAPSHOT_PAGE_SIZE   256
+#define SNAPSHOT_MAX_PAGES   128    // Pages of tracked memory supported
+#define SNAPSHOT_RING        64     // Snapshots kept at most
+#define SNAPSHOT_POOL_PAGES  1024   // Shared page storage (256KB)
+#define SNAPSHOT_EXTRA_MAX   512    // Registers and other unpaged state per snapshot
+
+typedef struct {
+    uint32_t captures;       // Snapshots taken since the last reset
+    uint32_t last_pages;     // Pages copied by the last capture
+    uint32_t last_bytes;     // Bytes copied by the last capture (pages + extra)
+    uint32_t held;           // Snapshots currently restorable
+    uint32_t pool_pages;     // Pool pages in use
+} SnapshotStats;
+
+extern uint8_t snapshot_dirty[SNAPSHOT_MAX_PAGES];
+
+/**
+ * Record a write to a tracked page
+ */
+static inline void snapshot_mark(int page) {
+    snapshot_dirty[page] = 1;
+}
+
+/**
+ * Track `pages` pages starting at `memory`, dropping every snapshot
+ */
+void snapshot_attach(uint8_t* memory, int pages);
+
+/**
+ * Drop every snapshot (e.g. a new ROM was loaded)
+ */
+void snapshot_reset(void);
+
+/**
+ * Tracked memory was changed without going through snapshot_mark()
+ */
+void snapshot_mark_all(void);
+
+/**
+ * Capture the tracked memory plus `extra` (at most SNAPSHOT_EXTRA_MAX bytes).
+ * Returns the snapshot id (never 0), or 0 if `extra` is too large.
+ */
+uint32_t snapshot_capture(const void* extra, uint32_t extra_size);
+
+/**
+ * Restore tracked memory to snapshot `id` and copy its extra state to `extra`.
+ * Returns the extra size, or -1 if the snapshot is no longer held.
+ */
+int snapshot_restore(uint32_t id, void* extra);
+
+const SnapshotStats* snapshot_stats(void);
+
+#endif // NES_SNAPSHOT_H
@@ -0,0 +1,99 @@
+/**
+ * Savestate container reader and writer
+ */
+
+#include "nes-state.h"
+
+#include <string.h>
+
+static void put_u32(uint8_t* p, uint32_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void state_begin(StateWriter* writer, uint8_t* data, uint32_t rom_hash) {
+    writer->data = data;
+    put_u32(data, STATE_MAGIC);
+    put_u32(data + 4, STATE_VERSION);
+    put_u32(data + 8, rom_hash);
+    put_u32(data + 12, 0);
+    writer->pos = STATE_HEADER_SIZE;
+}
+
+uint8_t* state_reserve_chunk(StateWriter* writer, uint32_t tag, uint32_t size) {
+    uint8_t* p = writer->data + writer->pos;
+    uint32_t padded = state_chunk_size(size) - STATE_CHUNK_HEADER;
+
+    put_u32(p, tag);
+    put_u32(p + 4, size);
+    memset(p + STATE_CHUNK_HEADER + size, 0, padded - size);
+    writer->pos += STATE_CHUNK_HEADER + padded;
+    return p + STATE_CHUNK_HEADER;
+}
+
+void state_write_chunk(StateWriter* writer, uint32_t tag, const void* payload, uint32_t size) {
+    memcpy(state_reserve_chunk(writer, tag, size), payload, size);
+}
+
+uint32_t state_end(StateWriter* writer) {
+    put_u32(writer->data + 12, writer->pos);
+    return writer->pos;
+}
+
+int state_open(StateReader* reader, const uint8_t* data, uint32_t size, uint32_t rom_hash) {
+    if (size < STATE_HEADER_SIZE || get_u32(data) != STATE_MAGIC) {
+        return STATE_ERROR_BAD_HEADER;
+    }
+    if (get_u32(data + 4) != STATE_VERSION) {
+        return STATE_ERROR_VERSION;
+    }
+    if (get_u32(data + 8) != rom_hash) {
+        return STATE_ERROR_ROM_MISMATCH;
+    }
+    uint32_t total = get_u32(data + 12);
+    if (total < STATE_HEADER_SIZE || total > size) {
+        return STATE_ERROR_TRUNCATED;
+    }
+
+    reader->data = data;
+    reader->size = total;
+    reader->pos = STATE_HEADER_SIZE;
+    return 0;
+}
+
+int state_next_chunk(StateReader* reader, uint32_t* tag, const uint8_t** payload, uint32_t* size) {
+    if (reader->pos == reader->size) {
+        return 0;
+    }
+    if (reader->size - reader->pos < STATE_CHUNK_HEADER) {
+        return -1;
+    }
+
+    const uint8_t* p = reader->data + reader->pos;
+    uint32_t payload_size = get_u32(p + 4);
+    if (payload_size > reader->size - reader->pos - STATE_CHUNK_HEADER) {
+        return -1;
+    }
+
+    *tag = get_u32(p);
+    *payload = p + STATE_CHUNK_HEADER;
+    *size = payload_size;
+
+    uint32_t next = reader->pos + state_chunk_size(payload_size);
+    reader->pos = next < reader->size ? next : reader->size;
+    return 1;
+}
+
+uint32_t state_hash(const uint8_t* data, uint32_t size) {
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
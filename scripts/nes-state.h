@@ -0,0 +1,82 @@
+/**
+ * Savestate container format
+ *
+ *   header:  magic "NESS", version, ROM hash, total size   (4 x uint32, little endian)
+ *   chunks:  tag (4 chars), payload size (uint32), payload, zero padding to 4 bytes
+ *
+ * Readers skip chunks with unknown tags, so newer states with extra chunks still
+ * load into older cores of the same version. A version bump means an existing
+ * chunk's layout changed.
+ */
+
+#ifndef NES_STATE_H
+#define NES_STATE_H
+
+#include <stdint.h>
+
+#define STATE_MAGIC        0x5353454Eu   // "NESS"
+#define STATE_VERSION      1
+#define STATE_HEADER_SIZE  16
+#define STATE_CHUNK_HEADER 8
+
+#define STATE_TAG(a, b, c, d) \
+    ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+// loadState() rejection reasons (also the TRACE_STATE_REJECTED argument)
+enum {
+    STATE_ERROR_NO_ROM = 1,
+    STATE_ERROR_BAD_HEADER,
+    STATE_ERROR_VERSION,
+    STATE_ERROR_ROM_MISMATCH,
+    STATE_ERROR_TRUNCATED,
+    STATE_ERROR_CHUNK_SIZE,
+};
+
+typedef struct {
+    uint8_t* data;
+    uint32_t pos;
+} StateWriter;
+
+typedef struct {
+    const uint8_t* data;
+    uint32_t size;
+    uint32_t pos;
+} StateReader;
+
+/**
+ * Bytes a chunk with `payload_size` bytes occupies, including header and padding
+ */
+static inline uint32_t state_chunk_size(uint32_t payload_size) {
+    return STATE_CHUNK_HEADER + ((payload_size + 3) & ~3u);
+}
+
+void state_begin(StateWriter* writer, uint8_t* data, uint32_t rom_hash);
+void state_write_chunk(StateWriter* writer, uint32_t tag, const void* payload, uint32_t size);
+
+/**
+ * Add a chunk and return its payload for the caller to fill in place
+ */
+uint8_t* state_reserve_chunk(StateWriter* writer, uint32_t tag, uint32_t size);
+
+/**
+ * Patch the total size into the header. Returns the bytes written.
+ */
+uint32_t state_end(StateWriter* writer);
+
+/**
+ * Validate the header. Returns 0 on success or a STATE_ERROR_* code.
+ */
+int state_open(StateReader* reader, const uint8_t* data, uint32_t size, uint32_t rom_hash);
+
+/**
+ * Step to the next chunk. Returns 1 with its tag, payload and size, 0 at the
+ * end, or -1 if a chunk runs past the end of the data.
+ */
+int state_next_chunk(StateReader* reader, uint32_t* tag, const uint8_t** payload, uint32_t* size);
+
+/**
+ * FNV-1a hash, used to tie states to the ROM they were made with
+ */
+uint32_t state_hash(const uint8_t* data, uint32_t size);
+
+#endif // NES_STATE_H
@@ -0,0 +1,120 @@
+/**
+ * WSOLA time-stretch
+ */
+
+#include "nes-stretch.h"
+
+#include <math.h>
+#include <string.h>
+
+#define CORRELATION_SHIFT 12   // Keeps int32 correlation sums from overflowing
+#define COARSE_STEP       4    // Seek window is scanned every 4 samples, then refined
+
+static int16_t fifo[STRETCH_FIFO_SAMPLES];
+static int fifo_count = 0;
+static int16_t overlap_tail[STRETCH_FIFO_SAMPLES / 32];  // End of the previous sequence
+static int sequence_length = 1764;
+static int overlap_length = 352;
+static int seek_length = 661;
+static int32_t speed = 1 << 16;
+static uint32_t skip_fraction = 0;   // Fractional input position, Q16
+
+void stretch_configure(uint32_t sample_rate) {
+    sequence_length = (int)(sample_rate * STRETCH_SEQUENCE_MS / 1000);
+    overlap_length = (int)(sample_rate * STRETCH_OVERLAP_MS / 1000);
+    seek_length = (int)(sample_rate * STRETCH_SEEK_MS / 1000);
+    stretch_reset();
+}
+
+void stretch_reset(void) {
+    fifo_count = 0;
+    skip_fraction = 0;
+    memset(overlap_tail, 0, sizeof(overlap_tail));
+}
+
+void stretch_set_speed(int32_t speed_q16) {
+    speed = speed_q16;
+}
+
+/**
+ * Normalized cross-correlation of the previous tail with a candidate sequence start
+ */
+static float correlate(const int16_t* input) {
+    int32_t sum = 0;
+    int32_t energy = 0;
+    for (int i = 0; i < overlap_length; i++) {
+        sum += (overlap_tail[i] * input[i]) >> CORRELATION_SHIFT;
+        energy += (input[i] * input[i]) >> CORRELATION_SHIFT;
+    }
+    return (float)sum / sqrtf((float)energy + 1.0f);
+}
+
+/**
+ * Find the splice point in the seek window that continues the waveform best
+ */
+static int seek_best_offset(void) {
+    int best = 0;
+    float best_score = -1e30f;
+
+    for (int offset = 0; offset < seek_length; offset += COARSE_STEP) {
+        float score = correlate(fifo + offset);
+        if (score > best_score) {
+            best_score = score;
+            best = offset;
+        }
+    }
+
+    int center = best;
+    for (int offset = center - COARSE_STEP + 1; offset < center + COARSE_STEP; offset++) {
+        if (offset < 0 || offset >= seek_length || offset == center) continue;
+        float score = correlate(fifo + offset);
+        if (score > best_score) {
+            best_score = score;
+            best = offset;
+        }
+    }
+    return best;
+}
+
+int stretch_process(const int16_t* in, int count, int16_t* out, int capacity) {
+    if (speed == 1 << 16 && fifo_count == 0) {
+        int n = count < capacity ? count : capacity;
+        memcpy(out, in, n * sizeof(int16_t));
+        return n;
+    }
+
+    if (count > STRETCH_FIFO_SAMPLES - fifo_count) {
+        count = STRETCH_FIFO_SAMPLES - fifo_count;   // Host is far ahead; drop the excess
+    }
+    memcpy(fifo + fifo_count, in, count * sizeof(int16_t));
+    fifo_count += count;
+
+    int produced = 0;
+    int step = sequence_length - overlap_length;   // Output per sequence
+
+    for (;;) {
+        uint32_t skip_q16 = (uint32_t)step * (uint32_t)speed + skip_fraction;
+        int skip = (int)(skip_q16 >> 16);
+        int required = seek_length + sequence_length;
+        if (skip > required) required = skip;
+        if (fifo_count < required || produced + step > capacity) {
+            break;
+        }
+
+        const int16_t* sequence = fifo + seek_best_offset();
+
+        // Cross-fade the previous tail into the new sequence
+        for (int i = 0; i < overlap_length; i++) {
+            out[produced + i] = (int16_t)((overlap_tail[i] * (overlap_length - i) + sequence[i] * i) / overlap_length);
+        }
+        memcpy(out + produced + overlap_length, sequence + overlap_length,
+               (step - overlap_length) * sizeof(int16_t));
+        memcpy(overlap_tail, sequence + step, overlap_length * sizeof(int16_t));
+        produced += step;
+
+        skip_fraction = skip_q16 & 0xFFFF;
+        fifo_count -= skip;
+        memmove(fifo, fifo + skip, fifo_count * sizeof(int16_t));
+    }
+    return produced;
+}
@@ -0,0 +1,41 @@
+/**
+ * Pitch-preserving time-stretch (WSOLA)
+ *
+ * When the host runs emulation faster or slower than real time, the APU output
+ * is consumed in overlapping sequences. The next sequence starts at the position
+ * within a seek window that best matches the waveform already output, and the
+ * overlap is cross-faded. Playing the result at the device rate keeps the
+ * original pitch. All processing is integer arithmetic on int16 samples.
+ */
+
+#ifndef NES_STRETCH_H
+#define NES_STRETCH_H
+
+#include <stdint.h>
+
+#define STRETCH_SPEED_MIN     0.25f
+#define STRETCH_SPEED_MAX     8.0f
+#define STRETCH_SEQUENCE_MS   40      // Length of each output sequence
+#define STRETCH_OVERLAP_MS    8       // Cross-fade between sequences
+#define STRETCH_SEEK_MS       15      // Search window for the best splice point
+#define STRETCH_FIFO_SAMPLES  65536   // Input held for the largest skip at 8x and 192kHz
+
+/**
+ * Size the sequences for a sample rate and drop any buffered input
+ */
+void stretch_configure(uint32_t sample_rate);
+
+void stretch_reset(void);
+
+/**
+ * Set the tempo: input consumed per sample produced (1.0 = pass-through)
+ */
+void stretch_set_speed(int32_t speed_q16);
+
+/**
+ * Append input samples and write as many stretched samples as are ready.
+ * Returns the number of samples written (at most `capacity`).
+ */
+int stretch_process(const int16_t* in, int count, int16_t* out, int capacity);
+
+#endif // NES_STRETCH_H
@@ -0,0 +1,170 @@
+/**
+ * Tile-delta video codec
+ */
+
+#include "nes-tiles.h"
+
+#include <string.h>
+
+#define NO_COLOR 0xFF
+
+static int bits_for(int colors) {
+    if (colors <= 1) return 0;
+    if (colors <= 2) return 1;
+    if (colors <= 4) return 2;
+    return 4;
+}
+
+/**
+ * Bytes a tile's encoding occupies, from its color count
+ */
+static uint32_t tile_size(int colors) {
+    return colors > 16 ? 1 + 64 : 1 + colors + bits_for(colors) * 8;
+}
+
+static void read_tile(const uint8_t* frame, int tile, uint8_t* pixels) {
+    const uint8_t* src = frame + (tile / TILES_PER_ROW) * 8 * TILES_WIDTH + (tile % TILES_PER_ROW) * 8;
+    for (int y = 0; y < 8; y++) {
+        memcpy(pixels + y * 8, src + y * TILES_WIDTH, 8);
+    }
+}
+
+static void write_tile(uint8_t* frame, int tile, const uint8_t* pixels) {
+    uint8_t* dst = frame + (tile / TILES_PER_ROW) * 8 * TILES_WIDTH + (tile % TILES_PER_ROW) * 8;
+    for (int y = 0; y < 8; y++) {
+        memcpy(dst + y * TILES_WIDTH, pixels + y * 8, 8);
+    }
+}
+
+static int tile_changed(const uint8_t* frame, const uint8_t* reference, int tile) {
+    uint32_t offset = (tile / TILES_PER_ROW) * 8 * TILES_WIDTH + (tile % TILES_PER_ROW) * 8;
+    for (int y = 0; y < 8; y++, offset += TILES_WIDTH) {
+        uint64_t a, b;
+        memcpy(&a, frame + offset, 8);
+        memcpy(&b, reference + offset, 8);
+        if (a != b) return 1;
+    }
+    return 0;
+}
+
+static uint8_t* encode_tile(const uint8_t* pixels, uint8_t* out) {
+    uint8_t slot[64];
+    uint8_t colors[64];
+    uint8_t indices[64];
+    int count = 0;
+
+    memset(slot, NO_COLOR, sizeof(slot));
+    for (int i = 0; i < 64; i++) {
+        uint8_t color = pixels[i] & 0x3F;
+        if (slot[color] == NO_COLOR) {
+            slot[color] = (uint8_t)count;
+            colors[count++] = color;
+        }
+        indices[i] = slot[color];
+    }
+
+    *out++ = (uint8_t)count;
+    if (count > 16) {
+        for (int i = 0; i < 64; i++) {
+            *out++ = pixels[i] & 0x3F;
+        }
+        return out;
+    }
+
+    memcpy(out, colors, count);
+    out += count;
+    int bits = bits_for(count);
+    if (bits > 0) {
+        int bytes = bits * 8;
+        memset(out, 0, bytes);
+        for (int i = 0; i < 64; i++) {
+            int bit = i * bits;
+            out[bit >> 3] |= (uint8_t)(indices[i] << (bit & 7));
+        }
+        out += bytes;
+    }
+    return out;
+}
+
+static const uint8_t* decode_tile(const uint8_t* in, uint8_t* pixels) {
+    int count = *in++;
+    if (count > 16) {
+        memcpy(pixels, in, 64);
+        return in + 64;
+    }
+
+    const uint8_t* colors = in;
+    in += count;
+    int bits = bits_for(count);
+    if (bits == 0) {
+        memset(pixels, colors[0], 64);
+        return in;
+    }
+    int mask = (1 << bits) - 1;
+    for (int i = 0; i < 64; i++) {
+        int bit = i * bits;
+        int index = (in[bit >> 3] >> (bit & 7)) & mask;
+        pixels[i] = index < count ? colors[index] : colors[0];
+    }
+    return in + bits * 8;
+}
+
+uint32_t tiles_encode(const uint8_t* frame, uint8_t* reference, int keyframe, uint8_t emphasis, uint8_t* out) {
+    uint8_t* bitmap = out + 4;
+    uint8_t* p = out + TILES_HEADER_SIZE;
+    uint8_t pixels[64];
+    uint32_t changed = 0;
+
+    memset(bitmap, 0, TILES_COUNT / 8);
+    for (int tile = 0; tile < TILES_COUNT; tile++) {
+        if (!keyframe && !tile_changed(frame, reference, tile)) {
+            continue;
+        }
+        bitmap[tile >> 3] |= (uint8_t)(1 << (tile & 7));
+        read_tile(frame, tile, pixels);
+        write_tile(reference, tile, pixels);
+        p = encode_tile(pixels, p);
+        changed++;
+    }
+
+    out[0] = keyframe ? TILES_KEYFRAME : 0;
+    out[1] = emphasis & 7;
+    out[2] = (uint8_t)changed;
+    out[3] = (uint8_t)(changed >> 8);
+    return (uint32_t)(p - out);
+}
+
+int tiles_decode(const uint8_t* packet, uint32_t size, uint8_t* frame) {
+    if (size < TILES_HEADER_SIZE) {
+        return -1;
+    }
+    const uint8_t* bitmap = packet + 4;
+    uint32_t changed = packet[2] | ((uint32_t)packet[3] << 8);
+
+    // Validate every tile before touching the frame
+    uint32_t offset = TILES_HEADER_SIZE;
+    uint32_t tiles = 0;
+    for (int tile = 0; tile < TILES_COUNT; tile++) {
+        if (!(bitmap[tile >> 3] & (1 << (tile & 7)))) {
+            continue;
+        }
+        if (offset >= size || packet[offset] == 0 || packet[offset] > 64) {
+            return -1;
+        }
+        offset += tile_size(packet[offset]);
+        tiles++;
+    }
+    if (offset != size || tiles != changed) {
+        return -1;
+    }
+
+    const uint8_t* p = packet + TILES_HEADER_SIZE;
+    uint8_t pixels[64];
+    for (int tile = 0; tile < TILES_COUNT; tile++) {
+        if (bitmap[tile >> 3] & (1 << (tile & 7))) {
+            p = decode_tile(p, pixels);
+            write_tile(frame, tile, pixels);
+        }
+    }
+    return packet[1] & 7;
+}
@@ -0,0 +1,53 @@
+/**
+ * Tile-delta video codec
+ *
+ * A low-bandwidth alternative to streaming the canvas through the browser's
+ * video encoder. NES frames are built from 8x8 tiles and most of them do not
+ * change from one frame to the next, so a packet carries only the tiles of
+ * the palette-index frame that differ from what the viewer already has, each
+ * packed with a per-tile color table:
+ *
+ *   0    u8   flags (TILES_KEYFRAME: every tile follows)
+ *   1    u8   emphasis (PPUMASK bits 5-7) for the whole frame
+ *   2    u16  changed tiles (little-endian)
+ *   4    u8[120]  changed-tile bitmap, 32x30 tiles row-major, LSB first
+ *   124  tiles in bitmap order:
+ *          u8 colors n (1-64)
+ *          n <= 16: n color indices, then 64 pixels at 0/1/2/4 bits each
+ *                   (n = 1/2/<=4/<=16), LSB first
+ *          n > 16:  64 raw color indices
+ *
+ * Decoding is exact (pixel-perfect). The packet is meant to be entropy coded
+ * by the transport (deflate); repeated tiles and color tables compress well.
+ */
+
+#ifndef NES_TILES_H
+#define NES_TILES_H
+
+#include <stdint.h>
+
+#define TILES_WIDTH       256
+#define TILES_HEIGHT      240
+#define TILES_PER_ROW     (TILES_WIDTH / 8)
+#define TILES_COUNT       (TILES_PER_ROW * (TILES_HEIGHT / 8))
+#define TILES_HEADER_SIZE (4 + TILES_COUNT / 8)
+#define TILES_PACKET_MAX  (TILES_HEADER_SIZE + TILES_COUNT * 65)
+
+#define TILES_KEYFRAME    0x01
+
+/**
+ * Encode `frame` (256x240 palette indices) against `reference`, the frame the
+ * decoder currently holds, and update `reference` to match. A keyframe sends
+ * every tile. Returns the packet size written to `out` (TILES_PACKET_MAX at
+ * most).
+ */
+uint32_t tiles_encode(const uint8_t* frame, uint8_t* reference, int keyframe, uint8_t emphasis, uint8_t* out);
+
+/**
+ * Apply a packet to `frame` (256x240 palette indices, the decoder's copy).
+ * Returns the packet's emphasis bits, or -1 (frame untouched) if the packet
+ * is malformed.
+ */
+int tiles_decode(const uint8_t* packet, uint32_t size, uint8_t* frame);
+
+#endif // NES_TILES_H
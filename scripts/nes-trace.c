@@ -0,0 +1,48 @@
+/**
+ * Core tracing ring buffer (debug builds only)
+ */
+
+#include "nes-trace.h"
+
+#ifdef NES_TRACE
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#else
+#define EMSCRIPTEN_KEEPALIVE
+#endif
+
+static TraceEvent trace_ring[TRACE_RING_SIZE];
+static uint32_t trace_head = 0;   // Total events recorded; slot = head % TRACE_RING_SIZE
+static uint32_t trace_frame = 0;
+
+void trace_set_frame(uint32_t frame) {
+    trace_frame = frame;
+}
+
+void trace_record(uint32_t id, uint32_t a, uint32_t b) {
+    TraceEvent* event = &trace_ring[trace_head & (TRACE_RING_SIZE - 1)];
+    event->frame = trace_frame;
+    event->id = id;
+    event->a = a;
+    event->b = b;
+    trace_head++;
+}
+
+/**
+ * Get the trace ring (TRACE_RING_SIZE events of 4 uint32 each)
+ */
+EMSCRIPTEN_KEEPALIVE
+TraceEvent* getTraceBuffer() {
+    return trace_ring;
+}
+
+/**
+ * Get the number of events recorded so far (the ring keeps the last TRACE_RING_SIZE)
+ */
+EMSCRIPTEN_KEEPALIVE
+uint32_t getTraceHead() {
+    return trace_head;
+}
+
+#endif // NES_TRACE
@@ -0,0 +1,66 @@
+/**
+ * Core tracing
+ *
+ * Release builds compile every TRACE() call away. Debug builds (-DNES_TRACE,
+ * see DEBUG=1 in compile-c-wasm.sh) append fixed-size events to a ring buffer
+ * in core memory that the host can read with getTraceBuffer()/getTraceHead();
+ * nothing is formatted or printed on the emulation path.
+ */
+
+#ifndef NES_TRACE_H
+#define NES_TRACE_H
+
+#include <stdint.h>
+
+// Event ids (mirrored by CORE_TRACE_EVENTS in src/emulator/utils/trace.ts)
+enum {
+    TRACE_INIT = 1,           // a: already initialized
+    TRACE_ROM_LOADED,         // a: mapper, b: (prg banks << 8) | chr banks
+    TRACE_ROM_REJECTED,       // a: TRACE_REJECT_* reason, b: detail (size)
+    TRACE_RESET,
+    TRACE_RUNNING,            // a: running
+    TRACE_PIXEL_FORMAT,       // a: format, b: output height
+    TRACE_PALETTE_REJECTED,   // a: size in bytes
+    TRACE_FRAME,              // a: frame sequence, b: slot (sampled)
+    TRACE_STATE_REJECTED,     // a: STATE_ERROR_* reason (nes-state.h), b: size
+};
+
+// ROM rejection reasons
+enum {
+    TRACE_REJECT_NOT_INITIALIZED = 1,
+    TRACE_REJECT_TOO_SMALL,
+    TRACE_REJECT_TOO_LARGE,
+    TRACE_REJECT_BAD_HEADER,
+    TRACE_REJECT_NO_PRG,
+    TRACE_REJECT_SIZE_MISMATCH,
+};
+
+#define TRACE_RING_SIZE     1024   // Events kept (power of two)
+#define TRACE_SAMPLE_MASK   63     // Sampled events record every 64th occurrence
+
+typedef struct {
+    uint32_t frame;
+    uint32_t id;
+    uint32_t a;
+    uint32_t b;
+} TraceEvent;
+
+#ifdef NES_TRACE
+
+void trace_record(uint32_t id, uint32_t a, uint32_t b);
+void trace_set_frame(uint32_t frame);
+
+#define TRACE(id, a, b) trace_record((id), (uint32_t)(a), (uint32_t)(b))
+#define TRACE_SAMPLED(id, counter, a, b) \
+    do { if (((counter) & TRACE_SAMPLE_MASK) == 0) TRACE(id, a, b); } while (0)
+#define TRACE_FRAME_NUMBER(frame) trace_set_frame(frame)
+
+#else
+
+#define TRACE(id, a, b) ((void)0)
+#define TRACE_SAMPLED(id, counter, a, b) ((void)0)
+#define TRACE_FRAME_NUMBER(frame) ((void)0)
+
+#endif // NES_TRACE
+
+#endif // NES_TRACE_H
@@ -0,0 +1,165 @@
+/**
+ * Native checks for the C core (see test-core.sh)
+ *
+ * Drives the core's exports directly, the same way the wasm host does, and
+ * checks properties the netplay layer relies on. Exits non-zero on failure.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Core exports (scripts/fceux-simple.c)
+int init(void);
+int loadRom(uint8_t* rom, uint32_t size);
+void frame(void);
+int runFrames(int count, const uint8_t* inputs, int flags);
+void setRunning(int running);
+void cpuWrite(int addr, int value);
+void setAudioEnabled(int enabled);
+uint32_t saveStateSize(void);
+uint32_t saveState(uint8_t* out);
+int loadState(const uint8_t* data, uint32_t size);
+uint32_t getStateHash(void);
+
+#define TEST_FRAMES 300
+#define RUN_FRAMES_VIDEO_LAST 0x01
+#define RUN_FRAMES_AUDIO_LAST 0x02
+
+static uint8_t rom[16 + 2 * 16384 + 8192];
+static uint8_t start_state[65536];
+static uint8_t state_a[65536];
+static uint8_t state_b[65536];
+static int failures = 0;
+
+static void check(const char* name, int ok) {
+    printf("%s %s\n", ok ? "ok  " : "FAIL", name);
+    failures += !ok;
+}
+
+/**
+ * Per-frame register writes touching every channel: sweeping pulses, the
+ * triangle, both noise modes and a looping DMC sample
+ */
+static void play_music(uint32_t f) {
+    static const uint16_t notes[8] = { 253, 225, 200, 189, 168, 150, 134, 126 };
+
+    if (f == 0) {
+        cpuWrite(0x4015, 0x1F);
+        cpuWrite(0x4010, 0x4F);
+        cpuWrite(0x4012, 0x00);
+        cpuWrite(0x4013, 0x20);
+        cpuWrite(0x4015, 0x1F);
+    }
+    if (f % 3 == 0) {
+        uint16_t p1 = notes[f % 8];
+        cpuWrite(0x4000, 0x9F);
+        cpuWrite(0x4001, 0xA2);
+        cpuWrite(0x4002, p1 & 0xFF);
+        cpuWrite(0x4003, (p1 >> 8) | 0x08);
+    }
+    if (f % 5 == 0) {
+        uint16_t p2 = notes[(f / 5) % 8] * 2;
+        cpuWrite(0x4004, 0x5A);
+        cpuWrite(0x4006, p2 & 0xFF);
+        cpuWrite(0x4007, (p2 >> 8) | 0x10);
+        cpuWrite(0x400C, 0x14);
+        cpuWrite(0x400E, (f & 0x40 ? 0x80 : 0x00) | (f % 16));
+        cpuWrite(0x400F, 0x18);
+    }
+    if (f % 7 == 0) {
+        uint16_t t = notes[(f / 7) % 8];
+        cpuWrite(0x4008, 0x90);
+        cpuWrite(0x400A, t & 0xFF);
+        cpuWrite(0x400B, (t >> 8) | 0x08);
+    }
+}
+
+/**
+ * Run TEST_FRAMES from the start state, with sound switched per frame by
+ * `audio`, and keep the resulting state in `out`
+ */
+static uint32_t run_music(int (*audio)(uint32_t f), uint8_t* out, uint32_t* size) {
+    loadState(start_state, saveStateSize());
+    for (uint32_t f = 0; f < TEST_FRAMES; f++) {
+        setAudioEnabled(audio(f));
+        play_music(f);
+        frame();
+    }
+    setAudioEnabled(1);
+    *size = saveState(out);
+    return getStateHash();
+}
+
+static int audio_on(uint32_t f) { (void)f; return 1; }
+static int audio_off(uint32_t f) { (void)f; return 0; }
+static int audio_toggled(uint32_t f) { return (f / 13) & 1; }
+
+/**
+ * Muting is a host setting: a peer with sound off must reach the same state
+ * and hash as one with sound on
+ */
+static void test_muted_state(void) {
+    uint32_t size_a, size_b;
+    uint32_t on = run_music(audio_on, state_a, &size_a);
+    uint32_t off = run_music(audio_off, state_b, &size_b);
+    check("muted run hashes like an unmuted one", on == off);
+    check("muted run saves the same state", size_a == size_b && !memcmp(state_a, state_b, size_a));
+
+    uint32_t toggled = run_music(audio_toggled, state_b, &size_b);
+    check("toggling sound keeps the hash", on == toggled);
+}
+
+/**
+ * Run TEST_FRAMES in batches of six, the music's register writes landing
+ * between batches; runFrames() with `flags` if `batched`, else frame()
+ */
+static uint32_t run_batches(int batched, int flags, uint8_t* out, uint32_t* size) {
+    loadState(start_state, saveStateSize());
+    for (uint32_t f = 0; f < TEST_FRAMES; f += 6) {
+        play_music(f);
+        if (batched) {
+            runFrames(6, NULL, flags);
+        } else {
+            for (int i = 0; i < 6; i++) {
+                frame();
+            }
+        }
+    }
+    *size = saveState(out);
+    return getStateHash();
+}
+
+/**
+ * Catch-up in batches (rollback, late join) must land on the state frame-by-
+ * frame peers reach, whichever runFrames() flags skip work
+ */
+static void test_batched_state(void) {
+    static const int flags[3] = { 0, RUN_FRAMES_AUDIO_LAST, RUN_FRAMES_VIDEO_LAST | RUN_FRAMES_AUDIO_LAST };
+    static const char* names[3] = {
+        "runFrames() hashes like frame()",
+        "runFrames() with audio on the last frame only hashes like frame()",
+        "runFrames() with video and audio on the last frame only hashes like frame()",
+    };
+    uint32_t size_a, size_b;
+    uint32_t stepped = run_batches(0, 0, state_a, &size_a);
+    for (int i = 0; i < 3; i++) {
+        uint32_t batched = run_batches(1, flags[i], state_b, &size_b);
+        check(names[i], batched == stepped && size_a == size_b && !memcmp(state_a, state_b, size_a));
+    }
+}
+
+int main(void) {
+    memcpy(rom, "NES\x1a\x02\x01", 6);
+    rom[6] = 0x20;   // Mapper 2 with CHR RAM
+    init();
+    loadRom(rom, sizeof(rom));
+    setRunning(1);
+    saveState(start_state);
+
+    test_muted_state();
+    test_batched_state();
+
+    printf("%s\n", failures ? "FAILED" : "All checks passed");
+    return failures ? 1 : 0;
+}
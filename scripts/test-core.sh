@@ -0,0 +1,17 @@
+#!/bin/bash
+
+# Build the C core natively and run scripts/test-core.c
+
+set -e
+
+CC="${CC:-cc}"
+OUT="${TMPDIR:-/tmp}/nes-test-core"
+
+echo "🔨 Building native core tests with $CC..."
+"$CC" -O2 -Wall \
+    scripts/fceux-simple.c scripts/nes-apu.c scripts/nes-blip.c scripts/nes-hash.c scripts/nes-input.c scripts/nes-palette.c scripts/nes-rewind.c scripts/nes-snapshot.c scripts/nes-state.c scripts/nes-stretch.c scripts/nes-tiles.c scripts/nes-trace.c \
+    scripts/test-core.c \
+    -lm -o "$OUT"
+
+echo "🧪 Running..."
+"$OUT"
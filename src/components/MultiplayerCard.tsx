@@ -1,4 +1,4 @@
-import { useState, useEffect, useRef } from 'react';
+import { useState, useEffect, useRef, type RefObject } from 'react';
 import { useNavigate } from 'react-router-dom';
 import { Card, CardContent, CardHeader, CardTitle } from '@/components/ui/card';
 import { Button } from '@/components/ui/button';
@@ -9,6 +9,9 @@ import { Input } from '@/components/ui/input';
 import { Label } from '@/components/ui/label';
 import { useToast } from '@/hooks/useToast';
 import { useMultiplayerSession } from '@/hooks/useMultiplayerSession';
+import { useCoreNetplay } from '@/hooks/useCoreNetplay';
+import type { NesCorePlayerRef } from '@/components/NesCorePlayer';
+import type { NesCore } from '@/emulator/NesCore';
 import { useGameStream } from '@/hooks/useGameStream';
 import { useCurrentUser } from '@/hooks/useCurrentUser';
 import { useAuthor } from '@/hooks/useAuthor';
@@ -44,11 +47,18 @@ interface MultiplayerCardProps {
   getGameStream?: () => MediaStream | null;
   maxPlayers?: number;
   defaultExpanded?: boolean;
+  // The game runs on the C core: host a rollback session on it (useCoreNetplay)
+  netplay?: {
+    player: RefObject<NesCorePlayerRef | null>;
+    core: NesCore | null;
+  };
 }
 
 type SessionStatus = 'idle' | 'creating' | 'available' | 'full' | 'error';
 type InteractionMode = 'idle' | 'starting' | 'joining';
 
+const emptyPlayerRef: RefObject<NesCorePlayerRef | null> = { current: null };
+
 export default function MultiplayerCard({
   gameMeta,
   className,
@@ -56,13 +66,15 @@ export default function MultiplayerCard({
   onStreamStart,
   getGameStream,
   maxPlayers = 2,
-  defaultExpanded
+  defaultExpanded,
+  netplay
 }: MultiplayerCardProps) {
   const navigate = useNavigate();
   const { toast } = useToast();
   const { user } = useCurrentUser();
 
   // Use the new multiplayer session hook
+  const multiplayer = useMultiplayerSession(gameMeta.id);
   const {
     sessionId,
     session,
@@ -73,7 +85,15 @@ export default function MultiplayerCard({
     startSession,
     joinSession,
     leaveSession
-  } = useMultiplayerSession(gameMeta.id);
+  } = multiplayer;
+
+  useCoreNetplay({
+    role: netplay ? 'host' : null,
+    player: netplay?.player ?? emptyPlayerRef,
+    core: netplay?.core ?? null,
+    multiplayer,
+    players: maxPlayers,
+  });
 
   // Use game stream hook for video capture
   const { startStream, stopStream, getStream } = useGameStream({
@@ -106,7 +126,7 @@ export default function MultiplayerCard({
    * Actually create the session after showing the invite link
    */
   const handleCreateSession = async () => {
-    if (!getGameStream) {
+    if (!getGameStream && !netplay) {
       toast({
         title: "Game Not Ready",
         description: "Game streaming not available",
@@ -116,17 +136,18 @@ export default function MultiplayerCard({
     }
 
     try {
-      // Get video stream from the game
-      const stream = getGameStream();
-      if (!stream) {
+      // Get video stream from the game; guests of a core session run the
+      // game themselves, so there is no video to encode
+      const stream = netplay ? null : getGameStream?.() ?? null;
+      if (!netplay && !stream) {
         throw new Error('Failed to capture game stream - make sure the game is running');
       }
 
       // Notify parent component about the stream
-      onStreamStart?.(stream);
+      if (stream) onStreamStart?.(stream);
 
       // Start the multiplayer session (no offer created immediately)
-      await startSession(stream, maxPlayersRef.current);
+      await startSession(stream, maxPlayersRef.current, Boolean(netplay));
 
       setInteractionMode('idle');
 
@@ -376,7 +397,7 @@ export default function MultiplayerCard({
               <Button
                 onClick={handleCreateSession}
                 className="flex-1 bg-green-600 hover:bg-green-700"
-                disabled={!getGameStream}
+                disabled={!getGameStream && !netplay}
               >
                 <Play className="w-4 h-4 mr-2" />
                 Create Session
@@ -0,0 +1,259 @@
+import { useState, useEffect, useRef, forwardRef, useImperativeHandle } from 'react';
+import { Button } from '@/components/ui/button';
+import { Card, CardContent } from '@/components/ui/card';
+import { Play, Pause, RotateCcw, Volume2, VolumeX } from 'lucide-react';
+import type { EmulatorJSRef } from '@/components/EmulatorIFrame';
+import type { NesCore } from '@/emulator/NesCore';
+import { NesPlayer } from '@/emulator/NesPlayer';
+import { WasmCoreAdapter } from '@/emulator/cores/wasmCoreAdapter';
+import Speakers from '@/emulator/audio/Speakers';
+import { buttonBit } from '@/emulator/netplay/inputProtocol';
+
+interface NesCorePlayerProps {
+  romData: Uint8Array;
+  title?: string;
+  className?: string;
+  onReady?: (core: NesCore) => void;
+  /** The core could not start (e.g. public/wasm/fceux-c.* is an older build) */
+  onError?: (error: Error) => void;
+}
+
+/**
+ * The C core (WasmCoreAdapter) as a player component. Netplay drives it
+ * through this handle instead of the core's own frame loop.
+ */
+export interface NesCorePlayerRef extends EmulatorJSRef {
+  getCore: () => NesCore | null;
+  /** Player 1's buttons in setButton() bit order */
+  getLocalButtons: () => number;
+  /**
+   * Run `step` instead of core.frame() each frame (null to restore); audio
+   * output follows it unless it returns false (no frame was run)
+   */
+  setFrameStep: (step: (() => boolean | void) | null) => void;
+}
+
+// Keyboard code to NES button, player 1
+const KEY_BUTTONS: Record<string, string> = {
+  ArrowUp: 'Up', ArrowDown: 'Down', ArrowLeft: 'Left', ArrowRight: 'Right',
+  KeyX: 'A', KeyZ: 'B', KeyY: 'B', Enter: 'Start', ShiftRight: 'Select', ControlRight: 'Select',
+};
+
+const NesCorePlayer = forwardRef<NesCorePlayerRef, NesCorePlayerProps>(({
+  romData,
+  title = 'Game',
+  className = '',
+  onReady,
+  onError
+}, ref) => {
+  const canvasRef = useRef<HTMLCanvasElement>(null);
+  const coreRef = useRef<WasmCoreAdapter | null>(null);
+  const playerRef = useRef<NesPlayer | null>(null);
+  const speakersRef = useRef<Speakers | null>(null);
+  const stepRef = useRef<(() => boolean | void) | null>(null);
+  const buttonsRef = useRef(0);
+  const mutedRef = useRef(false);
+  const onReadyRef = useRef(onReady);
+  onReadyRef.current = onReady;
+  const onErrorRef = useRef(onError);
+  onErrorRef.current = onError;
+
+  const [status, setStatus] = useState<'loading' | 'ready' | 'error'>('loading');
+  const [error, setError] = useState<string | null>(null);
+  const [isPaused, setIsPaused] = useState(false);
+  const [isMuted, setIsMuted] = useState(false);
+
+  // Load the core and ROM, then run
+  useEffect(() => {
+    const canvas = canvasRef.current;
+    if (!canvas) return;
+
+    let cancelled = false;
+    const core = new WasmCoreAdapter();
+    const speakers = new Speakers({});
+    speakersRef.current = speakers;
+
+    const start = async () => {
+      try {
+        setStatus('loading');
+        setError(null);
+        if (!await core.init() || !await core.loadRom(romData)) {
+          throw new Error('The core could not load this ROM');
+        }
+        if (cancelled) return;
+
+        core.setSampleRate(speakers.getSampleRate());
+        const player = new NesPlayer(core, canvas);
+        player.setFrameStep(() => {
+          if (stepRef.current) {
+            if (stepRef.current() === false) return;
+          } else {
+            core.setPortButtons(0, buttonsRef.current);
+            core.frame();
+          }
+
+          if (!mutedRef.current && speakers.isPlaying()) {
+            speakers.writeSamples(core.getAudioBuffer());
+            const fill = speakers.getBufferFill();
+            core.setAudioBufferFill(fill.queued, fill.capacity);
+          }
+        });
+
+        coreRef.current = core;
+        playerRef.current = player;
+        player.play();
+        setStatus('ready');
+        onReadyRef.current?.(core);
+      } catch (err) {
+        console.error('[NesCorePlayer] Failed to start core:', err);
+        if (!cancelled) {
+          setError(err instanceof Error ? err.message : 'Failed to start the core');
+          setStatus('error');
+          onErrorRef.current?.(err instanceof Error ? err : new Error(String(err)));
+        }
+      }
+    };
+    start();
+
+    return () => {
+      cancelled = true;
+      playerRef.current?.dispose();
+      playerRef.current = null;
+      coreRef.current = null;
+      speakers.close();
+      speakersRef.current = null;
+    };
+  }, [romData]);
+
+  // Player 1 on the keyboard; typing in page inputs (chat) is left alone
+  useEffect(() => {
+    const onKey = (e: KeyboardEvent) => {
+      const target = e.target as HTMLElement | null;
+      if (target && (target.tagName === 'INPUT' || target.tagName === 'TEXTAREA' || target.isContentEditable)) return;
+      const bit = buttonBit(KEY_BUTTONS[e.code] ?? '');
+      if (!bit) return;
+
+      e.preventDefault();
+      if (e.type === 'keydown') {
+        buttonsRef.current |= bit;
+        startAudio();
+      } else {
+        buttonsRef.current &= ~bit;
+      }
+    };
+    window.addEventListener('keydown', onKey);
+    window.addEventListener('keyup', onKey);
+    return () => {
+      window.removeEventListener('keydown', onKey);
+      window.removeEventListener('keyup', onKey);
+    };
+  }, []);
+
+  // Browsers only start audio from a user gesture
+  const startAudio = () => {
+    if (!mutedRef.current && speakersRef.current && !speakersRef.current.isPlaying()) {
+      speakersRef.current.start();
+    }
+  };
+
+  const handlePlayPause = () => {
+    const player = playerRef.current;
+    if (!player) return;
+    if (player.isRunning()) {
+      player.pause();
+      setIsPaused(true);
+    } else {
+      player.play();
+      setIsPaused(false);
+    }
+  };
+
+  const handleReset = () => {
+    coreRef.current?.reset();
+  };
+
+  const handleMuteToggle = () => {
+    const muted = !mutedRef.current;
+    mutedRef.current = muted;
+    setIsMuted(muted);
+    coreRef.current?.setAudioEnabled(!muted);
+    if (muted) {
+      speakersRef.current?.stop();
+    } else {
+      startAudio();
+    }
+  };
+
+  useImperativeHandle(ref, () => ({
+    getCanvasStream: () => {
+      const canvas = canvasRef.current;
+      if (!canvas || !coreRef.current) {
+        console.warn('[NesCorePlayer] Canvas stream not available - core not ready');
+        return null;
+      }
+      return canvas.captureStream(60);
+    },
+    getCore: () => coreRef.current,
+    getLocalButtons: () => buttonsRef.current,
+    setFrameStep: (step) => {
+      stepRef.current = step;
+    },
+  }), []);
+
+  return (
+    <div className={`flex flex-col items-center space-y-4 ${className}`}>
+      <Card className="w-full max-w-4xl">
+        <CardContent className="p-2 sm:p-4">
+          <div className="relative bg-black rounded-lg overflow-hidden" onPointerDown={startAudio}>
+            <canvas
+              ref={canvasRef}
+              width={256}
+              height={240}
+              aria-label={title}
+              className="w-full h-auto"
+              style={{ imageRendering: 'pixelated' }}
+            />
+            {status !== 'ready' && (
+              <div className="absolute inset-0 flex items-center justify-center bg-black/80 text-center p-4">
+                <p className={error ? 'text-red-400 text-sm' : 'text-gray-300 text-sm'}>
+                  {error ?? 'Loading core...'}
+                </p>
+              </div>
+            )}
+          </div>
+        </CardContent>
+      </Card>
+
+      <Card className="w-full max-w-4xl">
+        <CardContent className="p-3 sm:p-4">
+          <div className="flex flex-wrap items-stretch justify-center gap-2 sm:gap-3">
+            <Button onClick={handlePlayPause} variant={isPaused ? "default" : "secondary"} size="lg" disabled={status !== 'ready'}>
+              {isPaused ? <Play className="w-5 h-5 mr-2" /> : <Pause className="w-5 h-5 mr-2" />}
+              {isPaused ? 'Play' : 'Pause'}
+            </Button>
+
+            <Button onClick={handleReset} variant="outline" size="lg" disabled={status !== 'ready'}>
+              <RotateCcw className="w-5 h-5 mr-2" />
+              Reset
+            </Button>
+
+            <Button onClick={handleMuteToggle} variant="ghost" size="lg">
+              {isMuted ? <VolumeX className="w-5 h-5" /> : <Volume2 className="w-5 h-5" />}
+            </Button>
+
+            <div className="flex items-center gap-2 text-sm text-muted-foreground">
+              <div className={`w-2 h-2 rounded-full ${
+                status === 'error' ? 'bg-red-500' : status === 'ready' ? 'bg-green-500' : 'bg-yellow-500'
+              }`}></div>
+              {status === 'error' ? 'Error' : status === 'ready' ? 'Ready' : 'Loading'}
+            </div>
+          </div>
+        </CardContent>
+      </Card>
+    </div>
+  );
+});
+
+NesCorePlayer.displayName = 'NesCorePlayer';
+
+export default NesCorePlayer;
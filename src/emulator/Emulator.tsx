@@ -92,19 +92,13 @@ class Emulator extends Component<EmulatorProps> {
     console.log('[Emulator] 🎵 Creating Speakers...');
     this.speakers = new Speakers({
       onBufferUnderrun: (actualSize: number, desiredSize: number) => {
-        if (this.props.paused) return;
+        if (this.props.paused || !this.frameTimer) return;
 
-        console.log("Buffer underrun, running another frame to try and catch up");
-        if (this.frameTimer) {
+        // Run up to two frames to catch up
+        this.frameTimer.generateFrame();
+        if (this.speakers && this.speakers.getBufferFill().queued < desiredSize) {
           this.frameTimer.generateFrame();
         }
-
-        if (this.speakers && (this.speakers as any).buffer.size() < desiredSize) {
-          console.log("Still buffer underrun, running a second frame");
-          if (this.frameTimer) {
-            this.frameTimer.generateFrame();
-          }
-        }
       },
     });
 
@@ -124,6 +118,8 @@ class Emulator extends Component<EmulatorProps> {
       onGenerateFrame: this.nes.frame,
       onWriteFrame: this.screen ? this.screen.writeBuffer : () => {},
     });
+    // frameTimer.getPacingStats() in the console reports frame jitter
+    (window as unknown as Record<string, unknown>)["frameTimer"] = this.frameTimer;
 
     this.gamepadController = new GamepadController({
       onButtonDown: this.nes.buttonDown,
@@ -161,6 +157,9 @@ class Emulator extends Component<EmulatorProps> {
 
   componentWillUnmount() {
     this.stop();
+    if (this.speakers) {
+      this.speakers.close();
+    }
 
     if (this.keyboardController) {
       document.removeEventListener("keydown", this.keyboardController.handleKeyDown);
@@ -172,6 +171,7 @@ class Emulator extends Component<EmulatorProps> {
       this.gamepadPolling.stop();
     }
     (window as any)["nes"] = undefined;
+    (window as any)["frameTimer"] = undefined;
   }
 
   componentDidUpdate(prevProps: EmulatorProps) {
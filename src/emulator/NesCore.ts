@@ -6,14 +6,55 @@
  * frame rendering, and input handling.
  */
 
-export type PixelFormat = 'RGB24' | 'RGBA32' | 'INDEXED8';
+export type PixelFormat = 'RGB24' | 'RGBA32' | 'BGRA32' | 'RGB565' | 'INDEXED8';
 
 export interface FrameSpec {
   width: number;   // Expected: 256
-  height: number;  // Expected: 240
+  height: number;  // Expected: 240 (224 with overscan cropped)
   format: PixelFormat;
 }
 
+export interface LatestFrame {
+  index: number;     // Frame slot holding the frame
+  sequence: number;  // Increases by one per completed frame
+  buffer: Uint8Array; // View onto the slot; valid until the slot is reused
+}
+
+export interface RunFramesOptions {
+  videoLastOnly?: boolean;  // Render only the last frame
+  audioLastOnly?: boolean;  // Synthesize only the last frame's audio (faster; see runFrames())
+}
+
+export const RUN_FRAMES_PORTS = 4;   // Bytes per frame in runFrames() inputs, one per port
+
+/**
+ * Devices in the controller ports: a pad in each, four pads through a Four
+ * Score, or a pad in port 1 and a Zapper in port 2. The Zapper is driven by
+ * the same per-port bytes as pads: ZAPPER_TRIGGER in port 2's mask, then the
+ * aimed x and y (y >= 240: pointing away from the screen) as ports 3 and 4.
+ */
+export type InputMode = 'standard' | 'four-score' | 'zapper';
+
+export const ZAPPER_TRIGGER = 0x10;
+
+export interface CoreStats {
+  snapshots: number;          // Snapshots taken since the ROM was loaded
+  snapshotPages: number;      // 256-byte pages copied by the last snapshot
+  snapshotBytes: number;      // Bytes copied by the last snapshot
+  snapshotMicros: number;     // Average cost of takeSnapshot()
+  restoreMicros: number;      // Average cost of restoreSnapshot()
+  snapshotsHeld: number;      // Snapshots that can still be restored
+  snapshotPoolBytes: number;  // Snapshot storage in use
+  rewindStates: number;       // States rewindStep() can return to
+  rewindFrames: number;       // Frames of history they cover
+  rewindBytes: number;        // Encoded bytes held
+  rewindStateBytes: number;   // Encoded size of the last state captured
+  rewindMicros: number;       // Capture cost per frame
+  runAhead: number;           // Frames run ahead per frame()
+  runAheadFrameMicros: number; // Cost of each frame run ahead (rendering excluded)
+  runAheadStateMicros: number; // Save and restore around them, per frame()
+}
+
 export interface NesCore {
   /**
    * Initialize the emulator core
@@ -45,6 +86,72 @@ export interface NesCore {
    */
   setButton(index: number, pressed: boolean): void;
 
+  /**
+   * Set all buttons of one controller port (optional)
+   * @param port 0-3 (players 1-4; 3 and 4 are read through a Four Score)
+   * @param mask One bit per button, in setButton() index order
+   */
+  setPortButtons?(port: number, mask: number): void;
+
+  /**
+   * Set every controller port in one call (optional)
+   * @param masks One mask per port in setButton() bit order; ports left out are released
+   */
+  setButtons?(masks: Uint8Array): void;
+
+  /**
+   * Choose the devices plugged into the controller ports (optional). Not part
+   * of savestates: netplay peers must choose the same mode.
+   * @returns false if the core does not model them
+   */
+  setInputMode?(mode: InputMode): boolean;
+
+  /**
+   * Run `count` frames in one call (optional), for fast-forward and catch-up
+   * without a JS round trip per frame and button.
+   * getLatestFrame() and getAudioBuffer() then hold the result: the last
+   * frame, and with audioLastOnly its samples only, otherwise every frame's.
+   * audioLastOnly is like setAudioEnabled(false) for the earlier frames:
+   * neither the game nor getStateHash() can tell the difference.
+   * @param inputs RUN_FRAMES_PORTS masks per frame, or null to keep the current buttons
+   * @returns Frames run
+   */
+  runFrames?(count: number, inputs?: Uint8Array | null, options?: RunFramesOptions): number;
+
+  /**
+   * Queue frame-stamped input (optional). Each record applies when frame()
+   * reaches its frame and scanline, and the game sees it at its next
+   * controller strobe, so a whole batch from the network is handed over at
+   * once and input timing does not depend on when the host calls in.
+   * @param events 8-byte records: u32 frame, u8 port, u8 mask, u16 scanline
+   *        (0: from the frame's start; see InputEventBatch)
+   * @returns Records accepted
+   */
+  queueInputs?(events: Uint8Array): number;
+
+  /**
+   * Frames emulated since reset, the clock queueInputs() stamps refer to (optional)
+   */
+  getFrameCount?(): number;
+
+  /**
+   * Lag frames, in which the game never read its controllers (optional): bit 0
+   * for the last frame emulated, bit n for the frame n before it. Input for
+   * these frames need not be sent or predicted.
+   */
+  getLagFrames?(): number;
+
+  /**
+   * Lag frames emulated since the ROM was loaded or reset (optional)
+   */
+  getLagFrameCount?(): number;
+
+  /**
+   * Hash of the loaded ROM, the one savestates are tied to (optional)
+   * @returns 0 if no ROM is loaded
+   */
+  getRomHash?(): number;
+
   /**
    * Set the running state of the emulator
    * @param running Whether the emulator should be running
@@ -53,16 +160,39 @@ export interface NesCore {
 
   /**
    * Get the current frame buffer
+   * Cores backed by wasm memory should return the same view object for the same
+   * frame slot until memory grows, so hosts can cache wrappers (e.g. ImageData).
    * @returns Raw pixel buffer data
    */
   getFrameBuffer(): Uint8Array;
 
+  /**
+   * Get the latest completed frame from a multi-buffered core (optional).
+   * The core writes the next frame into a different slot, so the buffer can be
+   * read without copying while emulation continues.
+   * @returns Slot index, sequence number and a view onto the slot
+   */
+  getLatestFrame?(): LatestFrame;
+
   /**
    * Get the frame specification (dimensions and format)
    * @returns Frame specification object
    */
   getFrameSpec(): FrameSpec;
 
+  /**
+   * Select the pixel format the core writes directly into its frame buffer (optional)
+   * @param format Desired output format
+   * @returns true if the core supports the format
+   */
+  setPixelFormat?(format: PixelFormat): boolean;
+
+  /**
+   * Crop 8 overscan lines top and bottom, producing a 256x224 frame (optional)
+   * @param enabled Whether to crop
+   */
+  setOverscanCrop?(enabled: boolean): void;
+
   /**
    * Get the color palette (optional, for INDEXED8 format)
    * @returns Palette data or null if not available
@@ -70,8 +200,175 @@ export interface NesCore {
   getPalette?(): Uint8Array | Uint32Array | null;
 
   /**
-   * Get audio buffer (optional)
+   * Expand INDEXED8 pixels to little-endian RGBA with the full palette (optional)
+   * @param dst One RGBA word per pixel
+   * @param src Palette indices, e.g. a frame from getLatestFrame()
+   * @param emphasis PPUMASK emphasis bits (0-7), see getEmphasis()
+   */
+  expandIndexed?(dst: Uint32Array, src: Uint8Array, emphasis: number): void;
+
+  /**
+   * Current PPUMASK emphasis bits (0-7), which INDEXED8 pixels do not carry (optional)
+   */
+  getEmphasis?(): number;
+
+  /**
+   * Replace the palette from a .pal file (optional)
+   * @param pal 192 bytes (64 RGB colors) or 1536 bytes (512 colors with emphasis)
+   * @returns true if the palette was accepted
+   */
+  loadPalette?(pal: Uint8Array): boolean;
+
+  /**
+   * Get the samples produced by the last frame() (optional).
+   * Mono signed 16-bit at the rate set with setSampleRate(); the view is only
+   * valid until the next frame() call.
    * @returns Audio sample buffer or empty array if not available
    */
   getAudioBuffer?(): Int16Array;
-}
\ No newline at end of file
+
+  /**
+   * Set the audio output rate, normally the AudioContext's sampleRate (optional)
+   * @param rate Sample rate in Hz
+   * @returns true if the core accepted the rate
+   */
+  setSampleRate?(rate: number): boolean;
+
+  /**
+   * Report the host's audio buffer fill level once per frame (optional).
+   * The core nudges its output rate (by at most 0.5%) towards a half-full
+   * buffer, so audio stays locked to emulation without underruns or overruns.
+   * @param queued Samples waiting to be played
+   * @param capacity Size of the host buffer in samples
+   * @returns Applied rate adjustment in ppm
+   */
+  setAudioBufferFill?(queued: number, capacity: number): number;
+
+  /**
+   * Turn sound generation on or off (optional). Use while muted or for
+   * background previews: timing games can observe is kept, synthesis is skipped.
+   * @param enabled Whether frame() should produce samples
+   */
+  setAudioEnabled?(enabled: boolean): void;
+
+  /**
+   * Turn rendering on or off (optional). With video off frame() still advances
+   * the game and its audio but leaves the frame buffers untouched; used to
+   * re-simulate frames that were already displayed.
+   * @param enabled Whether frame() should render
+   */
+  setVideoEnabled?(enabled: boolean): void;
+
+  /**
+   * Tell the core how fast the host is running frames relative to real time
+   * (optional). Audio is time-stretched back to real time at the original pitch.
+   * @param multiplier 0.25 (slow motion) to 8 (fast-forward); 1 for normal speed
+   * @returns true if the multiplier is supported
+   */
+  setSpeed?(multiplier: number): boolean;
+
+  /**
+   * Serialize the emulation state between frames (optional).
+   * The result is versioned and tied to the loaded ROM.
+   * @returns State bytes, or null if no ROM is loaded
+   */
+  saveState?(): Uint8Array | null;
+
+  /**
+   * Restore a state from saveState() (optional). Nothing changes if the state
+   * is rejected (other ROM, other format version, or corrupt).
+   * @param state Bytes returned by saveState()
+   * @returns true if the state was applied
+   */
+  loadState?(state: Uint8Array): boolean;
+
+  /**
+   * Hash the emulation state between frames (optional). Takes microseconds;
+   * netplay peers compare it to detect a desync.
+   * @returns 32-bit hash, or 0 if no ROM is loaded
+   */
+  getStateHash?(): number;
+
+  /**
+   * Per-page hashes the state hash is built from (optional): guest RAM pages,
+   * then registers. Pass a peer's to saveStatePatch().
+   * @returns Page hashes, or null if no ROM is loaded
+   */
+  getStatePageHashes?(): Uint32Array | null;
+
+  /**
+   * Serialize only what differs from a peer's state (optional). The peer
+   * applies the result with loadState().
+   * @param peerHashes The peer's getStatePageHashes()
+   * @returns Patch bytes, or null if no ROM is loaded
+   */
+  saveStatePatch?(peerHashes: Uint32Array): Uint8Array | null;
+
+  /**
+   * Turn tile video capture on or off (optional). While on, each rendered
+   * frame is kept for encodeTileFrame(); the next packet is a keyframe.
+   * @param enabled Whether to capture
+   */
+  setTileEncoder?(enabled: boolean): void;
+
+  /**
+   * Encode the last rendered frame as the 8x8 tiles that changed since the
+   * previous packet (optional). Packets must be decoded in order; send a
+   * keyframe when a viewer joins or a packet may have been lost.
+   * @param keyframe Send every tile
+   * @returns Packet bytes, or null if capture is off
+   */
+  encodeTileFrame?(keyframe: boolean): Uint8Array | null;
+
+  /**
+   * Apply a packet from a peer's encodeTileFrame() and publish the result as
+   * the latest frame, in this core's pixel format (optional)
+   * @param packet Bytes from encodeTileFrame()
+   * @returns false if the packet was malformed (the frame is unchanged)
+   */
+  decodeTileFrame?(packet: Uint8Array): boolean;
+
+  /**
+   * Take an incremental snapshot between frames (optional). Only memory pages
+   * written since the previous snapshot are copied, so this is cheap enough
+   * to call every frame.
+   * @returns Snapshot id, or 0 if no ROM is loaded
+   */
+  takeSnapshot?(): number;
+
+  /**
+   * Return to a recent snapshot (optional)
+   * @param id Id from takeSnapshot()
+   * @returns false if the snapshot is no longer held
+   */
+  restoreSnapshot?(id: number): boolean;
+
+  /**
+   * Get core cost and memory statistics (optional)
+   */
+  getCoreStats?(): CoreStats;
+
+  /**
+   * Set the memory for the core's rewind history (optional). While enabled the
+   * core captures a compressed state every couple of frames.
+   * @param bytes History size; 0 turns rewind off
+   * @returns false if the budget was refused
+   */
+  setRewindBudget?(bytes: number): boolean;
+
+  /**
+   * Step back to the newest state in the rewind history and drop it (optional).
+   * Call once before each frame() while the rewind control is held.
+   * @returns false when the history is exhausted
+   */
+  rewindStep?(): boolean;
+
+  /**
+   * Run `frames` frames ahead of the real one and display the last (optional).
+   * Hides that many frames of the game's own input lag; the cost grows with
+   * `frames` (see getCoreStats()).
+   * @param frames 0 (off) to 4
+   * @returns false if out of range
+   */
+  setRunAhead?(frames: number): boolean;
+}
@@ -5,24 +5,22 @@
  */
 
 import { NesCore, PixelFormat } from './NesCore';
-
-// Debug logging flag - can be enabled/disabled easily
-let ENABLE_FRAME_DEBUG_LOGS = true;
-
-// Export function to control debug logging
-export function setFrameDebugLogging(enabled: boolean): void {
-  ENABLE_FRAME_DEBUG_LOGS = enabled;
-  console.log('[NesPlayer] Frame debug logging:', enabled ? 'ENABLED' : 'DISABLED');
-}
+import FrameTimer from './utils/FrameTimer';
+import { TRACE_ENABLED, TraceEvents, trace, traceSampled } from './utils/trace';
 
 export class NesPlayer {
   private ctx: CanvasRenderingContext2D;
   private imageData?: ImageData;
-  private rafId: number | null = null;
+  private imagePixels?: Uint32Array;   // imageData's pixels, one word each (INDEXED8 conversion)
+  private frameImages = new WeakMap<Uint8Array, ImageData>();
+  private frameTimer: FrameTimer;
+  private step: () => void;
   private isPlaying = false;
   private visibilityHandler?: () => void;
   private frameCount = 0;
-  private debugInitialized = false;
+  private lastFrameSequence = -1;
+  private indexedLut?: Uint32Array;
+  private indexedLutSource?: Uint8Array | Uint32Array;
 
   constructor(private core: NesCore, private canvas: HTMLCanvasElement) {
     console.log('[NesPlayer] Initializing player with canvas:', canvas.width, 'x', canvas.height);
@@ -36,9 +34,9 @@ export class NesPlayer {
     this.ctx = ctx;
     this.ctx.imageSmoothingEnabled = false; // Preserve pixel art
 
-    // Initial debug logging
-    if (ENABLE_FRAME_DEBUG_LOGS) {
-      this.logCanvasDebugInfo();
+    // Ask the core to write canvas-native RGBA so blit() needs no conversion pass
+    if (this.core.setPixelFormat && !this.core.setPixelFormat('RGBA32')) {
+      console.warn('[NesPlayer] Core does not support RGBA32 output, converting per frame');
     }
 
     // Handle page visibility changes (pause when tab is hidden)
@@ -54,145 +52,48 @@ export class NesPlayer {
 
     document.addEventListener('visibilitychange', this.visibilityHandler);
 
-    console.log('[NesPlayer] Player initialized successfully');
-  }
-
-  /**
-   * Log canvas and context debug information
-   */
-  private logCanvasDebugInfo(): void {
-    console.log('[NesPlayer] Canvas Debug Info:', {
-      canvasWidth: this.canvas.width,
-      canvasHeight: this.canvas.height,
-      canvasClientWidth: this.canvas.clientWidth,
-      canvasClientHeight: this.canvas.clientHeight,
-      contextType: this.ctx.constructor.name,
-      imageSmoothingEnabled: this.ctx.imageSmoothingEnabled,
-      globalAlpha: this.ctx.globalAlpha,
-      globalCompositeOperation: this.ctx.globalCompositeOperation
-    });
-
-    // Force disable image smoothing and log result
-    this.ctx.imageSmoothingEnabled = false;
-    console.log('[NesPlayer] Image smoothing forced to:', this.ctx.imageSmoothingEnabled);
-  }
-
-  /**
-   * Test canvas rendering with a solid red pixel
-   */
-  private testCanvasRendering(): void {
-    if (!ENABLE_FRAME_DEBUG_LOGS) return;
-
-    try {
-      // Create a 1x1 red pixel ImageData
-      const testPixel = new Uint8ClampedArray([255, 0, 0, 255]); // Red, opaque
-      const testImageData = new ImageData(testPixel, 1, 1);
-
-      // Draw test pixel at (100, 100)
-      this.ctx.putImageData(testImageData, 100, 100);
-
-      console.log('[NesPlayer] ✅ Test red pixel drawn at (100, 100)');
-
-      // Read back the pixel to verify it was written
-      const readBack = this.ctx.getImageData(100, 100, 1, 1);
-      console.log('[NesPlayer] Test pixel readback:', Array.from(readBack.data));
-
-    } catch (error) {
-      console.error('[NesPlayer] ❌ Test canvas rendering failed:', error);
-    }
-  }
-
-  /**
-   * Log frame buffer preview data
-   */
-  private logFrameBufferPreview(frameBuffer: Uint8Array): void {
-    if (!ENABLE_FRAME_DEBUG_LOGS) return;
-
-    console.log('[NesPlayer] Frame buffer preview (first 32 bytes):', Array.from(frameBuffer.slice(0, 32)));
-
-    // Log some sample pixels from different areas
-    const samples = [
-      { name: 'Top-left', offset: 0 },
-      { name: 'Top-right', offset: (255 * 4) },
-      { name: 'Center', offset: ((120 * 256) + 128) * 4 },
-      { name: 'Bottom-left', offset: (239 * 256) * 4 },
-      { name: 'Bottom-right', offset: ((239 * 256) + 255) * 4 }
-    ];
-
-    samples.forEach(sample => {
-      if (sample.offset + 3 < frameBuffer.length) {
-        const r = frameBuffer[sample.offset];
-        const g = frameBuffer[sample.offset + 1];
-        const b = frameBuffer[sample.offset + 2];
-        const a = frameBuffer[sample.offset + 3];
-        console.log(`[NesPlayer] ${sample.name} pixel: RGBA(${r}, ${g}, ${b}, ${a})`);
-      }
-    });
-
-    // Check for common issues
-    const allZero = frameBuffer.every(byte => byte === 0);
-    const allMax = frameBuffer.every(byte => byte === 255);
-    const hasVariation = new Set(frameBuffer).size > 1;
-
-    console.log('[NesPlayer] Frame buffer analysis:', {
-      allZero,
-      allMax,
-      hasVariation,
-      uniqueValues: new Set(frameBuffer.slice(0, 1000)).size // Sample first 1000 bytes
-    });
-  }
-
-  /**
-   * Verify ImageData creation and content
-   */
-  private verifyImageData(imageData: ImageData, sourceBuffer: Uint8Array): void {
-    if (!ENABLE_FRAME_DEBUG_LOGS) return;
-
-    console.log('[NesPlayer] ImageData verification:', {
-      width: imageData.width,
-      height: imageData.height,
-      dataLength: imageData.data.length,
-      sourceLength: sourceBuffer.length,
-      dataConstructor: imageData.data.constructor.name
+    // Frames are paced like the jsnes Emulator's: FrameTimer runs the core,
+    // the display shows the newest frame
+    this.step = () => this.core.frame();
+    this.frameTimer = new FrameTimer({
+      onGenerateFrame: () => {
+        try {
+          this.step();
+        } catch (error) {
+          console.error('[NesPlayer] Game loop error:', error);
+          this.pause(); // Stop on error
+        }
+      },
+      onWriteFrame: () => this.blit(),
     });
 
-    // Check if data was copied correctly
-    const firstPixelSource = Array.from(sourceBuffer.slice(0, 4));
-    const firstPixelImageData = Array.from(imageData.data.slice(0, 4));
-
-    console.log('[NesPlayer] First pixel comparison:', {
-      source: firstPixelSource,
-      imageData: firstPixelImageData,
-      match: JSON.stringify(firstPixelSource) === JSON.stringify(firstPixelImageData)
-    });
+    console.log('[NesPlayer] Player initialized successfully');
   }
 
   /**
    * Render current frame to canvas
-   * TODO: Update to work with new emulator core
    */
   private blit(): void {
     try {
       this.frameCount++;
 
-      // One-time debug initialization
-      if (ENABLE_FRAME_DEBUG_LOGS && !this.debugInitialized) {
-        this.testCanvasRendering();
-        this.debugInitialized = true;
-      }
-
-      // TODO: Replace with new emulator core getFrameSpec method
       const { width, height, format } = this.core.getFrameSpec();
 
-      if (ENABLE_FRAME_DEBUG_LOGS && this.frameCount <= 3) {
-        console.log(`[NesPlayer] Frame ${this.frameCount} - Frame spec:`, { width, height, format });
-      }
-
       // Get frame buffer with validation
       let src: Uint8Array;
       try {
-        // TODO: Replace with new emulator core getFrameBuffer method
-        src = this.core.getFrameBuffer();
+        if (this.core.getLatestFrame) {
+          // Multi-buffered core: read the completed slot in place, skip repeats
+          const latest = this.core.getLatestFrame();
+          if (latest.sequence === this.lastFrameSequence) {
+            if (TRACE_ENABLED) traceSampled(TraceEvents.FRAME_REPEATED, this.frameCount, latest.sequence);
+            return;
+          }
+          this.lastFrameSequence = latest.sequence;
+          src = latest.buffer;
+        } else {
+          src = this.core.getFrameBuffer();
+        }
       } catch (error) {
         console.error('[NesPlayer] Failed to get frame buffer:', error);
         return; // Skip this frame
@@ -208,15 +109,11 @@ export class NesPlayer {
         return; // Skip this frame
       }
 
-      // Debug logging for frame buffer
-      if (ENABLE_FRAME_DEBUG_LOGS && this.frameCount <= 3) {
-        this.logFrameBufferPreview(src);
-      }
-
       // Calculate expected buffer size based on format
       const expectedSize = this.calculateExpectedBufferSize(width, height, format);
 
       if (src.length !== expectedSize) {
+        if (TRACE_ENABLED) trace(TraceEvents.SIZE_MISMATCH, expectedSize, src.length);
         console.error('[NesPlayer] Frame buffer size mismatch:', {
           format,
           expected: expectedSize,
@@ -232,19 +129,21 @@ export class NesPlayer {
         }
       }
 
-      // Method 1: Try new ImageData constructor (preferred method)
+      // Method 1: ImageData backed directly by the core's frame buffer (preferred method)
       let imageData: ImageData | undefined;
       let conversionNeeded = false;
 
       if (format === 'RGBA32' && src.length === expectedSize) {
         try {
-          // Direct ImageData creation from frame buffer
-          imageData = new ImageData(new Uint8ClampedArray(src), width, height);
-
-          if (ENABLE_FRAME_DEBUG_LOGS && this.frameCount <= 3) {
-            console.log('[NesPlayer] ✅ Using direct ImageData constructor');
-            this.verifyImageData(imageData, src);
+          // Cores hand out the same view per frame slot until wasm memory grows,
+          // so the ImageData wrapping it is created once and reused (no copy, no allocation)
+          imageData = this.frameImages.get(src);
+          if (!imageData || imageData.width !== width || imageData.height !== height) {
+            imageData = new ImageData(new Uint8ClampedArray(src.buffer as ArrayBuffer, src.byteOffset, src.length), width, height);
+            this.frameImages.set(src, imageData);
           }
+
+          if (TRACE_ENABLED) traceSampled(TraceEvents.BLIT_DIRECT, this.frameCount, width, height);
         } catch (error) {
           console.warn('[NesPlayer] Direct ImageData creation failed, falling back to manual method:', error);
           conversionNeeded = true;
@@ -258,9 +157,7 @@ export class NesPlayer {
         // Create or recreate ImageData if dimensions changed
         if (!this.imageData || this.imageData.width !== width || this.imageData.height !== height) {
           this.imageData = this.ctx.createImageData(width, height);
-          if (ENABLE_FRAME_DEBUG_LOGS) {
-            console.log('[NesPlayer] Created new ImageData via context:', width, 'x', height);
-          }
+          this.imagePixels = new Uint32Array(this.imageData.data.buffer);
         }
 
         const dst = this.imageData.data; // Uint8ClampedArray (RGBA format)
@@ -269,10 +166,7 @@ export class NesPlayer {
         this.convertToRGBA(src, dst, format);
         imageData = this.imageData;
 
-        if (ENABLE_FRAME_DEBUG_LOGS && this.frameCount <= 3) {
-          console.log('[NesPlayer] ✅ Using manual conversion method');
-          this.verifyImageData(imageData, src);
-        }
+        if (TRACE_ENABLED) traceSampled(TraceEvents.BLIT_CONVERTED, this.frameCount, width, height);
       }
 
       // Ensure imageData is defined before drawing
@@ -281,26 +175,8 @@ export class NesPlayer {
         return;
       }
 
-      // Verify canvas state before drawing
-      if (ENABLE_FRAME_DEBUG_LOGS && this.frameCount <= 3) {
-        console.log('[NesPlayer] Pre-draw canvas state:', {
-          imageSmoothingEnabled: this.ctx.imageSmoothingEnabled,
-          globalAlpha: this.ctx.globalAlpha,
-          globalCompositeOperation: this.ctx.globalCompositeOperation
-        });
-      }
-
       // Draw to canvas
       this.ctx.putImageData(imageData, 0, 0);
-
-      if (ENABLE_FRAME_DEBUG_LOGS && this.frameCount <= 3) {
-        console.log(`[NesPlayer] ✅ Frame ${this.frameCount} rendered to canvas`);
-
-        // Verify what was actually drawn by reading back a pixel
-        const readback = this.ctx.getImageData(128, 120, 1, 1); // Center pixel
-        console.log('[NesPlayer] Center pixel readback:', Array.from(readback.data));
-      }
-
     } catch (error) {
       console.error('[NesPlayer] Blit error:', error);
     }
@@ -312,7 +188,10 @@ export class NesPlayer {
   private calculateExpectedBufferSize(width: number, height: number, format: PixelFormat): number {
     switch (format) {
       case 'RGBA32':
+      case 'BGRA32':
         return width * height * 4;
+      case 'RGB565':
+        return width * height * 2;
       case 'RGB24':
         return width * height * 3;
       case 'INDEXED8':
@@ -332,6 +211,33 @@ export class NesPlayer {
         dst.set(src);
         break;
 
+      case 'BGRA32': {
+        // Swap red and blue channels
+        for (let i = 0; i < src.length; i += 4) {
+          dst[i] = src[i + 2];
+          dst[i + 1] = src[i + 1];
+          dst[i + 2] = src[i];
+          dst[i + 3] = src[i + 3];
+        }
+        break;
+      }
+
+      case 'RGB565': {
+        // Expand 5/6/5-bit channels to 8 bits (little-endian 16-bit pixels)
+        let dstIndex = 0;
+        for (let i = 0; i < src.length; i += 2) {
+          const pixel = src[i] | (src[i + 1] << 8);
+          const r = (pixel >> 11) & 0x1F;
+          const g = (pixel >> 5) & 0x3F;
+          const b = pixel & 0x1F;
+          dst[dstIndex++] = (r << 3) | (r >> 2);
+          dst[dstIndex++] = (g << 2) | (g >> 4);
+          dst[dstIndex++] = (b << 3) | (b >> 2);
+          dst[dstIndex++] = 255;
+        }
+        break;
+      }
+
       case 'RGB24': {
         // Convert RGB24 to RGBA32 (add alpha channel)
         let srcIndex = 0;
@@ -346,13 +252,19 @@ export class NesPlayer {
       }
 
       case 'INDEXED8': {
+        // Let the core expand with its full palette, emphasis included
+        if (this.core.expandIndexed) {
+          this.core.expandIndexed(this.imagePixels!, src, this.core.getEmphasis?.() ?? 0);
+          break;
+        }
+
         // Convert indexed color using palette
         const palette = this.core.getPalette?.();
         if (!palette) {
           throw new Error('INDEXED8 format requires palette from core');
         }
 
-        this.convertIndexedToRGBA(src, dst, palette);
+        this.convertIndexedToRGBA(src, this.imagePixels!, palette);
         break;
       }
 
@@ -362,92 +274,85 @@ export class NesPlayer {
   }
 
   /**
-   * Convert indexed color data to RGBA using palette
+   * Convert indexed color data to RGBA using palette.
+   * Fallback for cores without expandIndexed(): emphasis is not applied. The
+   * palette is packed once into a 32-bit LUT and each pixel becomes a single
+   * lookup and store.
    */
   private convertIndexedToRGBA(
     src: Uint8Array,
-    dst: Uint8ClampedArray,
+    dst32: Uint32Array,
     palette: Uint8Array | Uint32Array
   ): void {
-    const isUint32Palette = palette instanceof Uint32Array;
-    let dstIndex = 0;
+    if (this.indexedLutSource !== palette) {
+      this.indexedLut = this.buildIndexedLut(palette);
+      this.indexedLutSource = palette;
+    }
 
+    const lut = this.indexedLut!;
     for (let i = 0; i < src.length; i++) {
-      const colorIndex = src[i] & 0xFF;
-
-      if (isUint32Palette) {
-        // Uint32Array palette (packed RGBA)
-        const rgba = palette[colorIndex];
-        // Assume little-endian RGBA format
-        dst[dstIndex++] = (rgba >>> 0) & 0xFF;  // R
-        dst[dstIndex++] = (rgba >>> 8) & 0xFF;  // G
-        dst[dstIndex++] = (rgba >>> 16) & 0xFF; // B
-        dst[dstIndex++] = (rgba >>> 24) & 0xFF; // A
-      } else {
-        // Uint8Array palette (separate RGBA bytes)
-        const baseIndex = colorIndex * 4;
-        dst[dstIndex++] = palette[baseIndex + 0] || 0;     // R
-        dst[dstIndex++] = palette[baseIndex + 1] || 0;     // G
-        dst[dstIndex++] = palette[baseIndex + 2] || 0;     // B
-        dst[dstIndex++] = palette[baseIndex + 3] || 255;   // A
+      dst32[i] = lut[src[i]];
+    }
+  }
+
+  /**
+   * Pack a palette into a 256-entry little-endian RGBA LUT
+   */
+  private buildIndexedLut(palette: Uint8Array | Uint32Array): Uint32Array {
+    const lut = new Uint32Array(256);
+
+    if (palette instanceof Uint32Array) {
+      // Packed RGBA entries; mirror if the palette has fewer than 256 colors
+      for (let i = 0; i < 256; i++) {
+        lut[i] = palette[i % palette.length];
+      }
+    } else {
+      // Separate RGBA bytes
+      const colors = palette.length >> 2;
+      for (let i = 0; i < 256; i++) {
+        const base = (i % colors) * 4;
+        lut[i] = (palette[base] | (palette[base + 1] << 8) | (palette[base + 2] << 16) | ((palette[base + 3] || 255) << 24)) >>> 0;
       }
     }
+
+    return lut;
+  }
+
+  /**
+   * Replace what runs each emulated frame, e.g. a netplay session's advance()
+   * in place of core.frame()
+   * @param step Called once per frame; null restores core.frame()
+   */
+  setFrameStep(step: (() => void) | null): void {
+    this.step = step ?? (() => this.core.frame());
   }
 
   /**
    * Start the game loop
-   * TODO: Update to work with new emulator core
    */
   play(): void {
-    if (this.rafId !== null) {
+    if (this.isPlaying) {
       console.log('[NesPlayer] Already playing, ignoring play() call');
       return;
     }
 
     console.log('[NesPlayer] Starting game loop');
     this.isPlaying = true;
-    // TODO: Replace with new emulator core setRunning method
-    // this.core.setRunning(true);
-
-    const gameLoop = () => {
-      if (!this.isPlaying) {
-        return; // Exit loop if stopped
-      }
-
-      try {
-        // TODO: Replace with new emulator core frame method
-        // Advance emulator by one frame
-        // this.core.frame();
-
-        // Render frame to canvas (keep canvas rendering logic)
-        this.blit();
-
-        // Schedule next frame
-        this.rafId = requestAnimationFrame(gameLoop);
-      } catch (error) {
-        console.error('[NesPlayer] Game loop error:', error);
-        this.pause(); // Stop on error
-      }
-    };
-
-    // Start the loop
-    this.rafId = requestAnimationFrame(gameLoop);
+    this.core.setRunning(true);
+    this.frameTimer.start();
   }
 
   /**
    * Pause the game loop
-   * TODO: Update to work with new emulator core
    */
   pause(): void {
-    if (this.rafId !== null) {
+    if (this.isPlaying) {
       console.log('[NesPlayer] Pausing game loop');
-      cancelAnimationFrame(this.rafId);
-      this.rafId = null;
     }
 
+    this.frameTimer.stop();
     this.isPlaying = false;
-    // TODO: Replace with new emulator core setRunning method
-    // this.core.setRunning(false);
+    this.core.setRunning(false);
   }
 
   /**
@@ -479,6 +384,8 @@ export class NesPlayer {
 
     // Clear image data
     this.imageData = undefined;
+    this.imagePixels = undefined;
+    this.frameImages = new WeakMap();
 
     console.log('[NesPlayer] Player disposed successfully');
   }
@@ -0,0 +1,65 @@
+import { describe, it, expect } from 'vitest';
+import { SampleRing } from './SampleRing';
+
+describe('SampleRing', () => {
+  it('rounds capacity up to a power of two', () => {
+    expect(new SampleRing(1000).capacity).toBe(1024);
+  });
+
+  it('reads frames back in order into planar channels', () => {
+    const ring = new SampleRing(8);
+    ring.write(new Float32Array([0.1, -0.1, 0.2, -0.2, 0.3, -0.3]));
+
+    const left = new Float32Array(2);
+    const right = new Float32Array(2);
+    expect(ring.read(left, right)).toBe(2);
+    expect(Array.from(left)).toEqual([Math.fround(0.1), Math.fround(0.2)]);
+    expect(Array.from(right)).toEqual([Math.fround(-0.1), Math.fround(-0.2)]);
+    expect(ring.available()).toBe(1);
+  });
+
+  it('drops frames that do not fit instead of overwriting unread ones', () => {
+    const ring = new SampleRing(4);
+    expect(ring.writeInt16(new Int16Array([1, 2, 3, 4, 5, 6]))).toBe(4);
+    expect(ring.available()).toBe(4);
+
+    const left = new Float32Array(4);
+    const right = new Float32Array(4);
+    ring.read(left, right);
+    expect(Array.from(left)).toEqual([1, 2, 3, 4].map(v => v / 32768));
+    expect(Array.from(right)).toEqual(Array.from(left));
+  });
+
+  it('publishes staged frames only on commit', () => {
+    const ring = new SampleRing(4);
+    expect(ring.stage(0, 0.5, 0.5)).toBe(true);
+    expect(ring.stage(1, 0.25, 0.25)).toBe(true);
+    expect(ring.available()).toBe(0);
+
+    ring.commit(2);
+    expect(ring.available()).toBe(2);
+  });
+
+  it('wraps around the end of the buffer', () => {
+    const ring = new SampleRing(4);
+    const left = new Float32Array(3);
+    const right = new Float32Array(3);
+    for (let round = 0; round < 5; round++) {
+      ring.write(new Float32Array([round, 0, round + 0.5, 0, round + 0.25, 0]));
+      expect(ring.read(left, right)).toBe(3);
+      expect(Array.from(left)).toEqual([round, round + 0.5, round + 0.25]);
+    }
+  });
+
+  it('shares state between two instances over a SharedArrayBuffer', () => {
+    const writer = new SampleRing(16, true);
+    const reader = new SampleRing(writer.buffer);
+    writer.writeInt16(new Int16Array([16384, -16384]));
+
+    const left = new Float32Array(2);
+    const right = new Float32Array(2);
+    expect(reader.read(left, right)).toBe(2);
+    expect(Array.from(left)).toEqual([0.5, -0.5]);
+    expect(writer.available()).toBe(0);
+  });
+});
@@ -0,0 +1,122 @@
+/**
+ * Sample Ring
+ *
+ * Lock-free single-producer/single-consumer ring of interleaved stereo Float32
+ * samples. The emulator thread only moves the write index and the audio thread
+ * only moves the read index, so over a SharedArrayBuffer the two sides need no
+ * locks or messages. The same class runs over a plain ArrayBuffer when shared
+ * memory is unavailable (the page is not cross-origin isolated).
+ */
+
+const READ_INDEX = 0;
+const WRITE_INDEX = 1;
+const HEADER_BYTES = 8;
+const CHANNELS = 2;
+
+export class SampleRing {
+  readonly capacity: number;        // Stereo frames (power of two)
+  readonly buffer: ArrayBuffer | SharedArrayBuffer;
+  private state: Int32Array;        // Read and write indices, in frames
+  private data: Float32Array;
+  private mask: number;
+
+  /**
+   * @param capacityOrBuffer Frames to allocate (rounded up to a power of two),
+   *   or an existing ring buffer to attach to (e.g. received by the worklet)
+   * @param shared Allocate in a SharedArrayBuffer
+   */
+  constructor(capacityOrBuffer: number | ArrayBuffer | SharedArrayBuffer, shared = false) {
+    if (typeof capacityOrBuffer === 'number') {
+      let capacity = 1;
+      while (capacity < capacityOrBuffer) capacity <<= 1;
+      const bytes = HEADER_BYTES + capacity * CHANNELS * 4;
+      this.buffer = shared ? new SharedArrayBuffer(bytes) : new ArrayBuffer(bytes);
+    } else {
+      this.buffer = capacityOrBuffer;
+    }
+
+    this.state = new Int32Array(this.buffer, 0, 2);
+    this.data = new Float32Array(this.buffer, HEADER_BYTES);
+    this.capacity = this.data.length / CHANNELS;
+    this.mask = this.capacity - 1;
+  }
+
+  /**
+   * Frames written but not yet read
+   */
+  available(): number {
+    return (Atomics.load(this.state, WRITE_INDEX) - Atomics.load(this.state, READ_INDEX)) | 0;
+  }
+
+  /**
+   * Write interleaved stereo frames; frames that do not fit are dropped.
+   * @returns Frames written
+   */
+  write(samples: Float32Array, frames = samples.length / CHANNELS): number {
+    const write = Atomics.load(this.state, WRITE_INDEX);
+    const count = Math.min(frames, this.capacity - ((write - Atomics.load(this.state, READ_INDEX)) | 0));
+    for (let i = 0; i < count; i++) {
+      const pos = ((write + i) & this.mask) * CHANNELS;
+      this.data[pos] = samples[i * CHANNELS];
+      this.data[pos + 1] = samples[i * CHANNELS + 1];
+    }
+    Atomics.store(this.state, WRITE_INDEX, (write + count) | 0);
+    return count;
+  }
+
+  /**
+   * Write mono signed 16-bit samples (as produced by the C core) to both channels
+   * @returns Frames written
+   */
+  writeInt16(samples: Int16Array): number {
+    const write = Atomics.load(this.state, WRITE_INDEX);
+    const count = Math.min(samples.length, this.capacity - ((write - Atomics.load(this.state, READ_INDEX)) | 0));
+    for (let i = 0; i < count; i++) {
+      const pos = ((write + i) & this.mask) * CHANNELS;
+      const value = samples[i] / 32768;
+      this.data[pos] = value;
+      this.data[pos + 1] = value;
+    }
+    Atomics.store(this.state, WRITE_INDEX, (write + count) | 0);
+    return count;
+  }
+
+  /**
+   * Write one stereo frame without publishing it; call commit() afterwards.
+   * For producers that deliver a sample at a time.
+   * @returns false if the ring is full
+   */
+  stage(offset: number, left: number, right: number): boolean {
+    const write = Atomics.load(this.state, WRITE_INDEX) + offset;
+    if (((write - Atomics.load(this.state, READ_INDEX)) | 0) >= this.capacity) {
+      return false;
+    }
+    const pos = (write & this.mask) * CHANNELS;
+    this.data[pos] = left;
+    this.data[pos + 1] = right;
+    return true;
+  }
+
+  /**
+   * Publish frames written with stage()
+   */
+  commit(frames: number): void {
+    Atomics.store(this.state, WRITE_INDEX, (Atomics.load(this.state, WRITE_INDEX) + frames) | 0);
+  }
+
+  /**
+   * Read up to `left.length` frames into planar channel arrays
+   * @returns Frames read; the rest of the outputs are left untouched
+   */
+  read(left: Float32Array, right: Float32Array): number {
+    const read = Atomics.load(this.state, READ_INDEX);
+    const count = Math.min(left.length, (Atomics.load(this.state, WRITE_INDEX) - read) | 0);
+    for (let i = 0; i < count; i++) {
+      const pos = ((read + i) & this.mask) * CHANNELS;
+      left[i] = this.data[pos];
+      right[i] = this.data[pos + 1];
+    }
+    Atomics.store(this.state, READ_INDEX, (read + count) | 0);
+    return count;
+  }
+}
@@ -1,92 +1,191 @@
-import RingBuffer from "ringbufferjs";
 import { handleError } from "../utils/errorUtils";
+import { SampleRing } from "./SampleRing";
+import processorUrl from "./speakersProcessor.ts?worker&url";
+import type { SpeakersProcessorOptions } from "./speakersProcessor";
 
 type SpeakersOptions = {
   onBufferUnderrun?: (currentSize: number, requiredSize: number) => void;
 };
 
+const RING_FRAMES = 8192;   // Stereo frames buffered between emulator and audio thread
+const COMMIT_FRAMES = 64;   // writeSample() publishes to the shared ring in batches
+const POST_FRAMES = 512;    // Batch size when samples are posted instead of shared
+
+/**
+ * Audio output through an AudioWorklet.
+ *
+ * When the page is cross-origin isolated, samples go into a SharedArrayBuffer
+ * ring that the worklet reads directly, with no main-thread work per audio
+ * callback. Otherwise they are transferred to the worklet in batches.
+ */
 export default class Speakers {
-  private bufferSize: number;
-  private buffer: RingBuffer<number>;
+  private ring: SampleRing | null = null;    // Shared ring, if shared memory is available
+  private staged = 0;                        // Frames written to the ring but not yet published
+  private chunk: Float32Array | null = null; // Posted mode: batch being filled
+  private chunkFrames = 0;
+  private postedFrames = 0;
+  private consumedFrames = 0;
   private audioCtx: AudioContext | null = null;
-  private scriptNode: ScriptProcessorNode | null = null;
+  private node: AudioWorkletNode | null = null;
+  private moduleLoaded: Promise<void> | null = null;
+  private running = false;
   private onBufferUnderrun?: (currentSize: number, requiredSize: number) => void;
 
   constructor({ onBufferUnderrun }: SpeakersOptions) {
     this.onBufferUnderrun = onBufferUnderrun;
-    this.bufferSize = 8192;
-    this.buffer = new RingBuffer(this.bufferSize * 2);
+    if (typeof SharedArrayBuffer !== "undefined" && window.crossOriginIsolated) {
+      this.ring = new SampleRing(RING_FRAMES, true);
+    }
   }
 
-  getSampleRate(): number {
+  /**
+   * The single AudioContext used for the device rate and for playback.
+   * It is created on first use and only suspended by stop().
+   */
+  private getContext(): AudioContext | null {
     if (!window.AudioContext) {
-      return 44100;
+      return null;
     }
-    const myCtx = new window.AudioContext();
-    const sampleRate = myCtx.sampleRate;
-    myCtx.close();
-    return sampleRate;
+    if (!this.audioCtx) {
+      this.audioCtx = new window.AudioContext();
+    }
+    return this.audioCtx;
+  }
+
+  getSampleRate(): number {
+    return this.getContext()?.sampleRate ?? 44100;
+  }
+
+  /**
+   * Samples (per channel) waiting to be played, for dynamic rate control
+   */
+  getBufferFill(): { queued: number; capacity: number } {
+    const queued = this.ring
+      ? this.ring.available() + this.staged
+      : this.postedFrames - this.consumedFrames + this.chunkFrames;
+    return { queued, capacity: RING_FRAMES };
+  }
+
+  /**
+   * Whether the worklet is connected and the context is consuming samples
+   */
+  isPlaying(): boolean {
+    return this.running && this.node !== null && this.audioCtx?.state === "running";
   }
 
   start(): void {
-    if (!window.AudioContext) return;
+    const audioCtx = this.getContext();
+    if (!audioCtx || this.running) return;
+
+    if (!audioCtx.audioWorklet) {
+      console.warn("[Speakers] AudioWorklet unavailable (insecure context?), audio disabled");
+      return;
+    }
+
+    this.running = true;
+    this.moduleLoaded ??= audioCtx.audioWorklet.addModule(processorUrl);
+    this.moduleLoaded
+      .then(() => {
+        if (!this.running || this.audioCtx !== audioCtx) return;
 
-    this.audioCtx = new window.AudioContext();
-    this.scriptNode = this.audioCtx.createScriptProcessor(1024, 0, 2);
-    this.scriptNode.onaudioprocess = this.onaudioprocess;
-    this.scriptNode.connect(this.audioCtx.destination);
+        if (!this.node) {
+          const processorOptions: SpeakersProcessorOptions = {
+            ring: this.ring?.buffer as SharedArrayBuffer | undefined,
+            capacity: RING_FRAMES,
+          };
+          this.node = new AudioWorkletNode(audioCtx, "nes-speakers", {
+            numberOfInputs: 0,
+            outputChannelCount: [2],
+            processorOptions,
+          });
+          this.node.port.onmessage = this.onProcessorMessage;
+        }
+        this.node.connect(audioCtx.destination);
+      })
+      .catch(handleError);
+    audioCtx.resume().catch(handleError);
   }
 
   stop(): void {
-    if (this.scriptNode && this.audioCtx) {
-      this.scriptNode.disconnect(this.audioCtx.destination);
-      this.scriptNode.onaudioprocess = null;
-      this.scriptNode = null;
+    this.running = false;
+
+    if (this.node) {
+      this.node.disconnect();
+    }
+
+    if (this.audioCtx) {
+      this.audioCtx.suspend().catch(handleError);
     }
+  }
 
+  /**
+   * Stop playback and release the AudioContext
+   */
+  close(): void {
+    this.stop();
+    if (this.node) {
+      this.node.port.onmessage = null;
+      this.node = null;
+    }
     if (this.audioCtx) {
       this.audioCtx.close().catch(handleError);
       this.audioCtx = null;
+      this.moduleLoaded = null;
     }
   }
 
   writeSample = (left: number, right: number): void => {
-    if (this.buffer.size() / 2 >= this.bufferSize) {
-      console.log("Buffer overrun");
-      this.buffer.deqN(this.bufferSize / 2);
+    if (this.ring) {
+      // Full ring: drop the new frame; only the audio thread may advance the read index
+      if (!this.ring.stage(this.staged, left, right)) return;
+      if (++this.staged >= COMMIT_FRAMES) {
+        this.ring.commit(this.staged);
+        this.staged = 0;
+      }
+      return;
     }
-    this.buffer.enq(left);
-    this.buffer.enq(right);
-  };
 
-  onaudioprocess = (e: AudioProcessingEvent): void => {
-    const left = e.outputBuffer.getChannelData(0);
-    const right = e.outputBuffer.getChannelData(1);
-    const size = left.length;
-
-    if (this.buffer.size() < size * 2 && this.onBufferUnderrun) {
-      this.onBufferUnderrun(this.buffer.size(), size * 2);
+    const chunk = (this.chunk ??= new Float32Array(POST_FRAMES * 2));
+    chunk[this.chunkFrames * 2] = left;
+    chunk[this.chunkFrames * 2 + 1] = right;
+    if (++this.chunkFrames === POST_FRAMES) {
+      this.postChunk();
     }
+  };
 
-    let samples: number[];
-
-    try {
-      samples = this.buffer.deqN(size * 2) as number[];
-    } catch {
-      const bufferSize = this.buffer.size() / 2;
-      if (bufferSize > 0) {
-        console.log(`Buffer underrun (needed ${size}, got ${bufferSize})`);
-      }
-      for (let j = 0; j < size; j++) {
-        left[j] = 0;
-        right[j] = 0;
-      }
+  /**
+   * Write mono signed 16-bit samples, as produced by the C core's getAudioBuffer()
+   */
+  writeSamples(samples: Int16Array): void {
+    if (this.ring) {
+      this.ring.commit(this.staged);
+      this.staged = 0;
+      this.ring.writeInt16(samples);
       return;
     }
+    for (let i = 0; i < samples.length; i++) {
+      const value = samples[i] / 32768;
+      this.writeSample(value, value);
+    }
+  }
+
+  private postChunk(): void {
+    const queued = this.postedFrames - this.consumedFrames;
+    if (this.node && this.running && queued + this.chunkFrames <= RING_FRAMES && this.chunk) {
+      this.node.port.postMessage(this.chunk, [this.chunk.buffer]);
+      this.postedFrames += this.chunkFrames;
+      this.chunk = null;
+    }
+    // Not playing or the worklet is full: the batch is dropped and its array reused
+    this.chunkFrames = 0;
+  }
 
-    for (let i = 0; i < size; i++) {
-      left[i] = samples[i * 2];
-      right[i] = samples[i * 2 + 1];
+  private onProcessorMessage = (e: MessageEvent): void => {
+    const message = e.data as { type: string; frames?: number; required?: number };
+    if (message.type === "consumed") {
+      this.consumedFrames += message.frames ?? 0;
+    } else if (message.type === "underrun" && this.onBufferUnderrun) {
+      this.onBufferUnderrun(this.getBufferFill().queued, message.required ?? 0);
     }
   };
-}
\ No newline at end of file
+}
@@ -0,0 +1,72 @@
+/**
+ * Speakers AudioWorklet processor
+ *
+ * Runs on the audio rendering thread and plays samples from a SampleRing.
+ * With shared memory the ring is the emulator's own SharedArrayBuffer and
+ * nothing is posted per callback; otherwise the main thread transfers
+ * batches of samples that are queued in a local ring.
+ */
+
+import { SampleRing } from './SampleRing';
+
+// AudioWorkletGlobalScope members (not part of the DOM lib)
+declare const registerProcessor: (name: string, processor: unknown) => void;
+declare class AudioWorkletProcessor {
+  readonly port: MessagePort;
+  constructor(options?: AudioWorkletNodeOptions);
+}
+
+export interface SpeakersProcessorOptions {
+  ring?: SharedArrayBuffer;   // Shared ring written by the emulator
+  capacity: number;           // Local ring size when samples are posted instead
+}
+
+const CONSUMED_REPORT_FRAMES = 1024;  // Posted-mode fill level report interval
+
+class SpeakersProcessor extends AudioWorkletProcessor {
+  private ring: SampleRing;
+  private shared: boolean;
+  private starved = false;
+  private consumed = 0;
+
+  constructor(options: AudioWorkletNodeOptions) {
+    super(options);
+    const { ring, capacity } = options.processorOptions as SpeakersProcessorOptions;
+    this.shared = ring !== undefined;
+    this.ring = new SampleRing(ring ?? capacity);
+
+    if (!this.shared) {
+      this.port.onmessage = (e: MessageEvent<Float32Array>) => {
+        this.ring.write(e.data);
+      };
+    }
+  }
+
+  process(_inputs: Float32Array[][], outputs: Float32Array[][]): boolean {
+    const [left, right] = outputs[0];
+    const frames = this.ring.read(left, right);
+
+    if (frames < left.length) {
+      left.fill(0, frames);
+      right.fill(0, frames);
+      // Report only the start of an underrun, not every starved callback
+      if (!this.starved) {
+        this.port.postMessage({ type: 'underrun', available: frames, required: left.length });
+      }
+      this.starved = true;
+    } else {
+      this.starved = false;
+    }
+
+    if (!this.shared) {
+      this.consumed += frames;
+      if (this.consumed >= CONSUMED_REPORT_FRAMES) {
+        this.port.postMessage({ type: 'consumed', frames: this.consumed });
+        this.consumed = 0;
+      }
+    }
+    return true;
+  }
+}
+
+registerProcessor('nes-speakers', SpeakersProcessor);
@@ -0,0 +1,605 @@
+/**
+ * WASM Core Adapter
+ *
+ * Implements the NesCore interface on top of the C core (scripts/fceux-simple.c)
+ * compiled to WebAssembly by scripts/compile-c-wasm.sh and loaded through the
+ * build's FCEUXModule factory. All frame data stays in core memory; the adapter only
+ * creates views onto it, and re-creates them only when getMemoryEpoch() reports
+ * that wasm memory grew. Steady-state frames allocate nothing on the JS side.
+ */
+
+import { NesCore, CoreStats, FrameSpec, InputMode, LatestFrame, PixelFormat, RUN_FRAMES_PORTS, RunFramesOptions } from '../NesCore';
+import { loadEmscriptenModule } from './wasmLoader';
+import { TRACE_ENABLED, TRACE_RING_SIZE_CORE, readCoreTrace } from '../utils/trace';
+
+/**
+ * Pixel format codes understood by setPixelFormat() (see PIXEL_FORMAT_* in the C core)
+ */
+export const PIXEL_FORMAT_CODES: Partial<Record<PixelFormat, number>> = {
+  RGBA32: 0,
+  BGRA32: 1,
+  RGB565: 2,
+  INDEXED8: 3,
+};
+
+const PIXEL_FORMAT_NAMES: PixelFormat[] = ['RGBA32', 'BGRA32', 'RGB565', 'INDEXED8'];
+
+// Room for getStatePageHashes() output (the core writes 73 hashes)
+const PAGE_HASHES_BYTES = 512;
+
+/**
+ * Input mode codes understood by setInputMode() (see INPUT_MODE_* in the C core)
+ */
+const INPUT_MODE_CODES: Record<InputMode, number> = {
+  'standard': 0,
+  'four-score': 1,
+  'zapper': 2,
+};
+
+// runFrames() flags (see RUN_FRAMES_* in the C core)
+const RUN_FRAMES_VIDEO_LAST = 0x01;
+const RUN_FRAMES_AUDIO_LAST = 0x02;
+
+export interface WasmCoreExports {
+  memory: WebAssembly.Memory;
+  init: () => number;
+  loadRom: (romPtr: number, romSize: number) => number;
+  getRomBuffer: () => number;
+  getRomBufferSize: () => number;
+  frame: () => void;
+  reset: () => void;
+  setButton: (button: number, pressed: number) => void;
+  setRunning: (running: number) => void;
+  getFrameBuffer: () => number;
+  getFrameBufferSize: () => number;
+  getLatestFrame: () => number;
+  getFrameSequences: () => number;
+  getFrameBufferAt: (index: number) => number;
+  setFrameBufferCount: (count: number) => number;
+  getMemoryEpoch: () => number;
+  getFrameSpec: () => number;
+  setPixelFormat: (format: number) => number;
+  setOverscanCrop: (enabled: number) => void;
+  getPalette: () => number;
+  loadPalette: (dataPtr: number, size: number) => number;
+  expandIndexed: (dstPtr: number, srcPtr: number, count: number, emphasis: number) => void;
+  getEmphasis: () => number;
+  cpuRead: (addr: number) => number;
+  cpuWrite: (addr: number, value: number) => void;
+  setSampleRate: (rate: number) => number;
+  getAudioBuffer: () => number;
+  getAudioSampleCount: () => number;
+  setAudioBufferFill: (queued: number, capacity: number) => number;
+  setAudioEnabled: (enabled: number) => void;
+  setSpeed: (multiplier: number) => number;
+  saveStateSize: () => number;
+  saveState: (outPtr: number) => number;
+  loadState: (dataPtr: number, size: number) => number;
+  takeSnapshot: () => number;
+  restoreSnapshot: (id: number) => number;
+  getCoreStats: () => number;
+  setRewindBudget: (bytes: number) => number;
+  rewindStep: () => number;
+  setRunAhead: (frames: number) => number;
+  setPortButtons: (port: number, mask: number) => void;
+  setButtons: (masksPtr: number) => void;
+  runFrames: (count: number, inputsPtr: number, flags: number) => number;
+  setInputMode: (mode: number) => number;
+  setVideoEnabled: (enabled: number) => void;
+  queueInputs: (eventsPtr: number, count: number) => number;
+  getFrameCount: () => number;
+  getLagFrames: () => number;
+  getLagFrameCount: () => number;
+  getRomHash: () => number;
+  getStateHash: () => number;
+  getStatePageHashes: (outPtr: number) => number;
+  saveStatePatch: (peerHashesPtr: number, outPtr: number) => number;
+  setTileEncoder: (enabled: number) => void;
+  tilePacketMaxSize: () => number;
+  encodeTileFrame: (outPtr: number, keyframe: number) => number;
+  decodeTileFrame: (packetPtr: number, size: number) => number;
+  malloc: (size: number) => number;
+  free: (ptr: number) => void;
+  // Only present in DEBUG=1 builds (-DNES_TRACE)
+  getTraceBuffer?: () => number;
+  getTraceHead?: () => number;
+}
+
+// Functions the adapter calls, without the `_` emscripten adds (see EXPORTS in
+// scripts/compile-c-wasm.sh)
+const CORE_EXPORTS: (keyof WasmCoreExports)[] = [
+  'init', 'loadRom', 'getRomBuffer', 'getRomBufferSize', 'frame', 'reset', 'setButton', 'setRunning',
+  'getFrameBuffer', 'getFrameBufferSize', 'getLatestFrame', 'getFrameSequences', 'getFrameBufferAt',
+  'setFrameBufferCount', 'getMemoryEpoch', 'getFrameSpec', 'setPixelFormat', 'setOverscanCrop',
+  'getPalette', 'loadPalette', 'expandIndexed', 'getEmphasis', 'cpuRead', 'cpuWrite', 'setSampleRate', 'getAudioBuffer',
+  'getAudioSampleCount', 'setAudioBufferFill', 'setAudioEnabled', 'setSpeed', 'saveStateSize', 'saveState',
+  'loadState', 'takeSnapshot', 'restoreSnapshot', 'getCoreStats', 'setRewindBudget', 'rewindStep',
+  'setRunAhead', 'setPortButtons', 'setButtons', 'runFrames', 'setInputMode', 'setVideoEnabled',
+  'queueInputs', 'getFrameCount', 'getLagFrames', 'getLagFrameCount', 'getRomHash', 'getStateHash',
+  'getStatePageHashes', 'saveStatePatch', 'setTileEncoder', 'tilePacketMaxSize', 'encodeTileFrame',
+  'decodeTileFrame', 'malloc', 'free',
+];
+
+export class WasmCoreAdapter implements NesCore {
+  private exports: WasmCoreExports | null = null;
+
+  // Views onto core memory, valid for one memory epoch
+  private memoryEpoch = -1;
+  private heapU32 = new Uint32Array(0);
+  private slotViews = new Map<number, Uint8Array>();
+  private audioViews = new Map<number, Int16Array>();  // Keyed by sample count
+  private paletteView: Uint32Array | null = null;
+
+  // Scratch block in core memory for savestates and input batches, grown on demand and kept
+  private statePtr = 0;
+  private stateCapacity = 0;
+
+  // Scratch block for expandIndexed(): RGBA output, then the indices when they are not in core memory
+  private expandPtr = 0;
+  private expandCapacity = 0;
+
+  // Reused result objects (callers must not hold on to them across frames)
+  private latest: LatestFrame = { index: 0, sequence: 0, buffer: new Uint8Array(0) };
+  private spec: FrameSpec = { width: 256, height: 240, format: 'RGBA32' };
+  private stats: CoreStats = {
+    snapshots: 0,
+    snapshotPages: 0,
+    snapshotBytes: 0,
+    snapshotMicros: 0,
+    restoreMicros: 0,
+    snapshotsHeld: 0,
+    snapshotPoolBytes: 0,
+    rewindStates: 0,
+    rewindFrames: 0,
+    rewindBytes: 0,
+    rewindStateBytes: 0,
+    rewindMicros: 0,
+    runAhead: 0,
+    runAheadFrameMicros: 0,
+    runAheadStateMicros: 0,
+  };
+
+  /**
+   * @param scriptUrl The emscripten glue of a compile-c-wasm.sh build; its
+   *        fceux-c.wasm is loaded from the same directory
+   */
+  constructor(private scriptUrl = '/wasm/fceux-c.js') {}
+
+  async init(): Promise<boolean> {
+    // The .wasm only exports minified names and imports the glue's runtime, so
+    // it is instantiated by the generated factory, not directly
+    const wasmModule = await loadEmscriptenModule<Record<string, unknown>>(this.scriptUrl, 'FCEUXModule');
+    const bound: Record<string, unknown> = { memory: wasmModule.wasmMemory };
+    for (const [name, value] of Object.entries(wasmModule)) {
+      if (name.startsWith('_') && typeof value === 'function') {
+        bound[name.slice(1)] = value;
+      }
+    }
+
+    const missing = CORE_EXPORTS.filter((name) => typeof bound[name] !== 'function');
+    if (!(bound.memory instanceof WebAssembly.Memory) || missing.length > 0) {
+      throw new Error(`${this.scriptUrl} is out of date (missing ${missing.length > 0 ? missing.join(', ') : 'wasmMemory'}); rebuild it with scripts/compile-c-wasm.sh`);
+    }
+    this.exports = bound as unknown as WasmCoreExports;
+
+    const result = this.exports.init();
+    console.log('[WasmCoreAdapter] Core initialized:', result !== 0);
+    return result !== 0;
+  }
+
+  async loadRom(rom: Uint8Array): Promise<boolean> {
+    const core = this.requireCore();
+
+    // The buffer is fixed-size core memory: check before writing into it
+    const capacity = core.getRomBufferSize();
+    if (rom.length > capacity) {
+      console.error(`[WasmCoreAdapter] ❌ ROM is ${rom.length} bytes, the core takes at most ${capacity}`);
+      return false;
+    }
+
+    // Write straight into the core's ROM buffer; loadRom() skips its copy for this pointer
+    const romPtr = core.getRomBuffer();
+    new Uint8Array(core.memory.buffer, romPtr, rom.length).set(rom);
+
+    const result = core.loadRom(romPtr, rom.length);
+    if (result === 0) {
+      console.error('[WasmCoreAdapter] ❌ Core rejected the ROM');
+    }
+    return result !== 0;
+  }
+
+  frame(): void {
+    this.exports?.frame();
+  }
+
+  reset(): void {
+    this.exports?.reset();
+  }
+
+  setButton(index: number, pressed: boolean): void {
+    this.exports?.setButton(index, pressed ? 1 : 0);
+  }
+
+  setPortButtons(port: number, mask: number): void {
+    this.exports?.setPortButtons(port, mask);
+  }
+
+  setButtons(masks: Uint8Array): void {
+    const core = this.requireCore();
+    const ptr = this.stateScratch(core, RUN_FRAMES_PORTS);
+    const view = new Uint8Array(core.memory.buffer, ptr, RUN_FRAMES_PORTS);
+    view.fill(0);
+    view.set(masks.subarray(0, RUN_FRAMES_PORTS));
+    core.setButtons(ptr);
+  }
+
+  setInputMode(mode: InputMode): boolean {
+    return this.exports?.setInputMode(INPUT_MODE_CODES[mode]) === 1;
+  }
+
+  runFrames(count: number, inputs?: Uint8Array | null, options: RunFramesOptions = {}): number {
+    const core = this.requireCore();
+    const flags = (options.videoLastOnly ? RUN_FRAMES_VIDEO_LAST : 0) | (options.audioLastOnly ? RUN_FRAMES_AUDIO_LAST : 0);
+    if (!inputs) {
+      return core.runFrames(count, 0, flags);
+    }
+    count = Math.min(count, Math.floor(inputs.length / RUN_FRAMES_PORTS));
+    const ptr = this.stateScratch(core, Math.max(1, count * RUN_FRAMES_PORTS));
+    new Uint8Array(core.memory.buffer, ptr, count * RUN_FRAMES_PORTS).set(inputs.subarray(0, count * RUN_FRAMES_PORTS));
+    return core.runFrames(count, ptr, flags);
+  }
+
+  queueInputs(events: Uint8Array): number {
+    const core = this.requireCore();
+    const ptr = this.stateScratch(core, events.length);
+    new Uint8Array(core.memory.buffer, ptr, events.length).set(events);
+    return core.queueInputs(ptr, events.length >> 3);
+  }
+
+  getFrameCount(): number {
+    return this.exports ? this.exports.getFrameCount() : 0;
+  }
+
+  getLagFrames(): number {
+    return this.exports ? this.exports.getLagFrames() >>> 0 : 0;
+  }
+
+  getLagFrameCount(): number {
+    return this.exports ? this.exports.getLagFrameCount() >>> 0 : 0;
+  }
+
+  getRomHash(): number {
+    return this.exports ? this.exports.getRomHash() >>> 0 : 0;
+  }
+
+  setRunning(running: boolean): void {
+    this.exports?.setRunning(running ? 1 : 0);
+  }
+
+  getFrameBuffer(): Uint8Array {
+    const core = this.requireCore();
+    return this.frameView(core.getFrameBuffer(), core.getFrameBufferSize());
+  }
+
+  getLatestFrame(): LatestFrame {
+    const core = this.requireCore();
+    this.syncMemoryViews(core);
+
+    // LatestFrame struct: index, sequence, size, buffer pointer (uint32 each)
+    const base = core.getLatestFrame() >> 2;
+    this.latest.index = this.heapU32[base];
+    this.latest.sequence = this.heapU32[base + 1];
+    this.latest.buffer = this.frameView(this.heapU32[base + 3], this.heapU32[base + 2]);
+    return this.latest;
+  }
+
+  /**
+   * Choose double (2) or triple (3) buffering
+   */
+  setFrameBufferCount(count: number): boolean {
+    return this.requireCore().setFrameBufferCount(count) !== 0;
+  }
+
+  getFrameSpec(): FrameSpec {
+    const core = this.requireCore();
+    this.syncMemoryViews(core);
+
+    // FrameSpec struct: width, height, format, pitch (uint32 each)
+    const base = core.getFrameSpec() >> 2;
+    this.spec.width = this.heapU32[base];
+    this.spec.height = this.heapU32[base + 1];
+    this.spec.format = PIXEL_FORMAT_NAMES[this.heapU32[base + 2]] ?? 'RGBA32';
+    return this.spec;
+  }
+
+  setPixelFormat(format: PixelFormat): boolean {
+    const code = PIXEL_FORMAT_CODES[format];
+    if (code === undefined || !this.exports) {
+      return false;
+    }
+    return this.exports.setPixelFormat(code) !== 0;
+  }
+
+  setOverscanCrop(enabled: boolean): void {
+    this.exports?.setOverscanCrop(enabled ? 1 : 0);
+  }
+
+  /**
+   * The same view is returned until memory grows or loadPalette() changes the
+   * colors, so callers can key derived tables on it
+   */
+  getPalette(): Uint32Array | null {
+    if (!this.exports) {
+      return null;
+    }
+    this.syncMemoryViews(this.exports);
+    this.paletteView ??= new Uint32Array(this.exports.memory.buffer, this.exports.getPalette(), 64);
+    return this.paletteView;
+  }
+
+  /**
+   * Replace the core palette from a .pal file (64 or 512 RGB entries)
+   */
+  loadPalette(pal: Uint8Array): boolean {
+    const core = this.requireCore();
+    const ptr = core.malloc(pal.length);
+    try {
+      new Uint8Array(core.memory.buffer, ptr, pal.length).set(pal);
+      return core.loadPalette(ptr, pal.length) !== 0;
+    } finally {
+      core.free(ptr);
+      this.paletteView = null;
+    }
+  }
+
+  /**
+   * Expand palette indices with the core's palette LUT for the given emphasis bank
+   */
+  expandIndexed(dst: Uint32Array, src: Uint8Array, emphasis: number): void {
+    const core = this.requireCore();
+    const count = Math.min(src.length, dst.length);
+    const inCore = src.buffer === core.memory.buffer;
+
+    const size = count * 4 + (inCore ? 0 : count);
+    if (size > this.expandCapacity) {
+      if (this.expandPtr) {
+        core.free(this.expandPtr);
+      }
+      this.expandPtr = core.malloc(size);
+      this.expandCapacity = size;
+    }
+
+    let srcPtr = src.byteOffset;
+    if (!inCore) {
+      srcPtr = this.expandPtr + count * 4;
+      new Uint8Array(core.memory.buffer, srcPtr, count).set(src.subarray(0, count));
+    }
+
+    core.expandIndexed(this.expandPtr, srcPtr, count, emphasis & 7);
+    dst.set(new Uint32Array(core.memory.buffer, this.expandPtr, count));
+  }
+
+  getEmphasis(): number {
+    return this.exports?.getEmphasis() ?? 0;
+  }
+
+  /**
+   * Get the last frame's samples. Sample counts alternate between a couple of
+   * values, so one cached view per count keeps this allocation-free.
+   */
+  getAudioBuffer(): Int16Array {
+    const core = this.requireCore();
+    this.syncMemoryViews(core);
+
+    const count = core.getAudioSampleCount();
+    let view = this.audioViews.get(count);
+    if (!view) {
+      view = new Int16Array(core.memory.buffer, core.getAudioBuffer(), count);
+      this.audioViews.set(count, view);
+    }
+    return view;
+  }
+
+  setSampleRate(rate: number): boolean {
+    return this.exports ? this.exports.setSampleRate(Math.round(rate)) !== 0 : false;
+  }
+
+  setAudioBufferFill(queued: number, capacity: number): number {
+    return this.exports ? this.exports.setAudioBufferFill(queued, capacity) : 0;
+  }
+
+  setAudioEnabled(enabled: boolean): void {
+    this.exports?.setAudioEnabled(enabled ? 1 : 0);
+  }
+
+  setVideoEnabled(enabled: boolean): void {
+    this.exports?.setVideoEnabled(enabled ? 1 : 0);
+  }
+
+  setSpeed(multiplier: number): boolean {
+    return this.exports ? this.exports.setSpeed(multiplier) !== 0 : false;
+  }
+
+  saveState(): Uint8Array | null {
+    const core = this.requireCore();
+    const ptr = this.stateScratch(core, core.saveStateSize());
+    const size = core.saveState(ptr);
+    if (size === 0) {
+      return null;
+    }
+    return new Uint8Array(core.memory.buffer, ptr, size).slice();
+  }
+
+  loadState(state: Uint8Array): boolean {
+    const core = this.requireCore();
+    const ptr = this.stateScratch(core, state.length);
+    new Uint8Array(core.memory.buffer, ptr, state.length).set(state);
+    return core.loadState(ptr, state.length) !== 0;
+  }
+
+  getStateHash(): number {
+    return this.exports ? this.exports.getStateHash() >>> 0 : 0;
+  }
+
+  getStatePageHashes(): Uint32Array | null {
+    const core = this.requireCore();
+    const ptr = this.stateScratch(core, PAGE_HASHES_BYTES);
+    const count = core.getStatePageHashes(ptr);
+    return count > 0 ? new Uint32Array(core.memory.buffer, ptr, count).slice() : null;
+  }
+
+  saveStatePatch(peerHashes: Uint32Array): Uint8Array | null {
+    const core = this.requireCore();
+    // Peer hashes first, the patch (at most a full state) after them
+    const ptr = this.stateScratch(core, PAGE_HASHES_BYTES + core.saveStateSize());
+    const hashes = new Uint32Array(core.memory.buffer, ptr, PAGE_HASHES_BYTES >> 2);
+    hashes.fill(0);
+    hashes.set(peerHashes.subarray(0, hashes.length));
+    const size = core.saveStatePatch(ptr, ptr + PAGE_HASHES_BYTES);
+    if (size === 0) {
+      return null;
+    }
+    return new Uint8Array(core.memory.buffer, ptr + PAGE_HASHES_BYTES, size).slice();
+  }
+
+  setTileEncoder(enabled: boolean): void {
+    this.exports?.setTileEncoder(enabled ? 1 : 0);
+  }
+
+  encodeTileFrame(keyframe: boolean): Uint8Array | null {
+    const core = this.requireCore();
+    const ptr = this.stateScratch(core, core.tilePacketMaxSize());
+    const size = core.encodeTileFrame(ptr, keyframe ? 1 : 0);
+    if (size === 0) {
+      return null;
+    }
+    return new Uint8Array(core.memory.buffer, ptr, size).slice();
+  }
+
+  decodeTileFrame(packet: Uint8Array): boolean {
+    const core = this.requireCore();
+    const ptr = this.stateScratch(core, packet.length);
+    new Uint8Array(core.memory.buffer, ptr, packet.length).set(packet);
+    return core.decodeTileFrame(ptr, packet.length) !== 0;
+  }
+
+  takeSnapshot(): number {
+    return this.exports ? this.exports.takeSnapshot() : 0;
+  }
+
+  restoreSnapshot(id: number): boolean {
+    return this.exports ? this.exports.restoreSnapshot(id) !== 0 : false;
+  }
+
+  getCoreStats(): CoreStats {
+    const core = this.requireCore();
+    const ptr = core.getCoreStats();
+    this.syncMemoryViews(core);
+
+    // CoreStats struct: uint32 fields, times in nanoseconds
+    const base = ptr >> 2;
+    const stats = this.stats;
+    stats.snapshots = this.heapU32[base];
+    stats.snapshotPages = this.heapU32[base + 1];
+    stats.snapshotBytes = this.heapU32[base + 2];
+    stats.snapshotMicros = this.heapU32[base + 3] / 1000;
+    stats.restoreMicros = this.heapU32[base + 4] / 1000;
+    stats.snapshotsHeld = this.heapU32[base + 5];
+    stats.snapshotPoolBytes = this.heapU32[base + 6];
+    stats.rewindStates = this.heapU32[base + 7];
+    stats.rewindFrames = this.heapU32[base + 8];
+    stats.rewindBytes = this.heapU32[base + 9];
+    stats.rewindStateBytes = this.heapU32[base + 10];
+    stats.rewindMicros = this.heapU32[base + 11] / 1000;
+    stats.runAhead = this.heapU32[base + 12];
+    stats.runAheadFrameMicros = this.heapU32[base + 13] / 1000;
+    stats.runAheadStateMicros = this.heapU32[base + 14] / 1000;
+    return stats;
+  }
+
+  setRewindBudget(bytes: number): boolean {
+    return this.exports ? this.exports.setRewindBudget(bytes) !== 0 : false;
+  }
+
+  rewindStep(): boolean {
+    return this.exports ? this.exports.rewindStep() !== 0 : false;
+  }
+
+  setRunAhead(frames: number): boolean {
+    return this.exports ? this.exports.setRunAhead(frames) !== 0 : false;
+  }
+
+  /**
+   * Access the CPU bus directly (APU registers at $4000-$4017, PPUMASK, RAM)
+   */
+  cpuRead(addr: number): number {
+    return this.requireCore().cpuRead(addr);
+  }
+
+  cpuWrite(addr: number, value: number): void {
+    this.requireCore().cpuWrite(addr, value);
+  }
+
+  /**
+   * Read the core's trace ring (development builds against a DEBUG=1 core only)
+   */
+  readTrace(): ReturnType<typeof readCoreTrace> {
+    const core = this.exports;
+    if (!TRACE_ENABLED || !core?.getTraceBuffer || !core.getTraceHead) {
+      return [];
+    }
+    const events = new Uint32Array(core.memory.buffer, core.getTraceBuffer(), TRACE_RING_SIZE_CORE * 4);
+    return readCoreTrace(events, core.getTraceHead());
+  }
+
+  /**
+   * Get a core memory block of at least `size` bytes for savestate and input transfers
+   */
+  private stateScratch(core: WasmCoreExports, size: number): number {
+    if (size > this.stateCapacity) {
+      if (this.statePtr) {
+        core.free(this.statePtr);
+      }
+      this.statePtr = core.malloc(size);
+      this.stateCapacity = size;
+    }
+    return this.statePtr;
+  }
+
+  /**
+   * Drop every cached view if wasm memory grew since they were created
+   */
+  private syncMemoryViews(core: WasmCoreExports): void {
+    const epoch = core.getMemoryEpoch();
+    if (epoch !== this.memoryEpoch) {
+      this.memoryEpoch = epoch;
+      this.heapU32 = new Uint32Array(core.memory.buffer);
+      this.slotViews.clear();
+      this.audioViews.clear();
+      this.paletteView = null;
+    }
+  }
+
+  /**
+   * Get a stable view onto a frame slot; the same object is returned for the
+   * same slot until memory grows or the frame size changes
+   */
+  private frameView(ptr: number, size: number): Uint8Array {
+    const core = this.requireCore();
+    this.syncMemoryViews(core);
+
+    let view = this.slotViews.get(ptr);
+    if (!view || view.length !== size) {
+      view = new Uint8Array(core.memory.buffer, ptr, size);
+      this.slotViews.set(ptr, view);
+    }
+    return view;
+  }
+
+  private requireCore(): WasmCoreExports {
+    if (!this.exports) {
+      throw new Error('Core not initialized - call init() first');
+    }
+    return this.exports;
+  }
+}
@@ -176,6 +176,54 @@ export async function loadWasm(wasmUrl: string, imports: WasmImports = {}): Prom
   }
 }
 
+/**
+ * Emscripten MODULARIZE output: a factory that instantiates the wasm with the
+ * imports its glue provides and resolves to the module, whose exports are
+ * `_`-prefixed functions (the .wasm itself only has minified names)
+ */
+export type EmscriptenFactory<T> = (moduleArg?: Record<string, unknown>) => Promise<T>;
+
+/**
+ * Load an emscripten -sMODULARIZE build through its generated factory
+ * @param scriptUrl URL of the JS glue (the .wasm is fetched next to it)
+ * @param factoryName -sEXPORT_NAME of the build
+ * @returns Promise resolving to the instantiated module
+ */
+export async function loadEmscriptenModule<T>(scriptUrl: string, factoryName: string): Promise<T> {
+  const scriptId = `wasm-${factoryName}`;
+
+  await new Promise<void>((resolve, reject) => {
+    const existingScript = document.getElementById(scriptId) as HTMLScriptElement | null;
+    if (existingScript?.dataset.loaded === 'true') {
+      resolve();
+      return;
+    }
+    if (existingScript) {
+      existingScript.addEventListener('load', () => resolve());
+      existingScript.addEventListener('error', () => reject(new Error(`Failed to load ${scriptUrl}`)));
+      return;
+    }
+
+    console.log('[WasmLoader] Loading emscripten glue from:', scriptUrl);
+    const script = document.createElement('script');
+    script.id = scriptId;
+    script.src = scriptUrl;
+    script.async = true;
+    script.onload = () => {
+      script.dataset.loaded = 'true';
+      resolve();
+    };
+    script.onerror = () => reject(new Error(`Failed to load ${scriptUrl}`));
+    document.body.appendChild(script);
+  });
+
+  const factory = (window as unknown as Record<string, unknown>)[factoryName] as EmscriptenFactory<T> | undefined;
+  if (typeof factory !== 'function') {
+    throw new Error(`${scriptUrl} did not define ${factoryName}; build it with -sMODULARIZE -sEXPORT_NAME=${factoryName}`);
+  }
+  return factory();
+}
+
 /**
  * Create default imports for NES emulator WASM modules
  * @param memory Optional WebAssembly memory instance
@@ -189,6 +237,8 @@ export function createDefaultImports(memory?: WebAssembly.Memory): WasmImports {
         console.error('[WASM] Abort called:', { msg, file, line, column });
       },
       emscripten_resize_heap: () => false,
+      // The core's snapshot/restore timers (getCoreStats), in milliseconds
+      emscripten_get_now: () => performance.now(),
       __handle_stack_overflow: () => {
         console.error('[WASM] Stack overflow detected');
       },
@@ -0,0 +1,163 @@
+import { describe, it, expect } from 'vitest';
+import { NesCore } from '../NesCore';
+import { RollbackGuest, RollbackHost } from './RollbackPeers';
+
+// Deterministic stand-in: the state is a hash of every frame's inputs
+function fakeCore() {
+  const ports = [0, 0, 0, 0];
+  const snapshots = new Map<number, number>();
+  const core = {
+    state: 1,
+    takeSnapshot: () => {
+      snapshots.set(snapshots.size + 1, core.state);
+      return snapshots.size;
+    },
+    restoreSnapshot: (id: number) => {
+      if (!snapshots.has(id)) return false;
+      core.state = snapshots.get(id)!;
+      return true;
+    },
+    setPortButtons: (port: number, mask: number) => {
+      ports[port] = mask;
+    },
+    saveState: () => new Uint8Array(new Uint32Array([core.state]).buffer),
+    loadState: (state: Uint8Array) => {
+      core.state = new Uint32Array(state.slice().buffer)[0];
+      return true;
+    },
+    getRomHash: () => 0x1234,
+    getStateHash: () => core.state,
+    getStatePageHashes: () => new Uint32Array([core.state]),
+    saveStatePatch: () => core.saveState(),
+    frame: () => {
+      core.state = (Math.imul(core.state, 31) + ports[0] * 7 + ports[1] * 13 + 1) >>> 0;
+    },
+  };
+  return core as typeof core & NesCore;
+}
+
+type Message = { player: number; frame: number; mask: number } | { frame: number; hash: number };
+
+const input = (player: number, frame: number) => (frame * (player + 3)) & 0xFF;
+
+describe('RollbackPeers', () => {
+  it('hands a port to a late guest and stays in sync', () => {
+    const toGuest: Message[] = [];
+    const toHost: Message[] = [];
+    const host = new RollbackHost(fakeCore(), { players: 2, hashInterval: 10 },
+      (player, frame, mask) => toGuest.push({ player, frame, mask }),
+      (frame, hash) => toGuest.push({ frame, hash }));
+
+    // Nobody plays port 2 yet: the host does not wait for it
+    for (let i = 0; i < 40; i++) {
+      expect(host.step(input(0, i))).toBe(true);
+    }
+
+    const guestCore = fakeCore();
+    const guest = new RollbackGuest(guestCore, 1,
+      (player, frame, mask) => toHost.push({ player, frame, mask }),
+      (frame, hash) => toHost.push({ frame, hash }), { hashInterval: 10 });
+    const deliver = () => {
+      for (const message of toGuest.splice(0)) {
+        if ('hash' in message) guest.session?.addRemoteHash(message.frame, message.hash);
+        else guest.addRemoteInput(message.player - 1, message.frame, message.mask);
+      }
+      for (const message of toHost.splice(0)) {
+        if ('hash' in message) host.session.addRemoteHash(message.frame, message.hash);
+        else host.addRemoteInput(message.player - 1, message.frame, message.mask);
+      }
+    };
+
+    const start = host.claim(1)!;
+    expect(start.players).toBe(2);
+    // Input sent while the state is in flight reaches the guest first
+    host.step(input(0, 40));
+    deliver();
+    expect(guest.start(start)).toBe(true);
+
+    for (let i = 41; i < 120; i++) {
+      host.step(input(0, i));
+      guest.step(input(1, i));
+      deliver();
+    }
+
+    expect(guest.fastForwardFrames).toBeGreaterThan(0);
+    expect(guest.session!.getStats().hashChecks).toBeGreaterThan(3);
+    expect(guest.session!.desyncFrame).toBe(-1);
+    expect(host.session.getStats().desyncs).toBe(0);
+    expect(host.session.currentFrame - guest.session!.currentFrame).toBeLessThan(4);
+  });
+
+  it('resyncs a guest whose state drifted from the host\'s', () => {
+    const toGuest: Message[] = [];
+    const toHost: Message[] = [];
+    const host = new RollbackHost(fakeCore(), { players: 2, hashInterval: 10 },
+      (player, frame, mask) => toGuest.push({ player, frame, mask }),
+      (frame, hash) => toGuest.push({ frame, hash }));
+    const guestCore = fakeCore();
+    const guest = new RollbackGuest(guestCore, 1,
+      (player, frame, mask) => toHost.push({ player, frame, mask }),
+      (frame, hash) => toHost.push({ frame, hash }), { hashInterval: 10 });
+    host.step(0);
+    expect(guest.start(host.claim(1)!)).toBe(true);
+
+    // Requests reach the host a frame later
+    let request: { frame: number; hashes: Uint32Array } | null = null;
+    let requests = 0;
+    for (let i = 1; i < 200; i++) {
+      if (i === 50) guestCore.state ^= 0x100;
+      host.step(input(0, i));
+      if (request) {
+        const patch = host.session.saveResyncPatch(request.frame, request.hashes);
+        if (patch) guest.applyResyncPatch(request.frame, patch);
+      }
+      guest.step(input(1, i));
+      for (const message of toGuest.splice(0)) {
+        if ('hash' in message) guest.session?.addRemoteHash(message.frame, message.hash);
+        else guest.addRemoteInput(message.player - 1, message.frame, message.mask);
+      }
+      for (const message of toHost.splice(0)) {
+        if ('hash' in message) host.session.addRemoteHash(message.frame, message.hash);
+        else host.addRemoteInput(message.player - 1, message.frame, message.mask);
+      }
+
+      request = guest.takeResyncRequest();
+      if (request) requests++;
+    }
+
+    expect(requests).toBe(1);
+    expect(guest.session!.getStats().resyncs).toBeGreaterThan(0);
+    expect(guest.session!.desyncFrame).toBe(-1);
+    expect(host.session.desyncFrame).toBe(-1);
+  });
+
+  it('takes a port back when its guest leaves', () => {
+    const sent: number[] = [];
+    const host = new RollbackHost(fakeCore(), { players: 2, maxRollback: 4 },
+      (player) => sent.push(player), () => {});
+    for (let i = 0; i < 10; i++) host.step(0);
+
+    host.claim(1);
+    let stalls = 0;
+    for (let i = 0; i < 20; i++) {
+      if (!host.step(0)) stalls++;
+    }
+    expect(stalls).toBeGreaterThan(0);
+
+    // Stamping catches up to the host's input at once
+    sent.length = 0;
+    host.release(1);
+    expect(host.isClaimed(1)).toBe(false);
+    expect(sent.includes(2)).toBe(true);
+    expect(host.step(0)).toBe(true);
+  });
+
+  it('rejects a start message for another ROM', () => {
+    const host = new RollbackHost(fakeCore(), { players: 2 }, () => {}, () => {});
+    host.step(0);
+    const start = host.claim(1)!;
+    const guest = new RollbackGuest(fakeCore(), 1, () => {}, () => {});
+    expect(guest.start({ ...start, romHash: 1 })).toBe(false);
+    expect(guest.step(0)).toBe(false);
+  });
+});
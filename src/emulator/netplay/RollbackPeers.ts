@@ -0,0 +1,285 @@
+/**
+ * Rollback Peers
+ *
+ * The two ends of a rollback session (RollbackSession.ts) in a hosted game.
+ *
+ * The host owns every port. A port no guest plays is stamped by the host with
+ * idle input, frame by frame, and sent on that player's behalf, so nobody
+ * waits for it. When a guest joins to play a port, the host stops stamping
+ * it and hands over the confirmed state together with the inputs it has from
+ * there on, including its own stamps for that port; the guest's input
+ * continues right after the last of them. When the guest leaves, the host
+ * resumes stamping after the newest input it got from them.
+ *
+ * A joining guest buffers input that arrives before the state, then
+ * fast-forwards with video off until it is live. A guest whose state hashes
+ * stop matching the host's asks for a patch of the pages that differ.
+ */
+
+import { NesCore } from '../NesCore';
+import { RollbackSession, type RollbackOptions } from './RollbackSession';
+import type { SpectatorStart } from './SpectatorSession';
+
+const FAST_FORWARD_MAX = 600;       // Frames per step() while joining (bounds the hitch)
+const PENDING_MAX = 4096;           // Inputs held until the join state arrives
+const RESYNC_RETRY_FRAMES = 120;    // Ask again if a resync request went unanswered
+
+/**
+ * Input one peer sends to the others: player 1-4, like the input protocol
+ */
+export type SendInput = (player: number, frame: number, mask: number) => void;
+export type SendStateHash = (frame: number, hash: number) => void;
+
+export class RollbackHost {
+  readonly session: RollbackSession;
+
+  private core: NesCore;
+  private send: SendInput;
+  private sendHash: SendStateHash;
+  private claimed: boolean[];
+  private nextStamp: Int32Array;     // Next frame to stamp, per unclaimed port
+
+  constructor(core: NesCore, options: Omit<RollbackOptions, 'localPlayer'>, send: SendInput, sendHash: SendStateHash) {
+    this.core = core;
+    this.session = new RollbackSession(core, { ...options, localPlayer: 0 });
+    this.send = send;
+    this.sendHash = sendHash;
+    this.claimed = new Array(this.session.players).fill(false);
+    this.claimed[0] = true;
+    // The session already holds idle input for the frames inside the delay
+    this.nextStamp = new Int32Array(this.session.players).fill(this.session.inputDelay);
+  }
+
+  /**
+   * Schedule the host's input, stamp the unclaimed ports and run one frame
+   * @returns false if the session stalled waiting for a guest
+   */
+  step(mask: number): boolean {
+    const frame = this.session.addLocalInput(mask);
+    if (frame >= 0) {
+      this.send(1, frame, mask);
+      for (let port = 1; port < this.session.players; port++) {
+        if (!this.claimed[port]) {
+          this.stamp(port, frame);
+        }
+      }
+    }
+
+    const advanced = this.session.advance();
+    const hash = this.session.takeStateHash();
+    if (hash) {
+      this.sendHash(hash.frame, hash.hash);
+    }
+    return advanced;
+  }
+
+  /**
+   * A guest's input; only claimed ports are taken from guests
+   */
+  addRemoteInput(port: number, frame: number, mask: number): void {
+    if (this.claimed[port]) {
+      this.session.addRemoteInput(port, frame, mask);
+    }
+  }
+
+  /**
+   * Hand `port` to a joining guest (taking it back first if someone else
+   * had it)
+   * @returns The start message for the guest, or null if the core cannot
+   *          save states or `port` is not in the game
+   */
+  claim(port: number): SpectatorStart | null {
+    if (port < 1 || port >= this.session.players) {
+      return null;
+    }
+    this.release(port);
+    const start = this.joinState();
+    if (start) {
+      this.claimed[port] = true;
+    }
+    return start;
+  }
+
+  /**
+   * Stamp `port` again from after the newest input its guest sent
+   */
+  release(port: number): void {
+    if (port < 1 || port >= this.session.players || !this.claimed[port]) {
+      return;
+    }
+    this.claimed[port] = false;
+    this.nextStamp[port] = this.session.newestInputFrame(port) + 1;
+    const frame = this.session.newestInputFrame(0);
+    if (frame >= 0) {
+      this.stamp(port, frame);
+    }
+  }
+
+  isClaimed(port: number): boolean {
+    return this.claimed[port] ?? false;
+  }
+
+  /**
+   * The state every peer agrees on and the inputs since, for a guest
+   * joining to play or watch
+   */
+  joinState(): SpectatorStart | null {
+    const saved = this.session.saveConfirmedState();
+    if (!saved) {
+      return null;
+    }
+    return { players: this.session.players, romHash: this.core.getRomHash?.() ?? 0, ...saved };
+  }
+
+  private stamp(port: number, frame: number): void {
+    for (let next = this.nextStamp[port]; next <= frame; next++) {
+      this.session.addRemoteInput(port, next, 0);
+      this.send(port + 1, next, 0);
+    }
+    this.nextStamp[port] = Math.max(this.nextStamp[port], frame + 1);
+  }
+}
+
+export class RollbackGuest {
+  private core: NesCore;
+  private localPlayer: number;
+  private options: Omit<RollbackOptions, 'localPlayer' | 'players'>;
+  private send: SendInput;
+  private sendHash: SendStateHash;
+  private pending: number[] = [];      // player, frame, mask triples received before start()
+  private joining = false;
+  private joinStartedAt = 0;
+  private resyncAskedAt = -1;          // Frame of the outstanding resync request, -1 if none
+
+  session: RollbackSession | null = null;
+  joinMillis = 0;                      // Join request to live, 0 until then
+  fastForwardFrames = 0;
+
+  /**
+   * @param localPlayer Port this guest plays (0-based)
+   */
+  constructor(core: NesCore, localPlayer: number, send: SendInput, sendHash: SendStateHash,
+              options: Omit<RollbackOptions, 'localPlayer' | 'players'> = {}) {
+    this.core = core;
+    this.localPlayer = localPlayer;
+    this.options = options;
+    this.send = send;
+    this.sendHash = sendHash;
+  }
+
+  /**
+   * Take over the port from the host's start message
+   * @param joinStartedAt performance.now() when the join was requested
+   * @returns false if the ROM differs, the port is not in the game or the
+   *          state was rejected
+   */
+  start(message: SpectatorStart, joinStartedAt = performance.now()): boolean {
+    if (this.core.getRomHash && this.core.getRomHash() !== message.romHash) {
+      console.warn('[Rollback] ROM does not match the host\'s');
+      return false;
+    }
+    if (this.localPlayer >= message.players) {
+      return false;
+    }
+
+    const session = new RollbackSession(this.core, { ...this.options, players: message.players, localPlayer: this.localPlayer });
+    if (!session.join(message)) {
+      console.warn('[Rollback] Host state rejected');
+      return false;
+    }
+    this.session = session;
+    this.joining = true;
+    this.resyncAskedAt = -1;
+    this.joinStartedAt = joinStartedAt;
+    this.joinMillis = 0;
+    this.fastForwardFrames = 0;
+
+    for (let i = 0; i < this.pending.length; i += 3) {
+      session.addRemoteInput(this.pending[i], this.pending[i + 1], this.pending[i + 2]);
+    }
+    this.pending = [];
+    return true;
+  }
+
+  /**
+   * Another peer's input (0-based port). Input arriving before start() is
+   * held until the state it follows is known.
+   */
+  addRemoteInput(player: number, frame: number, mask: number): void {
+    if (this.session) {
+      this.session.addRemoteInput(player, frame, mask);
+    } else if (this.pending.length < PENDING_MAX * 3) {
+      this.pending.push(player, frame, mask);
+    }
+  }
+
+  /**
+   * Run one displayed frame with the local buttons. Right after start() the
+   * frames the host has confirmed input for are run first, video off.
+   * @returns false if nothing was run (not started, or stalled)
+   */
+  step(mask: number): boolean {
+    const session = this.session;
+    if (!session) {
+      return false;
+    }
+
+    if (this.joining) {
+      let frames = 0;
+      this.core.setVideoEnabled?.(false);
+      while (session.currentFrame < session.confirmedFrame && frames < FAST_FORWARD_MAX && this.stepOnce(mask)) {
+        frames++;
+      }
+      this.core.setVideoEnabled?.(true);
+      this.fastForwardFrames += frames;
+      if (frames < FAST_FORWARD_MAX) {
+        this.joining = false;
+        this.joinMillis = performance.now() - this.joinStartedAt;
+      }
+    }
+    return this.stepOnce(mask);
+  }
+
+  /**
+   * A resync request for the host (RollbackSession.saveResyncPatch()) once a
+   * desync is detected; repeated if no patch arrives in time
+   */
+  takeResyncRequest(): { frame: number; hashes: Uint32Array } | null {
+    const session = this.session;
+    if (!session || this.joining || session.desyncFrame < 0) {
+      return null;
+    }
+    if (this.resyncAskedAt >= 0 && session.currentFrame - this.resyncAskedAt < RESYNC_RETRY_FRAMES) {
+      return null;
+    }
+    this.resyncAskedAt = session.currentFrame;
+    return session.saveResyncRequest();
+  }
+
+  /**
+   * Apply the host's answer to takeResyncRequest()
+   * @returns false if it could not be applied (asked again later)
+   */
+  applyResyncPatch(frame: number, patch: Uint8Array): boolean {
+    if (!this.session) {
+      return false;
+    }
+    this.resyncAskedAt = -1;
+    return this.session.applyResyncPatch(frame, patch);
+  }
+
+  private stepOnce(mask: number): boolean {
+    const session = this.session!;
+    const frame = session.addLocalInput(mask);
+    if (frame >= 0) {
+      this.send(this.localPlayer + 1, frame, mask);
+    }
+
+    const advanced = session.advance();
+    const hash = session.takeStateHash();
+    if (hash) {
+      this.sendHash(hash.frame, hash.hash);
+    }
+    return advanced;
+  }
+}
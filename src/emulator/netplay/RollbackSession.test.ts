@@ -0,0 +1,227 @@
+import { describe, it, expect } from 'vitest';
+import { NesCore } from '../NesCore';
+import { RollbackSession } from './RollbackSession';
+
+// Deterministic stand-in: the state is a hash of every frame's inputs
+function fakeCore() {
+  const ports = [0, 0, 0, 0];
+  const snapshots = new Map<number, number>();
+  const core = {
+    state: 1,
+    renderedFrames: 0,
+    video: true,
+    inputMode: 'standard',
+    setInputMode: (mode: string) => {
+      core.inputMode = mode;
+      return true;
+    },
+    takeSnapshot: () => {
+      snapshots.set(snapshots.size + 1, core.state);
+      return snapshots.size;
+    },
+    restoreSnapshot: (id: number) => {
+      if (!snapshots.has(id)) return false;
+      core.state = snapshots.get(id)!;
+      return true;
+    },
+    setPortButtons: (port: number, mask: number) => {
+      ports[port] = mask;
+    },
+    setVideoEnabled: (enabled: boolean) => {
+      core.video = enabled;
+    },
+    saveState: () => new Uint8Array(new Uint32Array([core.state]).buffer),
+    loadState: (state: Uint8Array) => {
+      core.state = new Uint32Array(state.slice().buffer)[0];
+      return true;
+    },
+    // One "page": the whole state
+    getStateHash: () => core.state,
+    getStatePageHashes: () => new Uint32Array([core.state]),
+    saveStatePatch: (peer: Uint32Array) => peer[0] === core.state ? new Uint8Array(0) : core.saveState(),
+    frame: () => {
+      core.state = (Math.imul(core.state, 31) + ports[0] * 7 + ports[1] * 13 + ports[2] * 17 + ports[3] * 19 + 1) >>> 0;
+      if (core.video) core.renderedFrames++;
+    },
+  };
+  return core;
+}
+
+function session(core: ReturnType<typeof fakeCore>, localPlayer: number, maxRollback = 8, hashInterval = 60) {
+  return new RollbackSession(core as unknown as NesCore, { players: 2, localPlayer, inputDelay: 2, maxRollback, hashInterval });
+}
+
+const input = (player: number, frame: number) => (frame * (player + 3)) & 0xFF;
+
+describe('RollbackSession', () => {
+  it('keeps peers in sync without rollbacks when input arrives within the delay', () => {
+    const cores = [fakeCore(), fakeCore()];
+    const peers = [session(cores[0], 0), session(cores[1], 1)];
+
+    for (let i = 0; i < 100; i++) {
+      const sent = peers.map((peer, player) => [peer.addLocalInput(input(player, i)), input(player, i)]);
+      peers[0].addRemoteInput(1, sent[1][0], sent[1][1]);
+      peers[1].addRemoteInput(0, sent[0][0], sent[0][1]);
+      expect(peers[0].advance()).toBe(true);
+      expect(peers[1].advance()).toBe(true);
+    }
+
+    expect(cores[0].state).toBe(cores[1].state);
+    expect(peers[0].getStats().rollbacks).toBe(0);
+    expect(peers[0].getStats().confirmedFrame).toBe(101);
+  });
+
+  it('rolls back with video off when late input contradicts the prediction', () => {
+    const cores = [fakeCore(), fakeCore()];
+    const peers = [session(cores[0], 0), session(cores[1], 1)];
+    const late: [number, number][] = [];
+
+    for (let i = 0; i < 60; i++) {
+      const sent = peers.map((peer, player) => [peer.addLocalInput(input(player, i)), input(player, i)]);
+      peers[1].addRemoteInput(0, sent[0][0], sent[0][1]);
+      late.push([sent[1][0], sent[1][1]]);
+      // Player 2's input reaches player 1 five frames late
+      if (late.length > 5) {
+        const [frame, mask] = late.shift()!;
+        peers[0].addRemoteInput(1, frame, mask);
+      }
+      peers[0].advance();
+      peers[1].advance();
+    }
+    for (const [frame, mask] of late) {
+      peers[0].addRemoteInput(1, frame, mask);
+    }
+    // The next frame corrects the mispredictions
+    peers[0].advance();
+    peers[1].advance();
+
+    expect(cores[0].state).toBe(cores[1].state);
+    const stats = peers[0].getStats();
+    expect(stats.rollbacks).toBeGreaterThan(0);
+    expect(stats.lastRollbackFrames).toBeGreaterThan(0);
+    expect(cores[0].renderedFrames).toBe(61);
+  });
+
+  it('keeps four players in sync through a Four Score', () => {
+    const cores = [fakeCore(), fakeCore(), fakeCore(), fakeCore()];
+    const peers = cores.map((core, player) =>
+      new RollbackSession(core as unknown as NesCore, { players: 4, localPlayer: player, inputDelay: 2 }));
+    const late: [number, number][] = [];
+
+    for (let i = 0; i < 60; i++) {
+      const sent = peers.map((peer, player) => [peer.addLocalInput(input(player, i)), input(player, i)]);
+      for (let to = 0; to < 4; to++) {
+        for (let from = 0; from < 4; from++) {
+          // Player 4's input reaches player 1 four frames late
+          if (from !== to && !(from === 3 && to === 0)) {
+            peers[to].addRemoteInput(from, sent[from][0], sent[from][1]);
+          }
+        }
+      }
+      late.push([sent[3][0], sent[3][1]]);
+      if (late.length > 4) {
+        const [frame, mask] = late.shift()!;
+        peers[0].addRemoteInput(3, frame, mask);
+      }
+      peers.forEach((peer) => expect(peer.advance()).toBe(true));
+    }
+    for (const [frame, mask] of late) {
+      peers[0].addRemoteInput(3, frame, mask);
+    }
+    peers.forEach((peer) => peer.advance());
+
+    expect(cores.every((core) => core.inputMode === 'four-score')).toBe(true);
+    expect(cores.every((core) => core.state === cores[0].state)).toBe(true);
+    expect(peers[0].getStats().rollbacks).toBeGreaterThan(0);
+    expect(peers[1].getStats().rollbacks).toBe(0);
+    expect(peers[1].getStats().confirmedFrame).toBe(61);
+  });
+
+  it('rejects more than four players', () => {
+    expect(() => new RollbackSession(fakeCore() as unknown as NesCore, { players: 5, localPlayer: 0 })).toThrow();
+  });
+
+  it('stalls instead of running past maxRollback frames of missing input', () => {
+    const core = fakeCore();
+    const peer = session(core, 0, 4);
+
+    let advanced = 0;
+    for (let i = 0; i < 20; i++) {
+      peer.addLocalInput(1);
+      if (peer.advance()) advanced++;
+    }
+
+    // Frames 0-1 are confirmed by the delay, then 4 more may be predicted
+    expect(advanced).toBe(6);
+    expect(peer.getStats().stalls).toBe(14);
+
+    peer.addRemoteInput(1, 2, 0);
+    expect(peer.advance()).toBe(true);
+  });
+
+  it('saves the state before the first unconfirmed frame without disturbing the present', () => {
+    const reference = fakeCore();
+    const core = fakeCore();
+    const peer = session(core, 0);
+
+    for (let i = 0; i < 10; i++) {
+      const frame = peer.addLocalInput(input(0, i));
+      if (frame < 7) peer.addRemoteInput(1, frame, input(1, frame));
+      peer.advance();
+    }
+    // Frames 0-6 have both inputs, 7-9 ran on a prediction
+    const present = core.state;
+    const saved = peer.saveConfirmedState()!;
+    expect(saved.frame).toBe(7);
+    expect(core.state).toBe(present);
+
+    // Local input applies two frames after it is read; remote input was stamped directly
+    for (let frame = 0; frame < 7; frame++) {
+      reference.setPortButtons(0, frame < 2 ? 0 : input(0, frame - 2));
+      reference.setPortButtons(1, frame < 2 ? 0 : input(1, frame));
+      reference.frame();
+    }
+    expect(Array.from(saved.state)).toEqual(Array.from(reference.saveState()));
+  });
+
+  it('detects a desync from confirmed state hashes and resyncs from a patch', () => {
+    const cores = [fakeCore(), fakeCore()];
+    const peers = [session(cores[0], 0, 8, 10), session(cores[1], 1, 8, 10)];
+    const exchange = () => {
+      const hashes = peers.map((peer) => peer.takeStateHash());
+      if (hashes[0]) peers[1].addRemoteHash(hashes[0].frame, hashes[0].hash);
+      if (hashes[1]) peers[0].addRemoteHash(hashes[1].frame, hashes[1].hash);
+    };
+    const step = (i: number) => {
+      const sent = peers.map((peer, player) => [peer.addLocalInput(input(player, i)), input(player, i)]);
+      peers[0].addRemoteInput(1, sent[1][0], sent[1][1]);
+      peers[1].addRemoteInput(0, sent[0][0], sent[0][1]);
+      peers[0].advance();
+      peers[1].advance();
+      exchange();
+    };
+
+    for (let i = 0; i < 30; i++) step(i);
+    expect(peers[1].getStats().hashChecks).toBe(3);
+    expect(peers[1].desyncFrame).toBe(-1);
+
+    // Something outside the inputs changes the guest's game
+    cores[1].state ^= 0x100;
+    for (let i = 30; i < 45; i++) step(i);
+    expect(peers[1].desyncFrame).toBe(30);
+    expect(peers[0].getStats().desyncs).toBe(2);
+
+    const request = peers[1].saveResyncRequest()!;
+    const patch = peers[0].saveResyncPatch(request.frame, request.hashes)!;
+    expect(patch.length).toBe(4);
+    expect(peers[1].applyResyncPatch(request.frame, patch)).toBe(true);
+    expect(cores[1].state).toBe(cores[0].state);
+    expect(peers[1].desyncFrame).toBe(-1);
+
+    for (let i = 45; i < 60; i++) step(i);
+    expect(cores[1].state).toBe(cores[0].state);
+    expect(peers[1].getStats().desyncs).toBe(2);
+    expect(peers[1].getStats().resyncs).toBe(1);
+    expect(peers[0].desyncFrame).toBe(-1);
+  });
+});
@@ -0,0 +1,533 @@
+/**
+ * Rollback Netplay Session
+ *
+ * Every peer runs its own core and advances immediately with the inputs it
+ * has. A remote player's input that has not arrived yet is predicted by
+ * repeating the newest one received. When the real input turns up and differs
+ * from what was used, the core goes back to the snapshot taken before that
+ * frame and re-simulates up to the present with video off, so only the next
+ * displayed frame shows the correction.
+ *
+ * Inputs are one byte per player per frame (setButton() bit order), for up
+ * to four players. Local
+ * input is scheduled `inputDelay` frames ahead, which gives it time to reach
+ * the other peers and keeps most frames free of rollbacks.
+ *
+ * Every `hashInterval` frames the core's state hash is taken once no
+ * prediction can have gone into it, for the peers to compare (see
+ * stateSync.ts). A desynced guest sends its page hashes and applies the
+ * host's patch of the pages that differ. Peers must start from the same
+ * state, e.g. the host's saveConfirmedState().
+ */
+
+import { NesCore } from '../NesCore';
+
+const HISTORY = 128;               // Frames of inputs and snapshot ids kept
+const HISTORY_MASK = HISTORY - 1;
+const NOT_RECEIVED = -1;
+
+export interface RollbackOptions {
+  players: number;        // Ports in use (1-4; 3 and 4 through a Four Score)
+  localPlayer: number;    // Port this peer controls (0-based)
+  inputDelay?: number;    // Frames between reading local input and applying it (default 2)
+  maxRollback?: number;   // Frames the session may run past confirmed input (default 8)
+  hashInterval?: number;  // Frames between state hash checks, 0 for none (default 60)
+}
+
+export interface RollbackStats {
+  frame: number;              // Next frame to simulate
+  confirmedFrame: number;     // Newest frame with every player's input received
+  rollbacks: number;          // Mispredictions corrected
+  resimulatedFrames: number;  // Frames re-run by those corrections
+  lastRollbackFrames: number; // Depth of the newest rollback
+  rollbackMicros: number;     // Cost of the newest rollback (restore + re-simulation)
+  stalls: number;             // advance() calls that waited for remote input
+  hashChecks: number;         // State hashes compared with a peer's
+  desyncs: number;            // Of those, mismatches
+  desyncFrame: number;        // Frame of the unresolved mismatch, -1 if in sync
+  resyncs: number;            // Patches applied
+  lastResyncBytes: number;    // Size of the newest patch
+}
+
+type RollbackCore = NesCore & Required<Pick<NesCore, 'takeSnapshot' | 'restoreSnapshot' | 'setPortButtons'>>;
+
+const KEPT_HASHES = 16;   // Confirmed hashes kept for peers' hashes arriving late
+
+export class RollbackSession {
+  readonly players: number;
+  readonly localPlayer: number;
+  readonly inputDelay: number;
+  readonly maxRollback: number;
+  readonly hashInterval: number;
+
+  private core: RollbackCore;
+  private frame = 0;
+  private startFrame = 0;                  // First frame simulated here (join())
+
+  // Per player, indexed by frame & HISTORY_MASK
+  private inputs: Uint8Array[] = [];
+  private inputFrames: Int32Array[] = [];   // Frame the slot's input belongs to, or NOT_RECEIVED
+  private usedInputs: Uint8Array[] = [];    // Input the simulation applied (received or predicted)
+  private newestInput: Uint8Array;          // Prediction source
+  private newestFrame: Int32Array;
+  private confirmed: Int32Array;            // Newest frame received without gaps
+
+  private snapshots = new Uint32Array(HISTORY);  // Snapshot taken before each frame
+  private rollbackFrom = -1;
+
+  // State hashes by frame: taken while simulating, final once confirmed
+  private pendingHashes = new Map<number, number>();
+  private localHashes = new Map<number, number>();
+  private remoteHashes = new Map<number, number>();
+  private unsentHash: { frame: number; hash: number } | null = null;
+
+  private stats: RollbackStats = {
+    frame: 0,
+    confirmedFrame: -1,
+    rollbacks: 0,
+    resimulatedFrames: 0,
+    lastRollbackFrames: 0,
+    rollbackMicros: 0,
+    stalls: 0,
+    hashChecks: 0,
+    desyncs: 0,
+    desyncFrame: -1,
+    resyncs: 0,
+    lastResyncBytes: 0,
+  };
+
+  constructor(core: NesCore, options: RollbackOptions) {
+    if (!core.takeSnapshot || !core.restoreSnapshot || !core.setPortButtons) {
+      throw new Error('Rollback needs a core with snapshots and per-port input');
+    }
+    if (options.players < 1 || options.players > 4 || options.localPlayer < 0 || options.localPlayer >= options.players) {
+      throw new Error(`Invalid rollback players: ${options.localPlayer} of ${options.players}`);
+    }
+    // Every peer builds the session with the same player count, so all of
+    // them plug in the Four Score
+    if (options.players > 2 && !core.setInputMode?.('four-score')) {
+      throw new Error('Rollback with more than two players needs a core with a Four Score');
+    }
+
+    this.core = core as RollbackCore;
+    this.players = options.players;
+    this.localPlayer = options.localPlayer;
+    this.inputDelay = Math.max(0, Math.floor(options.inputDelay ?? 2));
+    this.maxRollback = Math.min(32, Math.max(1, Math.floor(options.maxRollback ?? 8)));
+    this.hashInterval = core.getStateHash ? Math.max(0, Math.floor(options.hashInterval ?? 60)) : 0;
+
+    for (let player = 0; player < this.players; player++) {
+      this.inputs.push(new Uint8Array(HISTORY));
+      this.inputFrames.push(new Int32Array(HISTORY).fill(NOT_RECEIVED));
+      this.usedInputs.push(new Uint8Array(HISTORY));
+    }
+    this.newestInput = new Uint8Array(this.players);
+    this.newestFrame = new Int32Array(this.players).fill(-1);
+    this.confirmed = new Int32Array(this.players).fill(-1);
+
+    // Nobody can have sent input for the frames inside the delay
+    for (let frame = 0; frame < this.inputDelay; frame++) {
+      for (let player = 0; player < this.players; player++) {
+        this.storeInput(player, frame, 0);
+      }
+    }
+  }
+
+  /**
+   * Start from a peer's saveConfirmedState() instead of power-on (late join).
+   * The inputs sent with it are kept; the local player's own input follows
+   * on from the last of theirs, so addLocalInput() returns -1 until then.
+   * @returns false if the core rejected the state
+   */
+  join(start: { frame: number; state: Uint8Array; inputs: Uint8Array[] }): boolean {
+    if (!this.core.loadState?.(start.state)) {
+      return false;
+    }
+
+    this.frame = this.startFrame = start.frame;
+    this.rollbackFrom = -1;
+    for (let player = 0; player < this.players; player++) {
+      this.inputFrames[player].fill(NOT_RECEIVED);
+      this.newestInput[player] = 0;
+      this.newestFrame[player] = start.frame - 1;
+      this.confirmed[player] = start.frame - 1;
+      const masks = start.inputs[player] ?? new Uint8Array(0);
+      for (let i = 0; i < masks.length && i < HISTORY / 2; i++) {
+        this.storeInput(player, start.frame + i, masks[i]);
+      }
+    }
+    this.pendingHashes.clear();
+    this.localHashes.clear();
+    this.remoteHashes.clear();
+    this.unsentHash = null;
+    return true;
+  }
+
+  /**
+   * Newest frame with `player`'s input, received or local, -1 if none
+   */
+  newestInputFrame(player: number): number {
+    return this.newestFrame[player] ?? -1;
+  }
+
+  /**
+   * Frame the next advance() simulates
+   */
+  get currentFrame(): number {
+    return this.frame;
+  }
+
+  /**
+   * Newest frame for which every player's input has been received
+   */
+  get confirmedFrame(): number {
+    let frame = this.confirmed[0];
+    for (let player = 1; player < this.players; player++) {
+      frame = Math.min(frame, this.confirmed[player]);
+    }
+    return frame;
+  }
+
+  /**
+   * Schedule the local player's input. Call once per advance(), before it.
+   * @returns Frame the input applies to (send it to the other peers with
+   *          this stamp), or -1 if input for that frame is already scheduled
+   *          because the previous advance() stalled
+   */
+  addLocalInput(mask: number): number {
+    const frame = this.frame + this.inputDelay;
+    if (this.inputFrames[this.localPlayer][frame & HISTORY_MASK] === frame) {
+      return -1;
+    }
+    this.storeInput(this.localPlayer, frame, mask & 0xFF);
+    return frame;
+  }
+
+  /**
+   * Record another peer's input. Duplicates and frames too old to matter are
+   * ignored, so redundant or reordered delivery is fine.
+   */
+  addRemoteInput(player: number, frame: number, mask: number): void {
+    if (player < 0 || player >= this.players || player === this.localPlayer) {
+      return;
+    }
+    const slot = frame & HISTORY_MASK;
+    if (frame <= this.confirmed[player] || frame >= this.frame + HISTORY / 2 ||
+        this.inputFrames[player][slot] === frame) {
+      return;
+    }
+
+    mask &= 0xFF;
+    this.storeInput(player, frame, mask);
+
+    // Already simulated with a different guess: replay from there
+    if (frame < this.frame && this.usedInputs[player][slot] !== mask &&
+        (this.rollbackFrom < 0 || frame < this.rollbackFrom)) {
+      this.rollbackFrom = frame;
+    }
+  }
+
+  /**
+   * Correct any misprediction, then simulate and display one frame.
+   * @returns false if the session is maxRollback frames past confirmed input
+   *          and is waiting for remote peers (nothing was simulated)
+   */
+  advance(): boolean {
+    if (this.rollbackFrom >= 0) {
+      this.rollback();
+    }
+
+    if (this.frame - this.confirmedFrame > this.maxRollback) {
+      this.stats.stalls++;
+      return false;
+    }
+
+    this.simulate(this.frame);
+    this.frame++;
+    this.confirmHashes();
+    return true;
+  }
+
+  /**
+   * Newest confirmed state hash not taken yet, to send to the other peers
+   */
+  takeStateHash(): { frame: number; hash: number } | null {
+    const hash = this.unsentHash;
+    this.unsentHash = null;
+    return hash;
+  }
+
+  /**
+   * Compare a peer's state hash with this peer's for the same frame (now or
+   * once that frame is confirmed here)
+   */
+  addRemoteHash(frame: number, hash: number): void {
+    if (this.remoteHashes.size >= KEPT_HASHES * 4) {
+      return;   // Far ahead of this peer; later hashes will be checked
+    }
+    const local = this.localHashes.get(frame);
+    if (local === undefined) {
+      this.remoteHashes.set(frame, hash >>> 0);
+    } else {
+      this.compareHash(frame, local, hash >>> 0);
+    }
+  }
+
+  /**
+   * Frame of a detected, unresolved desync, or -1
+   */
+  get desyncFrame(): number {
+    return this.stats.desyncFrame;
+  }
+
+  /**
+   * Page hashes of the confirmed state, for the host to build a patch
+   * against (desynced guest)
+   * @returns null if the core cannot hash pages
+   */
+  saveResyncRequest(): { frame: number; hashes: Uint32Array } | null {
+    if (!this.core.getStatePageHashes) {
+      return null;
+    }
+    const saved = this.atConfirmedState(() => this.core.getStatePageHashes!());
+    return saved.value ? { frame: saved.frame, hashes: saved.value } : null;
+  }
+
+  /**
+   * Patch that turns a guest's state before `frame` into this peer's (host)
+   * @returns null if `frame` is not confirmed here yet or too old to restore
+   */
+  saveResyncPatch(frame: number, peerHashes: Uint32Array): Uint8Array | null {
+    if (!this.core.saveStatePatch || frame > this.confirmedFrame + 1) {
+      return null;
+    }
+    if (this.rollbackFrom >= 0) {
+      this.rollback();
+    }
+    if (frame === this.frame) {
+      return this.core.saveStatePatch(peerHashes);
+    }
+    if (!this.tryRestore(frame)) {
+      return null;
+    }
+    const patch = this.core.saveStatePatch(peerHashes);
+    this.resimulate(frame);
+    return patch;
+  }
+
+  /**
+   * Apply the host's patch to the state before `frame` and re-simulate up to
+   * the present (desynced guest)
+   * @returns false if the state before `frame` is no longer held or the
+   *          patch was rejected
+   */
+  applyResyncPatch(frame: number, patch: Uint8Array): boolean {
+    if (!this.core.loadState) {
+      return false;
+    }
+    if (this.rollbackFrom >= 0) {
+      this.rollback();
+    }
+    if (frame !== this.frame && !this.tryRestore(frame)) {
+      return false;
+    }
+    if (!this.core.loadState(patch)) {
+      this.resimulate(frame);
+      return false;
+    }
+    // Hashes from the desynced timeline must not be compared again; the ones
+    // from `frame` on are retaken while re-simulating
+    this.localHashes.clear();
+    this.pendingHashes.clear();
+    this.resimulate(frame);
+    this.confirmHashes();
+
+    this.stats.resyncs++;
+    this.stats.lastResyncBytes = patch.length;
+    this.stats.desyncFrame = -1;
+    return true;
+  }
+
+  /**
+   * Serialize the state before the first frame that is not confirmed yet. No
+   * prediction has gone into it, so every peer agrees on it: spectators and
+   * late joiners start from here and follow the input stream.
+   * @returns The state, the frame it precedes and each player's inputs
+   *          received from that frame on, or null if the core cannot save states
+   */
+  saveConfirmedState(): { frame: number; state: Uint8Array; inputs: Uint8Array[] } | null {
+    if (!this.core.saveState) {
+      return null;
+    }
+    const saved = this.atConfirmedState(() => this.core.saveState!());
+    return saved.value ? { frame: saved.frame, state: saved.value, inputs: this.inputsSince(saved.frame) } : null;
+  }
+
+  /**
+   * Run `read` on the state before the first frame that is not confirmed yet
+   */
+  private atConfirmedState<T>(read: () => T): { frame: number; value: T } {
+    if (this.rollbackFrom >= 0) {
+      this.rollback();
+    }
+    const frame = Math.min(this.confirmedFrame + 1, this.frame);
+    if (frame === this.frame) {
+      return { frame, value: read() };
+    }
+    this.restore(frame);
+    const value = read();
+    this.resimulate(frame);
+    return { frame, value };
+  }
+
+  /**
+   * Each player's received inputs from `frame` up to their first gap
+   */
+  private inputsSince(frame: number): Uint8Array[] {
+    const inputs: Uint8Array[] = [];
+    for (let player = 0; player < this.players; player++) {
+      let count = 0;
+      while (count < HISTORY / 2 && this.inputFrames[player][(frame + count) & HISTORY_MASK] === frame + count) {
+        count++;
+      }
+      const masks = new Uint8Array(count);
+      for (let i = 0; i < count; i++) {
+        masks[i] = this.inputs[player][(frame + i) & HISTORY_MASK];
+      }
+      inputs.push(masks);
+    }
+    return inputs;
+  }
+
+  getStats(): RollbackStats {
+    this.stats.frame = this.frame;
+    this.stats.confirmedFrame = this.confirmedFrame;
+    return this.stats;
+  }
+
+  private storeInput(player: number, frame: number, mask: number): void {
+    const slot = frame & HISTORY_MASK;
+    this.inputs[player][slot] = mask;
+    this.inputFrames[player][slot] = frame;
+
+    if (frame > this.newestFrame[player]) {
+      this.newestFrame[player] = frame;
+      this.newestInput[player] = mask;
+    }
+
+    // Advance the gap-free mark over inputs that arrived out of order
+    let confirmed = this.confirmed[player];
+    while (this.inputFrames[player][(confirmed + 1) & HISTORY_MASK] === confirmed + 1) {
+      confirmed++;
+    }
+    this.confirmed[player] = confirmed;
+  }
+
+  /**
+   * Snapshot, apply every player's input for `frame` and run it
+   */
+  private simulate(frame: number): void {
+    const slot = frame & HISTORY_MASK;
+    this.snapshots[slot] = this.core.takeSnapshot();
+    if (this.hashInterval > 0 && frame % this.hashInterval === 0) {
+      this.pendingHashes.set(frame, this.core.getStateHash!() >>> 0);
+    }
+
+    for (let player = 0; player < this.players; player++) {
+      const mask = this.inputFrames[player][slot] === frame ? this.inputs[player][slot] : this.newestInput[player];
+      this.usedInputs[player][slot] = mask;
+      this.core.setPortButtons(player, mask);
+    }
+    this.core.frame();
+  }
+
+  /**
+   * Return the core to the state before `frame`
+   */
+  private restore(frame: number): void {
+    if (!this.core.restoreSnapshot(this.snapshots[frame & HISTORY_MASK])) {
+      throw new Error(`Rollback snapshot for frame ${frame} is no longer held`);
+    }
+  }
+
+  /**
+   * Like restore(), for frames a peer named
+   * @returns false (nothing changed) if the snapshot is no longer held
+   */
+  private tryRestore(frame: number): boolean {
+    return frame >= this.frame - HISTORY && frame >= this.startFrame && frame < this.frame &&
+      this.core.restoreSnapshot(this.snapshots[frame & HISTORY_MASK]);
+  }
+
+  /**
+   * Hashes taken before frames that are now confirmed cannot change any more:
+   * a misprediction before them would have re-simulated them
+   */
+  private confirmHashes(): void {
+    const confirmed = this.confirmedFrame;
+    for (const [frame, hash] of this.pendingHashes) {
+      if (frame > confirmed + 1) {
+        continue;
+      }
+      this.pendingHashes.delete(frame);
+      this.localHashes.set(frame, hash);
+      this.unsentHash = { frame, hash };
+
+      const remote = this.remoteHashes.get(frame);
+      if (remote !== undefined) {
+        this.remoteHashes.delete(frame);
+        this.compareHash(frame, hash, remote);
+      }
+    }
+
+    for (const frame of this.localHashes.keys()) {
+      if (this.localHashes.size <= KEPT_HASHES) break;
+      this.localHashes.delete(frame);
+    }
+    for (const frame of this.remoteHashes.keys()) {
+      if (frame >= confirmed - this.hashInterval * KEPT_HASHES) break;
+      this.remoteHashes.delete(frame);   // Never simulated here
+    }
+  }
+
+  private compareHash(frame: number, local: number, remote: number): void {
+    this.stats.hashChecks++;
+    if (local !== remote) {
+      this.stats.desyncs++;
+      if (this.stats.desyncFrame < 0) {
+        this.stats.desyncFrame = frame;
+        console.warn(`[Rollback] Desync at frame ${frame}: ${local.toString(16)} vs ${remote.toString(16)}`);
+      }
+    } else if (frame > this.stats.desyncFrame) {
+      this.stats.desyncFrame = -1;   // The other peer resynced
+    }
+  }
+
+  /**
+   * Run `from` up to the present again after restore(from)
+   */
+  private resimulate(from: number): void {
+    // The frames being replayed were already shown and heard; only the next
+    // one is displayed, and getAudioBuffer() only keeps the last frame's samples
+    this.core.setVideoEnabled?.(false);
+    for (let frame = from; frame < this.frame; frame++) {
+      this.simulate(frame);
+    }
+    this.core.setVideoEnabled?.(true);
+  }
+
+  private rollback(): void {
+    const start = performance.now();
+    const from = this.rollbackFrom;
+    this.rollbackFrom = -1;
+
+    this.restore(from);
+    this.resimulate(from);
+
+    const frames = this.frame - from;
+    this.stats.rollbacks++;
+    this.stats.resimulatedFrames += frames;
+    this.stats.lastRollbackFrames = frames;
+    this.stats.rollbackMicros = (performance.now() - start) * 1000;
+  }
+}
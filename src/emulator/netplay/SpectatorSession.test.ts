@@ -0,0 +1,170 @@
+import { describe, it, expect } from 'vitest';
+import { NesCore } from '../NesCore';
+import { SpectatorSession, decodeSpectatorStart, encodeSpectatorStart } from './SpectatorSession';
+
+// Deterministic stand-in: the state is a hash of every frame's inputs
+function fakeCore() {
+  const ports = [0, 0];
+  const queued: number[][] = [];
+  const core = {
+    state: 1,
+    frames: 0,
+    renderedFrames: 0,
+    video: true,
+    getRomHash: () => 0xC0FFEE,
+    getFrameCount: () => core.frames,
+    saveState: () => new Uint8Array(new Uint32Array([core.state, core.frames]).buffer),
+    loadState: (state: Uint8Array) => {
+      const words = new Uint32Array(state.slice().buffer);
+      core.state = words[0];
+      core.frames = words[1];
+      return true;
+    },
+    queueInputs: (events: Uint8Array) => {
+      const view = new DataView(events.buffer, events.byteOffset, events.length);
+      for (let offset = 0; offset < events.length; offset += 8) {
+        queued.push([view.getUint32(offset, true), events[offset + 4], events[offset + 5]]);
+      }
+      return events.length / 8;
+    },
+    setPortButtons: (port: number, mask: number) => {
+      ports[port] = mask;
+    },
+    setVideoEnabled: (enabled: boolean) => {
+      core.video = enabled;
+    },
+    frame: () => {
+      for (const [frame, port, mask] of queued.splice(0)) {
+        if (frame === core.frames) ports[port] = mask;
+      }
+      core.state = (Math.imul(core.state, 31) + ports[0] * 7 + ports[1] * 13 + 1) >>> 0;
+      core.frames++;
+      if (core.video) core.renderedFrames++;
+    },
+  };
+  return core;
+}
+
+// Same core with the batched call
+function batchingCore() {
+  const core = fakeCore();
+  let calls = 0;
+  return Object.assign(core, {
+    runFrames: (count: number, inputs: Uint8Array) => {
+      calls++;
+      for (let i = 0; i < count; i++) {
+        core.setPortButtons(0, inputs[i * 4]);
+        core.setPortButtons(1, inputs[i * 4 + 1]);
+        core.frame();
+      }
+      return count;
+    },
+    runFramesCalls: () => calls,
+  });
+}
+
+const input = (player: number, frame: number) => (frame * (player + 3)) & 0xFF;
+
+// Host core run to `frames` with the test inputs
+function host(frames: number) {
+  const core = fakeCore();
+  for (let frame = 0; frame < frames; frame++) {
+    core.setPortButtons(0, input(0, frame));
+    core.setPortButtons(1, input(1, frame));
+    core.frame();
+  }
+  return core;
+}
+
+describe('SpectatorSession', () => {
+  it('round-trips the start message', () => {
+    const start = { players: 2, romHash: 0xDEADBEEF, frame: 1234, state: new Uint8Array([1, 2, 3]), inputs: [new Uint8Array([4, 5]), new Uint8Array(0)] };
+    const decoded = decodeSpectatorStart(encodeSpectatorStart(start));
+    expect(decoded).toEqual(start);
+    expect(decodeSpectatorStart(new Uint8Array([1, 2, 3]))).toBeNull();
+  });
+
+  it('follows the host from its state and input stream', () => {
+    const hostCore = host(10);
+    const viewer = fakeCore();
+    const session = new SpectatorSession(viewer as unknown as NesCore, 2);
+    expect(session.start({ players: 2, romHash: 0xC0FFEE, frame: 10, state: hostCore.saveState(), inputs: [] })).toBe(true);
+
+    // Host plays on, the spectator receives its inputs one frame at a time
+    let ran = 0;
+    for (let frame = 10; frame < 60; frame++) {
+      hostCore.setPortButtons(0, input(0, frame));
+      hostCore.setPortButtons(1, input(1, frame));
+      hostCore.frame();
+      session.addInput(0, frame, input(0, frame));
+      session.addInput(1, frame, input(1, frame));
+      if (session.advance()) ran++;
+    }
+    // Stays the delay behind: three frames buffered before the first one runs
+    expect(ran).toBe(48);
+    expect(session.getStats().bufferedFrames).toBe(2);
+
+    session.advance();
+    session.advance();
+    expect(viewer.state).toBe(hostCore.state);
+  });
+
+  it('waits for every player and catches up without displaying', () => {
+    const viewer = fakeCore();
+    const session = new SpectatorSession(viewer as unknown as NesCore, 2);
+    session.start({ players: 2, romHash: 0xC0FFEE, frame: 0, state: fakeCore().saveState(), inputs: [] });
+
+    for (let frame = 0; frame < 20; frame++) {
+      session.addInput(0, frame, 1);
+    }
+    expect(session.advance()).toBe(false);
+
+    for (let frame = 0; frame < 3; frame++) {
+      session.addInput(1, frame, 2);
+    }
+    expect(session.advance()).toBe(true);
+    expect(session.getStats().fastForwardFrames).toBe(0);
+
+    for (let frame = 3; frame < 20; frame++) {
+      session.addInput(1, frame, 2);
+    }
+    expect(session.advance()).toBe(true);
+    expect(session.getStats().catchUpFrames).toBe(1);
+    expect(viewer.frames).toBe(3);
+    expect(viewer.renderedFrames).toBe(2);
+  });
+
+  it('fast-forwards a late joiner to live without displaying', () => {
+    // Host state from frame 100, host is already at frame 400
+    const hostCore = host(400);
+    const stateCore = host(100);
+    const backlog = [0, 1].map((player) => Uint8Array.from({ length: 300 }, (_, i) => input(player, 100 + i)));
+
+    const viewer = batchingCore();
+    const session = new SpectatorSession(viewer as unknown as NesCore, 2);
+    // Inputs for frames after the backlog may arrive while the state is in flight
+    session.addInput(0, 400, input(0, 400));
+    session.addInput(1, 400, input(1, 400));
+    expect(session.start({ players: 2, romHash: 0xC0FFEE, frame: 100, state: stateCore.saveState(), inputs: backlog }, performance.now() - 50)).toBe(true);
+
+    expect(session.advance()).toBe(true);
+    const stats = session.getStats();
+    expect(stats.fastForwardFrames).toBe(298);
+    expect(viewer.runFramesCalls()).toBe(1);
+    expect(stats.joinMillis).toBeGreaterThan(49);
+    expect(stats.bufferedFrames).toBe(2);
+    expect(viewer.renderedFrames).toBe(1);
+
+    hostCore.setPortButtons(0, input(0, 400));
+    hostCore.setPortButtons(1, input(1, 400));
+    hostCore.frame();
+    session.advance();
+    session.advance();
+    expect(viewer.state).toBe(hostCore.state);
+  });
+
+  it('refuses a host running another ROM', () => {
+    const session = new SpectatorSession(fakeCore() as unknown as NesCore);
+    expect(session.start({ players: 1, romHash: 1, frame: 0, state: new Uint8Array(8), inputs: [] })).toBe(false);
+  });
+});
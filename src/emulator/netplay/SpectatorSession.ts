@@ -0,0 +1,332 @@
+/**
+ * Input-Stream Spectator
+ *
+ * Instead of watching an encoded video of the host's canvas, a spectator runs
+ * its own core. The host sends one start message (ROM hash, the frame it
+ * starts at, a savestate taken before that frame and the inputs it already
+ * has from there on) and then only the players' per-frame inputs, which the
+ * spectator already receives as netplay input packets. Each frame is run once
+ * every player's input for it is in, a couple of frames behind the newest
+ * input so network jitter does not stall playback. A guest joining a running
+ * game fast-forwards with video off until it is that close to live.
+ *
+ * Start message layout (little-endian):
+ *
+ *   0   u8   packet type (SPECTATOR_START)
+ *   1   u8   players
+ *   2   u16  reserved
+ *   4   u32  ROM hash (NesCore.getRomHash())
+ *   8   u32  frame the state precedes, in input-stream frame numbers
+ *   12  u32  state size
+ *   16  ...  savestate
+ *   then per player: u16 count, masks for frame ... frame + count - 1
+ */
+
+import { NesCore, RUN_FRAMES_PORTS } from '../NesCore';
+import { InputEventBatch, MAX_INPUT_PLAYERS } from './inputProtocol';
+
+export const SPECTATOR_START = 2;
+const START_HEADER_BYTES = 16;
+
+const HISTORY = 1024;              // Frames of input buffered ahead of playback
+const HISTORY_MASK = HISTORY - 1;
+const PENDING_MAX = HISTORY * MAX_INPUT_PLAYERS;
+const FAST_FORWARD_MAX = 600;      // Frames per advance() while joining (bounds the hitch)
+
+export interface SpectatorStart {
+  players: number;
+  romHash: number;
+  frame: number;
+  state: Uint8Array;
+  inputs: Uint8Array[];   // Per player, masks from `frame` on
+}
+
+export function encodeSpectatorStart(start: SpectatorStart): ArrayBuffer {
+  let size = START_HEADER_BYTES + start.state.length;
+  for (let player = 0; player < start.players; player++) {
+    size += 2 + Math.min(0xFFFF, start.inputs[player]?.length ?? 0);
+  }
+
+  const buffer = new ArrayBuffer(size);
+  const bytes = new Uint8Array(buffer);
+  const view = new DataView(buffer);
+  view.setUint8(0, SPECTATOR_START);
+  view.setUint8(1, start.players);
+  view.setUint32(4, start.romHash, true);
+  view.setUint32(8, start.frame, true);
+  view.setUint32(12, start.state.length, true);
+  bytes.set(start.state, START_HEADER_BYTES);
+
+  let offset = START_HEADER_BYTES + start.state.length;
+  for (let player = 0; player < start.players; player++) {
+    const inputs = (start.inputs[player] ?? new Uint8Array(0)).subarray(0, 0xFFFF);
+    view.setUint16(offset, inputs.length, true);
+    bytes.set(inputs, offset + 2);
+    offset += 2 + inputs.length;
+  }
+  return buffer;
+}
+
+/**
+ * @returns null if `data` is not a well-formed start message
+ */
+export function decodeSpectatorStart(data: ArrayBuffer | Uint8Array): SpectatorStart | null {
+  const bytes = data instanceof Uint8Array ? data : new Uint8Array(data);
+  if (bytes.length < START_HEADER_BYTES || bytes[0] !== SPECTATOR_START) {
+    return null;
+  }
+  const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.length);
+  const players = bytes[1];
+  const stateSize = view.getUint32(12, true);
+  if (players < 1 || players > MAX_INPUT_PLAYERS || START_HEADER_BYTES + stateSize > bytes.length) {
+    return null;
+  }
+
+  const inputs: Uint8Array[] = [];
+  let offset = START_HEADER_BYTES + stateSize;
+  for (let player = 0; player < players; player++) {
+    if (offset + 2 > bytes.length) {
+      return null;
+    }
+    const count = view.getUint16(offset, true);
+    if (offset + 2 + count > bytes.length) {
+      return null;
+    }
+    inputs.push(bytes.slice(offset + 2, offset + 2 + count));
+    offset += 2 + count;
+  }
+
+  return {
+    players,
+    romHash: view.getUint32(4, true),
+    frame: view.getUint32(8, true),
+    state: bytes.slice(START_HEADER_BYTES, START_HEADER_BYTES + stateSize),
+    inputs,
+  };
+}
+
+export interface SpectatorStats {
+  frame: number;            // Next input-stream frame to run
+  bufferedFrames: number;   // Frames whose input is complete but not yet run
+  stalls: number;           // advance() calls that had nothing to run
+  catchUpFrames: number;    // Extra frames run (video off) to get back to the target delay
+  fastForwardFrames: number; // Frames run with video off to reach live after joining
+  joinMillis: number;       // Join request to playable (caught up to live), 0 until then
+}
+
+type SpectatorCore = NesCore & Required<Pick<NesCore, 'loadState' | 'queueInputs' | 'getFrameCount'>>;
+
+export class SpectatorSession {
+  readonly delay: number;
+
+  private core: SpectatorCore;
+  private players = 0;
+  private started = false;
+  private playing = false;       // Buffered up to the delay since the last stall
+  private frame = 0;             // Next input-stream frame to run
+  private frameOffset = 0;       // Core frame count minus input-stream frame
+
+  // Per player, indexed by frame & HISTORY_MASK
+  private inputs: Uint8Array[] = [];
+  private inputFrames: Int32Array[] = [];
+  private pending: number[] = [];    // player, frame, mask triples received before start()
+  private batch = new InputEventBatch(MAX_INPUT_PLAYERS);
+  private frameInputs = new Uint8Array(FAST_FORWARD_MAX * RUN_FRAMES_PORTS);   // runFrames() layout
+
+  private joining = false;
+  private joinStartedAt = 0;
+
+  private stats: SpectatorStats = {
+    frame: 0,
+    bufferedFrames: 0,
+    stalls: 0,
+    catchUpFrames: 0,
+    fastForwardFrames: 0,
+    joinMillis: 0,
+  };
+
+  /**
+   * @param delay Frames of complete input kept in hand before playing
+   */
+  constructor(core: NesCore, delay = 2) {
+    if (!core.loadState || !core.queueInputs || !core.getFrameCount) {
+      throw new Error('Spectating needs a core with savestates and queued input');
+    }
+    this.core = core as SpectatorCore;
+    this.delay = Math.max(0, Math.floor(delay));
+  }
+
+  /**
+   * Load the host's state and the inputs sent with it. The core must already
+   * have the same ROM loaded.
+   * @param joinStartedAt performance.now() when the join was requested; the
+   *        time until playback is live is reported as joinMillis
+   * @returns false if the ROM differs or the state was rejected
+   */
+  start(message: SpectatorStart, joinStartedAt = performance.now()): boolean {
+    if (this.core.getRomHash && this.core.getRomHash() !== message.romHash) {
+      console.warn('[Spectator] ROM does not match the host\'s');
+      return false;
+    }
+    if (!this.core.loadState(message.state)) {
+      console.warn('[Spectator] Host state rejected');
+      return false;
+    }
+
+    this.players = message.players;
+    this.frame = message.frame;
+    this.frameOffset = this.core.getFrameCount() - message.frame;
+    this.inputs = [];
+    this.inputFrames = [];
+    for (let player = 0; player < this.players; player++) {
+      this.inputs.push(new Uint8Array(HISTORY));
+      this.inputFrames.push(new Int32Array(HISTORY).fill(-1));
+    }
+    this.started = true;
+    this.playing = false;
+    this.joining = true;
+    this.joinStartedAt = joinStartedAt;
+    this.stats.joinMillis = 0;
+
+    message.inputs.forEach((masks, player) => {
+      masks.forEach((mask, i) => this.addInput(player, message.frame + i, mask));
+    });
+    for (let i = 0; i < this.pending.length; i += 3) {
+      this.addInput(this.pending[i], this.pending[i + 1], this.pending[i + 2]);
+    }
+    this.pending = [];
+    return true;
+  }
+
+  /**
+   * Record a player's input (0-based port). Input arriving before start() is
+   * held until the state it follows is known; input for frames already run
+   * is ignored.
+   */
+  addInput(player: number, frame: number, mask: number): void {
+    if (!this.started) {
+      if (this.pending.length < PENDING_MAX * 3) {
+        this.pending.push(player, frame, mask);
+      }
+      return;
+    }
+    if (player < 0 || player >= this.players || frame < this.frame || frame >= this.frame + HISTORY) {
+      return;
+    }
+    this.inputs[player][frame & HISTORY_MASK] = mask;
+    this.inputFrames[player][frame & HISTORY_MASK] = frame;
+  }
+
+  /**
+   * Run the next frame if its input is complete, call once per display frame.
+   * Right after start() everything but the target delay is fast-forwarded
+   * with video off. Later, playback falls back to the delay after a stall
+   * and catches up (one extra frame per call, not displayed) when input
+   * piles up.
+   * @returns false if nothing was run
+   */
+  advance(): boolean {
+    if (!this.started) {
+      return false;
+    }
+
+    let buffered = this.bufferedFrames();
+    if (this.joining) {
+      buffered = this.fastForward(buffered);
+    }
+    if (buffered === 0 || (!this.playing && buffered <= this.delay)) {
+      this.playing = false;
+      this.stats.stalls++;
+      return false;
+    }
+    this.playing = true;
+
+    if (buffered > this.delay * 2 + 2) {
+      this.core.setVideoEnabled?.(false);
+      this.runFrame();
+      this.core.setVideoEnabled?.(true);
+      this.stats.catchUpFrames++;
+    }
+    this.runFrame();
+    return true;
+  }
+
+  getStats(): SpectatorStats {
+    this.stats.frame = this.frame;
+    this.stats.bufferedFrames = this.started ? this.bufferedFrames() : 0;
+    return this.stats;
+  }
+
+  /**
+   * Run the frames that put a joining spectator behind live by more than the
+   * delay, without rendering them
+   * @returns Frames still buffered
+   */
+  private fastForward(buffered: number): number {
+    const frames = Math.min(buffered - (this.delay + 1), FAST_FORWARD_MAX);
+    if (frames > 0) {
+      this.core.setVideoEnabled?.(false);
+      if (this.core.runFrames) {
+        this.runFrames(frames);
+      } else {
+        for (let i = 0; i < frames; i++) {
+          this.runFrame();
+        }
+      }
+      this.core.setVideoEnabled?.(true);
+      this.stats.fastForwardFrames += frames;
+      buffered -= frames;
+    }
+
+    // Live: the frame about to be displayed is exactly the delay behind
+    if (buffered === this.delay + 1) {
+      this.joining = false;
+      this.stats.joinMillis = performance.now() - this.joinStartedAt;
+    }
+    return buffered;
+  }
+
+  /**
+   * Consecutive frames from the next one whose input is complete
+   */
+  private bufferedFrames(): number {
+    let count = 0;
+    for (; count < HISTORY; count++) {
+      const frame = this.frame + count;
+      for (let player = 0; player < this.players; player++) {
+        if (this.inputFrames[player][frame & HISTORY_MASK] !== frame) {
+          return count;
+        }
+      }
+    }
+    return count;
+  }
+
+  /**
+   * Run `count` buffered frames in one core call, sound only for the last
+   */
+  private runFrames(count: number): void {
+    const inputs = this.frameInputs.subarray(0, count * RUN_FRAMES_PORTS);
+    inputs.fill(0);
+    for (let i = 0; i < count; i++) {
+      const slot = (this.frame + i) & HISTORY_MASK;
+      for (let player = 0; player < this.players; player++) {
+        inputs[i * RUN_FRAMES_PORTS + player] = this.inputs[player][slot];
+      }
+    }
+    this.core.runFrames!(count, inputs, { audioLastOnly: true });
+    this.frame += count;
+  }
+
+  private runFrame(): void {
+    const slot = this.frame & HISTORY_MASK;
+    for (let player = 0; player < this.players; player++) {
+      this.batch.add(this.frame + this.frameOffset, player, this.inputs[player][slot]);
+    }
+    this.core.queueInputs(this.batch.data);
+    this.batch.clear();
+
+    this.core.frame();
+    this.frame++;
+  }
+}
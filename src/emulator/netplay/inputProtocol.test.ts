@@ -0,0 +1,75 @@
+import { describe, it, expect } from 'vitest';
+import { InputEventBatch, InputPacketReader, InputPacketWriter, buttonBit, INPUT_HEADER_BYTES } from './inputProtocol';
+
+function collect(reader: InputPacketReader, packet: ArrayBuffer) {
+  const inputs: number[][] = [];
+  reader.read(packet, (player, frame, mask) => inputs.push([player, frame, mask]));
+  return inputs;
+}
+
+describe('inputProtocol', () => {
+  it('maps button names to setButton() bits', () => {
+    expect(buttonBit('Right')).toBe(0x01);
+    expect(buttonBit('A')).toBe(0x80);
+    expect(buttonBit('Turbo')).toBe(0);
+  });
+
+  it('carries the last frames redundantly in a small packet', () => {
+    const writer = new InputPacketWriter(2, 4);
+    let packet = writer.push(0, 0x10);
+    expect(packet.byteLength).toBe(INPUT_HEADER_BYTES + 1);
+
+    for (let frame = 1; frame < 10; frame++) {
+      packet = writer.push(frame, frame);
+    }
+    expect(packet.byteLength).toBe(INPUT_HEADER_BYTES + 4);
+    expect(Array.from(new Uint8Array(packet, INPUT_HEADER_BYTES))).toEqual([6, 7, 8, 9]);
+  });
+
+  it('recovers lost packets from later ones and drops duplicates', () => {
+    const writer = new InputPacketWriter(3, 8);
+    const reader = new InputPacketReader();
+    const packets = Array.from({ length: 12 }, (_, frame) => writer.push(frame, frame * 5).slice());
+
+    expect(collect(reader, packets[0])).toEqual([[3, 0, 0]]);
+    // Frames 1-4 lost, frame 5 fills them in
+    expect(collect(reader, packets[5])).toEqual([[3, 1, 5], [3, 2, 10], [3, 3, 15], [3, 4, 20], [3, 5, 25]]);
+    // Late and duplicate packets carry nothing new
+    expect(collect(reader, packets[3])).toEqual([]);
+    expect(collect(reader, packets[5])).toEqual([]);
+    expect(collect(reader, packets[6])).toEqual([[3, 6, 30]]);
+  });
+
+  it('accepts a restarted stream after resetPlayer()', () => {
+    const reader = new InputPacketReader();
+    const first = new InputPacketWriter(1, 4);
+    for (let frame = 0; frame < 10; frame++) {
+      collect(reader, first.push(frame, 1));
+    }
+
+    // The guest reconnects and numbers its frames from 0 again
+    const rejoined = new InputPacketWriter(1, 4);
+    expect(collect(reader, rejoined.push(0, 2))).toEqual([]);
+
+    reader.resetPlayer(1);
+    expect(collect(reader, rejoined.push(1, 3))).toEqual([[1, 0, 2], [1, 1, 3]]);
+  });
+
+  it('rejects malformed packets', () => {
+    const reader = new InputPacketReader();
+    expect(reader.read(new Uint8Array([1, 2, 0, 0, 0, 0, 3, 0]), () => {})).toBe(false);
+    expect(reader.read(new Uint8Array([7, 2, 0, 0, 0, 0, 1, 0]), () => {})).toBe(false);
+    expect(reader.read(new Uint8Array([1, 9, 0, 0, 0, 0, 1, 0]), () => {})).toBe(false);
+  });
+
+  it('batches received inputs in the core queue record layout', () => {
+    const batch = new InputEventBatch(1);
+    batch.add(0x01020304, 1, 0x81);
+    batch.add(7, 0, 0x10, 0x105);
+
+    expect(batch.length).toBe(2);
+    expect(Array.from(batch.data)).toEqual([4, 3, 2, 1, 1, 0x81, 0, 0, 7, 0, 0, 0, 0, 0x10, 5, 1]);
+    batch.clear();
+    expect(batch.data.length).toBe(0);
+  });
+});
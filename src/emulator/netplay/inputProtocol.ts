@@ -0,0 +1,169 @@
+/**
+ * Binary Netplay Input Protocol
+ *
+ * One packet per frame carries a player's button mask for that frame plus the
+ * masks of the frames before it, so a lost packet is repaired by any of the
+ * next few and the channel can run unordered without retransmits:
+ *
+ *   0  u8   packet type (INPUT_PACKET)
+ *   1  u8   player (1-4)
+ *   2  u32  frame of the newest mask (little-endian)
+ *   6  u8   count
+ *   7  u8[count] masks, oldest first: frame - count + 1 ... frame
+ *
+ * Masks use setButton() bit order. With the default redundancy a packet is
+ * 15 bytes.
+ */
+
+export const INPUT_PACKET = 1;
+export const INPUT_HEADER_BYTES = 7;
+export const INPUT_REDUNDANCY = 8;    // Frames per packet
+export const MAX_INPUT_PLAYERS = 4;
+
+// Button names as used by 'remoteInput' events, in setButton() bit order
+export const BUTTON_NAMES = ['Right', 'Left', 'Down', 'Up', 'Start', 'Select', 'B', 'A'] as const;
+
+export function buttonBit(name: string): number {
+  const index = BUTTON_NAMES.indexOf(name as typeof BUTTON_NAMES[number]);
+  return index < 0 ? 0 : 1 << index;
+}
+
+/**
+ * Builds one player's packets. Returned buffers are reused by later push()
+ * calls; RTCDataChannel.send() copies them.
+ */
+export class InputPacketWriter {
+  private player: number;
+  private redundancy: number;
+  private history: Uint8Array;
+  private buffers: ArrayBuffer[] = [];  // One exact-size packet per mask count
+  private newestFrame = -1;
+  private count = 0;
+
+  constructor(player: number, redundancy = INPUT_REDUNDANCY) {
+    this.player = player;
+    this.redundancy = Math.min(255, Math.max(1, redundancy));
+    this.history = new Uint8Array(this.redundancy);
+    for (let count = 0; count <= this.redundancy; count++) {
+      this.buffers.push(new ArrayBuffer(INPUT_HEADER_BYTES + count));
+    }
+  }
+
+  /**
+   * Record the mask for `frame` (one more than the previous frame, or a new
+   * start) and build the packet that carries it
+   */
+  push(frame: number, mask: number): ArrayBuffer {
+    if (frame !== this.newestFrame + 1) {
+      this.count = 0;   // Non-consecutive: earlier masks no longer line up
+    }
+    this.history[frame % this.redundancy] = mask & 0xFF;
+    this.newestFrame = frame;
+    this.count = Math.min(this.count + 1, this.redundancy);
+
+    const count = this.count;
+    const buffer = this.buffers[count];
+    const packet = new Uint8Array(buffer);
+    packet[0] = INPUT_PACKET;
+    packet[1] = this.player;
+    new DataView(buffer).setUint32(2, frame, true);
+    packet[6] = count;
+    for (let i = 0; i < count; i++) {
+      packet[INPUT_HEADER_BYTES + i] = this.history[(frame - count + 1 + i) % this.redundancy];
+    }
+    return buffer;
+  }
+}
+
+/**
+ * Turns packets from any number of players back into one input per frame,
+ * delivered once each and in frame order per player
+ */
+export class InputPacketReader {
+  private newest = new Float64Array(MAX_INPUT_PLAYERS + 1).fill(-1);
+
+  /**
+   * @returns false if `data` is not a well-formed input packet
+   */
+  read(data: ArrayBuffer | Uint8Array, onInput: (player: number, frame: number, mask: number) => void): boolean {
+    const bytes = data instanceof Uint8Array ? data : new Uint8Array(data);
+    if (bytes.length < INPUT_HEADER_BYTES || bytes[0] !== INPUT_PACKET) {
+      return false;
+    }
+    const player = bytes[1];
+    const count = bytes[6];
+    if (player < 1 || player > MAX_INPUT_PLAYERS || count === 0 || bytes.length < INPUT_HEADER_BYTES + count) {
+      return false;
+    }
+
+    const frame = new DataView(bytes.buffer, bytes.byteOffset).getUint32(2, true);
+    const first = frame - count + 1;
+    // Packets that arrive late carry nothing newer; the next ones cover gaps
+    for (let f = Math.max(first, this.newest[player] + 1); f <= frame; f++) {
+      onInput(player, f, bytes[INPUT_HEADER_BYTES + f - first]);
+    }
+    if (frame > this.newest[player]) {
+      this.newest[player] = frame;
+    }
+    return true;
+  }
+
+  /**
+   * Forget a player's stream (they left or restarted their frame count)
+   */
+  resetPlayer(player: number): void {
+    this.newest[player] = -1;
+  }
+}
+
+export const INPUT_EVENT_BYTES = 8;
+
+/**
+ * Collects received inputs in the record layout NesCore.queueInputs() takes
+ * (u32 frame, u8 port, u8 mask, u16 scanline), so a packet's frames reach
+ * the core in one call
+ */
+export class InputEventBatch {
+  private bytes: Uint8Array;
+  private view: DataView;
+  private count = 0;
+
+  constructor(capacity = 64) {
+    this.bytes = new Uint8Array(capacity * INPUT_EVENT_BYTES);
+    this.view = new DataView(this.bytes.buffer);
+  }
+
+  /**
+   * @param scanline Scanline within the frame the buttons change on; 0 (the
+   *        frame's start) for netplay, where only whole frames are exchanged
+   */
+  add(frame: number, port: number, mask: number, scanline = 0): void {
+    if ((this.count + 1) * INPUT_EVENT_BYTES > this.bytes.length) {
+      const grown = new Uint8Array(this.bytes.length * 2);
+      grown.set(this.bytes);
+      this.bytes = grown;
+      this.view = new DataView(grown.buffer);
+    }
+    const offset = this.count * INPUT_EVENT_BYTES;
+    this.view.setUint32(offset, frame, true);
+    this.bytes[offset + 4] = port;
+    this.bytes[offset + 5] = mask;
+    this.view.setUint16(offset + 6, scanline, true);
+    this.count++;
+  }
+
+  get length(): number {
+    return this.count;
+  }
+
+  /**
+   * Records added since the last clear(); valid until the next add()
+   */
+  get data(): Uint8Array {
+    return this.bytes.subarray(0, this.count * INPUT_EVENT_BYTES);
+  }
+
+  clear(): void {
+    this.count = 0;
+  }
+}
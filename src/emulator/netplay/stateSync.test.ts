@@ -0,0 +1,23 @@
+import { describe, it, expect } from 'vitest';
+import { decodeResyncPatch, decodeResyncRequest, decodeStateHash, encodeResyncPatch, encodeResyncRequest, encodeStateHash } from './stateSync';
+
+describe('stateSync', () => {
+  it('round-trips hash, resync request and patch messages', () => {
+    const hash = { player: 2, frame: 600, hash: 0xDEADBEEF };
+    expect(encodeStateHash(hash).byteLength).toBe(12);
+    expect(decodeStateHash(encodeStateHash(hash))).toEqual(hash);
+
+    const request = { frame: 1234, hashes: new Uint32Array([1, 0xFFFFFFFF, 3]) };
+    expect(decodeResyncRequest(encodeResyncRequest(request))).toEqual(request);
+
+    const resync = { frame: 99, patch: new Uint8Array([5, 6, 7]) };
+    expect(decodeResyncPatch(encodeResyncPatch(resync))).toEqual(resync);
+  });
+
+  it('tells message types apart', () => {
+    const hash = encodeStateHash({ player: 1, frame: 1, hash: 1 });
+    expect(decodeResyncRequest(hash)).toBeNull();
+    expect(decodeStateHash(new Uint8Array([1, 1, 0, 0, 0, 0, 1, 0]))).toBeNull();
+    expect(decodeResyncRequest(new Uint8Array([6, 4, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4]))).toBeNull();
+  });
+});
@@ -0,0 +1,107 @@
+/**
+ * Desync Detection Messages
+ *
+ * Rollback peers exchange the hash of their confirmed state every few frames
+ * (RollbackSession hashInterval). When hashes differ the desynced guest sends
+ * the host its per-page hashes for a confirmed frame and gets back a patch
+ * holding only the pages that differ, instead of a full savestate.
+ *
+ *   STATE_HASH (12 bytes, 'inputs' channel; a lost one skips one check):
+ *     0 u8 type, 1 u8 player (1-4), 2 u16 reserved, 4 u32 frame, 8 u32 hash
+ *   RESYNC_REQUEST ('spectate' channel):
+ *     0 u8 type, 1 u8 page count, 2 u16 reserved, 4 u32 frame, 8 u32[count] page hashes
+ *   RESYNC_PATCH ('spectate' channel, sent with encodeTransfer()):
+ *     0 u8 type, 1-3 reserved, 4 u32 frame, 8 ... NesCore.saveStatePatch() bytes
+ */
+
+export const STATE_HASH = 5;
+export const RESYNC_REQUEST = 6;
+export const RESYNC_PATCH = 7;
+const HEADER_BYTES = 8;
+
+export interface StateHash {
+  player: number;
+  frame: number;
+  hash: number;
+}
+
+export interface ResyncRequest {
+  frame: number;
+  hashes: Uint32Array;
+}
+
+export interface ResyncPatch {
+  frame: number;
+  patch: Uint8Array;
+}
+
+function header(type: number, size: number, frame: number): { bytes: Uint8Array; view: DataView } {
+  const bytes = new Uint8Array(size);
+  const view = new DataView(bytes.buffer);
+  bytes[0] = type;
+  view.setUint32(4, frame, true);
+  return { bytes, view };
+}
+
+function open(data: ArrayBuffer | Uint8Array, type: number): { bytes: Uint8Array; view: DataView } | null {
+  const bytes = data instanceof Uint8Array ? data : new Uint8Array(data);
+  if (bytes.length < HEADER_BYTES || bytes[0] !== type) {
+    return null;
+  }
+  return { bytes, view: new DataView(bytes.buffer, bytes.byteOffset, bytes.length) };
+}
+
+export function encodeStateHash(message: StateHash): ArrayBuffer {
+  const { bytes, view } = header(STATE_HASH, HEADER_BYTES + 4, message.frame);
+  bytes[1] = message.player;
+  view.setUint32(8, message.hash, true);
+  return bytes.buffer;
+}
+
+/**
+ * @returns null if `data` is not a well-formed STATE_HASH message
+ */
+export function decodeStateHash(data: ArrayBuffer | Uint8Array): StateHash | null {
+  const message = open(data, STATE_HASH);
+  if (!message || message.bytes.length < HEADER_BYTES + 4) {
+    return null;
+  }
+  return { player: message.bytes[1], frame: message.view.getUint32(4, true), hash: message.view.getUint32(8, true) };
+}
+
+export function encodeResyncRequest(request: ResyncRequest): ArrayBuffer {
+  const count = Math.min(255, request.hashes.length);
+  const { bytes, view } = header(RESYNC_REQUEST, HEADER_BYTES + count * 4, request.frame);
+  bytes[1] = count;
+  for (let i = 0; i < count; i++) {
+    view.setUint32(HEADER_BYTES + i * 4, request.hashes[i], true);
+  }
+  return bytes.buffer;
+}
+
+export function decodeResyncRequest(data: ArrayBuffer | Uint8Array): ResyncRequest | null {
+  const message = open(data, RESYNC_REQUEST);
+  const count = message ? message.bytes[1] : 0;
+  if (!message || message.bytes.length < HEADER_BYTES + count * 4) {
+    return null;
+  }
+  const hashes = new Uint32Array(count);
+  for (let i = 0; i < count; i++) {
+    hashes[i] = message.view.getUint32(HEADER_BYTES + i * 4, true);
+  }
+  return { frame: message.view.getUint32(4, true), hashes };
+}
+
+export function encodeResyncPatch(resync: ResyncPatch): Uint8Array {
+  const { bytes } = header(RESYNC_PATCH, HEADER_BYTES + resync.patch.length, resync.frame);
+  bytes.set(resync.patch, HEADER_BYTES);
+  return bytes;
+}
+
+export function decodeResyncPatch(data: ArrayBuffer | Uint8Array): ResyncPatch | null {
+  const message = open(data, RESYNC_PATCH);
+  if (!message) {
+    return null;
+  }
+  return { frame: message.view.getUint32(4, true), patch: message.bytes.slice(HEADER_BYTES) };
+}
@@ -0,0 +1,44 @@
+import { describe, it, expect } from 'vitest';
+import { TransferAssembler, decodeJoinState, encodeJoinState, JOIN_STATE_CHUNK } from './stateTransfer';
+
+describe('stateTransfer', () => {
+  it('sends a compressed state in channel-sized chunks', async () => {
+    // Savestates are mostly zeroes: random bytes in one of every 8
+    const state = new Uint8Array(40000);
+    let seed = 1;
+    for (let i = 0; i < state.length; i += 8) {
+      seed = (Math.imul(seed, 1103515245) + 12345) >>> 0;
+      state[i] = seed >>> 24;
+    }
+    const start = { players: 2, romHash: 0x12345678, frame: 999, state, inputs: [new Uint8Array(60).fill(1), new Uint8Array(60)] };
+
+    const chunks = await encodeJoinState(start, 3, 1024);
+    expect(chunks.length).toBeGreaterThan(1);
+    for (const chunk of chunks) {
+      expect(chunk.byteLength <= 1024).toBe(true);
+      expect(new Uint8Array(chunk)[0]).toBe(JOIN_STATE_CHUNK);
+    }
+
+    const assembler = new TransferAssembler();
+    let transfer = null;
+    for (const chunk of chunks) {
+      transfer = await assembler.add(chunk);
+    }
+    const joined = transfer && decodeJoinState(transfer);
+    expect(joined?.start).toEqual(start);
+    expect(joined!.compressedBytes < state.length / 4).toBe(true);
+    expect(joined!.chunks).toBe(chunks.length);
+  });
+
+  it('drops an unfinished transfer when a newer one starts', async () => {
+    const start = { players: 1, romHash: 1, frame: 5, state: new Uint8Array([1, 2, 3]), inputs: [new Uint8Array([9])] };
+    const stale = await encodeJoinState({ ...start, frame: 4, state: crypto.getRandomValues(new Uint8Array(4000)) }, 1, 1024);
+    const fresh = await encodeJoinState(start, 2, 1024);
+
+    const assembler = new TransferAssembler();
+    expect(await assembler.add(stale[0])).toBeNull();
+    const transfer = await assembler.add(fresh[0]);
+    expect(transfer && decodeJoinState(transfer)?.start).toEqual(start);
+    expect(await assembler.add(new Uint8Array([JOIN_STATE_CHUNK, 0]))).toBeNull();
+  });
+});
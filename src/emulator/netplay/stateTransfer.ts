@@ -0,0 +1,165 @@
+/**
+ * Late-Join State Transfer
+ *
+ * A guest joining a running game sends JOIN_REQUEST on the 'spectate'
+ * channel (u8 type, u8 1 to watch or 0 to play its port). The host answers
+ * with a spectator start message (savestate plus the inputs it has since the
+ * state's frame). That message, and any other larger than a DataChannel
+ * message (e.g. a resync patch), is deflated with CompressionStream and split
+ * into chunks that fit the message limits:
+ *
+ *   0   u8   packet type (JOIN_STATE_CHUNK)
+ *   1   u8   transfer id (a newer transfer replaces an unfinished one)
+ *   2   u16  chunk index
+ *   4   u16  chunk count
+ *   6   u16  reserved
+ *   8   u32  uncompressed size
+ *   12  ...  compressed bytes
+ *
+ * The channel is reliable and ordered, so chunks arrive complete and in order.
+ */
+
+import { type SpectatorStart, decodeSpectatorStart, encodeSpectatorStart } from './SpectatorSession';
+
+export const JOIN_REQUEST = 3;
+export const JOIN_STATE_CHUNK = 4;
+export const JOIN_CHUNK_BYTES = 16 * 1024;   // Message size every browser pair accepts
+const CHUNK_HEADER_BYTES = 12;
+
+async function transform(data: Uint8Array, stream: CompressionStream | DecompressionStream): Promise<Uint8Array> {
+  const writer = stream.writable.getWriter();
+  writer.write(data as BufferSource).catch(() => {});
+  writer.close().catch(() => {});
+  return new Uint8Array(await new Response(stream.readable).arrayBuffer());
+}
+
+export function deflate(data: Uint8Array): Promise<Uint8Array> {
+  return transform(data, new CompressionStream('deflate'));
+}
+
+export function inflate(data: Uint8Array): Promise<Uint8Array> {
+  return transform(data, new DecompressionStream('deflate'));
+}
+
+export function joinRequest(spectate = false): ArrayBuffer {
+  return new Uint8Array([JOIN_REQUEST, spectate ? 1 : 0]).buffer;
+}
+
+/**
+ * Compress a message and split it into channel-sized chunks
+ */
+export async function encodeTransfer(message: Uint8Array, transferId = 0, chunkBytes = JOIN_CHUNK_BYTES): Promise<ArrayBuffer[]> {
+  const compressed = await deflate(message);
+
+  const payload = Math.max(1, chunkBytes - CHUNK_HEADER_BYTES);
+  const count = Math.max(1, Math.ceil(compressed.length / payload));
+  const chunks: ArrayBuffer[] = [];
+  for (let index = 0; index < count; index++) {
+    const part = compressed.subarray(index * payload, (index + 1) * payload);
+    const chunk = new Uint8Array(CHUNK_HEADER_BYTES + part.length);
+    const view = new DataView(chunk.buffer);
+    chunk[0] = JOIN_STATE_CHUNK;
+    chunk[1] = transferId & 0xFF;
+    view.setUint16(2, index, true);
+    view.setUint16(4, count, true);
+    view.setUint32(8, message.length, true);
+    chunk.set(part, CHUNK_HEADER_BYTES);
+    chunks.push(chunk.buffer);
+  }
+  return chunks;
+}
+
+export function encodeJoinState(start: SpectatorStart, transferId = 0, chunkBytes = JOIN_CHUNK_BYTES): Promise<ArrayBuffer[]> {
+  return encodeTransfer(new Uint8Array(encodeSpectatorStart(start)), transferId, chunkBytes);
+}
+
+export interface Transfer {
+  message: Uint8Array;      // Reassembled and inflated; its first byte is the message type
+  compressedBytes: number;  // Bytes transferred (without chunk headers)
+  chunks: number;
+  transferMillis: number;   // First chunk to decoded message
+}
+
+export interface JoinState {
+  start: SpectatorStart;
+  bytes: number;            // Start message size
+  compressedBytes: number;  // Bytes transferred (without chunk headers)
+  chunks: number;
+  transferMillis: number;   // First chunk to decoded message
+}
+
+/**
+ * @returns null if the transfer is not a well-formed start message
+ */
+export function decodeJoinState(transfer: Transfer): JoinState | null {
+  const start = decodeSpectatorStart(transfer.message);
+  if (!start) {
+    return null;
+  }
+  const { compressedBytes, chunks, transferMillis } = transfer;
+  return { start, bytes: transfer.message.length, compressedBytes, chunks, transferMillis };
+}
+
+/**
+ * Collects JOIN_STATE_CHUNK messages on the receiving side
+ */
+export class TransferAssembler {
+  private transferId = -1;
+  private parts: Uint8Array[] = [];
+  private received = 0;
+  private firstChunkAt = 0;
+
+  /**
+   * @returns The message once its last chunk is in, otherwise null (also
+   *          for malformed or corrupt transfers)
+   */
+  async add(data: ArrayBuffer | Uint8Array): Promise<Transfer | null> {
+    const bytes = data instanceof Uint8Array ? data : new Uint8Array(data);
+    if (bytes.length < CHUNK_HEADER_BYTES || bytes[0] !== JOIN_STATE_CHUNK) {
+      return null;
+    }
+    const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.length);
+    const index = view.getUint16(2, true);
+    const count = view.getUint16(4, true);
+    const size = view.getUint32(8, true);
+    if (index >= count) {
+      return null;
+    }
+
+    if (bytes[1] !== this.transferId || this.parts.length !== count) {
+      this.transferId = bytes[1];
+      this.parts = new Array(count);
+      this.received = 0;
+      this.firstChunkAt = performance.now();
+    }
+    if (!this.parts[index]) {
+      this.received++;
+    }
+    this.parts[index] = bytes.slice(CHUNK_HEADER_BYTES);
+    if (this.received < count) {
+      return null;
+    }
+
+    const compressedBytes = this.parts.reduce((total, part) => total + part.length, 0);
+    const compressed = new Uint8Array(compressedBytes);
+    let offset = 0;
+    for (const part of this.parts) {
+      compressed.set(part, offset);
+      offset += part.length;
+    }
+    this.transferId = -1;
+    this.parts = [];
+
+    try {
+      const message = await inflate(compressed);
+      if (message.length !== size) {
+        console.warn('[Transfer] Corrupt state transfer');
+        return null;
+      }
+      return { message, compressedBytes, chunks: count, transferMillis: performance.now() - this.firstChunkAt };
+    } catch (err) {
+      console.warn('[Transfer] Failed to inflate state transfer:', err);
+      return null;
+    }
+  }
+}
@@ -0,0 +1,81 @@
+import { describe, it, expect } from 'vitest';
+import { NesCore } from '../NesCore';
+import { TileVideoReceiver, TileVideoSender } from './tileVideo';
+
+// Stand-in codec: a packet is the frame number, a keyframe flag and padding;
+// a delta only decodes on top of the frame before it
+function fakeCores() {
+  let rendered = 0;
+  let shown = -1;
+  const host = {
+    capturing: false,
+    setTileEncoder: (enabled: boolean) => {
+      host.capturing = enabled;
+    },
+    encodeTileFrame: (keyframe: boolean) => {
+      if (!host.capturing) return null;
+      const packet = new Uint8Array(2000);
+      new DataView(packet.buffer).setUint32(0, rendered, true);
+      packet[4] = keyframe ? 1 : 0;
+      return packet;
+    },
+    frame: () => {
+      rendered++;
+    },
+  };
+  const viewer = {
+    decodeTileFrame: (packet: Uint8Array) => {
+      const frame = new DataView(packet.buffer, packet.byteOffset).getUint32(0, true);
+      if (packet[4] !== 1 && frame !== shown + 1) return false;
+      shown = frame;
+      return true;
+    },
+    shown: () => shown,
+  };
+  return { host, viewer };
+}
+
+describe('tileVideo', () => {
+  it('streams deltas after a keyframe', async () => {
+    const { host, viewer } = fakeCores();
+    const sender = new TileVideoSender(host as unknown as NesCore, 0);
+    const receiver = new TileVideoReceiver(viewer as unknown as NesCore);
+    expect(sender.start()).toBe(true);
+
+    for (let frame = 0; frame < 10; frame++) {
+      host.frame();
+      const chunks = await sender.capture();
+      const results = await Promise.all(chunks!.map((chunk) => receiver.add(chunk)));
+      expect(results[results.length - 1]).toBe('shown');
+      expect(viewer.shown()).toBe(frame + 1);
+    }
+    expect(sender.stats.keyframes).toBe(1);
+    expect(receiver.stats.frames).toBe(10);
+    expect(receiver.stats.sentBytes < receiver.stats.packetBytes / 10).toBe(true);
+  });
+
+  it('asks for a keyframe when joining mid-stream or after a gap', async () => {
+    const { host, viewer } = fakeCores();
+    const sender = new TileVideoSender(host as unknown as NesCore, 0);
+    const receiver = new TileVideoReceiver(viewer as unknown as NesCore);
+    sender.start();
+
+    host.frame();
+    await sender.capture();   // Keyframe the viewer missed
+    host.frame();
+    expect(await receiver.add((await sender.capture())![0])).toBe('needs-keyframe');
+    host.frame();
+    expect(await receiver.add((await sender.capture())![0])).toBe('waiting');
+
+    sender.requestKeyframe();
+    host.frame();
+    expect(await receiver.add((await sender.capture())![0])).toBe('shown');
+
+    // Frame skipped by the host: the next delta does not follow on
+    host.frame();
+    await sender.capture();
+    host.frame();
+    expect(await receiver.add((await sender.capture())![0])).toBe('needs-keyframe');
+    expect(receiver.stats.skipped).toBe(3);
+  });
+});
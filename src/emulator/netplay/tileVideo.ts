@@ -0,0 +1,232 @@
+/**
+ * Tile-Delta Video
+ *
+ * A low-bandwidth alternative to the host's MediaStream for viewers: the host
+ * core encodes each frame as the 8x8 tiles of its palette-index picture that
+ * changed (NesCore.encodeTileFrame()), the viewer's core decodes them into its
+ * own frame buffer (NesCore.decodeTileFrame()). Both ends run the same C
+ * kernels. Packets travel on the reliable, ordered 'tiles' channel, deflated
+ * and chunked with encodeTransfer():
+ *
+ *   TILE_FRAME:
+ *     0 u8 type, 1 u8 flags (bit 0: keyframe), 2 u16 reserved, 4 u32 sequence,
+ *     8 ... encodeTileFrame() packet
+ *   TILE_KEYFRAME_REQUEST (viewer to host, not chunked):
+ *     0 u8 type
+ *
+ * Deltas only apply on top of the previous packet, so a viewer that joins or
+ * sees a gap in the sequence (the host skips frames while the channel is
+ * backed up) shows nothing new until the keyframe it asks for.
+ */
+
+import { NesCore } from '../NesCore';
+import { TransferAssembler, encodeTransfer } from './stateTransfer';
+
+export const TILE_FRAME = 8;
+export const TILE_KEYFRAME_REQUEST = 9;
+const HEADER_BYTES = 8;
+const KEYFRAME_FLAG = 0x01;
+const KEYFRAME_REQUEST_MS = 500;   // At most one request per interval while out of sync
+
+export interface TileFrameMessage {
+  sequence: number;
+  keyframe: boolean;
+  packet: Uint8Array;
+}
+
+export function encodeTileMessage(message: TileFrameMessage): Uint8Array {
+  const bytes = new Uint8Array(HEADER_BYTES + message.packet.length);
+  bytes[0] = TILE_FRAME;
+  bytes[1] = message.keyframe ? KEYFRAME_FLAG : 0;
+  new DataView(bytes.buffer).setUint32(4, message.sequence, true);
+  bytes.set(message.packet, HEADER_BYTES);
+  return bytes;
+}
+
+/**
+ * @returns null if `data` is not a TILE_FRAME message
+ */
+export function decodeTileMessage(data: Uint8Array): TileFrameMessage | null {
+  if (data.length < HEADER_BYTES || data[0] !== TILE_FRAME) {
+    return null;
+  }
+  const view = new DataView(data.buffer, data.byteOffset, data.length);
+  return {
+    sequence: view.getUint32(4, true),
+    keyframe: (data[1] & KEYFRAME_FLAG) !== 0,
+    packet: data.subarray(HEADER_BYTES),
+  };
+}
+
+export function keyframeRequest(): ArrayBuffer {
+  return new Uint8Array([TILE_KEYFRAME_REQUEST]).buffer;
+}
+
+export interface TileVideoStats {
+  frames: number;        // Packets sent or shown
+  keyframes: number;
+  packetBytes: number;   // Average encodeTileFrame() size
+  sentBytes: number;     // Average bytes on the wire (deflated)
+  skipped: number;       // Sender: frames not encoded while the previous one was compressing;
+                         // receiver: packets dropped while out of sync
+}
+
+/**
+ * Running totals behind the TileVideoStats averages
+ */
+class StatsCounter {
+  private packetBytes = 0;
+  private sentBytes = 0;
+  readonly stats: TileVideoStats = { frames: 0, keyframes: 0, packetBytes: 0, sentBytes: 0, skipped: 0 };
+
+  add(keyframe: boolean, packetBytes: number, sentBytes: number): void {
+    const stats = this.stats;
+    stats.frames++;
+    stats.keyframes += keyframe ? 1 : 0;
+    this.packetBytes += packetBytes;
+    this.sentBytes += sentBytes;
+    stats.packetBytes = Math.round(this.packetBytes / stats.frames);
+    stats.sentBytes = Math.round(this.sentBytes / stats.frames);
+  }
+}
+
+/**
+ * Host side: encodes the frame the core just rendered into channel-sized chunks
+ */
+export class TileVideoSender {
+  private sequence = 0;
+  private sinceKeyframe = 0;
+  private keyframePending = true;
+  private busy = false;
+  private counter = new StatsCounter();
+  private readonly core: NesCore;
+  private readonly keyframeInterval: number;
+
+  /**
+   * @param keyframeInterval Frames between unrequested keyframes; 0 sends
+   *        them only when asked
+   */
+  constructor(core: NesCore, keyframeInterval = 600) {
+    this.core = core;
+    this.keyframeInterval = keyframeInterval;
+  }
+
+  /**
+   * Start capturing rendered frames
+   * @returns false if the core has no tile encoder
+   */
+  start(): boolean {
+    if (!this.core.setTileEncoder || !this.core.encodeTileFrame) {
+      return false;
+    }
+    this.core.setTileEncoder(true);
+    this.keyframePending = true;
+    return true;
+  }
+
+  stop(): void {
+    this.core.setTileEncoder?.(false);
+  }
+
+  get stats(): TileVideoStats {
+    return this.counter.stats;
+  }
+
+  /**
+   * Make the next packet a keyframe (a viewer joined or lost a packet)
+   */
+  requestKeyframe(): void {
+    this.keyframePending = true;
+  }
+
+  /**
+   * Encode the last rendered frame; call once after each frame().
+   * Frames are skipped rather than queued while the previous one is still
+   * being compressed, so chunks are produced in order.
+   * @returns Chunks to send on the 'tiles' channel, or null if nothing was encoded
+   */
+  async capture(): Promise<ArrayBuffer[] | null> {
+    if (this.busy) {
+      this.stats.skipped++;
+      return null;
+    }
+    const keyframe = this.keyframePending || (this.keyframeInterval > 0 && this.sinceKeyframe >= this.keyframeInterval);
+    const packet = this.core.encodeTileFrame?.(keyframe);
+    if (!packet) {
+      return null;
+    }
+    this.keyframePending = false;
+    this.sinceKeyframe = keyframe ? 0 : this.sinceKeyframe + 1;
+
+    const sequence = this.sequence;
+    this.sequence = (sequence + 1) >>> 0;
+    this.busy = true;
+    try {
+      const chunks = await encodeTransfer(encodeTileMessage({ sequence, keyframe, packet }), sequence & 0xFF);
+      this.counter.add(keyframe, packet.length, chunks.reduce((total, chunk) => total + chunk.byteLength, 0));
+      return chunks;
+    } finally {
+      this.busy = false;
+    }
+  }
+}
+
+export type TileVideoResult = 'shown' | 'needs-keyframe' | 'waiting';
+
+/**
+ * Viewer side: reassembles packets and decodes them into the core's frame buffer
+ */
+export class TileVideoReceiver {
+  private assembler = new TransferAssembler();
+  private queue: Promise<unknown> = Promise.resolve();
+  private nextSequence = -1;   // -1 until a keyframe has been shown
+  private requestedAt = -Infinity;
+  private counter = new StatsCounter();
+  private readonly core: NesCore;
+
+  constructor(core: NesCore) {
+    this.core = core;
+  }
+
+  get stats(): TileVideoStats {
+    return this.counter.stats;
+  }
+
+  /**
+   * Feed one message from the 'tiles' channel. Messages are processed in
+   * arrival order even though decompression is asynchronous.
+   * @returns 'shown' when a frame was published (read it with
+   *          getLatestFrame()), 'needs-keyframe' when the host should be sent
+   *          keyframeRequest(), otherwise 'waiting'
+   */
+  add(data: ArrayBuffer | Uint8Array): Promise<TileVideoResult> {
+    const result = this.queue.then(() => this.process(data));
+    this.queue = result;
+    return result;
+  }
+
+  private async process(data: ArrayBuffer | Uint8Array): Promise<TileVideoResult> {
+    const transfer = await this.assembler.add(data);
+    const message = transfer && decodeTileMessage(transfer.message);
+    if (!message) {
+      return 'waiting';
+    }
+
+    const inOrder = message.keyframe || message.sequence === this.nextSequence;
+    if (!inOrder || !this.core.decodeTileFrame?.(message.packet)) {
+      this.nextSequence = -1;
+      this.stats.skipped++;
+      const now = performance.now();
+      if (now - this.requestedAt < KEYFRAME_REQUEST_MS) {
+        return 'waiting';
+      }
+      this.requestedAt = now;
+      return 'needs-keyframe';
+    }
+
+    this.nextSequence = (message.sequence + 1) >>> 0;
+    this.requestedAt = -Infinity;
+    this.counter.add(message.keyframe, message.packet.length, transfer.compressedBytes);
+    return 'shown';
+  }
+}
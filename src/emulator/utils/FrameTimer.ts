@@ -1,4 +1,13 @@
 const FPS = 60.098;
+const PACING_HISTORY = 256;      // Frame intervals kept for getPacingStats()
+
+export interface PacingStats {
+  frames: number;            // Frames generated since start()
+  meanMs: number;            // Mean interval between generated frames
+  jitterMs: number;          // Standard deviation of that interval
+  maxMs: number;
+  bursts: number;            // Display ticks that had to catch up several frames
+}
 
 interface FrameTimerProps {
   onGenerateFrame: () => void;
@@ -13,6 +22,12 @@ export default class FrameTimer {
   private lastFrameTime: number | false;
   private running: boolean;
 
+  // Pacing measurements
+  private intervals = new Float64Array(PACING_HISTORY);
+  private frames = 0;
+  private lastGenerated = 0;
+  private bursts = 0;
+
   constructor(props: FrameTimerProps) {
     this.onGenerateFrame = props.onGenerateFrame;
     this.onWriteFrame = props.onWriteFrame;
@@ -24,6 +39,8 @@ export default class FrameTimer {
 
   start() {
     this.running = true;
+    this.frames = 0;
+    this.bursts = 0;
     this.requestAnimationFrame();
   }
 
@@ -35,6 +52,30 @@ export default class FrameTimer {
     this.lastFrameTime = false;
   }
 
+  /**
+   * Frame interval statistics over the last 256 generated frames
+   */
+  getPacingStats(): PacingStats {
+    const count = Math.min(this.frames - 1, PACING_HISTORY);
+    let sum = 0;
+    let sumSquares = 0;
+    let max = 0;
+    for (let i = 0; i < count; i++) {
+      const interval = this.intervals[i];
+      sum += interval;
+      sumSquares += interval * interval;
+      max = Math.max(max, interval);
+    }
+    const mean = count > 0 ? sum / count : 0;
+    return {
+      frames: this.frames,
+      meanMs: mean,
+      jitterMs: count > 0 ? Math.sqrt(Math.max(0, sumSquares / count - mean * mean)) : 0,
+      maxMs: max,
+      bursts: this.bursts,
+    };
+  }
+
   private requestAnimationFrame() {
     this._requestID = window.requestAnimationFrame(this.onAnimationFrame);
   }
@@ -44,6 +85,13 @@ export default class FrameTimer {
     if (typeof this.lastFrameTime === 'number') {
       this.lastFrameTime += this.interval;
     }
+
+    const now = performance.now();
+    if (this.frames > 0) {
+      this.intervals[(this.frames - 1) % PACING_HISTORY] = now - this.lastGenerated;
+    }
+    this.lastGenerated = now;
+    this.frames++;
   }
 
   private onAnimationFrame = (time: number) => {
@@ -74,7 +122,7 @@ export default class FrameTimer {
     }
 
     if (numFrames > 1) {
-      console.log("SKIP", numFrames - 1, this.lastFrameTime);
+      this.bursts++;
     }
   };
-}
\ No newline at end of file
+}
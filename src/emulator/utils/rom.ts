@@ -4,6 +4,14 @@
  * Helpers for base64 decoding, NES ROM header validation, and SHA256 hash checking.
  */
 
+/**
+ * The parts of a game event (kind 31996) that carry its ROM
+ */
+export interface RomEvent {
+  content: string;
+  tags: string[][];
+}
+
 export interface INesHeader {
   magic: number[];      // [0x4E, 0x45, 0x53, 0x1A]
   prgBanks: number;     // Number of PRG-ROM banks (16KB each)
@@ -276,4 +284,62 @@ export function validateNESRom(bytes: Uint8Array): void {
   if (compatibilityIssues.length > 0) {
     console.warn('[ROM] Potential emulator compatibility issues:', compatibilityIssues);
   }
-}
\ No newline at end of file
+}
+
+/**
+ * Get the ROM a game event carries: base64 in the content (legacy) or a
+ * Blossom URL (encoding=url), checked against its sha256 tag if present
+ * @param event Game event
+ * @returns ROM bytes
+ */
+export async function loadRomFromEvent(event: RomEvent): Promise<Uint8Array> {
+  const getTag = (name: string) => event.tags.find(t => t[0] === name)?.[1];
+  const encoding = getTag('encoding');
+  console.log('[ROM] Encoding detected:', encoding || 'base64 (legacy)');
+
+  if (encoding === 'base64' || !encoding) {
+    try {
+      return decodeBase64ToBytes(event.content);
+    } catch (decodeError) {
+      throw new Error(`Failed to decode base64 ROM: ${decodeError instanceof Error ? decodeError.message : 'Invalid base64 data'}`);
+    }
+  }
+  if (encoding !== 'url') {
+    throw new Error(`Unsupported encoding: ${encoding}. Expected 'base64' or 'url'.`);
+  }
+
+  const romUrl = getTag('url');
+  if (!romUrl) {
+    throw new Error('encoding=url specified but no url tag found');
+  }
+
+  console.log('[ROM] Fetching ROM from URL:', romUrl);
+  let romBytes: Uint8Array;
+  try {
+    const response = await fetch(romUrl, {
+      method: 'GET',
+      mode: 'cors',
+      credentials: 'omit'
+    });
+    if (!response.ok) {
+      throw new Error(`HTTP error! status: ${response.status}`);
+    }
+    romBytes = new Uint8Array(await response.arrayBuffer());
+    console.log('[ROM] ROM fetched from URL, size:', romBytes.length, 'bytes');
+  } catch (fetchError) {
+    throw new Error(`Failed to fetch ROM from URL: ${fetchError instanceof Error ? fetchError.message : 'Network error'}`);
+  }
+
+  // Integrity check for Blossom URLs
+  const expectedHash = getTag('sha256') || getTag('x') || getTag('ox');
+  if (expectedHash) {
+    const actualHash = await sha256(romBytes);
+    if (actualHash !== expectedHash) {
+      throw new Error(`ROM integrity check failed. Expected SHA256: ${expectedHash.substring(0, 8)}..., got: ${actualHash.substring(0, 8)}...`);
+    }
+    console.log('[ROM] Integrity check passed');
+  } else {
+    console.log('[ROM] No integrity hash found, skipping verification');
+  }
+  return romBytes;
+}
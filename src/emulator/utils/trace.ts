@@ -0,0 +1,103 @@
+/**
+ * Emulator Tracing
+ *
+ * Development builds record sampled events into a fixed-size ring buffer instead
+ * of logging or reading pixels back on the hot path. TRACE_ENABLED is
+ * `import.meta.env.DEV`, which Vite replaces with `false` in production builds,
+ * so every `if (TRACE_ENABLED)` block (including its arguments) is stripped.
+ *
+ * Inspect from devtools with `__nesTrace()` in development.
+ */
+
+export const TRACE_ENABLED = import.meta.env.DEV;
+
+export const TraceEvents = {
+  BLIT_DIRECT: 1,       // a: width, b: height
+  BLIT_CONVERTED: 2,    // a: width, b: height
+  FRAME_REPEATED: 3,    // a: sequence
+  SIZE_MISMATCH: 4,     // a: expected, b: actual
+} as const;
+
+// TRACE_RING_SIZE in scripts/nes-trace.h
+export const TRACE_RING_SIZE_CORE = 1024;
+
+// Core event ids (mirrors the enum in scripts/nes-trace.h)
+export const CORE_TRACE_EVENTS: Record<number, string> = {
+  1: 'INIT',
+  2: 'ROM_LOADED',
+  3: 'ROM_REJECTED',
+  4: 'RESET',
+  5: 'RUNNING',
+  6: 'PIXEL_FORMAT',
+  7: 'PALETTE_REJECTED',
+  8: 'FRAME',
+  9: 'STATE_REJECTED',
+};
+
+export interface TraceRecord {
+  time: number;
+  id: number;
+  a: number;
+  b: number;
+}
+
+const RING_SIZE = 1024;      // Events kept (power of two)
+const SAMPLE_MASK = 63;      // traceSampled() records every 64th occurrence
+const FIELDS = 4;            // time, id, a, b
+
+const ring = new Float64Array(TRACE_ENABLED ? RING_SIZE * FIELDS : 0);
+let head = 0;
+
+/**
+ * Record an event
+ */
+export function trace(id: number, a = 0, b = 0): void {
+  const i = (head & (RING_SIZE - 1)) * FIELDS;
+  ring[i] = performance.now();
+  ring[i + 1] = id;
+  ring[i + 2] = a;
+  ring[i + 3] = b;
+  head++;
+}
+
+/**
+ * Record an event only for every 64th value of a running counter
+ */
+export function traceSampled(id: number, counter: number, a = 0, b = 0): void {
+  if ((counter & SAMPLE_MASK) === 0) {
+    trace(id, a, b);
+  }
+}
+
+/**
+ * Read the ring buffer, oldest event first
+ */
+export function readTrace(): TraceRecord[] {
+  const records: TraceRecord[] = [];
+  for (let n = Math.max(0, head - RING_SIZE); n < head; n++) {
+    const i = (n & (RING_SIZE - 1)) * FIELDS;
+    records.push({ time: ring[i], id: ring[i + 1], a: ring[i + 2], b: ring[i + 3] });
+  }
+  return records;
+}
+
+/**
+ * Decode a core trace ring (TraceEvent structs of 4 uint32: frame, id, a, b).
+ * For core events `time` holds the emulated frame number.
+ * @param events View onto the core's getTraceBuffer()
+ * @param coreHead Value of the core's getTraceHead()
+ */
+export function readCoreTrace(events: Uint32Array, coreHead: number): Array<TraceRecord & { name: string }> {
+  const capacity = events.length / FIELDS;
+  const records: Array<TraceRecord & { name: string }> = [];
+  for (let n = Math.max(0, coreHead - capacity); n < coreHead; n++) {
+    const i = (n % capacity) * FIELDS;
+    const id = events[i + 1];
+    records.push({ time: events[i], id, a: events[i + 2], b: events[i + 3], name: CORE_TRACE_EVENTS[id] ?? `EVENT_${id}` });
+  }
+  return records;
+}
+
+if (TRACE_ENABLED && typeof window !== 'undefined') {
+  (window as unknown as Record<string, unknown>).__nesTrace = readTrace;
+}
@@ -0,0 +1,294 @@
+import { useEffect, useRef, useState, type RefObject } from 'react';
+import type { NesCore } from '@/emulator/NesCore';
+import type { NesCorePlayerRef } from '@/components/NesCorePlayer';
+import { RollbackGuest, RollbackHost } from '@/emulator/netplay/RollbackPeers';
+import { SpectatorSession } from '@/emulator/netplay/SpectatorSession';
+import type { ResyncPatch, ResyncRequest, StateHash } from '@/emulator/netplay/stateSync';
+import { TileVideoReceiver, TileVideoSender } from '@/emulator/netplay/tileVideo';
+import type { FrameInput, JoinRequestEvent, SpectatorJoin, useMultiplayerSession } from '@/hooks/useMultiplayerSession';
+
+/**
+ * host: runs the game and owns every port
+ * player: plays its assigned port from the host's state
+ * spectator: runs the game from the host's state and the players' input
+ * viewer: shows the host's tile video (decoded by the core, which does not run)
+ */
+export type NetplayRole = 'host' | 'player' | 'spectator' | 'viewer';
+
+export interface CoreNetplayOptions {
+  role: NetplayRole | null;                    // null outside a core session
+  player: RefObject<NesCorePlayerRef | null>;
+  core: NesCore | null;                        // The player's core once it runs (NesCorePlayer onReady)
+  multiplayer: ReturnType<typeof useMultiplayerSession>;
+  players: number;                             // Ports in the game (host)
+}
+
+/**
+ * How a guest's late join went (see stateTransfer.ts)
+ */
+export interface NetplayJoinStats {
+  joinMillis: number;         // Join request to live
+  transferMillis: number;     // First chunk of the state to decoded
+  bytes: number;              // Start message size
+  compressedBytes: number;    // Bytes transferred
+  fastForwardFrames: number;  // Frames run with video off to reach live
+}
+
+/**
+ * Rollback netplay on the C core for a multiplayer session: replaces the
+ * player's frame loop with the session's and connects it to the session's
+ * input, hash, join and resync messages (see RollbackPeers.ts), and to tile
+ * video for viewers
+ */
+export function useCoreNetplay({ role, player, core, multiplayer, players }: CoreNetplayOptions) {
+  const multiplayerRef = useRef(multiplayer);
+  multiplayerRef.current = multiplayer;
+  const hostRef = useRef<RollbackHost | null>(null);
+  const [joined, setJoined] = useState(false);
+  const [joinStats, setJoinStats] = useState<NetplayJoinStats | null>(null);
+
+  const { isHost, sessionId, connectedPlayers, playerIndex } = multiplayer;
+  // A guest waits for the host to assign its port
+  const active = Boolean(role && core && sessionId && playerIndex) && (role === 'host') === isHost;
+
+  // Host: every frame goes through the rollback session
+  useEffect(() => {
+    if (!active || role !== 'host' || !core) return;
+    const send = (playerNumber: number, frame: number, mask: number) => multiplayerRef.current.sendFrameInput(frame, mask, playerNumber);
+    const sendHash = (frame: number, hash: number) => multiplayerRef.current.sendStateHash(frame, hash);
+
+    let host: RollbackHost;
+    try {
+      host = new RollbackHost(core, { players: Math.min(4, Math.max(1, players)) }, send, sendHash);
+    } catch (err) {
+      console.error('[Netplay] Cannot host on this core:', err);
+      return;
+    }
+    hostRef.current = host;
+
+    // Tile video is encoded once the first viewer asks for it
+    const tiles = new TileVideoSender(core);
+    let capturing = false;
+    const sendTiles = (chunks: ArrayBuffer[] | null) => {
+      if (chunks) multiplayerRef.current.sendTileVideo(chunks);
+    };
+
+    player.current?.setFrameStep(() => {
+      const advanced = host.step(player.current?.getLocalButtons() ?? 0);
+      if (capturing && advanced) {
+        tiles.capture().then(sendTiles);
+      }
+      return advanced;
+    });
+    console.log(`[Netplay] Hosting ${host.session.players} players`);
+
+    const onInput = (e: CustomEvent<FrameInput>) => {
+      host.addRemoteInput(e.detail.player - 1, e.detail.frame, e.detail.mask);
+    };
+    const onHash = (e: CustomEvent<StateHash>) => {
+      host.session.addRemoteHash(e.detail.frame, e.detail.hash);
+    };
+    const onJoin = (e: CustomEvent<JoinRequestEvent>) => {
+      const { pubkey, spectate } = e.detail;
+      const guest = multiplayerRef.current.connectedPlayers.find((p) => p.pubkey === pubkey);
+      const port = (guest?.playerIndex ?? 0) - 1;
+      const start = spectate ? host.joinState() : host.claim(port);
+      if (!start) {
+        console.warn(`[Netplay] No ${spectate ? 'state' : 'port'} for guest ${pubkey.substring(0, 8)}...`);
+        return;
+      }
+      console.log(`[Netplay] ${spectate ? 'Spectator' : `Player ${port + 1}`} joins at frame ${start.frame}`);
+      multiplayerRef.current.sendSpectatorStart(start, pubkey);
+    };
+    // A desynced guest gets the pages of the confirmed state that differ
+    const onResync = (e: CustomEvent<ResyncRequest & { pubkey: string }>) => {
+      const { frame, hashes, pubkey } = e.detail;
+      const patch = host.session.saveResyncPatch(frame, hashes);
+      if (!patch) {
+        console.warn(`[Netplay] Cannot resync guest ${pubkey.substring(0, 8)}... at frame ${frame}`);
+        return;
+      }
+      multiplayerRef.current.sendResyncPatch(frame, patch, pubkey);
+    };
+
+    const onViewerJoin = () => {
+      if (!capturing) {
+        capturing = tiles.start();
+        if (!capturing) console.warn('[Netplay] This core has no tile encoder');
+      }
+      tiles.requestKeyframe();
+    };
+    const onKeyframe = () => tiles.requestKeyframe();
+
+    window.addEventListener('remoteFrameInput', onInput as EventListener);
+    window.addEventListener('remoteStateHash', onHash as EventListener);
+    window.addEventListener('spectatorJoinRequest', onJoin as EventListener);
+    window.addEventListener('resyncRequest', onResync as EventListener);
+    window.addEventListener('tileViewerJoin', onViewerJoin);
+    window.addEventListener('tileKeyframeRequest', onKeyframe);
+    return () => {
+      window.removeEventListener('remoteFrameInput', onInput as EventListener);
+      window.removeEventListener('remoteStateHash', onHash as EventListener);
+      window.removeEventListener('spectatorJoinRequest', onJoin as EventListener);
+      window.removeEventListener('resyncRequest', onResync as EventListener);
+      window.removeEventListener('tileViewerJoin', onViewerJoin);
+      window.removeEventListener('tileKeyframeRequest', onKeyframe);
+      tiles.stop();
+      player.current?.setFrameStep(null);
+      hostRef.current = null;
+    };
+  }, [active, role, core, players, player]);
+
+  // Host: a guest that dropped gives its port back
+  useEffect(() => {
+    const host = hostRef.current;
+    if (!host) return;
+    for (let port = 1; port < host.session.players; port++) {
+      const connected = connectedPlayers.some((p) => p.playerIndex === port + 1 && p.status === 'connected');
+      if (host.isClaimed(port) && !connected) {
+        console.log(`[Netplay] Player ${port + 1} left, port is idle again`);
+        host.release(port);
+      }
+    }
+  }, [connectedPlayers]);
+
+  // Guest: nothing runs until the host's state arrives
+  useEffect(() => {
+    if (!active || role !== 'player' || !core) return;
+    const send = (playerNumber: number, frame: number, mask: number) => multiplayerRef.current.sendFrameInput(frame, mask, playerNumber);
+    const sendHash = (frame: number, hash: number) => multiplayerRef.current.sendStateHash(frame, hash);
+    const guest = new RollbackGuest(core, playerIndex - 1, send, sendHash);
+    let transfer: SpectatorJoin | null = null;
+    player.current?.setFrameStep(() => {
+      const advanced = guest.step(player.current?.getLocalButtons() ?? 0);
+      const request = guest.takeResyncRequest();
+      if (request) {
+        multiplayerRef.current.sendResyncRequest(request.frame, request.hashes);
+      }
+      // Reported once, when the fast-forward reaches live
+      if (transfer && guest.joinMillis) {
+        setJoinStats(joinStatsOf(transfer, guest.joinMillis, guest.fastForwardFrames));
+        transfer = null;
+      }
+      return advanced;
+    });
+
+    const onInput = (e: CustomEvent<FrameInput>) => {
+      guest.addRemoteInput(e.detail.player - 1, e.detail.frame, e.detail.mask);
+    };
+    const onHash = (e: CustomEvent<StateHash>) => {
+      if (e.detail.player === 1) {
+        guest.session?.addRemoteHash(e.detail.frame, e.detail.hash);
+      }
+    };
+    const onStart = (e: CustomEvent<SpectatorJoin>) => {
+      if (guest.start(e.detail.start, e.detail.requestedAt)) {
+        console.log(`[Netplay] Playing as player ${playerIndex} from frame ${e.detail.start.frame}`);
+        transfer = e.detail;
+        setJoined(true);
+      }
+    };
+    const onResync = (e: CustomEvent<ResyncPatch>) => {
+      if (guest.applyResyncPatch(e.detail.frame, e.detail.patch)) {
+        console.log(`[Netplay] Resynced at frame ${e.detail.frame} (${e.detail.patch.length} bytes)`);
+      }
+    };
+
+    window.addEventListener('remoteFrameInput', onInput as EventListener);
+    window.addEventListener('remoteStateHash', onHash as EventListener);
+    window.addEventListener('spectatorStart', onStart as EventListener);
+    window.addEventListener('resyncPatch', onResync as EventListener);
+    multiplayerRef.current.requestJoin(false);
+    return () => {
+      window.removeEventListener('remoteFrameInput', onInput as EventListener);
+      window.removeEventListener('remoteStateHash', onHash as EventListener);
+      window.removeEventListener('spectatorStart', onStart as EventListener);
+      window.removeEventListener('resyncPatch', onResync as EventListener);
+      player.current?.setFrameStep(null);
+      setJoined(false);
+      setJoinStats(null);
+    };
+  }, [active, role, core, playerIndex, player]);
+
+  // Spectator: plays back everyone's input, a couple of frames behind
+  useEffect(() => {
+    if (!active || role !== 'spectator' || !core) return;
+    let spectator: SpectatorSession;
+    try {
+      spectator = new SpectatorSession(core, 2);
+    } catch (err) {
+      console.error('[Netplay] Cannot spectate on this core:', err);
+      return;
+    }
+    let transfer: SpectatorJoin | null = null;
+    player.current?.setFrameStep(() => {
+      const advanced = spectator.advance();
+      const stats = spectator.getStats();
+      if (transfer && stats.joinMillis) {
+        setJoinStats(joinStatsOf(transfer, stats.joinMillis, stats.fastForwardFrames));
+        transfer = null;
+      }
+      return advanced;
+    });
+
+    const onInput = (e: CustomEvent<FrameInput>) => {
+      spectator.addInput(e.detail.player - 1, e.detail.frame, e.detail.mask);
+    };
+    const onStart = (e: CustomEvent<SpectatorJoin>) => {
+      if (spectator.start(e.detail.start, e.detail.requestedAt)) {
+        console.log(`[Netplay] Spectating from frame ${e.detail.start.frame}`);
+        transfer = e.detail;
+        setJoined(true);
+      }
+    };
+
+    window.addEventListener('remoteFrameInput', onInput as EventListener);
+    window.addEventListener('spectatorStart', onStart as EventListener);
+    multiplayerRef.current.requestJoin(true);
+    return () => {
+      window.removeEventListener('remoteFrameInput', onInput as EventListener);
+      window.removeEventListener('spectatorStart', onStart as EventListener);
+      player.current?.setFrameStep(null);
+      setJoined(false);
+      setJoinStats(null);
+    };
+  }, [active, role, core, player]);
+
+  // Viewer: the core only decodes the host's frames
+  useEffect(() => {
+    if (!active || role !== 'viewer' || !core) return;
+    const receiver = new TileVideoReceiver(core);
+    player.current?.setFrameStep(() => false);
+
+    const onData = (e: CustomEvent<ArrayBuffer>) => {
+      receiver.add(e.detail).then((result) => {
+        if (result === 'needs-keyframe') {
+          multiplayerRef.current.requestTileKeyframe();
+        } else if (result === 'shown') {
+          setJoined(true);
+        }
+      });
+    };
+
+    window.addEventListener('tileVideoData', onData as EventListener);
+    multiplayerRef.current.requestTileKeyframe();
+    return () => {
+      window.removeEventListener('tileVideoData', onData as EventListener);
+      player.current?.setFrameStep(null);
+      setJoined(false);
+    };
+  }, [active, role, core, player]);
+
+  return { joined, joinStats };
+}
+
+function joinStatsOf(transfer: SpectatorJoin, joinMillis: number, fastForwardFrames: number): NetplayJoinStats {
+  console.log(`[Netplay] Live ${joinMillis.toFixed(0)} ms after the join request, ${fastForwardFrames} frames fast-forwarded`);
+  return {
+    joinMillis,
+    transferMillis: transfer.transferMillis,
+    bytes: transfer.bytes,
+    compressedBytes: transfer.compressedBytes,
+    fastForwardFrames,
+  };
+}
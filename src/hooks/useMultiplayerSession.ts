@@ -4,6 +4,11 @@ import { useCurrentUser } from '@/hooks/useCurrentUser';
 import { useNostrPublish } from '@/hooks/useNostrPublish';
 import { useAppContext } from '@/hooks/useAppContext';
 import type { NostrEvent } from '@jsr/nostrify__nostrify';
+import { BUTTON_NAMES, InputPacketReader, InputPacketWriter, MAX_INPUT_PLAYERS, buttonBit } from '@/emulator/netplay/inputProtocol';
+import { SPECTATOR_START, type SpectatorStart } from '@/emulator/netplay/SpectatorSession';
+import { RESYNC_PATCH, RESYNC_REQUEST, type ResyncPatch, type ResyncRequest, type StateHash, decodeResyncPatch, decodeResyncRequest, decodeStateHash, encodeResyncPatch, encodeResyncRequest, encodeStateHash } from '@/emulator/netplay/stateSync';
+import { JOIN_REQUEST, type JoinState, TransferAssembler, decodeJoinState, encodeJoinState, encodeTransfer, joinRequest } from '@/emulator/netplay/stateTransfer';
+import { TILE_KEYFRAME_REQUEST, keyframeRequest } from '@/emulator/netplay/tileVideo';
 
 export type SessionStatus = 'idle' | 'creating' | 'available' | 'full' | 'error';
 
@@ -15,6 +20,7 @@ export interface MultiplayerSession {
   status: SessionStatus;
   guests: string[];
   connected: string[];
+  netplay?: 'core';   // Every peer runs the C core (useCoreNetplay) instead of watching the host's video
 }
 
 export interface ConnectedPlayer {
@@ -30,6 +36,40 @@ export interface PeerConnection {
   connection: RTCPeerConnection;
   dataChannel?: RTCDataChannel;
   chatChannel?: RTCDataChannel;
+  spectateChannel?: RTCDataChannel;
+  tilesChannel?: RTCDataChannel;
+  tileViewer?: boolean;   // Asked for tile video; only these peers are sent it
+}
+
+const INPUT_TICK_MS = 1000 / 60;  // Guest key input is sampled once per NES frame
+const TILES_MAX_BUFFERED = 256 * 1024;  // Tile frames are dropped while a viewer's channel is this far behind
+
+/**
+ * One player's buttons for one emulated frame. Delivered to the page as a
+ * 'remoteFrameInput' window event.
+ */
+export interface FrameInput {
+  player: number;  // 1-4 (1=host)
+  frame: number;   // Frame the input applies to
+  mask: number;    // Buttons, one bit each in setButton() order
+}
+
+/**
+ * A late-join state transfer as received by the guest. Delivered to the page
+ * as a 'spectatorStart' window event, to be passed to SpectatorSession.start()
+ * together with `requestedAt`.
+ */
+export interface SpectatorJoin extends JoinState {
+  requestedAt: number;   // performance.now() when the guest asked for the state
+}
+
+/**
+ * A guest asking for the start state (host side), delivered as a
+ * 'spectatorJoinRequest' window event
+ */
+export interface JoinRequestEvent {
+  pubkey: string;
+  spectate: boolean;   // Watch instead of playing the guest's port
 }
 
 // Constants for event kinds
@@ -93,6 +133,7 @@ export interface ParsedSessionEvent {
   status?: SessionStatus;
   guests?: string[];
   connected?: string[];
+  netplay?: string;
 }
 
 function waitForIceGatheringComplete(pc: RTCPeerConnection) {
@@ -121,6 +162,7 @@ export function useMultiplayerSession(gameId: string) {
   const [status, setStatus] = useState<SessionStatus>('idle');
   const [connectedPlayers, setConnectedPlayers] = useState<ConnectedPlayer[]>([]);
   const [error, setError] = useState<string | null>(null);
+  const [guestPlayerIndex, setGuestPlayerIndex] = useState(0);   // Assigned by the host's offer, 0 until then
 
   // WebRTC connections - one per guest for the host
   const peerConnectionsRef = useRef<Map<string, PeerConnection>>(new Map());
@@ -140,6 +182,25 @@ export function useMultiplayerSession(gameId: string) {
   const guestPeerConnectionRef = useRef<RTCPeerConnection | null>(null);
   const guestDataChannelRef = useRef<RTCDataChannel | null>(null);
   const guestChatChannelRef = useRef<RTCDataChannel | null>(null);
+  const guestSpectateChannelRef = useRef<RTCDataChannel | null>(null);
+  const guestTilesChannelRef = useRef<RTCDataChannel | null>(null);
+  const pendingTilesRef = useRef(false);   // requestTileKeyframe() before the channel opened
+
+  // Binary input stream (see inputProtocol.ts), one writer per player sent for
+  const inputWritersRef = useRef(new Map<number, InputPacketWriter>());
+  const inputReaderRef = useRef(new InputPacketReader());
+  const remoteMasksRef = useRef(new Uint8Array(MAX_INPUT_PLAYERS + 1));
+  const localMaskRef = useRef(0);
+  const latchedMaskRef = useRef(0);     // Presses since the last tick, so short taps are not missed
+  const inputFrameRef = useRef(0);
+  const inputTickRef = useRef<ReturnType<typeof setInterval> | null>(null);
+
+  // Late join (see stateTransfer.ts)
+  const joinTransferIdRef = useRef(0);
+  const joinAssemblerRef = useRef(new TransferAssembler());
+  const joinRequestedAtRef = useRef(0);
+  const pendingJoinRef = useRef<boolean | null>(null);   // requestJoin() before the channel opened: spectate?
+  const netplayRef = useRef(false);
 
   const isStartingRef = useRef(false);
   const hasStartedRef = useRef(false);
@@ -170,8 +231,8 @@ export function useMultiplayerSession(gameId: string) {
   /**
    * Attach/replace host video track on all existing peers
    */
-  const attachStreamToAllPeers = useCallback((stream: MediaStream) => {
-    const videoTrack = stream.getVideoTracks()[0];
+  const attachStreamToAllPeers = useCallback((stream: MediaStream | null) => {
+    const videoTrack = stream?.getVideoTracks()[0];
     if (!videoTrack) return;
     peerConnectionsRef.current.forEach(({ connection }) => {
       const tx = connection.getTransceivers().find(t => t.sender?.track?.kind === 'video' || t.receiver?.track?.kind === 'video');
@@ -201,6 +262,7 @@ export function useMultiplayerSession(gameId: string) {
       ['players', (updates.maxPlayers || session?.maxPlayers || 2).toString()],
     ];
 
+    if (netplayRef.current) tags.push(['netplay', 'core']);
     if (updates.status) tags.push(['status', updates.status]);
     if (updates.guests) updates.guests.forEach(g => tags.push(['guest', g]));
     if (updates.connected) updates.connected.forEach(c => tags.push(['connected', c]));
@@ -236,6 +298,7 @@ export function useMultiplayerSession(gameId: string) {
       status: getTag('status') as SessionStatus,
       guests: getVals('guest'),
       connected: getVals('connected'),
+      netplay: getTag('netplay'),
     };
   }, []);
 
@@ -365,6 +428,7 @@ export function useMultiplayerSession(gameId: string) {
             console.log(`[GUEST] Received player index: ${payload.playerIndex}`);
             // Store player index for this guest
             localStorage.setItem(`playerIndex_${sessionId}`, payload.playerIndex.toString());
+            setGuestPlayerIndex(payload.playerIndex);
           }
 
           const answer = await pc.createAnswer();
@@ -465,7 +529,7 @@ export function useMultiplayerSession(gameId: string) {
   /**
    * Create WebRTC peer connection for a specific guest (host side)
    */
-  const createHostPeerConnection = useCallback((guestPubkey: string): RTCPeerConnection => {
+  const createHostPeerConnection = useCallback((guestPubkey: string, playerIndex: number): RTCPeerConnection => {
     const peerConnection = new RTCPeerConnection({
       iceServers: [
         { urls: 'stun:stun.l.google.com:19302' },
@@ -484,23 +548,44 @@ export function useMultiplayerSession(gameId: string) {
       vtx.sender.replaceTrack(track).catch(err => console.error('[HOST] replaceTrack fail:', err));
     }
 
-    // DataChannel para inputs
-    const dataChannel = peerConnection.createDataChannel('inputs', { ordered: true });
+    // DataChannel para inputs: binary packets that repeat the last frames, so
+    // a lost one is repaired by the next and nothing waits for retransmits
+    const dataChannel = peerConnection.createDataChannel('inputs', { ordered: false, maxRetransmits: 0 });
+    dataChannel.binaryType = 'arraybuffer';
     dataChannel.onopen = () => {
       console.log(`[DataChannel] Opened for guest ${guestPubkey.substring(0, 8)}...`);
     };
     dataChannel.onmessage = (event) => {
-      try {
-        const input = JSON.parse(event.data);
-        console.log(`[DataChannel] Received input from guest ${guestPubkey.substring(0, 8)}...`, input);
-
-        if (input.type === 'input') {
-          // avisa o EmulatorIFrame
-          window.dispatchEvent(new CustomEvent('remoteInput', { detail: input }));
+      const packet = event.data as ArrayBuffer;
+      const stateHash = decodeStateHash(packet);
+      if (stateHash) {
+        window.dispatchEvent(new CustomEvent<StateHash>('remoteStateHash', { detail: stateHash }));
+        return;
+      }
+      const valid = inputReaderRef.current.read(packet, (player, frame, mask) => {
+        window.dispatchEvent(new CustomEvent<FrameInput>('remoteFrameInput', { detail: { player, frame, mask } }));
+
+        // avisa o EmulatorIFrame: one key event per button that changed
+        const changed = mask ^ remoteMasksRef.current[player];
+        remoteMasksRef.current[player] = mask;
+        for (let bit = 0; changed >> bit; bit++) {
+          if (changed & (1 << bit)) {
+            const detail = { type: 'input', player, key: BUTTON_NAMES[bit], pressed: (mask & (1 << bit)) !== 0 };
+            window.dispatchEvent(new CustomEvent('remoteInput', { detail }));
+          }
         }
-      } catch (err) {
-        console.error('[DataChannel] Failed to parse guest input:', err);
+      });
+      if (!valid) {
+        console.warn(`[DataChannel] Ignored malformed input from guest ${guestPubkey.substring(0, 8)}...`);
+        return;
       }
+
+      // Every peer may simulate every player: relay to the other guests
+      peerConnectionsRef.current.forEach((peer, pk) => {
+        if (pk !== guestPubkey && peer.dataChannel?.readyState === 'open') {
+          peer.dataChannel.send(packet);
+        }
+      });
     };
 
     // DataChannel para chat
@@ -526,6 +611,44 @@ export function useMultiplayerSession(gameId: string) {
       }
     };
 
+    // DataChannel para espectadores: the start state for running the game
+    // locally from the input stream instead of watching the video
+    const spectateChannel = peerConnection.createDataChannel('spectate', { ordered: true });
+    spectateChannel.binaryType = 'arraybuffer';
+    spectateChannel.onopen = () => {
+      console.log(`[SpectateDC] Opened for guest ${guestPubkey.substring(0, 8)}...`);
+    };
+    spectateChannel.onmessage = (ev) => {
+      const type = new Uint8Array(ev.data as ArrayBuffer)[0];
+      if (type === JOIN_REQUEST) {
+        const spectate = new Uint8Array(ev.data as ArrayBuffer)[1] === 1;
+        console.log(`[SpectateDC] Join request from guest ${guestPubkey.substring(0, 8)}...${spectate ? ' (spectating)' : ''}`);
+        window.dispatchEvent(new CustomEvent<JoinRequestEvent>('spectatorJoinRequest', { detail: { pubkey: guestPubkey, spectate } }));
+      } else if (type === RESYNC_REQUEST) {
+        const request = decodeResyncRequest(ev.data as ArrayBuffer);
+        if (request) {
+          console.log(`[SpectateDC] Resync request from guest ${guestPubkey.substring(0, 8)}... at frame ${request.frame}`);
+          window.dispatchEvent(new CustomEvent<ResyncRequest & { pubkey: string }>('resyncRequest', { detail: { ...request, pubkey: guestPubkey } }));
+        }
+      }
+    };
+
+    // Tile-delta video (tileVideo.ts), an alternative to the MediaStream for
+    // viewers on slow links. A viewer subscribes with its first keyframe request.
+    const tilesChannel = peerConnection.createDataChannel('tiles', { ordered: true });
+    tilesChannel.binaryType = 'arraybuffer';
+    tilesChannel.onmessage = (ev) => {
+      if (new Uint8Array(ev.data as ArrayBuffer)[0] !== TILE_KEYFRAME_REQUEST) return;
+      const peer = peerConnectionsRef.current.get(guestPubkey);
+      if (peer && !peer.tileViewer) {
+        peer.tileViewer = true;
+        console.log(`[TilesDC] Guest ${guestPubkey.substring(0, 8)}... watches tile video`);
+        window.dispatchEvent(new CustomEvent('tileViewerJoin', { detail: { pubkey: guestPubkey } }));
+      } else {
+        window.dispatchEvent(new CustomEvent('tileKeyframeRequest', { detail: { pubkey: guestPubkey } }));
+      }
+    };
+
     // Sem trickle ICE
     peerConnection.onicecandidate = () => { /* no-op */ };
 
@@ -534,6 +657,14 @@ export function useMultiplayerSession(gameId: string) {
       const state = peerConnection.connectionState;
       console.log(`[PeerConnection] State for guest ${guestPubkey.substring(0, 8)}...`, state);
 
+      // A guest that comes back starts its input frames over
+      if (state === 'closed' || state === 'failed') {
+        inputReaderRef.current.resetPlayer(playerIndex);
+        if (peerConnectionsRef.current.get(guestPubkey)?.connection === peerConnection) {
+          peerConnectionsRef.current.delete(guestPubkey);
+        }
+      }
+
       setConnectedPlayers(prev =>
         prev.map(player =>
           player.pubkey === guestPubkey
@@ -548,7 +679,9 @@ export function useMultiplayerSession(gameId: string) {
       pubkey: guestPubkey,
       connection: peerConnection,
       dataChannel,
-      chatChannel
+      chatChannel,
+      spectateChannel,
+      tilesChannel
     });
 
     return peerConnection;
@@ -588,7 +721,64 @@ export function useMultiplayerSession(gameId: string) {
       // Store reference for sending inputs
       if (dataChannel.label === 'inputs') {
         guestDataChannelRef.current = dataChannel;
+        dataChannel.binaryType = 'arraybuffer';
         dataChannel.onopen = () => console.log('[DataChannel] Guest inputs opened');
+        dataChannel.onmessage = (ev) => {
+          const stateHash = decodeStateHash(ev.data as ArrayBuffer);
+          if (stateHash) {
+            window.dispatchEvent(new CustomEvent<StateHash>('remoteStateHash', { detail: stateHash }));
+            return;
+          }
+          inputReaderRef.current.read(ev.data as ArrayBuffer, (player, frame, mask) => {
+            window.dispatchEvent(new CustomEvent<FrameInput>('remoteFrameInput', { detail: { player, frame, mask } }));
+          });
+        };
+        return;
+      }
+      if (dataChannel.label === 'spectate') {
+        dataChannel.binaryType = 'arraybuffer';
+        guestSpectateChannelRef.current = dataChannel;
+        joinAssemblerRef.current = new TransferAssembler();
+        // A join asked for before the channel existed goes out once it opens
+        dataChannel.onopen = () => {
+          if (pendingJoinRef.current !== null) {
+            dataChannel.send(joinRequest(pendingJoinRef.current));
+            pendingJoinRef.current = null;
+          }
+        };
+        dataChannel.onmessage = (ev) => {
+          joinAssemblerRef.current.add(ev.data as ArrayBuffer).then((transfer) => {
+            if (transfer?.message[0] === RESYNC_PATCH) {
+              const resync = decodeResyncPatch(transfer.message);
+              if (resync) {
+                console.log(`[SpectateDC] Resync patch received: frame ${resync.frame}, ${resync.patch.length} bytes`);
+                window.dispatchEvent(new CustomEvent<ResyncPatch>('resyncPatch', { detail: resync }));
+              }
+              return;
+            }
+            const joined = transfer?.message[0] === SPECTATOR_START ? decodeJoinState(transfer) : null;
+            if (!joined) return;
+            console.log(`[SpectateDC] Start state received: frame ${joined.start.frame}, ${joined.compressedBytes}/${joined.bytes} bytes in ${joined.chunks} chunks, ${joined.transferMillis.toFixed(0)} ms`);
+            window.dispatchEvent(new CustomEvent<SpectatorJoin>('spectatorStart', {
+              detail: { ...joined, requestedAt: joinRequestedAtRef.current },
+            }));
+          });
+        };
+        return;
+      }
+      if (dataChannel.label === 'tiles') {
+        // Chunks go to TileVideoReceiver.add() as they are
+        dataChannel.binaryType = 'arraybuffer';
+        guestTilesChannelRef.current = dataChannel;
+        dataChannel.onopen = () => {
+          if (pendingTilesRef.current) {
+            dataChannel.send(keyframeRequest());
+            pendingTilesRef.current = false;
+          }
+        };
+        dataChannel.onmessage = (ev) => {
+          window.dispatchEvent(new CustomEvent<ArrayBuffer>('tileVideoData', { detail: ev.data as ArrayBuffer }));
+        };
         return;
       }
       if (dataChannel.label === 'chat') {
@@ -640,6 +830,7 @@ export function useMultiplayerSession(gameId: string) {
         status: parsed.status || 'available',
         guests: parsed.guests || [],
         connected: parsed.connected || [],
+        netplay: parsed.netplay === 'core' ? 'core' : undefined,
       };
       setSession(newSession);
       setStatus(newSession.status);
@@ -674,8 +865,9 @@ export function useMultiplayerSession(gameId: string) {
       // Start per-peer signaling subscription for this guest
       startPeerSignalingSubscription(guestPubkey);
 
-      // Create peer connection
-      const pc = createHostPeerConnection(guestPubkey);
+      // Create peer connection; input from this player index starts over
+      inputReaderRef.current.resetPlayer(availablePlayerIndex);
+      const pc = createHostPeerConnection(guestPubkey, availablePlayerIndex);
 
       // Add to UI with assigned player index
       setConnectedPlayers(prev => [
@@ -738,8 +930,10 @@ export function useMultiplayerSession(gameId: string) {
 
   /**
    * Start multiplayer session as host
+   * @param videoStream The game's video, null in netplay sessions where every
+   *        guest runs the core from the input stream
    */
-  const startSession = useCallback(async (videoStream: MediaStream, maxPlayers: number = 2) => {
+  const startSession = useCallback(async (videoStream: MediaStream | null, maxPlayers: number = 2, netplay = false) => {
     if (!user) {
       setError('Must be logged in to start session');
       return;
@@ -750,6 +944,7 @@ export function useMultiplayerSession(gameId: string) {
       return;
     }
     isStartingRef.current = true;
+    netplayRef.current = netplay;
 
     try {
       setError(null);
@@ -929,6 +1124,17 @@ export function useMultiplayerSession(gameId: string) {
       guestPeerConnectionRef.current = null;
     }
 
+    // Stop sampling guest input
+    if (inputTickRef.current) {
+      clearInterval(inputTickRef.current);
+      inputTickRef.current = null;
+    }
+    inputWritersRef.current.clear();
+    inputReaderRef.current = new InputPacketReader();
+    remoteMasksRef.current.fill(0);
+    localMaskRef.current = latchedMaskRef.current = 0;
+    inputFrameRef.current = 0;
+
     // Close guest data channel
     if (guestDataChannelRef.current) {
       guestDataChannelRef.current.close();
@@ -940,6 +1146,11 @@ export function useMultiplayerSession(gameId: string) {
       guestChatChannelRef.current.close();
       guestChatChannelRef.current = null;
     }
+    guestSpectateChannelRef.current = null;
+    guestTilesChannelRef.current = null;
+    pendingTilesRef.current = false;
+    pendingJoinRef.current = null;
+    netplayRef.current = false;
 
     // Stop video tracks
     if (hostVideoStreamRef.current) {
@@ -964,6 +1175,7 @@ export function useMultiplayerSession(gameId: string) {
     setStatus('idle');
     setConnectedPlayers([]);
     setError(null);
+    setGuestPlayerIndex(0);
     processedEventIdsRef.current.clear();
     iceCandidateQueuesRef.current.clear();
 
@@ -986,25 +1198,161 @@ export function useMultiplayerSession(gameId: string) {
   }, []);
 
   /**
-   * Send game input via data channel (guest only)
+   * Send one frame's input packet: from the host to every guest, from a guest
+   * to the host (which relays it). `player` defaults to this peer's own.
+   */
+  const sendInputPacket = useCallback((frame: number, mask: number, player?: number) => {
+    player ??= isHost ? 1 : parseInt(localStorage.getItem(`playerIndex_${sessionId}`) || '2');
+    let writer = inputWritersRef.current.get(player);
+    if (!writer) {
+      writer = new InputPacketWriter(player);
+      inputWritersRef.current.set(player, writer);
+    }
+    const packet = writer.push(frame, mask);
+
+    if (isHost) {
+      peerConnectionsRef.current.forEach(({ dataChannel }) => {
+        if (dataChannel?.readyState === 'open') {
+          dataChannel.send(packet);
+        }
+      });
+    } else if (guestDataChannelRef.current?.readyState === 'open') {
+      guestDataChannelRef.current.send(packet);
+    }
+  }, [isHost, sessionId]);
+
+  /**
+   * Send game input via data channel (guest only). Key changes update the
+   * guest's button mask, which is sent once per frame.
    */
   const sendGameInput = useCallback((inputData: { key: string; pressed: boolean }) => {
     if (isHost || !guestDataChannelRef.current) return;
 
-    // Get player index from localStorage
-    const playerIndex = parseInt(localStorage.getItem(`playerIndex_${sessionId}`) || '2');
+    const bit = buttonBit(inputData.key);
+    if (inputData.pressed) {
+      localMaskRef.current |= bit;
+      latchedMaskRef.current |= bit;
+    } else {
+      localMaskRef.current &= ~bit;
+    }
 
-    if (guestDataChannelRef.current.readyState === 'open') {
-      guestDataChannelRef.current.send(JSON.stringify({
-        type: 'input',
-        timestamp: Date.now(),
-        player: playerIndex,
-        ...inputData
-      }));
-      console.log(`[GUEST] Sent input (Player ${playerIndex}):`, inputData);
+    if (!inputTickRef.current) {
+      inputTickRef.current = setInterval(() => {
+        sendInputPacket(inputFrameRef.current++, localMaskRef.current | latchedMaskRef.current);
+        latchedMaskRef.current = 0;
+      }, INPUT_TICK_MS);
+      console.log('[GUEST] Started input stream');
+    }
+  }, [isHost, sendInputPacket]);
+
+  /**
+   * Send the local player's input for one emulated frame (rollback netplay).
+   * Use instead of sendGameInput(), with consecutive frame numbers. The host
+   * also sends for the ports no guest plays (`player` 2-4).
+   */
+  const sendFrameInput = useCallback((frame: number, mask: number, player?: number) => {
+    sendInputPacket(frame, mask, player);
+  }, [sendInputPacket]);
+
+  /**
+   * Ask the host for the state to start from (guest only): to play this
+   * guest's port, or to `spectate`. Answered with a 'spectatorStart' event.
+   */
+  const requestJoin = useCallback((spectate = false) => {
+    joinRequestedAtRef.current = performance.now();
+    joinAssemblerRef.current = new TransferAssembler();
+    const channel = guestSpectateChannelRef.current;
+    if (channel?.readyState === 'open') {
+      channel.send(joinRequest(spectate));
+    } else {
+      pendingJoinRef.current = spectate;
+    }
+  }, []);
+
+  /**
+   * Send the state spectators start from (host only), compressed and chunked:
+   * to one guest when its 'spectatorJoinRequest' event fires, or to every
+   * guest. Include the inputs since the state's frame so the guest can
+   * fast-forward to live; from then on it only needs the input stream.
+   */
+  const sendSpectatorStart = useCallback(async (start: SpectatorStart, guestPubkey?: string) => {
+    if (!isHost) return;
+    const chunks = await encodeJoinState(start, joinTransferIdRef.current++ & 0xFF);
+    peerConnectionsRef.current.forEach(({ spectateChannel }, pk) => {
+      if ((!guestPubkey || pk === guestPubkey) && spectateChannel?.readyState === 'open') {
+        chunks.forEach((chunk) => spectateChannel.send(chunk));
+      }
+    });
+  }, [isHost]);
+
+  /**
+   * Send this peer's confirmed state hash (RollbackSession.takeStateHash())
+   * to the other peers, who receive it as a 'remoteStateHash' event
+   */
+  const sendStateHash = useCallback((frame: number, hash: number) => {
+    const player = isHost ? 1 : parseInt(localStorage.getItem(`playerIndex_${sessionId}`) || '2');
+    const message = encodeStateHash({ player, frame, hash });
+    if (isHost) {
+      peerConnectionsRef.current.forEach(({ dataChannel }) => {
+        if (dataChannel?.readyState === 'open') {
+          dataChannel.send(message);
+        }
+      });
+    } else if (guestDataChannelRef.current?.readyState === 'open') {
+      guestDataChannelRef.current.send(message);
     }
   }, [isHost, sessionId]);
 
+  /**
+   * Ask the host for a patch after a desync (guest only), with
+   * RollbackSession.saveResyncRequest(). The host gets a 'resyncRequest'
+   * event, answers with sendResyncPatch() and the guest gets 'resyncPatch'.
+   */
+  const sendResyncRequest = useCallback((frame: number, hashes: Uint32Array) => {
+    if (isHost || guestSpectateChannelRef.current?.readyState !== 'open') return;
+    guestSpectateChannelRef.current.send(encodeResyncRequest({ frame, hashes }));
+  }, [isHost]);
+
+  /**
+   * Answer a guest's 'resyncRequest' (host only), compressed and chunked like
+   * the join state
+   */
+  const sendResyncPatch = useCallback(async (frame: number, patch: Uint8Array, guestPubkey: string) => {
+    if (!isHost) return;
+    const chunks = await encodeTransfer(encodeResyncPatch({ frame, patch }), joinTransferIdRef.current++ & 0xFF);
+    const spectateChannel = peerConnectionsRef.current.get(guestPubkey)?.spectateChannel;
+    if (spectateChannel?.readyState === 'open') {
+      chunks.forEach((chunk) => spectateChannel.send(chunk));
+    }
+  }, [isHost]);
+
+  /**
+   * Send one frame of tile video (TileVideoSender.capture()) to every viewer
+   * (host only); a guest becomes a viewer with its first keyframe request
+   * ('tileViewerJoin' event). A viewer whose channel is backed up misses the
+   * frame and asks for a keyframe, which arrives as a 'tileKeyframeRequest' event.
+   */
+  const sendTileVideo = useCallback((chunks: ArrayBuffer[]) => {
+    if (!isHost) return;
+    peerConnectionsRef.current.forEach(({ tilesChannel, tileViewer }) => {
+      if (tileViewer && tilesChannel?.readyState === 'open' && tilesChannel.bufferedAmount < TILES_MAX_BUFFERED) {
+        chunks.forEach((chunk) => tilesChannel.send(chunk));
+      }
+    });
+  }, [isHost]);
+
+  /**
+   * Ask the host for a tile video keyframe (guest only): once to start
+   * watching, then when TileVideoReceiver.add() returns 'needs-keyframe'
+   */
+  const requestTileKeyframe = useCallback(() => {
+    if (isHost) return;
+    if (guestTilesChannelRef.current?.readyState === 'open') {
+      guestTilesChannelRef.current.send(keyframeRequest());
+    } else {
+      pendingTilesRef.current = true;
+    }
+  }, [isHost]);
 
   /**
    * Chat: host broadcasts via per-peer chatChannel; guest uses guestChatChannelRef
@@ -1035,6 +1383,7 @@ export function useMultiplayerSession(gameId: string) {
     sessionId,
     session,
     isHost,
+    playerIndex: isHost ? 1 : guestPlayerIndex,
     status,
     connectedPlayers,
     error,
@@ -1043,6 +1392,14 @@ export function useMultiplayerSession(gameId: string) {
     leaveSession,
     getPeerConnection,
     sendGameInput,
+    sendFrameInput,
+    requestJoin,
+    sendSpectatorStart,
+    sendStateHash,
+    sendResyncRequest,
+    sendResyncPatch,
+    sendTileVideo,
+    requestTileKeyframe,
     sendChatMessage
   };
 }
\ No newline at end of file
@@ -3,20 +3,25 @@
  *
  * Displays and runs NES games from Nostr events (kind 31996).
  * Now uses an iframe-based Emulator (EmulatorIFrame + public/embed.html).
+ * NES games run on the C core (NesCorePlayer) instead with ?core=wasm; its
+ * multiplayer sessions use rollback netplay (useCoreNetplay). If the core
+ * cannot start (no current public/wasm/fceux-c build), the iframe runs the game.
  */
 
 import { useState, useEffect, useRef, useCallback } from 'react';
-import { useParams, useNavigate, Link } from 'react-router-dom';
+import { useParams, useNavigate, useSearchParams, Link } from 'react-router-dom';
 import { useNostr } from '@jsr/nostrify__react';
 import { Button } from '@/components/ui/button';
 import { Card, CardContent } from '@/components/ui/card';
 import { ArrowLeft, RefreshCw } from 'lucide-react';
 
 // Import ROM utilities for parsing Nostr events
-import { decodeBase64ToBytes, parseINesHeader, sha256, validateNESRom } from '@/emulator/utils/rom';
+import { loadRomFromEvent, parseINesHeader, sha256, validateNESRom } from '@/emulator/utils/rom';
 import { analyzeRom, generateRecommendations, quickCompatibilityCheck } from '@/emulator/utils/romDebugger';
 import { isMultiplayerGame, getMaxPlayers } from '@/lib/gameUtils';
 import EmulatorIFrame, { EmulatorJSRef } from '@/components/EmulatorIFrame';
+import NesCorePlayer, { NesCorePlayerRef } from '@/components/NesCorePlayer';
+import type { NesCore } from '@/emulator/NesCore';
 import GameInteractionCard from '@/components/GameInteractionCard';
 import MultiplayerCard from '@/components/MultiplayerCard';
 import MultiplayerChat from '@/components/MultiplayerChat';
@@ -76,6 +81,7 @@ interface RomInfo {
 export default function GamePage() {
   const { id } = useParams<{ id: string }>();
   const navigate = useNavigate();
+  const [searchParams] = useSearchParams();
   const { nostr } = useNostr();
 
   // Game state
@@ -92,6 +98,16 @@ export default function GamePage() {
 
   // Refs for multiplayer integration
   const emulatorRef = useRef<EmulatorJSRef>(null);
+  const coreRef = useRef<NesCorePlayerRef>(null);
+  const [coreFailed, setCoreFailed] = useState(false);
+  const useWasmCore = searchParams.get('core') === 'wasm' && platform === 'nes-rom' && !coreFailed;
+  const [core, setCore] = useState<NesCore | null>(null);
+
+  const handleCoreError = (error: Error) => {
+    console.warn('[GamePage] C core unavailable, using the iframe emulator:', error.message);
+    setCore(null);
+    setCoreFailed(true);
+  };
 
   // Handle multiplayer stream start
   const handleStreamStart = (_stream: MediaStream) => {
@@ -100,8 +116,9 @@ export default function GamePage() {
 
   // Get canvas stream for multiplayer
   const getGameCanvas = () => {
-    if (emulatorRef.current) {
-      return emulatorRef.current.getCanvasStream();
+    const emulator = useWasmCore ? coreRef.current : emulatorRef.current;
+    if (emulator) {
+      return emulator.getCanvasStream();
     }
     return null;
   };
@@ -175,87 +192,8 @@ export default function GamePage() {
         setPlatform(detectedPlatform);
         console.log('[GamePage] Platform detected:', detectedPlatform);
 
-        // Check encoding tag
-        const encodingTag = getTag(event, 'encoding');
-        const encoding = encodingTag?.[1];
-
-        console.log('[GamePage] Encoding detected:', encoding || 'base64 (legacy)');
-
-        // Decode ROM based on encoding
-        let romBytes: Uint8Array;
-
-        if (encoding === 'url') {
-          console.log('[GamePage] Loading ROM from URL (Blossom)');
-
-          // Get URL from url tag
-          const urlTag = getTag(event, 'url');
-          const romUrl = urlTag?.[1];
-
-          if (!romUrl) {
-            throw new Error('encoding=url specified but no url tag found');
-          }
-
-          console.log('[GamePage] Fetching ROM from URL:', romUrl);
-
-          try {
-            const response = await fetch(romUrl, {
-              method: 'GET',
-              mode: 'cors',
-              credentials: 'omit'
-            });
-
-            if (!response.ok) {
-              throw new Error(`HTTP error! status: ${response.status}`);
-            }
-
-            const arrayBuffer = await response.arrayBuffer();
-            romBytes = new Uint8Array(arrayBuffer);
-            console.log('[GamePage] ROM fetched from URL, size:', romBytes.length, 'bytes');
-
-          } catch (fetchError) {
-            throw new Error(`Failed to fetch ROM from URL: ${fetchError instanceof Error ? fetchError.message : 'Network error'}`);
-          }
-
-        } else if (encoding === 'base64' || !encoding) {
-          // Legacy base64 encoding
-          console.log('[GamePage] Decoding base64 ROM from event content');
-
-          try {
-            romBytes = decodeBase64ToBytes(event.content);
-            console.log('[GamePage] ROM decoded, size:', romBytes.length, 'bytes');
-          } catch (decodeError) {
-            throw new Error(`Failed to decode base64 ROM: ${decodeError instanceof Error ? decodeError.message : 'Invalid base64 data'}`);
-          }
-
-        } else {
-          throw new Error(`Unsupported encoding: ${encoding}. Expected 'base64' or 'url'.`);
-        }
-
-        // Keep platform as raw value (*-rom), let EmulatorIFrame handle mapping
-        setPlatform(detectedPlatform);
-        console.log('[GamePage] Platform detected:', detectedPlatform);
-
-        // Integrity check for Blossom URLs
-        if (encoding === 'url') {
-          console.log('[GamePage] Performing integrity check for Blossom ROM');
-
-          // Get expected hash from various possible tags
-          const expectedHash = getTag(event, 'sha256')?.[1] ||
-                              getTag(event, 'x')?.[1] ||
-                              getTag(event, 'ox')?.[1];
-
-          if (expectedHash) {
-            console.log('[GamePage] Expected hash found:', expectedHash);
-            const actualHash = await sha256(romBytes);
-
-            if (actualHash !== expectedHash) {
-              throw new Error(`ROM integrity check failed. Expected SHA256: ${expectedHash.substring(0, 8)}..., got: ${actualHash.substring(0, 8)}...`);
-            }
-            console.log('[GamePage] Integrity check passed');
-          } else {
-            console.log('[GamePage] No integrity hash found, skipping verification');
-          }
-        }
+        // Decode ROM (base64 content or Blossom URL with integrity check)
+        const romBytes = await loadRomFromEvent(event);
 
         // Platform-specific ROM validation and processing
         if (detectedPlatform === 'nes-rom') {
@@ -466,16 +404,28 @@ export default function GamePage() {
         <div className="grid gap-6 lg:grid-cols-4 lg:gap-8">
           {/* Main game area - full width on mobile, 3/4 on desktop */}
           <div className="lg:col-span-3">
-            <EmulatorIFrame
-              key={`${id}-${romInfo?.sha256?.slice(0,8) ?? 'nohash'}-${reloadToken}`}
-              romData={romData}
-              platform={platform}
-              title={gameMeta.title}
-              className="w-full"
-              ref={emulatorRef}
-              isHost={isMultiplayer}
-              addVideoTrackToPeerConnection={undefined} // This will be passed from MultiplayerCard if needed
-            />
+            {useWasmCore ? (
+              <NesCorePlayer
+                key={`${id}-${romInfo?.sha256?.slice(0,8) ?? 'nohash'}-${reloadToken}`}
+                romData={romData}
+                title={gameMeta.title}
+                className="w-full"
+                ref={coreRef}
+                onReady={setCore}
+                onError={handleCoreError}
+              />
+            ) : (
+              <EmulatorIFrame
+                key={`${id}-${romInfo?.sha256?.slice(0,8) ?? 'nohash'}-${reloadToken}`}
+                romData={romData}
+                platform={platform}
+                title={gameMeta.title}
+                className="w-full"
+                ref={emulatorRef}
+                isHost={isMultiplayer}
+                addVideoTrackToPeerConnection={undefined} // This will be passed from MultiplayerCard if needed
+              />
+            )}
           </div>
 
           {/* Side panel - full width on mobile, 1/4 on desktop */}
@@ -490,6 +440,7 @@ export default function GamePage() {
                   getGameStream={getGameCanvas}
                   maxPlayers={maxPlayers}
                   defaultExpanded={false} // Collapsed by default on mobile
+                  netplay={useWasmCore ? { player: coreRef, core } : undefined}
                 />
               ) : (
                 <GameInteractionCard challengeStarted={challengeStarted} />
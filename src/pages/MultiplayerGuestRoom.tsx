@@ -3,20 +3,26 @@
  *
  * For guests joining multiplayer sessions. Uses a video element instead of NesPlayer
  * to receive the host's game stream via WebRTC. Maintains visual consistency with
- * the host room while providing a spectator/guest experience.
+ * the host room while providing a spectator/guest experience. In sessions the
+ * host runs on the C core, the guest runs the game too (NesCorePlayer) and
+ * plays its port through rollback netplay (useCoreNetplay).
  */
 
 import { useState, useEffect, useRef } from 'react';
-import { useParams, useNavigate, Link } from 'react-router-dom';
+import { useParams, useNavigate, useSearchParams, Link } from 'react-router-dom';
 import { Button } from '@/components/ui/button';
 import { Card, CardContent } from '@/components/ui/card';
 import { Badge } from '@/components/ui/badge';
 import { ArrowLeft, RefreshCw, Users, Wifi, WifiOff, Play } from 'lucide-react';
 import MultiplayerChat from '@/components/MultiplayerChat';
+import NesCorePlayer, { NesCorePlayerRef } from '@/components/NesCorePlayer';
 import GameControls from '@/components/GameControls';
 import { useCurrentUser } from '@/hooks/useCurrentUser';
 import { useAuthor } from '@/hooks/useAuthor';
 import { useMultiplayerSession } from '@/hooks/useMultiplayerSession';
+import { useCoreNetplay } from '@/hooks/useCoreNetplay';
+import type { NesCore } from '@/emulator/NesCore';
+import { loadRomFromEvent } from '@/emulator/utils/rom';
 import { useNostr } from '@jsr/nostrify__react';
 import { useAppContext } from '@/hooks/useAppContext';
 import { genUserName } from '@/lib/genUserName';
@@ -62,6 +68,7 @@ export default function MultiplayerGuestRoom() {
   const { sessionId: raw } = useParams<{ sessionId: string }>();
   const sessionId = raw ? decodeURIComponent(raw) : '';
   const navigate = useNavigate();
+  const [searchParams] = useSearchParams();
   const { user } = useCurrentUser();
   const videoRef = useRef<HTMLVideoElement>(null);
   const { nostr } = useNostr();
@@ -71,6 +78,7 @@ export default function MultiplayerGuestRoom() {
   const { gameId: parsedGameId } = parseSessionId(sessionId);
 
   // Use the multiplayer session hook
+  const multiplayer = useMultiplayerSession(parsedGameId);
   const {
     session,
     status,
@@ -80,7 +88,27 @@ export default function MultiplayerGuestRoom() {
     leaveSession,
     sendChatMessage,
     sendGameInput,
-  } = useMultiplayerSession(parsedGameId);
+    playerIndex: assignedPlayerIndex,
+  } = multiplayer;
+
+  // Core sessions: this guest runs the game from the host's state, and
+  // watches it (input stream only) with ?watch or when no port is left;
+  // ?watch=tiles shows the host's tile video instead of running the game
+  const coreMode = session?.netplay === 'core';
+  const maxPlayers = session?.maxPlayers ?? 2;
+  const tileViewing = searchParams.get('watch') === 'tiles';
+  const spectating = searchParams.has('watch') || assignedPlayerIndex > maxPlayers;
+  const corePlayerRef = useRef<NesCorePlayerRef>(null);
+  const [core, setCore] = useState<NesCore | null>(null);
+  const [romData, setRomData] = useState<Uint8Array | null>(null);
+  const [gameEvent, setGameEvent] = useState<{ content: string; tags: string[][] } | null>(null);
+  const { joined, joinStats } = useCoreNetplay({
+    role: coreMode ? (tileViewing ? 'viewer' : spectating ? 'spectator' : 'player') : null,
+    player: corePlayerRef,
+    core,
+    multiplayer,
+    players: maxPlayers,
+  });
 
   // State management
   const [connectionState, setConnectionState] = useState<ConnectionState>('connecting');
@@ -132,6 +160,12 @@ export default function MultiplayerGuestRoom() {
   };
 
   // Update player index when session is established
+  useEffect(() => {
+    if (assignedPlayerIndex >= 2 && assignedPlayerIndex <= 4) {
+      setPlayerIndex(assignedPlayerIndex);
+    }
+  }, [assignedPlayerIndex]);
+
   useEffect(() => {
     if (sessionId) {
       const storedIndex = localStorage.getItem(`playerIndex_${sessionId}`);
@@ -145,9 +179,9 @@ export default function MultiplayerGuestRoom() {
     }
   }, [sessionId]);
 
-  // Handle input focus and event listeners
+  // Handle input focus and event listeners (the core player reads its own keys)
   useEffect(() => {
-    if (!focused) return;
+    if (!focused || coreMode) return;
 
     const onKeyDown = (e: KeyboardEvent) => {
       const k = mapKey(e);
@@ -194,7 +228,7 @@ export default function MultiplayerGuestRoom() {
       const currentPressed = pressedRef.current;
       currentPressed.clear();
     };
-  }, [focused, sendGameInput, playerIndex]);
+  }, [focused, sendGameInput, playerIndex, coreMode]);
 
   // Handle ESC key to exit focus
   useEffect(() => {
@@ -312,6 +346,7 @@ export default function MultiplayerGuestRoom() {
 
         if (gameEvents.length > 0) {
           const gameEvent = gameEvents[0];
+          setGameEvent(gameEvent);
 
           // Parse game metadata
           const getTagValue = (tagName: string): string | undefined => {
@@ -342,6 +377,26 @@ export default function MultiplayerGuestRoom() {
     fetchGameMetadata();
   }, [parsedGameId, nostr, config.relayUrl]);
 
+  // Core sessions need the game's ROM
+  useEffect(() => {
+    if (!coreMode || !gameEvent || romData) return;
+    loadRomFromEvent(gameEvent)
+      .then(setRomData)
+      .catch((err) => {
+        console.error('[GuestRoom] Failed to load ROM:', err);
+        setError(err instanceof Error ? err.message : 'Failed to load ROM');
+        setConnectionState('error');
+      });
+  }, [coreMode, gameEvent, romData]);
+
+  // Playing from the host's state counts as receiving the game
+  useEffect(() => {
+    if (joined) {
+      setIsStreamActive(true);
+      setConnectionState('receiving');
+    }
+  }, [joined]);
+
   /**
    * Retry connection
    */
@@ -541,7 +596,29 @@ export default function MultiplayerGuestRoom() {
         <div className="grid lg:grid-cols-4 gap-8">
           {/* Main video area */}
           <div className="lg:col-span-3 space-y-6">
-            {/* Video Stream */}
+            {coreMode ? (
+              romData ? (
+                <div className="relative">
+                  <NesCorePlayer
+                    romData={romData}
+                    title={gameMeta?.title}
+                    className="w-full"
+                    ref={corePlayerRef}
+                    onReady={setCore}
+                  />
+                  {!joined && (
+                    <div className="absolute top-4 left-4 bg-gray-900/80 backdrop-blur-sm rounded px-3 py-2 text-sm text-gray-300">
+                      Joining the host's game...
+                    </div>
+                  )}
+                </div>
+              ) : (
+                <div className="relative bg-gray-900 rounded-lg overflow-hidden aspect-video flex items-center justify-center">
+                  <p className="text-gray-400">Loading game...</p>
+                </div>
+              )
+            ) : (
+            /* Video Stream */
             <div className="relative bg-gray-900 rounded-lg overflow-hidden aspect-video">
               {/* Video element - hidden until stream is received */}
               <div className="relative bg-gray-900 rounded-lg overflow-hidden aspect-video">
@@ -606,6 +683,7 @@ export default function MultiplayerGuestRoom() {
                 </div>
               )}
             </div>
+            )}
 
             {/* Game Controls below video - for input if implemented */}
             {isStreamActive && <GameControls />}
@@ -708,10 +786,16 @@ export default function MultiplayerGuestRoom() {
                   <div className="pt-2 border-t border-gray-800">
                     <span className="text-gray-500">Session:</span>
                     <div className="text-xs text-gray-400 mt-1 space-y-1">
-                      <div>Mode: Player {playerIndex}</div>
+                      <div>Mode: {coreMode && spectating ? 'Spectator' : `Player ${playerIndex}`}</div>
                       <div>Game ID: {gameId}</div>
                       <div>Host: {hostDisplayName}</div>
                       <div>Status: {connectionInfo.text}</div>
+                      {joinStats && (
+                        <div>
+                          Joined in {joinStats.joinMillis.toFixed(0)} ms
+                          ({(joinStats.compressedBytes / 1024).toFixed(1)} KB state, {joinStats.fastForwardFrames} frames caught up)
+                        </div>
+                      )}
                     </div>
                   </div>
 